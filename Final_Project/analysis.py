@@ -2,16 +2,10 @@ import sys
 import numpy as np
 import math
 import symnmfmodule
-import kmeans
-from sklearn.metrics import silhouette_score
 from symnmf import initialize_H, compute_data_matrix
 
 MAX_ITER = 300
 
-def closest_centroid(vector, centroids):
-    distances = np.linalg.norm(np.array(centroids) - np.array(vector), axis=1)
-    return np.argmin(distances)
-
 def symnmf_clustering(data_matrix, k):
     n = len(data_matrix)
     W = symnmfmodule.norm(data_matrix)
@@ -22,8 +16,8 @@ def symnmf_clustering(data_matrix, k):
     return symnmf_indexes
 
 def kmeans_clustering(data_matrix, k):
-    centroids = kmeans.k_means(k, MAX_ITER, data_matrix)
-    return [closest_centroid(vector, centroids) for vector in data_matrix]
+    _, labels, _ = symnmfmodule.kmeans(data_matrix, k, MAX_ITER) #native Lloyd, same rules as kmeans.py
+    return labels
 
 def main():
     k = int(sys.argv[1])
@@ -32,10 +26,11 @@ def main():
     data_matrix = compute_data_matrix(file_name) #load data
 
     symnmf_values = symnmf_clustering(data_matrix, k)
-    symnmf_score = silhouette_score(data_matrix, symnmf_values)
-
     kmeans_values = kmeans_clustering(data_matrix, k) 
-    kmeans_score = silhouette_score(data_matrix, kmeans_values)
+
+    #both labelings are scored in a single pass over the pairwise distances
+    symnmf_score, kmeans_score = symnmfmodule.silhouette(data_matrix, [[int(x) for x in symnmf_values],
+                                                                       kmeans_values])
 
     print("nmf: %.4f" % symnmf_score)
     print("kmeans: %.4f" % kmeans_score)
@@ -0,0 +1,269 @@
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "symnmf.h"
+#include "arena.h"
+
+/* The single buffer of a caller-supplied backend */
+typedef struct buffer_ctx {
+    void* buffer;
+    size_t size;
+    int taken;
+} buffer_ctx;
+
+/**
+ * @brief malloc backend, reserve
+ */
+static void* malloc_reserve(size_t bytes, void* ctx){
+    (void)ctx;
+    return malloc(bytes);
+}
+
+/**
+ * @brief malloc backend, release
+ */
+static void malloc_release(void* block, size_t bytes, void* ctx){
+    (void)bytes, (void)ctx;
+    free(block);
+}
+
+/**
+ * @brief Huge-page backend, reserve: an anonymous mapping backed by explicit huge pages when
+ * the system has some, otherwise a regular mapping marked for transparent huge pages
+ */
+static void* huge_page_reserve(size_t bytes, void* ctx){
+    void* block = MAP_FAILED;
+    (void)ctx;
+#ifdef MAP_HUGETLB
+    block = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (block == MAP_FAILED){
+        block = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (block == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+        madvise(block, bytes, MADV_HUGEPAGE);
+#endif
+    }
+    return block;
+}
+
+/**
+ * @brief Huge-page backend, release
+ */
+static void huge_page_release(void* block, size_t bytes, void* ctx){
+    (void)ctx;
+    munmap(block, bytes);
+}
+
+/**
+ * @brief Buffer backend, reserve: hands out the caller's buffer once, if it is large enough
+ */
+static void* buffer_reserve(size_t bytes, void* ctx){
+    buffer_ctx* buffer = (buffer_ctx*)ctx;
+    if (buffer->taken || bytes > buffer->size) return NULL;
+    buffer->taken = 1;
+    return buffer->buffer;
+}
+
+/**
+ * @brief Buffer backend, release: the buffer stays owned by the caller
+ */
+static void buffer_release(void* block, size_t bytes, void* ctx){
+    (void)block, (void)bytes;
+    ((buffer_ctx*)ctx)->taken = 0;
+}
+
+/**
+ * @brief Backend taking its blocks from malloc
+ *
+ * @return arena_backend The backend
+ */
+arena_backend malloc_backend(void){
+    arena_backend backend;
+    backend.name = "malloc", backend.reserve = malloc_reserve, backend.release = malloc_release, backend.ctx = NULL;
+    return backend;
+}
+
+/**
+ * @brief Backend taking its blocks from anonymous mmap with huge pages (blocks are rounded up
+ * to ARENA_HUGE_PAGE by the arena)
+ *
+ * @return arena_backend The backend
+ */
+arena_backend huge_page_backend(void){
+    arena_backend backend;
+    backend.name = "hugepage", backend.reserve = huge_page_reserve, backend.release = huge_page_release, backend.ctx = NULL;
+    return backend;
+}
+
+/**
+ * @brief Backend serving a single caller-supplied buffer; an arena on it fails (exits like
+ * create_matrix) once the buffer is full. The returned backend keeps a pointer to a context
+ * allocated here, released with the backend's arena by arena_destroy.
+ *
+ * @param buffer The buffer, owned by the caller
+ * @param size Size of the buffer in bytes
+ * @return arena_backend The backend
+ */
+arena_backend buffer_backend(void* buffer, size_t size){
+    arena_backend backend;
+    buffer_ctx* ctx = malloc(sizeof(buffer_ctx));
+    if (check_pointer(ctx)) exit(1);
+    ctx->buffer = buffer, ctx->size = size, ctx->taken = 0;
+    backend.name = "buffer", backend.reserve = buffer_reserve, backend.release = buffer_release, backend.ctx = ctx;
+    return backend;
+}
+
+/**
+ * @brief The backend named by SYMNMF_ARENA ("malloc" or "hugepage"), malloc by default
+ *
+ * @return arena_backend The backend
+ */
+arena_backend env_backend(void){
+    const char* name = getenv(ARENA_ENV);
+    if (name != NULL && strcmp(name, "hugepage") == 0) return huge_page_backend();
+    return malloc_backend();
+}
+
+/**
+ * @brief Initializes an empty arena, no memory is reserved until the first allocation
+ *
+ * @param a The arena
+ * @param backend Where the blocks come from
+ * @param block_size Minimum size of a block, 0 for ARENA_BLOCK_SIZE
+ */
+void arena_init(arena* a, const arena_backend* backend, size_t block_size){
+    a->backend = *backend;
+    a->first = NULL, a->current = NULL;
+    a->block_size = block_size > 0 ? block_size : ARENA_BLOCK_SIZE;
+    a->in_use = 0, a->high_water = 0, a->reserved = 0, a->allocations = 0;
+}
+
+/**
+ * @brief Gets a new block of at least bytes usable bytes from the backend
+ *
+ * @param a The arena
+ * @param bytes Needed bytes
+ * @return arena_block* The block, NULL on failure
+ */
+static arena_block* reserve_block(arena* a, size_t bytes){
+    size_t header = (sizeof(arena_block) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    size_t total = header + (bytes > a->block_size ? bytes : a->block_size);
+    arena_block* block;
+    if (a->backend.reserve == huge_page_reserve) total = (total + ARENA_HUGE_PAGE - 1) / ARENA_HUGE_PAGE * ARENA_HUGE_PAGE;
+    block = (arena_block*)a->backend.reserve(total, a->backend.ctx);
+    if (block == NULL) return NULL;
+    block->next = NULL, block->size = total - header, block->used = 0;
+    a->reserved += total;
+    return block;
+}
+
+/**
+ * @brief First usable byte of a block
+ */
+static char* block_data(arena_block* block){
+    return (char*)block + (sizeof(arena_block) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+}
+
+/**
+ * @brief Allocates ARENA_ALIGN-aligned memory by bumping the current block. When it is full
+ * the next cached block is reused (blocks survive resets), or a new one is reserved.
+ * Exits on failure, like create_matrix.
+ *
+ * @param a The arena
+ * @param bytes Needed bytes
+ * @return void* The memory, not zeroed
+ */
+void* arena_alloc(arena* a, size_t bytes){
+    arena_block* block;
+    void* ptr;
+    bytes = (bytes + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    if (a->current == NULL || a->current->used + bytes > a->current->size){
+        block = a->current != NULL ? a->current->next : a->first;
+        if (block != NULL && block->size >= bytes){
+            block->used = 0;
+        } else {
+            block = reserve_block(a, bytes);
+            if (check_pointer(block)) exit(1);
+            if (a->current == NULL){ /* new first block, the old chain (if any) follows */
+                block->next = a->first;
+                a->first = block;
+            } else {
+                block->next = a->current->next;
+                a->current->next = block;
+            }
+        }
+        a->current = block;
+    }
+    ptr = block_data(a->current) + a->current->used;
+    a->current->used += bytes;
+    a->in_use += bytes;
+    if (a->in_use > a->high_water) a->high_water = a->in_use;
+    a->allocations++;
+    return ptr;
+}
+
+/**
+ * @brief Allocates a zeroed matrix from the arena (the same layout as create_matrix, a row
+ * pointer array over one contiguous block of rows * columns doubles)
+ *
+ * @param a The arena
+ * @param rows Number of rows
+ * @param columns Number of columns
+ * @return double** The matrix, released by arena_reset or arena_destroy only
+ */
+double** arena_matrix(arena* a, int rows, int columns){
+    double** matrix = arena_alloc(a, (rows > 0 ? rows : 1) * sizeof(double*));
+    double* values = arena_alloc(a, (size_t)(rows > 0 ? rows : 1) * (columns > 0 ? columns : 1) * sizeof(double));
+    int i;
+    memset(values, 0, (size_t)rows * columns * sizeof(double));
+    for (i = 0; i < rows; i++) matrix[i] = values + (size_t)i * columns;
+    return matrix;
+}
+
+/**
+ * @brief Remembers the current position of the arena
+ *
+ * @param a The arena
+ * @return arena_mark The position
+ */
+arena_mark arena_save(const arena* a){
+    arena_mark mark;
+    mark.block = a->current;
+    mark.used = a->current != NULL ? a->current->used : 0;
+    mark.in_use = a->in_use;
+    return mark;
+}
+
+/**
+ * @brief Releases everything allocated after a mark in O(1); the blocks stay cached
+ *
+ * @param a The arena
+ * @param mark A position from arena_save
+ */
+void arena_reset(arena* a, arena_mark mark){
+    a->current = mark.block;
+    if (a->current != NULL) a->current->used = mark.used;
+    a->in_use = mark.in_use;
+}
+
+/**
+ * @brief Returns every block to the backend
+ *
+ * @param a The arena
+ */
+void arena_destroy(arena* a){
+    arena_block *block = a->first, *next;
+    size_t header = (sizeof(arena_block) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    while (block != NULL){
+        next = block->next;
+        a->backend.release(block, block->size + header, a->backend.ctx);
+        block = next;
+    }
+    if (a->backend.release == buffer_release) free(a->backend.ctx);
+    a->first = NULL, a->current = NULL, a->in_use = 0;
+}
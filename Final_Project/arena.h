@@ -0,0 +1,58 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* Constants */
+#define ARENA_ENV "SYMNMF_ARENA"
+#define ARENA_BLOCK_SIZE (1 << 20)
+#define ARENA_ALIGN 16
+#define ARENA_HUGE_PAGE (2UL << 20)
+
+/* Where an arena gets its blocks from: reserve returns at least bytes (NULL on failure) */
+typedef struct arena_backend {
+    const char* name;
+    void* (*reserve)(size_t bytes, void* ctx);
+    void (*release)(void* block, size_t bytes, void* ctx);
+    void* ctx;
+} arena_backend;
+
+/* A block of memory handed out by bumping a pointer */
+typedef struct arena_block {
+    struct arena_block* next;
+    size_t size; /* usable bytes after the header */
+    size_t used;
+} arena_block;
+
+/* A bump allocator over a chain of blocks; blocks survive a reset and are reused */
+typedef struct arena {
+    arena_backend backend;
+    arena_block* first;
+    arena_block* current;
+    size_t block_size;
+    size_t in_use;      /* bytes handed out since the last reset to empty */
+    size_t high_water;  /* largest in_use ever reached */
+    size_t reserved;    /* bytes obtained from the backend */
+    size_t allocations; /* number of arena_alloc calls */
+} arena;
+
+/* A position to come back to with arena_reset, everything allocated after it is released */
+typedef struct arena_mark {
+    arena_block* block;
+    size_t used;
+    size_t in_use;
+} arena_mark;
+
+/* Function declarations from arena.c */
+arena_backend malloc_backend(void);
+arena_backend huge_page_backend(void);
+arena_backend buffer_backend(void* buffer, size_t size);
+arena_backend env_backend(void);
+void arena_init(arena* a, const arena_backend* backend, size_t block_size);
+void* arena_alloc(arena* a, size_t bytes);
+double** arena_matrix(arena* a, int rows, int columns);
+arena_mark arena_save(const arena* a);
+void arena_reset(arena* a, arena_mark mark);
+void arena_destroy(arena* a);
+
+#endif
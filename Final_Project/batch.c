@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "symnmf.h"
+#include "parallel.h"
+#include "placement.h"
+#include "batch.h"
+
+/* Shared context of a batch, every job only writes to its own entry */
+typedef struct batch_pass {
+    batch_job* jobs;
+    int goal;
+    unsigned long seed;
+} batch_pass;
+
+static const char* BATCH_GOALS[] = {"sym", "ddg", "norm", "symnmf"};
+
+/**
+ * @brief Finds a batch goal by name
+ *
+ * @param name "sym", "ddg", "norm" or "symnmf"
+ * @return int The batch_goal, -1 for an unknown name
+ */
+int find_batch_goal(const char* name){
+    int i;
+    for (i = 0; i < (int)(sizeof(BATCH_GOALS) / sizeof(BATCH_GOALS[0])); i++){
+        if (strcmp(BATCH_GOALS[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Whether a line holds nothing but whitespace
+ *
+ * @param line Start of the line
+ * @return int 1 for a blank line
+ */
+static int blank_line(const char* line){
+    while (*line != '\0' && *line != '\n'){
+        if (!isspace((unsigned char)*line)) return 0;
+        line++;
+    }
+    return 1;
+}
+
+/**
+ * @brief Start of the line after the one at line
+ *
+ * @param line Start of a line
+ * @return const char* The next line, at the terminating '\0' after the last one
+ */
+static const char* next_line(const char* line){
+    const char* end = strchr(line, '\n');
+    return end != NULL ? end + 1 : line + strlen(line);
+}
+
+/**
+ * @brief Parses comma-separated points from a text buffer, one point per line, blank lines
+ * skipped. Unlike compute_data_matrix it reads lines of any length and rejects ragged rows.
+ *
+ * @param text The text, '\0'-terminated
+ * @param n Output, number of points
+ * @param d Output, dimension of every point
+ * @return double** The n x d points, NULL for an empty or malformed text
+ */
+double** parse_points(const char* text, int* n, int* d){
+    const char *line, *cursor;
+    char* end = NULL;
+    double** points;
+    int i, j;
+
+    *n = 0, *d = 0;
+    for (line = text; *line != '\0'; line = next_line(line)){
+        if (blank_line(line)) continue;
+        if (*n == 0){
+            for (*d = 1, cursor = line; *cursor != '\0' && *cursor != '\n'; cursor++) *d += *cursor == ',';
+        }
+        (*n)++;
+    }
+    if (*n == 0) return NULL;
+
+    points = create_matrix(*n, *d);
+    for (i = 0, line = text; *line != '\0'; line = next_line(line)){
+        if (blank_line(line)) continue;
+        for (j = 0, cursor = line; j < *d; j++){
+            while (*cursor == ' ' || *cursor == '\t') cursor++;
+            if (*cursor == '\n' || *cursor == '\0') break; /* strtod would read on into the next line */
+            points[i][j] = strtod(cursor, &end);
+            if (end == cursor || (j < *d - 1 && *end != ',')) break;
+            cursor = end + 1;
+        }
+        if (j < *d || !blank_line(end)){ /* a short, long or unparsable row */
+            free_matrix(points, *n);
+            return NULL;
+        }
+        i++;
+    }
+    return points;
+}
+
+/**
+ * @brief Draws an initial H from a seed with the bound of initialize_H, 2*sqrt(mean(W)/k)
+ *
+ * @param W Normalized similarity matrix
+ * @param n Number of rows and columns in W
+ * @param k Number of columns in H
+ * @param seed Seed of the generator
+ * @return double** The n x k matrix H
+ */
+double** seeded_H(double** W, int n, int k, unsigned long seed){
+    double total = 0;
+    int i, j;
+
+    for (i = 0; i < n; i++){
+        for (j = 0; j < n; j++) total += W[i][j];
+    }
+    return seeded_H_sum(total, n, k, seed);
+}
+
+/**
+ * @brief seeded_H from the sum of the entries of W, for a W that is not held as a dense matrix
+ *
+ * @param total Sum of the entries of W
+ * @param n Number of rows and columns in W
+ * @param k Number of columns in H
+ * @param seed Seed of the generator
+ * @return double** The n x k matrix H
+ */
+double** seeded_H_sum(double total, int n, int k, unsigned long seed){
+    double **H, bound;
+    unsigned long state = seed;
+    int i, j;
+
+    bound = 2 * sqrt(total / ((double)n * n) / k);
+    H = create_matrix(n, k);
+    for (i = 0; i < n; i++){
+        for (j = 0; j < k; j++) H[i][j] = bound * rand_uniform(&state);
+    }
+    return H;
+}
+
+/**
+ * @brief Runs the symNMF pipeline of one job: W from its points, H from seeded_H, then the
+ * multiplicative updates
+ *
+ * @param job The job, its points already parsed
+ * @param seed Seed of the initial H
+ */
+static void run_symnmf_job(batch_job* job, unsigned long seed){
+    double **W, **H;
+
+    W = compute_goals(job->data, NULL, "norm", job->n, job->d);
+    H = seeded_H(W, job->n, job->k, seed);
+    job->result = optimize_H_solver(H, W, job->n, job->k, find_solver(NULL), &job->iterations, NULL);
+    job->rows = job->n, job->columns = job->k;
+    free_placed_matrix(W, job->n, job->n);
+}
+
+/**
+ * @brief Task of parallel_steal running the jobs [begin, end): parse, then the goal
+ *
+ * @param ctx A batch_pass
+ * @param begin First job
+ * @param end One past the last job
+ */
+static void run_jobs(void* ctx, int begin, int end){
+    batch_pass* pass = (batch_pass*)ctx;
+    batch_job* job;
+    int j;
+
+    for (j = begin; j < end; j++){
+        job = &pass->jobs[j];
+        if (job->text != NULL){
+            job->data = parse_points(job->text, &job->n, &job->d);
+            free(job->text), job->text = NULL;
+        }
+        if (job->data == NULL || job->n <= 0 || (pass->goal == BATCH_SYMNMF && (job->k <= 0 || job->k >= job->n))){
+            job->status = 1;
+            continue;
+        }
+        if (pass->goal == BATCH_SYMNMF){
+            run_symnmf_job(job, pass->seed);
+        } else {
+            job->result = compute_goals(job->data, NULL, BATCH_GOALS[pass->goal], job->n, job->d);
+            job->rows = job->columns = job->n, job->placed = 1;
+        }
+    }
+}
+
+/**
+ * @brief Runs the same goal on many independent datasets. The jobs are scheduled over a
+ * work-stealing pool, one dataset at a time, so a few large datasets do not hold the rest
+ * back, and every dataset runs single-threaded on its worker.
+ *
+ * @param jobs The jobs, their points given as data or text; results are written in place
+ * @param count Number of jobs
+ * @param goal A batch_goal
+ * @param seed Seed of the initial H of every BATCH_SYMNMF job
+ */
+void batch_run(batch_job* jobs, int count, int goal, unsigned long seed){
+    batch_pass pass;
+    int j;
+    for (j = 0; j < count; j++){
+        jobs[j].result = NULL, jobs[j].rows = jobs[j].columns = 0, jobs[j].placed = 0;
+        jobs[j].iterations = 0, jobs[j].status = 0;
+    }
+    pass.jobs = jobs, pass.goal = goal, pass.seed = seed;
+    parallel_steal(count, run_jobs, &pass);
+}
+
+/**
+ * @brief Frees the text, points and result of every job
+ *
+ * @param jobs The jobs
+ * @param count Number of jobs
+ */
+void free_batch_jobs(batch_job* jobs, int count){
+    int j;
+    for (j = 0; j < count; j++){
+        free(jobs[j].text);
+        if (jobs[j].data != NULL) free_matrix(jobs[j].data, jobs[j].n);
+        if (jobs[j].result != NULL && jobs[j].placed) free_placed_matrix(jobs[j].result, jobs[j].rows, jobs[j].columns);
+        else if (jobs[j].result != NULL) free_matrix(jobs[j].result, jobs[j].rows);
+        jobs[j].text = NULL, jobs[j].data = NULL, jobs[j].result = NULL;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+/* Constants */
+#define BATCH_DEFAULT_SEED 1234
+
+/* What every job of a batch computes */
+typedef enum batch_goal {
+    BATCH_SYM,
+    BATCH_DDG,
+    BATCH_NORM,
+    BATCH_SYMNMF
+} batch_goal;
+
+/* One dataset of a batch and its result */
+typedef struct batch_job {
+    char* text;        /* comma-separated points parsed by the worker, NULL when data is given */
+    double** data;     /* n x d points, filled from text when it is given */
+    int n, d, k;       /* k is only used by BATCH_SYMNMF */
+    double** result;   /* rows x columns: the goal matrix, or H for BATCH_SYMNMF */
+    int rows, columns;
+    int placed;        /* result comes from create_placed_matrix (the goal matrices) */
+    int iterations;    /* updates of the symNMF loop */
+    int status;        /* 0 on success, 1 for unparsable text or an invalid k */
+} batch_job;
+
+/* Function declarations from batch.c */
+int find_batch_goal(const char* name);
+double** parse_points(const char* text, int* n, int* d);
+double** seeded_H(double** W, int n, int k, unsigned long seed);
+double** seeded_H_sum(double total, int n, int k, unsigned long seed);
+void batch_run(batch_job* jobs, int count, int goal, unsigned long seed);
+void free_batch_jobs(batch_job* jobs, int count);
+
+#endif
@@ -0,0 +1,400 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "symnmf.h"
+#include "packed.h"
+#include "kmeans.h"
+
+/* Constants */
+#define BENCH_DEFAULT_SIZES "250,500,1000"
+#define BENCH_DEFAULT_D 5
+#define BENCH_DEFAULT_K 5
+#define BENCH_DEFAULT_REPS 5
+#define BENCH_DEFAULT_SEED 1234
+#define BENCH_MAX_SIZES 32
+#define BENCH_CENTER_SPREAD 4.0
+
+/* One problem size: the generated points and the matrices the kernels start from */
+typedef struct bench_case {
+    int n, d, k;
+    unsigned long seed;
+    double** points;
+    double** A;  /* sym(points) */
+    double** D;  /* ddg(A) */
+    double** W;  /* norm(D, A) */
+    double** H;  /* initial H, drawn like initialize_H */
+} bench_case;
+
+/* Runs a kernel once on a case and returns the work done, in the unit of the kernel */
+typedef double (*bench_kernel)(const bench_case* c);
+
+/* A named kernel and the unit of its throughput */
+typedef struct bench_entry {
+    const char* name;
+    bench_kernel run;
+    const char* unit;
+    double scale; /* work per unit, 1e9 for GFLOP/s */
+} bench_entry;
+
+/* Timing summary of one kernel on one case */
+typedef struct bench_result {
+    const bench_entry* entry;
+    const bench_case* c;
+    int reps;
+    double mean, stddev, ci95, work;
+} bench_result;
+
+/**
+ * @brief Seconds on the monotonic clock
+ *
+ * @return double The time
+ */
+static double now_seconds(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Draws a standard normal number (Box-Muller) from the xorshift generator of symnmf.c
+ *
+ * @param state Generator state, updated in place
+ * @return double A N(0, 1) sample
+ */
+static double rand_normal(unsigned long* state){
+    double u = rand_uniform(state), v = rand_uniform(state);
+    if (u < 1e-300) u = 1e-300;
+    return sqrt(-2 * log(u)) * cos(2 * M_PI_VALUE * v);
+}
+
+/**
+ * @brief Builds a case: n points from k unit-variance gaussians in d dimensions with centers
+ * in [-BENCH_CENTER_SPREAD, BENCH_CENTER_SPREAD]^d, the matrices of the pipeline and an
+ * initial H in [0, 2*sqrt(mean(W)/k)]
+ *
+ * @param c The case to fill
+ * @param n Number of points
+ * @param d Dimension
+ * @param k Number of clusters
+ * @param seed Seed of the generator
+ */
+static void init_case(bench_case* c, int n, int d, int k, unsigned long seed){
+    double** centers = create_matrix(k, d);
+    double mean = 0, bound;
+    unsigned long state = seed;
+    int i, j, label;
+
+    c->n = n, c->d = d, c->k = k, c->seed = seed;
+    for (i = 0; i < k; i++){
+        for (j = 0; j < d; j++) centers[i][j] = BENCH_CENTER_SPREAD * (2 * rand_uniform(&state) - 1);
+    }
+    c->points = create_matrix(n, d);
+    for (i = 0; i < n; i++){
+        label = (int)(rand_uniform(&state) * k);
+        for (j = 0; j < d; j++) c->points[i][j] = centers[label][j] + rand_normal(&state);
+    }
+    free_matrix(centers, k);
+
+    c->A = sym(c->points, n, d);
+    c->D = ddg(c->A, n);
+    c->W = norm(c->D, c->A, n);
+    for (i = 0; i < n; i++){
+        for (j = 0; j < n; j++) mean += c->W[i][j];
+    }
+    bound = 2 * sqrt(mean / ((double)n * n) / k);
+    c->H = create_matrix(n, k);
+    for (i = 0; i < n; i++){
+        for (j = 0; j < k; j++) c->H[i][j] = bound * rand_uniform(&state);
+    }
+}
+
+/**
+ * @brief Frees the memory owned by a case
+ *
+ * @param c The case
+ */
+static void free_case(bench_case* c){
+    free_matrix(c->points, c->n), free_matrix(c->A, c->n), free_matrix(c->D, c->n);
+    free_matrix(c->W, c->n), free_matrix(c->H, c->n);
+}
+
+/**
+ * @brief Copies a n x k matrix
+ */
+static double** copy_of(double** M, int n, int k){
+    double** copy = create_matrix(n, k);
+    int i;
+    for (i = 0; i < n; i++) memcpy(copy[i], M[i], k * sizeof(double));
+    return copy;
+}
+
+/**
+ * @brief sym, dense: every ordered pair of points
+ */
+static double run_sym(const bench_case* c){
+    free_matrix(sym(c->points, c->n, c->d), c->n);
+    return (double)c->n * (c->n - 1);
+}
+
+/**
+ * @brief sym_packed: every unordered pair of points once
+ */
+static double run_sym_packed(const bench_case* c){
+    packed_matrix A;
+    if (sym_packed(&A, c->points, NULL, c->n, c->d)) exit(1);
+    free_packed_matrix(&A);
+    return (double)c->n * (c->n - 1) / 2;
+}
+
+/**
+ * @brief ddg, dense: n^2 additions
+ */
+static double run_ddg(const bench_case* c){
+    free_matrix(ddg(c->A, c->n), c->n);
+    return (double)c->n * c->n;
+}
+
+/**
+ * @brief norm, dense: 2n^2 multiplications
+ */
+static double run_norm(const bench_case* c){
+    free_matrix(norm(c->D, c->A, c->n), c->n);
+    return 2.0 * c->n * c->n;
+}
+
+/**
+ * @brief multiply_matrices, W*H: 2n^2k flops
+ */
+static double run_multiply(const bench_case* c){
+    free_matrix(multiply_matrices(c->W, c->H, c->n, c->n, c->n, c->k), c->n);
+    return 2.0 * c->n * c->n * c->k;
+}
+
+/**
+ * @brief update_H, one multiplicative step: W*H, HH^T and (HH^T)H, 6n^2k flops
+ */
+static double run_update_H(const bench_case* c){
+    free_matrix(update_H(c->H, c->W, c->n, c->k), c->n);
+    return 6.0 * c->n * c->n * c->k;
+}
+
+/**
+ * @brief optimize_H to convergence from the case's H, 6n^2k flops per iteration
+ */
+static double run_optimize_H(const bench_case* c){
+    int iterations = 0;
+    double** H = optimize_H_with(copy_of(c->H, c->n, c->k), c->W, c->n, c->k, update_H_scratch, &iterations, NULL);
+    free_matrix(H, c->n);
+    return 6.0 * c->n * c->n * c->k * iterations;
+}
+
+/**
+ * @brief Nearest-centroid assignment of every point, kmeans_fit with no update step
+ */
+static double run_assign(const bench_case* c){
+    double** centroids = create_matrix(c->k, c->d);
+    int* labels = malloc(c->n * sizeof(int));
+    if (check_pointer(labels)) exit(1);
+    kmeans_fit(c->points, c->n, c->d, c->k, 0, KMEANS_EPSILON, centroids, labels);
+    free_matrix(centroids, c->k), free(labels);
+    return c->n;
+}
+
+/**
+ * @brief kmeans_fit to convergence, points assigned per second over all the iterations
+ */
+static double run_kmeans(const bench_case* c){
+    double** centroids = create_matrix(c->k, c->d);
+    int* labels = malloc(c->n * sizeof(int));
+    int iterations;
+    if (check_pointer(labels)) exit(1);
+    iterations = kmeans_fit(c->points, c->n, c->d, c->k, KMEANS_MAX_ITER, KMEANS_EPSILON, centroids, labels);
+    free_matrix(centroids, c->k), free(labels);
+    return (double)c->n * (iterations + 1);
+}
+
+static const bench_entry KERNELS[] = {
+    {"sym", run_sym, "pairs/s", 1},
+    {"sym_packed", run_sym_packed, "pairs/s", 1},
+    {"ddg", run_ddg, "GFLOP/s", 1e9},
+    {"norm", run_norm, "GFLOP/s", 1e9},
+    {"multiply_matrices", run_multiply, "GFLOP/s", 1e9},
+    {"update_H", run_update_H, "GFLOP/s", 1e9},
+    {"optimize_H", run_optimize_H, "GFLOP/s", 1e9},
+    {"kmeans_fit_assign", run_assign, "points/s", 1},
+    {"kmeans_fit", run_kmeans, "points/s", 1}
+};
+
+#define KERNEL_COUNT ((int)(sizeof(KERNELS) / sizeof(KERNELS[0])))
+
+/**
+ * @brief Two-sided 95% quantile of Student's t distribution
+ *
+ * @param df Degrees of freedom
+ * @return double The quantile
+ */
+static double t95(int df){
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228};
+    if (df < 1) return 0;
+    if (df <= 10) return table[df - 1];
+    if (df <= 20) return 2.086;
+    if (df <= 30) return 2.042;
+    return 1.960;
+}
+
+/**
+ * @brief Times a kernel: one untimed warm-up run, then reps timed runs
+ *
+ * @param entry The kernel
+ * @param c The case
+ * @param reps Number of timed runs
+ * @return bench_result Mean, standard deviation and 95% confidence half-width of the run time
+ */
+static bench_result time_kernel(const bench_entry* entry, const bench_case* c, int reps){
+    bench_result result;
+    double *times = malloc(reps * sizeof(double)), start, sum = 0, sq = 0;
+    int r;
+    if (check_pointer(times)) exit(1);
+    result.entry = entry, result.c = c, result.reps = reps;
+    result.work = entry->run(c);
+    for (r = 0; r < reps; r++){
+        start = now_seconds();
+        entry->run(c);
+        times[r] = now_seconds() - start;
+        sum += times[r];
+    }
+    result.mean = sum / reps;
+    for (r = 0; r < reps; r++) sq += (times[r] - result.mean) * (times[r] - result.mean);
+    result.stddev = reps > 1 ? sqrt(sq / (reps - 1)) : 0;
+    result.ci95 = reps > 1 ? t95(reps - 1) * result.stddev / sqrt(reps) : 0;
+    free(times);
+    return result;
+}
+
+/**
+ * @brief Throughput at a given run time
+ */
+static double throughput(const bench_result* result, double seconds){
+    return seconds > 0 ? result->work / result->entry->scale / seconds : 0;
+}
+
+/**
+ * @brief Writes one result as a CSV row: the throughput bounds come from the confidence
+ * interval of the run time
+ */
+static void write_csv_row(FILE* out, const bench_result* r){
+    fprintf(out, "%s,%d,%d,%d,%d,%.6e,%.6e,%.6e,%.6e,%.6e,%.6e,%s\n", r->entry->name,
+            r->c->n, r->c->d, r->c->k, r->reps, r->mean, r->stddev, r->ci95,
+            throughput(r, r->mean), throughput(r, r->mean + r->ci95), throughput(r, r->mean - r->ci95),
+            r->entry->unit);
+}
+
+/**
+ * @brief Writes one result as a JSON object
+ */
+static void write_json_row(FILE* out, const bench_result* r, int first){
+    fprintf(out, "%s\n  {\"kernel\": \"%s\", \"n\": %d, \"d\": %d, \"k\": %d, \"reps\": %d, "
+            "\"mean_s\": %.6e, \"stddev_s\": %.6e, \"ci95_s\": %.6e, \"throughput\": %.6e, "
+            "\"throughput_low\": %.6e, \"throughput_high\": %.6e, \"unit\": \"%s\"}",
+            first ? "" : ",", r->entry->name, r->c->n, r->c->d, r->c->k, r->reps, r->mean,
+            r->stddev, r->ci95, throughput(r, r->mean), throughput(r, r->mean + r->ci95),
+            throughput(r, r->mean - r->ci95), r->entry->unit);
+}
+
+/**
+ * @brief Parses a comma-separated list of sizes
+ *
+ * @param list The list
+ * @param sizes Output array of BENCH_MAX_SIZES sizes
+ * @return int The number of sizes, 0 on a malformed list
+ */
+static int parse_sizes(const char* list, int* sizes){
+    int count = 0, consumed;
+    while (count < BENCH_MAX_SIZES && sscanf(list, "%d%n", &sizes[count], &consumed) == 1){
+        if (sizes[count] <= 0) return 0;
+        count++, list += consumed;
+        if (*list != ',') break;
+        list++;
+    }
+    return *list == '\0' ? count : 0;
+}
+
+/**
+ * @brief Whether a kernel is selected by a comma-separated list of names (NULL selects all)
+ */
+static int selected(const char* list, const char* name){
+    size_t len = strlen(name);
+    const char* at = list;
+    if (list == NULL) return 1;
+    while ((at = strstr(at, name)) != NULL){
+        if ((at == list || at[-1] == ',') && (at[len] == ',' || at[len] == '\0')) return 1;
+        at += len;
+    }
+    return 0;
+}
+
+/**
+ * @brief Benchmarks the core kernels over a sweep of sizes on seeded gaussian mixtures.
+ * Usage: bench [--sizes n1,n2,...] [--d d] [--k k] [--reps r] [--seed s]
+ *              [--kernels name1,name2,...] [--csv file] [--json file]
+ * The CSV goes to stdout unless --csv names a file, the JSON is written only with --json.
+ */
+int main(int argc, char** argv){
+    const char *size_list = BENCH_DEFAULT_SIZES, *kernels = NULL, *csv_name = NULL, *json_name = NULL;
+    int sizes[BENCH_MAX_SIZES], size_count, d = BENCH_DEFAULT_D, k = BENCH_DEFAULT_K;
+    int reps = BENCH_DEFAULT_REPS, i, s, first = 1;
+    unsigned long seed = BENCH_DEFAULT_SEED;
+    FILE *csv = stdout, *json = NULL;
+    bench_case c;
+    bench_result result;
+
+    for (i = 1; i + 1 < argc; i += 2){
+        if (strcmp(argv[i], "--sizes") == 0) size_list = argv[i + 1];
+        else if (strcmp(argv[i], "--d") == 0) d = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--k") == 0) k = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--reps") == 0) reps = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0) seed = strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--kernels") == 0) kernels = argv[i + 1];
+        else if (strcmp(argv[i], "--csv") == 0) csv_name = argv[i + 1];
+        else if (strcmp(argv[i], "--json") == 0) json_name = argv[i + 1];
+        else break;
+    }
+    size_count = parse_sizes(size_list, sizes);
+    if (i != argc || size_count == 0 || d <= 0 || k <= 1 || reps <= 0){
+        fprintf(stderr, "%s\n", ERROR_MESSAGE);
+        return 1;
+    }
+    if (csv_name != NULL) csv = fopen(csv_name, "w");
+    if (json_name != NULL) json = fopen(json_name, "w");
+    if (csv == NULL || (json_name != NULL && json == NULL)){
+        fprintf(stderr, "%s\n", ERROR_MESSAGE);
+        return 1;
+    }
+
+    fprintf(csv, "kernel,n,d,k,reps,mean_s,stddev_s,ci95_s,throughput,throughput_low,throughput_high,unit\n");
+    if (json != NULL) fprintf(json, "[");
+    for (s = 0; s < size_count; s++){
+        if (sizes[s] <= k) continue;
+        init_case(&c, sizes[s], d, k, seed);
+        for (i = 0; i < KERNEL_COUNT; i++){
+            if (!selected(kernels, KERNELS[i].name)) continue;
+            result = time_kernel(&KERNELS[i], &c, reps);
+            write_csv_row(csv, &result);
+            fflush(csv);
+            if (json != NULL) write_json_row(json, &result, first);
+            first = 0;
+        }
+        free_case(&c);
+    }
+    if (json != NULL){
+        fprintf(json, "\n]\n");
+        fclose(json);
+    }
+    if (csv != stdout) fclose(csv);
+    return 0;
+}
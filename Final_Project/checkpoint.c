@@ -0,0 +1,391 @@
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "checksum.h"
+
+static const char CHECKPOINT_MAGIC[8] = {'S', 'Y', 'M', 'N', 'M', 'F', 'C', 'K'};
+
+/* Fails to compile if the header stops being 72 bytes (a multiple of 8, so the doubles stay aligned) */
+typedef char checkpoint_header_size[sizeof(checkpoint_header) == 72 ? 1 : -1];
+
+/**
+ * @brief Prepares a checkpoint with no snapshot loaded
+ *
+ * @param cp The checkpoint
+ * @param path File of the snapshots
+ * @param kind CHECKPOINT_SYMNMF or CHECKPOINT_KMEANS
+ * @param interval Iterations between snapshots, 0 for snapshots only when the loop stops
+ * @param with_W Whether snapshots also hold W (symNMF only)
+ * @param seed Generator state that drew the initial iterate, recorded in every snapshot
+ */
+void checkpoint_init(checkpoint* cp, const char* path, int kind, int interval, int with_W, unsigned long seed){
+    cp->path = malloc(strlen(path) + 1);
+    if (check_pointer(cp->path)) exit(1);
+    strcpy(cp->path, path);
+    cp->kind = kind, cp->interval = interval > 0 ? interval : 0;
+    cp->with_W = with_W && kind == CHECKPOINT_SYMNMF, cp->seed = seed;
+    cp->iteration = 0, cp->finished = 0, cp->saved = 0;
+    cp->W_saved = 0, cp->W_checksum = 0;
+    cp->data_key[0] = cp->data_key[1] = 0;
+    cp->history = NULL, cp->history_length = cp->history_capacity = 0;
+}
+
+/**
+ * @brief Frees the memory owned by a checkpoint, the file is kept
+ *
+ * @param cp The checkpoint
+ */
+void checkpoint_destroy(checkpoint* cp){
+    free(cp->path), free(cp->history);
+    cp->path = NULL, cp->history = NULL;
+}
+
+/**
+ * @brief Records which input a run works on, hashed as the disk cache keys its points. A snapshot
+ * saved from other data (another W or other points of the same shape) is then not loaded.
+ * Called between checkpoint_init and checkpoint_load.
+ *
+ * @param cp The checkpoint
+ * @param data The input of the run: the points, or W when the points are not known
+ * @param rows Rows of data
+ * @param columns Columns of data
+ * @param weights Weight of every row, NULL for unit weights
+ */
+void checkpoint_fingerprint(checkpoint* cp, double** data, int rows, int columns, const double* weights){
+    unsigned long key[2];
+    unsigned int shape[3];
+    int i;
+
+    shape[0] = (unsigned int)rows, shape[1] = (unsigned int)columns, shape[2] = weights != NULL;
+    hash_init(key);
+    hash_bytes(key, shape, sizeof(shape));
+    for (i = 0; i < rows; i++) hash_bytes(key, data[i], columns * sizeof(double));
+    if (weights != NULL) hash_bytes(key, weights, rows * sizeof(double));
+    cp->data_key[0] = (unsigned int)key[0], cp->data_key[1] = (unsigned int)key[1];
+}
+
+/**
+ * @brief Number of doubles after the header of a checkpoint file
+ *
+ * @param header The header
+ * @return size_t The iterate and the history
+ */
+static size_t payload_length(const checkpoint_header* header){
+    return (size_t)header->rows * header->columns + 2 * (size_t)header->history_length;
+}
+
+/**
+ * @brief Path of the file holding the W of a checkpoint
+ *
+ * @param path The checkpoint file
+ * @return char* The path, to be freed
+ */
+static char* W_path(const char* path){
+    char* W_file = malloc(strlen(path) + sizeof(CHECKPOINT_W_SUFFIX));
+    if (check_pointer(W_file)) exit(1);
+    sprintf(W_file, "%s%s", path, CHECKPOINT_W_SUFFIX);
+    return W_file;
+}
+
+/**
+ * @brief Opens the W file of a checkpoint when it has the size of a rows x rows lower triangle
+ *
+ * @param path The checkpoint file
+ * @param rows Rows of W
+ * @return FILE* The file, positioned at its start; NULL when missing or of another size
+ */
+static FILE* open_W(const char* path, unsigned int rows){
+    char* W_file = W_path(path);
+    FILE* file = fopen(W_file, "rb");
+    free(W_file);
+    if (file == NULL) return NULL;
+    if (fseek(file, 0, SEEK_END) != 0 || ftell(file) != (long)((size_t)rows * (rows + 1) / 2 * sizeof(double))
+        || fseek(file, 0, SEEK_SET) != 0){
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+/**
+ * @brief Reads the W of a checkpoint from its W file
+ *
+ * @param path The checkpoint file
+ * @param rows Rows of W
+ * @param checksum The Adler-32 the header recorded for the W file
+ * @return double** The rows x rows W, NULL for a missing, truncated or corrupt file
+ */
+static double** read_W(const char* path, int rows, unsigned int checksum){
+    FILE* file = open_W(path, (unsigned int)rows);
+    double** W;
+    unsigned int actual = 1;
+    int i, j, failed = 0;
+
+    if (file == NULL) return NULL;
+    W = create_matrix(rows, rows);
+    for (i = 0; i < rows && !failed; i++){
+        failed = fread(W[i], sizeof(double), i + 1, file) != (size_t)(i + 1);
+        actual = adler32(actual, W[i], (i + 1) * sizeof(double));
+        for (j = 0; j < i; j++) W[j][i] = W[i][j];
+    }
+    fclose(file);
+    if (failed || actual != checksum){
+        for (i = 0; i < rows; i++) free(W[i]);
+        free(W);
+        return NULL;
+    }
+    return W;
+}
+
+/**
+ * @brief Writes the lower triangle of W to the W file of a checkpoint, once per run
+ *
+ * @param cp The checkpoint, its W_saved and W_checksum are set on success
+ * @param W The rows x rows W
+ * @param rows Rows of W
+ * @return int 0 on success, 1 when the file cannot be written
+ */
+static int save_W(checkpoint* cp, double** W, int rows){
+    char *W_file = W_path(cp->path), *temp = malloc(strlen(W_file) + 8);
+    unsigned int checksum = 1;
+    FILE* file;
+    int fd, failed = 0, i;
+
+    if (check_pointer(temp)) exit(1);
+    sprintf(temp, "%s.XXXXXX", W_file);
+    fd = mkstemp(temp);
+    file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (file == NULL){
+        if (fd >= 0) close(fd), remove(temp);
+        free(temp), free(W_file);
+        return 1;
+    }
+    for (i = 0; i < rows && !failed; i++){ /* the lower triangle, row by row */
+        checksum = adler32(checksum, W[i], (i + 1) * sizeof(double));
+        failed = fwrite(W[i], sizeof(double), i + 1, file) != (size_t)(i + 1);
+    }
+    if (failed) fclose(file), remove(temp);
+    else failed = commit_file(file, temp, W_file);
+    free(temp), free(W_file);
+    if (failed) return 1;
+    cp->W_saved = 1, cp->W_checksum = checksum;
+    return 0;
+}
+
+/**
+ * @brief Reads and validates a checkpoint file: magic, version, byte order, size and checksum
+ *
+ * @param path The file
+ * @param header Output, its header
+ * @return double* Everything after the header, to be freed; NULL for a missing or invalid file
+ */
+static double* read_checkpoint(const char* path, checkpoint_header* header){
+    FILE* file = fopen(path, "rb");
+    double* payload = NULL;
+    size_t length;
+    int extra;
+
+    if (file == NULL) return NULL;
+    if (fread(header, sizeof(*header), 1, file) == 1 && memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) == 0
+        && header->version == CHECKPOINT_VERSION && header->byte_order == CHECKPOINT_BYTE_ORDER){
+        length = payload_length(header);
+        payload = malloc((length > 0 ? length : 1) * sizeof(double));
+        if (check_pointer(payload)) exit(1);
+        extra = fread(payload, sizeof(double), length, file) != length || fgetc(file) != EOF;
+        if (extra || adler32(1, payload, length * sizeof(double)) != header->checksum){
+            free(payload);
+            payload = NULL;
+        }
+    }
+    fclose(file);
+    return payload;
+}
+
+/**
+ * @brief Describes the snapshot in a file without loading it into a run. has_W is cleared when
+ * its W file is missing or of the wrong size (its checksum is checked only by checkpoint_load).
+ *
+ * @param path The file
+ * @param header Output, its header
+ * @param history Output, its (iteration, objective) pairs, to be freed (may be NULL)
+ * @return int 0 for a valid snapshot, 1 for a missing or invalid file
+ */
+int checkpoint_probe(const char* path, checkpoint_header* header, double** history){
+    double* payload = read_checkpoint(path, header);
+    FILE* W_file = NULL;
+    size_t offset;
+    if (payload == NULL) return 1;
+    if (header->has_W && (W_file = open_W(path, header->rows)) == NULL) header->has_W = 0;
+    if (W_file != NULL) fclose(W_file);
+    if (history != NULL){
+        offset = (size_t)header->rows * header->columns;
+        *history = malloc((header->history_length > 0 ? 2 * header->history_length : 1) * sizeof(double));
+        if (check_pointer(*history)) exit(1);
+        memcpy(*history, payload + offset, 2 * header->history_length * sizeof(double));
+    }
+    free(payload);
+    return 0;
+}
+
+/**
+ * @brief Loads the snapshot of the checkpoint's file into a run of the same kind, shape and data
+ * fingerprint: the iterate, the iteration count, whether the loop had finished, the history and
+ * the seed, and W when asked and stored
+ *
+ * @param cp The checkpoint
+ * @param iterate Output, rows x columns, overwritten with the saved iterate
+ * @param rows Rows of the iterate
+ * @param columns Columns of the iterate
+ * @param W Output (may be NULL), a rows x rows W from the snapshot's W file or NULL when it has
+ * none or the file is missing or corrupt
+ * @return int 0 when the run resumes, 1 when there is no usable snapshot (the run starts fresh)
+ */
+int checkpoint_load(checkpoint* cp, double** iterate, int rows, int columns, double*** W){
+    checkpoint_header header;
+    double *payload = read_checkpoint(cp->path, &header), *cursor;
+    int i;
+
+    if (W != NULL) *W = NULL;
+    if (payload == NULL) return 1;
+    if (header.kind != (unsigned int)cp->kind || header.rows != (unsigned int)rows || header.columns != (unsigned int)columns
+        || header.data_key[0] != cp->data_key[0] || header.data_key[1] != cp->data_key[1]){
+        free(payload);
+        return 1;
+    }
+    cursor = payload;
+    for (i = 0; i < rows; i++, cursor += columns) memcpy(iterate[i], cursor, columns * sizeof(double));
+    free(cp->history);
+    cp->history_length = cp->history_capacity = (int)header.history_length;
+    cp->history = malloc((cp->history_capacity > 0 ? 2 * cp->history_capacity : 1) * sizeof(double));
+    if (check_pointer(cp->history)) exit(1);
+    memcpy(cp->history, cursor, 2 * header.history_length * sizeof(double));
+    if (W != NULL && header.has_W){
+        *W = read_W(cp->path, rows, header.W_checksum);
+        /* the W file still holds this run's W, later snapshots do not rewrite it */
+        if (*W != NULL) cp->W_saved = 1, cp->W_checksum = header.W_checksum;
+    }
+    cp->iteration = (int)header.iteration, cp->finished = header.finished != 0;
+    cp->seed = header.seed[0] | (((unsigned long)header.seed[1] << 16) << 16);
+    free(payload);
+    return 0;
+}
+
+/**
+ * @brief Whether a snapshot is due after an iteration
+ *
+ * @param cp The checkpoint (may be NULL)
+ * @param iteration Iterations done
+ * @return int 1 every interval iterations
+ */
+int checkpoint_due(const checkpoint* cp, int iteration){
+    return cp != NULL && cp->interval > 0 && iteration > 0 && iteration % cp->interval == 0;
+}
+
+/**
+ * @brief Appends an objective value to the history, when known and not yet recorded
+ *
+ * @param cp The checkpoint
+ * @param iteration Iterations done
+ * @param objective The objective, negative when unknown
+ */
+static void record_objective(checkpoint* cp, int iteration, double objective){
+    if (objective < 0 || (cp->history_length > 0 && cp->history[2 * cp->history_length - 2] == iteration)) return;
+    if (cp->history_length == cp->history_capacity){
+        cp->history_capacity = cp->history_capacity > 0 ? 2 * cp->history_capacity : 16;
+        cp->history = realloc(cp->history, 2 * cp->history_capacity * sizeof(double));
+        if (check_pointer(cp->history)) exit(1);
+    }
+    cp->history[2 * cp->history_length] = iteration;
+    cp->history[2 * cp->history_length + 1] = objective;
+    cp->history_length++;
+}
+
+/**
+ * @brief Called by a loop after every iteration and once when it stops: records the objective
+ * and saves a snapshot when one is due or forced. A failed save is retried at the next one.
+ *
+ * @param cp The checkpoint (may be NULL)
+ * @param iteration Iterations done
+ * @param objective The objective, negative when unknown
+ * @param iterate The current iterate
+ * @param rows Rows of the iterate
+ * @param columns Columns of the iterate
+ * @param W The rows x rows W of a symNMF run, stored when the checkpoint asks for it (may be NULL)
+ * @param force Save even when no snapshot is due
+ */
+void checkpoint_step(checkpoint* cp, int iteration, double objective, double** iterate, int rows, int columns, double** W, int force){
+    if (cp == NULL) return;
+    record_objective(cp, iteration, objective);
+    if (force || checkpoint_due(cp, iteration)) checkpoint_save(cp, iteration, iterate, rows, columns, W);
+}
+
+/**
+ * @brief Writes a snapshot under a unique temporary name, syncs it to disk and renames it over
+ * the checkpoint's file, so neither an interrupted write nor a crash of the host replaces the
+ * previous snapshot with a partial one
+ *
+ * @param cp The checkpoint
+ * @param iteration Iterations done
+ * @param iterate The current iterate
+ * @param rows Rows of the iterate
+ * @param columns Columns of the iterate
+ * @param W The rows x rows W, written to the W file by the first snapshot when cp->with_W is
+ * set (may be NULL)
+ * @return int 0 on success, 1 when the file cannot be written
+ */
+int checkpoint_save(checkpoint* cp, int iteration, double** iterate, int rows, int columns, double** W){
+    checkpoint_header header;
+    unsigned int checksum = 1;
+    char* temp = malloc(strlen(cp->path) + 8);
+    FILE* file;
+    int fd, failed = 0, i;
+
+    if (check_pointer(temp)) exit(1);
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION, header.byte_order = CHECKPOINT_BYTE_ORDER;
+    header.kind = (unsigned int)cp->kind, header.rows = (unsigned int)rows, header.columns = (unsigned int)columns;
+    header.iteration = (unsigned int)iteration, header.history_length = (unsigned int)cp->history_length;
+    if (cp->with_W && W != NULL && !cp->W_saved) save_W(cp, W, rows); /* W is written once per run */
+    header.has_W = cp->with_W && cp->W_saved, header.finished = cp->finished != 0;
+    header.W_checksum = cp->W_checksum;
+    header.data_key[0] = cp->data_key[0], header.data_key[1] = cp->data_key[1];
+    header.seed[0] = (unsigned int)(cp->seed & 0xFFFFFFFFUL);
+    header.seed[1] = (unsigned int)(((cp->seed >> 16) >> 16) & 0xFFFFFFFFUL);
+
+    sprintf(temp, "%s.XXXXXX", cp->path);
+    fd = mkstemp(temp);
+    file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (file == NULL){
+        if (fd >= 0) close(fd), remove(temp);
+        free(temp);
+        return 1;
+    }
+    failed = fwrite(&header, sizeof(header), 1, file) != 1;
+    for (i = 0; i < rows && !failed; i++){
+        checksum = adler32(checksum, iterate[i], columns * sizeof(double));
+        failed = fwrite(iterate[i], sizeof(double), columns, file) != (size_t)columns;
+    }
+    if (!failed && cp->history_length > 0){
+        checksum = adler32(checksum, cp->history, 2 * cp->history_length * sizeof(double));
+        failed = fwrite(cp->history, sizeof(double), 2 * cp->history_length, file) != (size_t)(2 * cp->history_length);
+    }
+    header.checksum = checksum;
+    failed = failed || fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1;
+    if (failed){
+        fclose(file), remove(temp), free(temp);
+        return 1;
+    }
+    if (commit_file(file, temp, cp->path) != 0){
+        free(temp);
+        return 1;
+    }
+    free(temp);
+    cp->saved++;
+    return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+/* Constants */
+#define CHECKPOINT_DEFAULT_INTERVAL 25
+#define CHECKPOINT_VERSION 3
+#define CHECKPOINT_W_SUFFIX ".W"
+#define CHECKPOINT_BYTE_ORDER 0x01020304U
+
+/* The loop a checkpoint belongs to */
+typedef enum checkpoint_kind {
+    CHECKPOINT_SYMNMF, /* the iterate is H (n x k) */
+    CHECKPOINT_KMEANS  /* the iterate is the centroids (k x d), kmeans++ stacks the centroids of the
+                          iteration before under them (2k x d) */
+} checkpoint_kind;
+
+/*
+ * Header of a checkpoint file, followed by native doubles: the iterate (rows x columns) and the
+ * objective history as (iteration, objective) pairs. When has_W is set the lower triangle of W,
+ * row by row (rows(rows+1)/2 entries), is in the sibling file path CHECKPOINT_W_SUFFIX, written
+ * once by the first snapshot since W does not change during a run.
+ */
+typedef struct checkpoint_header {
+    char magic[8];               /* "SYMNMFCK" */
+    unsigned int version;        /* CHECKPOINT_VERSION */
+    unsigned int byte_order;     /* CHECKPOINT_BYTE_ORDER as written by the producer */
+    unsigned int kind;
+    unsigned int rows, columns;
+    unsigned int iteration;      /* iterations done when the iterate was saved */
+    unsigned int history_length;
+    unsigned int has_W;
+    unsigned int seed[2];        /* generator state that drew the initial iterate, low and high words */
+    unsigned int checksum;       /* Adler-32 of everything after the header */
+    unsigned int finished;       /* 1 when the loop had converged or reached its iteration cap */
+    unsigned int W_checksum;     /* Adler-32 of the W file, when has_W is set */
+    unsigned int data_key[2];    /* hash of the input the run was started on, see checkpoint_fingerprint */
+    unsigned int reserved;
+} checkpoint_header;
+
+/* Periodic snapshots of a symNMF or k-means loop, attached to its run_control. The loop saves its
+ * iterate every interval iterations and when it stops; a loop given a loaded checkpoint continues
+ * from its iterate and iteration count, and does no update when the snapshot is of a finished loop. */
+typedef struct checkpoint {
+    char* path;
+    int kind;
+    int interval;          /* iterations between snapshots, 0 saves only when the loop stops */
+    int with_W;            /* also store W, so a resumed symNMF skips rebuilding it */
+    int W_saved;           /* the W file holds this run's W, whose checksum is W_checksum */
+    unsigned int W_checksum;
+    unsigned int data_key[2]; /* set by checkpoint_fingerprint, a snapshot of other data is not loaded */
+    unsigned long seed;
+    int iteration;         /* iterations already done, set by checkpoint_load */
+    int finished;          /* the loop is over, set by the loop before its last snapshot */
+    double* history;       /* (iteration, objective) pairs known so far */
+    int history_length, history_capacity;
+    int saved;             /* snapshots written */
+} checkpoint;
+
+/* Provided by the program that links checkpoint.c (symnmf.c or kmeansmodule.c) */
+double** create_matrix(int rows, int columns);
+int check_pointer(void* ptr);
+
+/* Function declarations from checkpoint.c */
+void checkpoint_init(checkpoint* cp, const char* path, int kind, int interval, int with_W, unsigned long seed);
+void checkpoint_destroy(checkpoint* cp);
+void checkpoint_fingerprint(checkpoint* cp, double** data, int rows, int columns, const double* weights);
+int checkpoint_probe(const char* path, checkpoint_header* header, double** history);
+int checkpoint_load(checkpoint* cp, double** iterate, int rows, int columns, double*** W);
+int checkpoint_due(const checkpoint* cp, int iteration);
+void checkpoint_step(checkpoint* cp, int iteration, double objective, double** iterate, int rows, int columns, double** W, int force);
+int checkpoint_save(checkpoint* cp, int iteration, double** iterate, int rows, int columns, double** W);
+
+#endif
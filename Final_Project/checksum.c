@@ -0,0 +1,97 @@
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "checksum.h"
+
+/**
+ * @brief Adler-32 checksum of a buffer, continuing the checksum of the bytes before it
+ *
+ * @param adler Checksum so far, 1 for the first buffer
+ * @param data The buffer
+ * @param bytes Its size
+ * @return unsigned int The checksum
+ */
+unsigned int adler32(unsigned int adler, const void* data, size_t bytes){
+    const unsigned char* p = (const unsigned char*)data;
+    unsigned long a = adler & 0xFFFFUL, b = (adler >> 16) & 0xFFFFUL;
+    size_t chunk;
+    while (bytes > 0){
+        chunk = bytes < 5552 ? bytes : 5552; /* the largest run that cannot overflow b */
+        bytes -= chunk;
+        while (chunk-- > 0){
+            a += *p++;
+            b += a;
+        }
+        a %= 65521, b %= 65521;
+    }
+    return (unsigned int)((b << 16) | a);
+}
+
+/**
+ * @brief Starts the two 32-bit hashes of a key, FNV-1a and djb2
+ *
+ * @param key The two hashes
+ */
+void hash_init(unsigned long* key){
+    key[0] = 2166136261UL, key[1] = 5381UL;
+}
+
+/**
+ * @brief Feeds a buffer to the two 32-bit hashes of a key, FNV-1a and djb2
+ *
+ * @param key The two hashes
+ * @param data The buffer
+ * @param bytes Its size
+ */
+void hash_bytes(unsigned long* key, const void* data, size_t bytes){
+    const unsigned char* p = (const unsigned char*)data;
+    size_t i;
+    for (i = 0; i < bytes; i++){
+        key[0] = ((key[0] ^ p[i]) * 16777619UL) & 0xFFFFFFFFUL;
+        key[1] = (key[1] * 33 + p[i]) & 0xFFFFFFFFUL;
+    }
+}
+
+/**
+ * @brief Flushes the directory entry of a file to disk, so a rename into it survives a crash
+ *
+ * @param path The file
+ */
+static void sync_parent(const char* path){
+    const char* slash = strrchr(path, '/');
+    size_t length = slash == NULL ? 1 : slash > path ? (size_t)(slash - path) : 1;
+    char* dir = malloc(length + 1);
+    int fd;
+    if (dir == NULL) return; /* the rename is done, only its durability is not forced */
+    if (slash == NULL) strcpy(dir, ".");
+    else memcpy(dir, path, length), dir[length] = '\0';
+    fd = open(dir, O_RDONLY);
+    if (fd >= 0) fsync(fd), close(fd);
+    free(dir);
+}
+
+/**
+ * @brief Makes a fully written temporary file the file at path: flushes it and its data to disk,
+ * closes it, renames it over path and syncs the directory. After a crash path holds either its
+ * previous content or the whole new file, never an empty or partial one.
+ *
+ * @param file The temporary file, open for writing; always closed
+ * @param temp Its path, removed on failure
+ * @param path The final path
+ * @return int 0 on success, 1 when the file could not be written or renamed
+ */
+int commit_file(FILE* file, const char* temp, const char* path){
+    int failed = fflush(file) != 0 || fsync(fileno(file)) != 0;
+    failed = fclose(file) != 0 || failed;
+    if (failed || rename(temp, path) != 0){
+        remove(temp);
+        return 1;
+    }
+    sync_parent(path);
+    return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Function declarations from checksum.c */
+unsigned int adler32(unsigned int adler, const void* data, size_t bytes);
+void hash_init(unsigned long* key);
+void hash_bytes(unsigned long* key, const void* data, size_t bytes);
+int commit_file(FILE* file, const char* temp, const char* path);
+
+#endif
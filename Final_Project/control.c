@@ -0,0 +1,132 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "control.h"
+
+/**
+ * @brief Prepares a control for a new run: no budget, no progress, running
+ *
+ * @param control The control
+ */
+void control_init(run_control* control){
+    pthread_mutex_init(&control->lock, NULL);
+    control->cancel = 0, control->deadline = 0;
+    control->iteration = 0, control->delta = 0, control->objective = -1;
+    control->state = CONTROL_RUNNING, control->checkpoint = NULL;
+}
+
+/**
+ * @brief Releases a control, once its loop has returned
+ *
+ * @param control The control
+ */
+void control_destroy(run_control* control){
+    pthread_mutex_destroy(&control->lock);
+}
+
+/**
+ * @brief Seconds on the monotonic clock, the time base of the budgets
+ *
+ * @return double The time
+ */
+double control_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Asks the loop to stop before its next iteration
+ *
+ * @param control The control
+ */
+void control_cancel(run_control* control){
+    pthread_mutex_lock(&control->lock);
+    control->cancel = 1;
+    pthread_mutex_unlock(&control->lock);
+}
+
+/**
+ * @brief Gives the loop a wall-clock budget, counted from now; it stops before the first
+ * iteration that would start after the budget is spent
+ *
+ * @param control The control
+ * @param seconds The budget, 0 or less removes it
+ */
+void control_set_budget(run_control* control, double seconds){
+    double deadline = seconds > 0 ? control_now() + seconds : 0;
+    pthread_mutex_lock(&control->lock);
+    control->deadline = deadline;
+    pthread_mutex_unlock(&control->lock);
+}
+
+/**
+ * @brief Called by the loop between iterations: whether it has been cancelled or its budget
+ * is spent, in which case the matching state is recorded
+ *
+ * @param control The control (NULL never stops)
+ * @return int 1 if the loop must stop now
+ */
+int control_should_stop(run_control* control){
+    int stop = 0;
+    if (control == NULL) return 0;
+    pthread_mutex_lock(&control->lock);
+    if (control->cancel){
+        control->state = CONTROL_CANCELLED, stop = 1;
+    } else if (control->deadline > 0 && control_now() >= control->deadline){
+        control->state = CONTROL_TIMED_OUT, stop = 1;
+    }
+    pthread_mutex_unlock(&control->lock);
+    return stop;
+}
+
+/**
+ * @brief Publishes the progress of the loop after an iteration
+ *
+ * @param control The control (may be NULL)
+ * @param iteration Number of iterations done
+ * @param delta Change made by the last one
+ * @param objective Current objective, negative to keep the last known one
+ */
+void control_report(run_control* control, int iteration, double delta, double objective){
+    if (control == NULL) return;
+    pthread_mutex_lock(&control->lock);
+    control->iteration = iteration, control->delta = delta;
+    if (objective >= 0) control->objective = objective;
+    pthread_mutex_unlock(&control->lock);
+}
+
+/**
+ * @brief Records the end of the loop; a cancelled or timed out loop keeps that state
+ *
+ * @param control The control (may be NULL)
+ * @param state CONTROL_DONE when the loop ended by itself
+ * @param objective Objective of the returned iterate, negative when unknown
+ */
+void control_finish(run_control* control, int state, double objective){
+    if (control == NULL) return;
+    pthread_mutex_lock(&control->lock);
+    if (control->state == CONTROL_RUNNING) control->state = state;
+    if (objective >= 0) control->objective = objective;
+    pthread_mutex_unlock(&control->lock);
+}
+
+/**
+ * @brief Reads a consistent snapshot of the progress, from any thread
+ *
+ * @param control The control
+ * @param iteration Output, iterations done
+ * @param delta Output, change made by the last iteration
+ * @param objective Output, last known objective (-1 if none yet)
+ * @param state Output, a control_state
+ */
+void control_read(run_control* control, int* iteration, double* delta, double* objective, int* state){
+    pthread_mutex_lock(&control->lock);
+    *iteration = control->iteration, *delta = control->delta;
+    *objective = control->objective, *state = control->state;
+    pthread_mutex_unlock(&control->lock);
+}
@@ -0,0 +1,40 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <pthread.h>
+
+struct checkpoint;
+
+/* Where a controlled loop is */
+typedef enum control_state {
+    CONTROL_RUNNING,
+    CONTROL_DONE,      /* converged or reached its iteration cap */
+    CONTROL_CANCELLED, /* stopped by control_cancel */
+    CONTROL_TIMED_OUT  /* stopped by its time budget */
+} control_state;
+
+/* Shared by a running optimization loop and its owner: progress flows out, cancellation and
+   the time budget flow in. Every field is accessed under lock. */
+typedef struct run_control {
+    pthread_mutex_t lock;
+    int cancel;
+    double deadline;  /* control_now() value at which the loop stops, 0 for no budget */
+    int iteration;
+    double delta;     /* last squared change of H (largest squared centroid shift for k-means) */
+    double objective; /* of the latest iterate, -1 until known */
+    int state;
+    struct checkpoint* checkpoint; /* snapshots of the loop, NULL for none; set before it starts */
+} run_control;
+
+/* Function declarations from control.c */
+void control_init(run_control* control);
+void control_destroy(run_control* control);
+double control_now(void);
+void control_cancel(run_control* control);
+void control_set_budget(run_control* control, double seconds);
+int control_should_stop(run_control* control);
+void control_report(run_control* control, int iteration, double delta, double objective);
+void control_finish(run_control* control, int state, double objective);
+void control_read(run_control* control, int* iteration, double* delta, double* objective, int* state);
+
+#endif
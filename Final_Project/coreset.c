@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "coreset.h"
+#include "parallel.h"
+
+/* A coreset point in the index of coreset_nearest: its distance to its pivot and its row */
+typedef struct pivot_member {
+    double radius;
+    int index;
+} pivot_member;
+
+/* Shared context of a coreset_nearest pass */
+typedef struct nearest_pass {
+    double** data;
+    double** coreset;
+    int d;
+    int pivots;
+    const int* pivot_rows;        /* coreset row of every pivot */
+    const int* group_start;       /* members of pivot c are members[group_start[c], group_start[c + 1]) */
+    const pivot_member* members;  /* grouped by pivot, by increasing radius within a group */
+    int* nearest;
+} nearest_pass;
+
+/**
+ * @brief Draws a uniform number in [0,1) from a seeded xorshift generator
+ *
+ * @param state Generator state, updated in place
+ * @return double A uniform random number
+ */
+double rand_uniform(unsigned long *state){
+    unsigned long x = *state & 0xFFFFFFFFUL;
+    if (x == 0) x = 0x9E3779B9UL;
+    x ^= (x << 13) & 0xFFFFFFFFUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xFFFFFFFFUL;
+    *state = x;
+    return (double)x / 4294967296.0;
+}
+
+/**
+ * @brief Calculates the squared euclidean distance between two vectors
+ *
+ * @param x First vector
+ * @param y Second vector
+ * @param d The dimension of the vectors
+ * @return double res The squared distance
+ */
+static double squared_distance(double *x, double *y, int d){
+    double res = 0, diff;
+    int i;
+    for (i = 0; i < d; i++){
+        diff = x[i] - y[i];
+        res += diff * diff;
+    }
+    return res;
+}
+
+/**
+ * @brief Runs a k-means++ seeding pass (D^2 sampling) and keeps, for every point,
+ * the squared distance to its nearest seed and the index of that seed
+ *
+ * @param data Set of n datapoints
+ * @param n Number of datapoints
+ * @param d Dimension of the datapoints
+ * @param k Number of seeds to pick
+ * @param state Random generator state
+ * @param min_dist Output array of size n, squared distance to the nearest seed
+ * @param assign Output array of size n, index of the nearest seed
+ * @param seeds Output array of size k (may be NULL), the row of every seed
+ * @return int The number of seeds picked, less than k when every point coincides with a seed
+ */
+static int kmeanspp_seeding(double** data, int n, int d, int k, unsigned long *state, double* min_dist, int* assign,
+                            int* seeds){
+    int i, c, seed;
+    double total, target, dist;
+
+    seed = (int)(rand_uniform(state) * n);
+    if (seeds != NULL) seeds[0] = seed;
+    for (i = 0; i < n; i++){
+        min_dist[i] = squared_distance(data[i], data[seed], d);
+        assign[i] = 0;
+    }
+    for (c = 1; c < k; c++){
+        total = 0;
+        for (i = 0; i < n; i++) total += min_dist[i];
+        if (total <= 0) break; /* every point already coincides with a seed */
+        target = rand_uniform(state) * total;
+        for (seed = 0; seed < n - 1; seed++){
+            target -= min_dist[seed];
+            if (target < 0) break;
+        }
+        if (seeds != NULL) seeds[c] = seed;
+        for (i = 0; i < n; i++){
+            dist = squared_distance(data[i], data[seed], d);
+            if (dist < min_dist[i]){
+                min_dist[i] = dist;
+                assign[i] = c;
+            }
+        }
+    }
+    return c;
+}
+
+/**
+ * @brief Builds a weighted coreset by sensitivity sampling.
+ * A k-means++ pass gives a rough clustering B, the sensitivity of a point x in cluster C_b
+ * is bounded by dist(x,B)^2/cost(B) + 1/|C_b|, and m points are drawn with probability
+ * proportional to that bound and weighted by 1/(m*p) so that weighted sums stay unbiased.
+ *
+ * @param data Set of n datapoints
+ * @param n Number of datapoints
+ * @param d Dimension of the datapoints
+ * @param k Number of seeds for the k-means++ pass
+ * @param m Requested coreset size
+ * @param seed Seed of the random generator
+ * @param weights Output array of size m with the weight of every coreset point
+ * @return double** coreset A m x d matrix of sampled datapoints
+ */
+double** build_coreset(double** data, int n, int d, int k, int m, unsigned long seed, double* weights){
+    double **coreset, *min_dist, *cumulative;
+    double cost, total, target;
+    int *assign, *cluster_size;
+    int i, j, lo, hi, mid;
+    unsigned long state = seed;
+
+    if (n <= 0 || m <= 0 || k <= 0) return NULL;
+    if (k > n) k = n;
+    coreset = create_matrix(m, d);
+    if (m >= n){ /* nothing to compress, keep every point with unit weight */
+        for (i = 0; i < m; i++){
+            memcpy(coreset[i], data[i % n], d * sizeof(double));
+            weights[i] = i < n ? 1.0 : 0.0;
+        }
+        return coreset;
+    }
+
+    min_dist = malloc(n * sizeof(double));
+    cumulative = malloc(n * sizeof(double));
+    assign = malloc(n * sizeof(int));
+    cluster_size = calloc(k, sizeof(int));
+    if (min_dist == NULL || cumulative == NULL || assign == NULL || cluster_size == NULL){
+        fprintf(stderr, "An Error Has Occurred\n");
+        exit(1);
+    }
+
+    kmeanspp_seeding(data, n, d, k, &state, min_dist, assign, NULL);
+    cost = 0;
+    for (i = 0; i < n; i++){
+        cost += min_dist[i];
+        cluster_size[assign[i]]++;
+    }
+
+    total = 0;
+    for (i = 0; i < n; i++){
+        total += (cost > 0 ? min_dist[i] / cost : 0) + 1.0 / cluster_size[assign[i]];
+        cumulative[i] = total;
+    }
+
+    for (j = 0; j < m; j++){
+        target = rand_uniform(&state) * total;
+        lo = 0, hi = n - 1;
+        while (lo < hi){
+            mid = (lo + hi) / 2;
+            if (cumulative[mid] <= target) lo = mid + 1;
+            else hi = mid;
+        }
+        memcpy(coreset[j], data[lo], d * sizeof(double));
+        /* weight = 1 / (m * p), where p = sensitivity / total */
+        weights[j] = total / (m * (cumulative[lo] - (lo > 0 ? cumulative[lo - 1] : 0)));
+    }
+
+    free(min_dist), free(cumulative), free(assign), free(cluster_size);
+    return coreset;
+}
+
+/**
+ * @brief Orders pivot members by radius, then by row
+ */
+static int compare_members(const void* a, const void* b){
+    const pivot_member *x = (const pivot_member*)a, *y = (const pivot_member*)b;
+    if (x->radius != y->radius) return x->radius < y->radius ? -1 : 1;
+    return x->index - y->index;
+}
+
+/**
+ * @brief Range task finding the nearest coreset point of the datapoints [begin, end).
+ * A coreset point y of pivot c is at least |dist(x,c) - radius(y)| away from x, so only the
+ * members whose radius lies within the best distance so far of dist(x,c) are compared, starting
+ * with the group of the nearest pivot. Ties go to the lower row, as in a full scan.
+ *
+ * @param ctx A nearest_pass
+ * @param begin First datapoint
+ * @param end One past the last datapoint
+ */
+static void nearest_rows(void* ctx, int begin, int end){
+    nearest_pass* pass = (nearest_pass*)ctx;
+    double *to_pivot = malloc(pass->pivots * sizeof(double));
+    double best, bound, dist;
+    int i, c, g, t, lo, hi, mid, first, best_index;
+
+    if (to_pivot == NULL){
+        fprintf(stderr, "An Error Has Occurred\n");
+        exit(1);
+    }
+    for (i = begin; i < end; i++){
+        first = 0;
+        for (c = 0; c < pass->pivots; c++){
+            to_pivot[c] = sqrt(squared_distance(pass->data[i], pass->coreset[pass->pivot_rows[c]], pass->d));
+            if (to_pivot[c] < to_pivot[first]) first = c;
+        }
+        best = HUGE_VAL, best_index = -1;
+        for (g = -1; g < pass->pivots; g++){
+            c = g < 0 ? first : g;
+            if (g == first) continue;
+            /* the bound is widened slightly so that rounding in sqrt never prunes a tie */
+            bound = best == HUGE_VAL ? HUGE_VAL : sqrt(best) * (1 + 1e-9);
+            lo = pass->group_start[c], hi = pass->group_start[c + 1];
+            if (lo == hi || to_pivot[c] - pass->members[hi - 1].radius > bound) continue;
+            while (lo < hi){
+                mid = (lo + hi) / 2;
+                if (pass->members[mid].radius < to_pivot[c] - bound) lo = mid + 1;
+                else hi = mid;
+            }
+            for (t = lo; t < pass->group_start[c + 1] && pass->members[t].radius <= to_pivot[c] + bound; t++){
+                dist = squared_distance(pass->data[i], pass->coreset[pass->members[t].index], pass->d);
+                if (dist < best || (dist == best && pass->members[t].index < best_index)){
+                    best = dist, best_index = pass->members[t].index;
+                    bound = sqrt(best) * (1 + 1e-9);
+                }
+            }
+        }
+        pass->nearest[i] = best_index;
+    }
+    free(to_pivot);
+}
+
+/**
+ * @brief Finds the nearest coreset point of every datapoint, through which a result computed on
+ * the coreset (a row of H, a label) is carried back to the full dataset.
+ * A full scan costs O(n*m*d). Instead, about sqrt(m) pivots are drawn from the coreset with the
+ * same k-means++ pass that builds it, every coreset point joins its nearest pivot (O(m*sqrt(m)*d)
+ * once), and every datapoint compares against the pivots and then only against the members the
+ * triangle inequality cannot rule out: O(n*sqrt(m)*d) plus the surviving members, which on
+ * clustered data are a small fraction of m. The datapoints are split over the worker threads.
+ * The result is exactly that of a full scan.
+ *
+ * @param data Set of n datapoints
+ * @param n Number of datapoints
+ * @param coreset The m coreset points
+ * @param m Number of coreset points
+ * @param d Dimension of the points
+ * @param nearest Output array of size n, index of the nearest coreset point
+ */
+void coreset_nearest(double** data, int n, double** coreset, int m, int d, int* nearest){
+    nearest_pass pass;
+    pivot_member* members;
+    double* min_dist;
+    int *assign, *pivot_rows, *group_start, *fill;
+    int pivots, c, j;
+    unsigned long state = CORESET_DEFAULT_SEED;
+
+    if (n <= 0 || m <= 0) return;
+    pivots = (int)sqrt((double)m);
+    if (pivots < 1) pivots = 1;
+    min_dist = malloc(m * sizeof(double));
+    assign = malloc(m * sizeof(int));
+    pivot_rows = malloc(pivots * sizeof(int));
+    group_start = calloc(pivots + 1, sizeof(int));
+    fill = malloc(pivots * sizeof(int));
+    members = malloc(m * sizeof(pivot_member));
+    if (min_dist == NULL || assign == NULL || pivot_rows == NULL || group_start == NULL || fill == NULL || members == NULL){
+        fprintf(stderr, "An Error Has Occurred\n");
+        exit(1);
+    }
+
+    pivots = kmeanspp_seeding(coreset, m, d, pivots, &state, min_dist, assign, pivot_rows);
+    for (j = 0; j < m; j++) group_start[assign[j] + 1]++;
+    for (c = 0; c < pivots; c++){
+        group_start[c + 1] += group_start[c];
+        fill[c] = group_start[c];
+    }
+    for (j = 0; j < m; j++){
+        members[fill[assign[j]]].radius = sqrt(min_dist[j]);
+        members[fill[assign[j]]++].index = j;
+    }
+    for (c = 0; c < pivots; c++){
+        qsort(members + group_start[c], group_start[c + 1] - group_start[c], sizeof(pivot_member), compare_members);
+    }
+
+    pass.data = data, pass.coreset = coreset, pass.d = d, pass.pivots = pivots;
+    pass.pivot_rows = pivot_rows, pass.group_start = group_start, pass.members = members, pass.nearest = nearest;
+    parallel_for(n, nearest_rows, &pass);
+    free(min_dist), free(assign), free(pivot_rows), free(group_start), free(fill), free(members);
+}
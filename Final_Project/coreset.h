@@ -0,0 +1,16 @@
+#ifndef CORESET_H
+#define CORESET_H
+
+/* Constants */
+#define CORESET_DEFAULT_K 10
+#define CORESET_DEFAULT_SEED 1234
+
+/* Provided by the program that links coreset.c (symnmf.c, kmeans/kmeans.c or kmeansmodule.c) */
+double** create_matrix(int rows, int columns);
+
+/* Function declarations from coreset.c */
+double rand_uniform(unsigned long *state);
+double** build_coreset(double** data, int n, int d, int k, int m, unsigned long seed, double* weights);
+void coreset_nearest(double** data, int n, double** coreset, int m, int d, int* nearest);
+
+#endif 
@@ -0,0 +1,352 @@
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "symnmf.h"
+#include "packed.h"
+#include "placement.h"
+#include "stats.h"
+#include "diskcache.h"
+#include "checksum.h"
+
+/* The goals a cache file answers, in the order of its sections */
+enum { DISK_GOAL_SYM, DISK_GOAL_DDG, DISK_GOAL_NORM };
+
+/* The affinity of sym_packed; part of the key, so a different kernel never reads old files */
+static const char DISK_CACHE_KERNEL[] = "gaussian exp(-|x-y|^2/2)";
+static const char DISK_CACHE_MAGIC[8] = {'S', 'Y', 'M', 'N', 'M', 'F', 'D', 'C'};
+
+/* Fails to compile if the header stops being 64 bytes */
+typedef char disk_cache_header_size[sizeof(disk_cache_header) == 64 ? 1 : -1];
+
+/**
+ * @brief Whether the disk cache is on: SYMNMF_CACHE_DIR names its directory
+ *
+ * @return int 1 when it is set and not empty
+ */
+int disk_cache_enabled(void){
+    const char* dir = getenv(DISK_CACHE_ENV);
+    return dir != NULL && dir[0] != '\0';
+}
+
+/**
+ * @brief Size cap of the cache directory from SYMNMF_CACHE_MB, DISK_CACHE_DEFAULT_MB by default
+ *
+ * @return size_t The cap in bytes
+ */
+static size_t cache_limit(void){
+    const char* env = getenv(DISK_CACHE_LIMIT_ENV);
+    long mb = env != NULL ? atol(env) : 0;
+    return (size_t)(mb > 0 ? mb : DISK_CACHE_DEFAULT_MB) * 1024 * 1024;
+}
+
+/**
+ * @brief Fills the header a cache file of these points must have, checksums left at 0
+ *
+ * @param header The header
+ * @param points Set of n datapoints
+ * @param weights Weight of every datapoint, NULL for unit weights
+ * @param n Number of datapoints
+ * @param d Dimension of the datapoints
+ */
+static void describe(disk_cache_header* header, double** points, double* weights, int n, int d){
+    unsigned long key[2];
+    int i;
+
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, DISK_CACHE_MAGIC, sizeof(header->magic));
+    header->version = DISK_CACHE_VERSION, header->byte_order = DISK_CACHE_BYTE_ORDER;
+    header->n = (unsigned int)n, header->d = (unsigned int)d, header->weighted = weights != NULL;
+
+    hash_init(key);
+    hash_bytes(key, DISK_CACHE_KERNEL, sizeof(DISK_CACHE_KERNEL));
+    hash_bytes(key, &header->n, 3 * sizeof(unsigned int));
+    for (i = 0; i < n; i++) hash_bytes(key, points[i], d * sizeof(double));
+    if (weights != NULL) hash_bytes(key, weights, n * sizeof(double));
+    header->key[0] = (unsigned int)key[0], header->key[1] = (unsigned int)key[1];
+}
+
+/**
+ * @brief Size of the cache file of n points
+ *
+ * @param n Number of datapoints
+ * @return size_t Header and sections, in bytes
+ */
+static size_t entry_bytes(int n){
+    return sizeof(disk_cache_header) + (2 * PACKED_INDEX(n, 0) + n) * sizeof(double);
+}
+
+/**
+ * @brief Path of the cache file of a header: the directory and the key in hex
+ *
+ * @param header The header
+ * @return char* The path, to be freed
+ */
+static char* entry_path(const disk_cache_header* header){
+    const char* dir = getenv(DISK_CACHE_ENV);
+    char* path = malloc(strlen(dir) + 32);
+    if (check_pointer(path)) exit(1);
+    sprintf(path, "%s/%08x%08x%s", dir, header->key[0], header->key[1], DISK_CACHE_SUFFIX);
+    return path;
+}
+
+/**
+ * @brief Reads a goal from a cache file through a read-only mapping. The file must match the
+ * expected header and the checksums of the sections that are read; a missing, stale, truncated
+ * or corrupt file is a miss. A hit refreshes the file's time for the size cap.
+ *
+ * @param path The file
+ * @param expected Header computed from the points
+ * @param goal DISK_GOAL_SYM, DISK_GOAL_DDG or DISK_GOAL_NORM
+ * @param A Output, the packed A or W; for DISK_GOAL_DDG only its n is set
+ * @param degree Output, the n degrees, to be freed
+ * @return int 0 on a hit, 1 on a miss
+ */
+static int load_entry(const char* path, const disk_cache_header* expected, int goal, packed_matrix* A, double** degree){
+    size_t triangle = PACKED_INDEX(expected->n, 0), bytes = entry_bytes(expected->n);
+    const disk_cache_header* header;
+    const double *sections, *matrix;
+    struct stat info;
+    void* map;
+    int fd, status = 1;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return 1;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size != bytes){
+        close(fd);
+        return 1;
+    }
+    map = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 1;
+
+    header = (const disk_cache_header*)map;
+    sections = (const double*)((const char*)map + sizeof(disk_cache_header));
+    matrix = goal == DISK_GOAL_SYM ? sections : sections + triangle + expected->n;
+    if (memcmp(header, expected, offsetof(disk_cache_header, checksum)) == 0
+        && adler32(1, sections + triangle, expected->n * sizeof(double)) == header->checksum[1]
+        && (goal == DISK_GOAL_DDG || adler32(1, matrix, triangle * sizeof(double)) == header->checksum[goal])){
+        *degree = malloc((expected->n > 0 ? expected->n : 1) * sizeof(double));
+        if (check_pointer(*degree)) exit(1);
+        memcpy(*degree, sections + triangle, expected->n * sizeof(double));
+        A->n = (int)expected->n, A->data = NULL;
+        if (goal != DISK_GOAL_DDG){
+            if (init_packed_matrix(A, A->n)) exit(1);
+            memcpy(A->data, matrix, triangle * sizeof(double));
+        }
+        status = 0;
+    }
+    munmap(map, bytes);
+    if (status == 0) utime(path, NULL);
+    return status;
+}
+
+/**
+ * @brief Removes the least recently used cache files until the directory holds at most limit
+ * bytes of them
+ *
+ * @param dir The cache directory
+ * @param limit The cap in bytes
+ */
+static void prune(const char* dir, size_t limit){
+    DIR* directory = opendir(dir);
+    struct dirent* item;
+    struct stat info;
+    char** names = NULL;
+    time_t* times = NULL;
+    size_t *sizes = NULL, total = 0, length, suffix = strlen(DISK_CACHE_SUFFIX);
+    int count = 0, capacity = 0, oldest, i;
+
+    if (directory == NULL) return;
+    while ((item = readdir(directory)) != NULL){
+        length = strlen(item->d_name);
+        if (length <= suffix || strcmp(item->d_name + length - suffix, DISK_CACHE_SUFFIX) != 0) continue;
+        if (count == capacity){
+            capacity = capacity > 0 ? 2 * capacity : 16;
+            names = realloc(names, capacity * sizeof(char*));
+            times = realloc(times, capacity * sizeof(time_t));
+            sizes = realloc(sizes, capacity * sizeof(size_t));
+            if (check_pointer(names) || check_pointer(times) || check_pointer(sizes)) exit(1);
+        }
+        names[count] = malloc(strlen(dir) + length + 2);
+        if (check_pointer(names[count])) exit(1);
+        sprintf(names[count], "%s/%s", dir, item->d_name);
+        if (stat(names[count], &info) != 0 || !S_ISREG(info.st_mode)){
+            free(names[count]);
+            continue;
+        }
+        times[count] = info.st_mtime, sizes[count] = (size_t)info.st_size;
+        total += sizes[count++];
+    }
+    closedir(directory);
+
+    while (total > limit){
+        for (oldest = -1, i = 0; i < count; i++){
+            if (names[i] != NULL && (oldest < 0 || times[i] < times[oldest])) oldest = i;
+        }
+        if (oldest < 0) break;
+        remove(names[oldest]);
+        total -= sizes[oldest];
+        free(names[oldest]), names[oldest] = NULL;
+    }
+    for (i = 0; i < count; i++) free(names[i]);
+    free(names), free(times), free(sizes);
+}
+
+/**
+ * @brief Starts a cache file under a unique temporary name, so concurrent writers of the same
+ * entry never share a file: a header and the A and degree sections
+ *
+ * @param temp Template of the temporary path, ending in XXXXXX; completed by mkstemp
+ * @param header The header, its first two checksums are filled here
+ * @param A The packed A
+ * @param degree The n degrees
+ * @return FILE* The file, NULL if it cannot be written
+ */
+static FILE* begin_entry(char* temp, disk_cache_header* header, const packed_matrix* A, const double* degree){
+    size_t triangle = PACKED_INDEX(A->n, 0);
+    int fd = mkstemp(temp);
+    FILE* file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (file == NULL){
+        if (fd >= 0) close(fd), remove(temp);
+        return NULL;
+    }
+    header->checksum[0] = adler32(1, A->data, triangle * sizeof(double));
+    header->checksum[1] = adler32(1, degree, A->n * sizeof(double));
+    if (fwrite(header, sizeof(*header), 1, file) != 1
+        || fwrite(A->data, sizeof(double), triangle, file) != triangle
+        || fwrite(degree, sizeof(double), A->n, file) != (size_t)A->n){
+        fclose(file), remove(temp);
+        return NULL;
+    }
+    return file;
+}
+
+/**
+ * @brief Completes a cache file with the W section and its checksum, then syncs and renames it
+ * into place, so readers never see a partial file even after a crash, and applies the size cap
+ *
+ * @param file The file from begin_entry
+ * @param temp Its temporary path
+ * @param path The final path
+ * @param header The header
+ * @param W The packed W
+ */
+static void finish_entry(FILE* file, const char* temp, const char* path, disk_cache_header* header, const packed_matrix* W){
+    size_t triangle = PACKED_INDEX(W->n, 0);
+    const char* dir = getenv(DISK_CACHE_ENV);
+    int failed;
+
+    header->checksum[2] = adler32(1, W->data, triangle * sizeof(double));
+    failed = fwrite(W->data, sizeof(double), triangle, file) != triangle
+             || fseek(file, 0, SEEK_SET) != 0 || fwrite(header, sizeof(*header), 1, file) != 1;
+    if (failed){
+        fclose(file), remove(temp);
+        return;
+    }
+    if (commit_file(file, temp, path) != 0) return;
+    prune(dir, cache_limit());
+}
+
+/**
+ * @brief The sym, ddg or norm goal in packed form, through the disk cache when it is on.
+ * A hit reads the goal from the cache file and skips the O(n^2 d) affinities; a miss computes
+ * A, the degrees and W as sym_packed, ddg_packed and norm_packed do and stores all three, so
+ * any goal of the same points is a hit afterwards. Files larger than the cap are not stored.
+ * Reading a hit is timed as STAGE_PARSE.
+ *
+ * @param A Output, the packed A for "sym" or W for "norm"; for "ddg" its data is NULL
+ * @param degree Output, the n degrees (the diagonal of D), to be freed
+ * @param points Set of n datapoints
+ * @param weights Weight of every datapoint, NULL for unit weights
+ * @param n Number of datapoints
+ * @param d Dimension of the datapoints
+ * @param goal "sym", "ddg" or "norm"
+ * @return int 0 on success, 1 for an unknown goal or an allocation failure
+ */
+int cached_goal_packed(packed_matrix* A, double** degree, double** points, double* weights, int n, int d, const char* goal){
+    int which = strcmp(goal, "sym") == 0 ? DISK_GOAL_SYM : strcmp(goal, "ddg") == 0 ? DISK_GOAL_DDG
+              : strcmp(goal, "norm") == 0 ? DISK_GOAL_NORM : -1;
+    disk_cache_header header;
+    packed_matrix W;
+    char *path = NULL, *temp = NULL;
+    stats_timer timer;
+    FILE* file = NULL;
+    int normalized = 0, copied = 0, hit;
+
+    if (which < 0) return 1;
+    *degree = NULL;
+    if (disk_cache_enabled()){
+        describe(&header, points, weights, n, d);
+        path = entry_path(&header);
+        timer = stats_begin(STAGE_PARSE);
+        hit = load_entry(path, &header, which, A, degree) == 0;
+        stats_end(timer);
+        if (hit){
+            free(path);
+            return 0;
+        }
+    }
+
+    if (sym_packed(A, points, weights, n, d)){
+        free(path);
+        return 1;
+    }
+    *degree = ddg_packed(A);
+    W = *A;
+    if (path != NULL && entry_bytes(n) <= cache_limit()) temp = malloc(strlen(path) + 32);
+    if (temp != NULL && which == DISK_GOAL_SYM){ /* W goes to the file, A to the caller */
+        copied = init_packed_matrix(&W, n) == 0;
+        if (copied) memcpy(W.data, A->data, PACKED_INDEX(n, 0) * sizeof(double));
+        else free(temp), temp = NULL; /* no memory for the copy, the entry is not stored */
+    }
+    if (temp != NULL){
+        sprintf(temp, "%s.XXXXXX", path);
+        file = begin_entry(temp, &header, A, *degree);
+    }
+    if (file != NULL){
+        norm_packed(&W, *degree);
+        finish_entry(file, temp, path, &header, &W);
+        normalized = which != DISK_GOAL_SYM;
+    }
+    if (copied) free_packed_matrix(&W);
+    if (which == DISK_GOAL_NORM && !normalized) norm_packed(A, *degree);
+    if (which == DISK_GOAL_DDG) free_packed_matrix(A);
+    free(path), free(temp);
+    return 0;
+}
+
+/**
+ * @brief cached_goal_packed expanded to a full n x n matrix, the result of compute_goals
+ *
+ * @param points Set of n datapoints
+ * @param weights Weight of every datapoint, NULL for unit weights
+ * @param goal "sym", "ddg" or "norm"
+ * @param n Number of datapoints
+ * @param d Dimension of the datapoints
+ * @return double** The matrix (from create_placed_matrix), NULL for an unknown goal
+ */
+double** cached_goal(double** points, double* weights, const char* goal, int n, int d){
+    packed_matrix A;
+    double **result, *degree;
+    int i, j;
+
+    if (cached_goal_packed(&A, &degree, points, weights, n, d, goal)) return NULL;
+    result = create_placed_matrix(n, n);
+    for (i = 0; i < n; i++){
+        for (j = 0; j < n; j++) result[i][j] = A.data != NULL ? packed_get(&A, i, j) : (i == j ? degree[i] : 0.0);
+    }
+    free_packed_matrix(&A), free(degree);
+    return result;
+}
@@ -0,0 +1,36 @@
+#ifndef DISKCACHE_H
+#define DISKCACHE_H
+
+#include "packed.h"
+
+/* Constants */
+#define DISK_CACHE_ENV "SYMNMF_CACHE_DIR"
+#define DISK_CACHE_LIMIT_ENV "SYMNMF_CACHE_MB"
+#define DISK_CACHE_DEFAULT_MB 4096
+#define DISK_CACHE_VERSION 1
+#define DISK_CACHE_SUFFIX ".symc"
+#define DISK_CACHE_BYTE_ORDER 0x01020304U
+
+/*
+ * Header of a cache file, followed by three sections of native doubles:
+ * the packed A (n(n+1)/2 entries), the n degrees and the packed W (n(n+1)/2 entries).
+ * The header is 64 bytes so every section starts 8-byte aligned and can be used in place
+ * from a mapping of the file.
+ */
+typedef struct disk_cache_header {
+    char magic[8];              /* "SYMNMFDC" */
+    unsigned int version;       /* DISK_CACHE_VERSION */
+    unsigned int byte_order;    /* DISK_CACHE_BYTE_ORDER as written by the producer */
+    unsigned int n, d;
+    unsigned int weighted;      /* 1 when the points had weights */
+    unsigned int key[2];        /* hash of the kernel, the points and the weights */
+    unsigned int checksum[3];   /* Adler-32 of A, the degrees and W */
+    unsigned int reserved[4];
+} disk_cache_header;
+
+/* Function declarations from diskcache.c */
+int disk_cache_enabled(void);
+int cached_goal_packed(packed_matrix* A, double** degree, double** points, double* weights, int n, int d, const char* goal);
+double** cached_goal(double** points, double* weights, const char* goal, int n, int d);
+
+#endif
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "symnmf.h"
+#include "packed.h"
+#include "parallel.h"
+#include "incremental.h"
+
+/* Shared context of the pass filling the appended rows of A */
+typedef struct append_pass {
+    incremental_state* state;
+    int first; /* first appended row */
+} append_pass;
+
+/**
+ * @brief Makes room for rows rows of points and A, growing the capacity geometrically so that
+ * a sequence of appends copies A a constant number of times per doubling of n
+ *
+ * @param state The state
+ * @param rows Rows needed
+ */
+static void reserve_rows(incremental_state* state, int rows){
+    int capacity = state->capacity;
+    if (rows <= capacity) return;
+    while (capacity < rows) capacity = capacity > 0 ? 2 * capacity : 64;
+    state->points = realloc(state->points, capacity * sizeof(double*));
+    state->A.data = realloc(state->A.data, PACKED_INDEX(capacity, 0) * sizeof(double));
+    state->degree = realloc(state->degree, capacity * sizeof(double));
+    state->scale = realloc(state->scale, capacity * sizeof(double));
+    if (check_pointer(state->points) || check_pointer(state->A.data)
+        || check_pointer(state->degree) || check_pointer(state->scale)) exit(1);
+    state->capacity = capacity;
+}
+
+/**
+ * @brief Range task filling the appended rows [first + begin, first + end) of A: the affinities
+ * of every new point to all points before it, the same values as sym_packed
+ *
+ * @param ctx An append_pass
+ * @param begin First new row, relative to first
+ * @param end One past the last new row, relative to first
+ */
+static void append_rows(void* ctx, int begin, int end){
+    append_pass* pass = (append_pass*)ctx;
+    incremental_state* state = pass->state;
+    double* row;
+    int i, j;
+    for (i = pass->first + begin; i < pass->first + end; i++){
+        row = state->A.data + PACKED_INDEX(i, 0);
+        for (j = 0; j < i; j++){
+            row[j] = exp(-(pow(vector_distance(state->points[i], state->points[j], state->d), 2)) / 2);
+        }
+        row[i] = 0;
+    }
+}
+
+/**
+ * @brief Appends points: their rows of A, then the degrees and D^{-1/2} of every point. Old
+ * degrees only gain the affinities to the new points, so this costs O(m(n+m)d).
+ *
+ * @param state The state
+ * @param points The m new points, copied
+ * @param m Number of new points
+ */
+static void append_points(incremental_state* state, double** points, int m){
+    int first = state->n, i, j;
+    append_pass pass;
+    double a, *row;
+
+    reserve_rows(state, first + m);
+    for (i = 0; i < m; i++){
+        state->points[first + i] = malloc(state->d * sizeof(double));
+        if (check_pointer(state->points[first + i])) exit(1);
+        memcpy(state->points[first + i], points[i], state->d * sizeof(double));
+    }
+    state->n = state->A.n = first + m;
+    pass.state = state, pass.first = first;
+    parallel_for(m, append_rows, &pass);
+
+    for (i = first; i < state->n; i++) state->degree[i] = 0;
+    for (i = first; i < state->n; i++){
+        row = state->A.data + PACKED_INDEX(i, 0);
+        for (j = 0; j < i; j++){
+            a = row[j];
+            state->degree[i] += a, state->degree[j] += a;
+        }
+    }
+    for (i = 0; i < state->n; i++) state->scale[i] = state->degree[i] != 0 ? 1.0 / sqrt(state->degree[i]) : 0;
+}
+
+/**
+ * @brief W*H for the W of a state: D^{-1/2} (A (D^{-1/2} H)), A streamed once by packed_multiply
+ *
+ * @param W The operator, its data is an incremental_state
+ * @param H A n x k matrix
+ * @param k Number of columns in H
+ * @param out A n x k matrix, overwritten with W*H
+ */
+static void incremental_multiply(const w_operator* W, double** H, int k, double** out){
+    const incremental_state* state = (const incremental_state*)W->data;
+    w_operator A = packed_w_operator(&state->A);
+    double** scaled = create_matrix(state->n, k);
+    int i, l;
+
+    for (i = 0; i < state->n; i++){
+        for (l = 0; l < k; l++) scaled[i][l] = state->scale[i] * H[i][l];
+    }
+    packed_multiply(&A, scaled, k, out);
+    for (i = 0; i < state->n; i++){
+        for (l = 0; l < k; l++) out[i][l] *= state->scale[i];
+    }
+    free_matrix(scaled, state->n);
+}
+
+/**
+ * @brief The W of a state as an operator for optimize_H_operator
+ *
+ * @param state The state
+ * @return w_operator W = D^{-1/2} A D^{-1/2}
+ */
+w_operator incremental_w_operator(const incremental_state* state){
+    w_operator W;
+    W.data = state, W.multiply = incremental_multiply, W.n = state->n;
+    return W;
+}
+
+/**
+ * @brief Builds the state of a first set of points and solves it from a random H with the
+ * bound of initialize_H, 2*sqrt(mean(W)/k)
+ *
+ * @param state The state to initialize
+ * @param points Set of n datapoints, copied
+ * @param n Number of datapoints
+ * @param d Dimension of the datapoints
+ * @param k Number of clusters
+ * @param seed Seed of the initial H
+ * @return int 0 on success, 1 for an invalid k
+ */
+int incremental_init(incremental_state* state, double** points, int n, int d, int k, unsigned long seed){
+    unsigned long random = seed;
+    double total = 0, bound, *row;
+    w_operator W;
+    int i, j;
+
+    if (k <= 0 || k >= n) return 1;
+    memset(state, 0, sizeof(*state));
+    state->d = d, state->k = k;
+    append_points(state, points, n);
+
+    for (i = 0; i < n; i++){
+        row = state->A.data + PACKED_INDEX(i, 0);
+        for (j = 0; j < i; j++) total += 2 * state->scale[i] * row[j] * state->scale[j];
+    }
+    bound = 2 * sqrt(total / ((double)n * n) / k);
+    state->H = create_matrix(n, k);
+    for (i = 0; i < n; i++){
+        for (j = 0; j < k; j++) state->H[i][j] = bound * rand_uniform(&random);
+    }
+    W = incremental_w_operator(state);
+    state->H = optimize_H_operator(state->H, &W, k, &state->iterations);
+    return 0;
+}
+
+/**
+ * @brief Appends points and warm-starts optimize_H from the previous H. Every new point starts
+ * from the affinity-weighted mean of the H rows of the old points (the mean of all of them for
+ * a point with no affinity), which is close to the optimum when the new points fall in
+ * existing clusters, so few updates are needed compared to a cold start.
+ *
+ * @param state The state
+ * @param points The m new points, copied
+ * @param m Number of new points
+ * @return int 0 on success, 1 for m <= 0
+ */
+int incremental_extend(incremental_state* state, double** points, int m){
+    int old = state->n, k = state->k, i, j, l;
+    double total, a, *row, *mean;
+    w_operator W;
+
+    if (m <= 0) return 1;
+    append_points(state, points, m);
+
+    mean = calloc(k, sizeof(double));
+    if (check_pointer(mean)) exit(1);
+    for (j = 0; j < old; j++){
+        for (l = 0; l < k; l++) mean[l] += state->H[j][l] / old;
+    }
+    state->H = realloc(state->H, state->n * sizeof(double*));
+    if (check_pointer(state->H)) exit(1);
+    for (i = old; i < state->n; i++){
+        state->H[i] = calloc(k, sizeof(double));
+        if (check_pointer(state->H[i])) exit(1);
+        row = state->A.data + PACKED_INDEX(i, 0);
+        for (total = 0, j = 0; j < old; j++){
+            a = row[j], total += a;
+            for (l = 0; l < k; l++) state->H[i][l] += a * state->H[j][l];
+        }
+        for (l = 0; l < k; l++) state->H[i][l] = total > 0 ? state->H[i][l] / total : mean[l];
+    }
+    free(mean);
+
+    W = incremental_w_operator(state);
+    state->H = optimize_H_operator(state->H, &W, k, &state->iterations);
+    return 0;
+}
+
+/**
+ * @brief Frees the memory owned by a state
+ *
+ * @param state The state
+ */
+void free_incremental_state(incremental_state* state){
+    int i;
+    for (i = 0; i < state->n; i++) free(state->points[i]);
+    free(state->points), free(state->A.data), free(state->degree), free(state->scale);
+    if (state->H != NULL) free_matrix(state->H, state->n);
+    memset(state, 0, sizeof(*state));
+}
@@ -0,0 +1,30 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "symnmf.h"
+#include "packed.h"
+
+/* Constants */
+#define INCREMENTAL_DEFAULT_SEED 1234
+
+/* A dataset that grows by appended points, with its symNMF kept up to date. A is stored packed
+ * and only gains rows, W = D^{-1/2} A D^{-1/2} is applied through scale and never stored, so an
+ * update touches the new rows of A, the degrees and H but no existing entry of A or W. */
+typedef struct incremental_state {
+    double** points;   /* n x d */
+    int n, d, k;
+    int capacity;      /* rows allocated for points and A */
+    packed_matrix A;   /* n(n+1)/2 affinities, room for capacity rows */
+    double* degree;    /* row sums of A, the diagonal of D */
+    double* scale;     /* D^{-1/2} */
+    double** H;        /* n x k */
+    int iterations;    /* updates of the last optimization */
+} incremental_state;
+
+/* Function declarations from incremental.c */
+int incremental_init(incremental_state* state, double** points, int n, int d, int k, unsigned long seed);
+int incremental_extend(incremental_state* state, double** points, int m);
+w_operator incremental_w_operator(const incremental_state* state);
+void free_incremental_state(incremental_state* state);
+
+#endif
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "parallel.h"
+#include "kmeans.h"
+#include "stats.h"
+#include "control.h"
+#include "checkpoint.h"
+#include "arena.h"
+
+/* Shared context of an assignment pass */
+typedef struct assign_pass {
+    double** data;
+    int d;
+    double** centroids;
+    int k;
+    int* labels;
+    double* distances; /* squared distance of every point to its centroid, NULL when unused */
+} assign_pass;
+
+/**
+ * @brief Range task assigning points [begin, end) to their closest centroid
+ * (the first one on ties, as find_closest_point in kmeans.py)
+ *
+ * @param ctx An assign_pass
+ * @param begin First point
+ * @param end One past the last point
+ */
+static void assign_points(void* ctx, int begin, int end){
+    assign_pass* pass = (assign_pass*)ctx;
+    double dist, diff, minimum;
+    int i, c, l;
+    for (i = begin; i < end; i++){
+        minimum = -1;
+        for (c = 0; c < pass->k; c++){
+            dist = 0;
+            for (l = 0; l < pass->d; l++){
+                diff = pass->data[i][l] - pass->centroids[c][l];
+                dist += diff * diff;
+            }
+            if (minimum < 0 || dist < minimum){
+                minimum = dist;
+                pass->labels[i] = c;
+            }
+        }
+        if (pass->distances != NULL) pass->distances[i] = minimum;
+    }
+}
+
+/**
+ * @brief The inertia of an assignment, sum of the weighted squared distances
+ *
+ * @param distances Squared distance of every point to its centroid
+ * @param weights Weight of every point (NULL for unit weights)
+ * @param n Number of points
+ * @return double The inertia
+ */
+static double weighted_inertia(const double* distances, const double* weights, int n){
+    double inertia = 0;
+    int i;
+    for (i = 0; i < n; i++) inertia += weights != NULL ? weights[i] * distances[i] : distances[i];
+    return inertia;
+}
+
+/**
+ * @brief The Lloyd loop shared by this project, kmeans/ and kmeans++/: every update assigns
+ * each point to its closest centroid (on the worker threads) and moves every centroid to the
+ * weighted mean of its points, a centroid whose cluster is empty keeps its place. The loop
+ * stops after max_iter updates or once no centroid moves by eps or more. Under a run_control
+ * progress is published after every update, with the weighted inertia (sum of squared distances
+ * to the assigned centroids) as the objective, and the loop stops between updates when cancelled
+ * or out of budget. With a checkpoint on the control the centroids are saved every interval
+ * updates and when the loop stops, and a checkpoint loaded by checkpoint_load resumes from the
+ * updates it already did. The per-call buffers come from one scratch arena.
+ *
+ * @param data Set of n datapoints
+ * @param weights Weight of every datapoint (NULL for unit weights)
+ * @param n Number of datapoints
+ * @param d Dimension of the datapoints
+ * @param k Number of clusters, in [1, n]
+ * @param max_iter Maximum number of updates
+ * @param eps Convergence threshold on the centroid shift
+ * @param centroids In: the initial centroids (ignored when a checkpoint resumes), out: the final ones
+ * @param labels Output array of n labels in [0, k) for the final centroids (may be NULL)
+ * @param control The control (may be NULL)
+ * @return int The number of updates performed, including those before a resumed checkpoint
+ */
+int kmeans_lloyd(double** data, const double* weights, int n, int d, int k, int max_iter, double eps, double** centroids, int* labels, run_control* control){
+    assign_pass pass;
+    arena scratch;
+    arena_backend backend = env_backend();
+    double** sums;
+    double* mass;
+    int iter = 0, moved = 1, i, c, l;
+    double shift, diff, largest = 0, inertia, w;
+    stats_timer timer;
+    checkpoint* cp = control != NULL ? control->checkpoint : NULL;
+
+    arena_init(&scratch, &backend, 0);
+    sums = arena_matrix(&scratch, k, d);
+    mass = arena_alloc(&scratch, k * sizeof(double));
+    if (cp != NULL && cp->iteration > 0) iter = cp->iteration, moved = !cp->finished;
+    pass.data = data, pass.d = d, pass.centroids = centroids, pass.k = k;
+    pass.labels = labels != NULL ? labels : arena_alloc(&scratch, (n > 0 ? n : 1) * sizeof(int));
+    pass.distances = NULL;
+    if (control != NULL) pass.distances = arena_alloc(&scratch, (n > 0 ? n : 1) * sizeof(double));
+
+    while (iter < max_iter && moved && !control_should_stop(control)){
+        timer = stats_begin(STAGE_UPDATE);
+        parallel_for(n, assign_points, &pass);
+        for (c = 0; c < k; c++){
+            memset(sums[c], 0, d * sizeof(double));
+            mass[c] = 0;
+        }
+        for (i = 0; i < n; i++){
+            w = weights != NULL ? weights[i] : 1.0;
+            mass[pass.labels[i]] += w;
+            for (l = 0; l < d; l++) sums[pass.labels[i]][l] += w * data[i][l];
+        }
+        stats_end(timer);
+        timer = stats_begin(STAGE_CONVERGENCE);
+        moved = 0, largest = 0;
+        for (c = 0; c < k; c++){
+            if (mass[c] == 0) continue; /* an empty cluster keeps its centroid */
+            shift = 0;
+            for (l = 0; l < d; l++){
+                diff = sums[c][l] / mass[c] - centroids[c][l];
+                shift += diff * diff;
+                centroids[c][l] = sums[c][l] / mass[c];
+            }
+            if (sqrt(shift) >= eps) moved = 1;
+            if (shift > largest) largest = shift;
+        }
+        stats_end(timer);
+        iter++;
+        if (control != NULL){
+            inertia = weighted_inertia(pass.distances, weights, n);
+            control_report(control, iter, largest, inertia); /* inertia of the assignment this update used */
+            checkpoint_step(cp, iter, inertia, centroids, k, d, NULL, 0);
+        }
+    }
+    stats_loop(iter, largest);
+    if (labels != NULL || control != NULL) parallel_for(n, assign_points, &pass);
+    if (control != NULL){
+        inertia = weighted_inertia(pass.distances, weights, n);
+        control_finish(control, CONTROL_DONE, inertia);
+        if (cp != NULL) cp->finished = !moved || iter >= max_iter;
+        checkpoint_step(cp, iter, inertia, centroids, k, d, NULL, 1);
+    }
+    arena_destroy(&scratch);
+    return iter;
+}
+
+/**
+ * @brief Lloyd's k-means with the semantics of kmeans.py: the first k points are the initial
+ * centroids, and the loop stops after max_iter updates or once no centroid moves by eps or
+ * more. The assignment step runs on the worker threads. Labels are those of the final centroids.
+ *
+ * @param data Set of n datapoints
+ * @param n Number of datapoints
+ * @param d Dimension of the datapoints
+ * @param k Number of clusters, in [1, n]
+ * @param max_iter Maximum number of updates
+ * @param eps Convergence threshold on the centroid shift
+ * @param centroids Output k x d matrix of final centroids
+ * @param labels Output array of n labels in [0, k)
+ * @return int The number of updates performed
+ */
+int kmeans_fit(double** data, int n, int d, int k, int max_iter, double eps, double** centroids, int* labels){
+    return kmeans_fit_controlled(data, n, d, k, max_iter, eps, centroids, labels, NULL);
+}
+
+/**
+ * @brief kmeans_fit under a run_control, see kmeans_lloyd: a checkpoint loaded by
+ * checkpoint_load resumes from the centroids it put in centroids instead of the first k points.
+ *
+ * @param data Set of n datapoints
+ * @param n Number of datapoints
+ * @param d Dimension of the datapoints
+ * @param k Number of clusters, in [1, n]
+ * @param max_iter Maximum number of updates
+ * @param eps Convergence threshold on the centroid shift
+ * @param centroids Output k x d matrix of final centroids
+ * @param labels Output array of n labels in [0, k)
+ * @param control The control (NULL runs uncontrolled, as kmeans_fit)
+ * @return int The number of updates performed, including those before a resumed checkpoint
+ */
+int kmeans_fit_controlled(double** data, int n, int d, int k, int max_iter, double eps, double** centroids, int* labels, run_control* control){
+    checkpoint* cp = control != NULL ? control->checkpoint : NULL;
+    int c;
+    if (cp == NULL || cp->iteration == 0){
+        for (c = 0; c < k; c++) memcpy(centroids[c], data[c], d * sizeof(double));
+    }
+    return kmeans_lloyd(data, NULL, n, d, k, max_iter, eps, centroids, labels, control);
+}
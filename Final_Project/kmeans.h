@@ -0,0 +1,15 @@
+#ifndef KMEANS_H
+#define KMEANS_H
+
+#include "control.h"
+
+/* Constants */
+#define KMEANS_MAX_ITER 300
+#define KMEANS_EPSILON 0.001
+
+/* Function declarations from kmeans.c */
+int kmeans_lloyd(double** data, const double* weights, int n, int d, int k, int max_iter, double eps, double** centroids, int* labels, run_control* control);
+int kmeans_fit(double** data, int n, int d, int k, int max_iter, double eps, double** centroids, int* labels);
+int kmeans_fit_controlled(double** data, int n, int d, int k, int max_iter, double eps, double** centroids, int* labels, run_control* control);
+
+#endif
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "symnmf.h"
+#include "parallel.h"
+#include "matrix_free.h"
+
+/* Shared context of a tiled pass over the affinities */
+typedef struct affinity_pass {
+    const affinity_operator* op;
+    double** H;     /* NULL for the degree pass */
+    int k;
+    double** out;   /* n x k result of W*H */
+    double* degree; /* n degrees, filled by the degree pass */
+} affinity_pass;
+
+/**
+ * @brief Fills a tile with the gaussian affinities exp(-||x_i - x_j||^2 / 2) of rows
+ * [row, row + rows) against columns [col, col + cols), with zeros on the diagonal
+ *
+ * @param op The affinity operator holding the points
+ * @param row First row of the tile
+ * @param rows Number of rows in the tile
+ * @param col First column of the tile
+ * @param cols Number of columns in the tile
+ * @param tile Output tile
+ */
+static void affinity_tile(const affinity_operator* op, int row, int rows, int col, int cols, double tile[TILE_ROWS][TILE_COLS]){
+    int i, j, l;
+    double dist, diff, *x, *y;
+    for (i = 0; i < rows; i++){
+        x = op->points[row + i];
+        for (j = 0; j < cols; j++){
+            y = op->points[col + j];
+            dist = 0;
+            for (l = 0; l < op->d; l++){
+                diff = x[l] - y[l];
+                dist += diff * diff;
+            }
+            tile[i][j] = (row + i == col + j) ? 0 : exp(-dist / 2);
+        }
+    }
+}
+
+/**
+ * @brief Range task of a tiled pass: for rows [begin, end) either sums the affinities
+ * (degree pass) or accumulates the rows of W*H
+ *
+ * @param ctx An affinity_pass
+ * @param begin First row
+ * @param end One past the last row
+ */
+static void affinity_rows(void* ctx, int begin, int end){
+    affinity_pass* pass = (affinity_pass*)ctx;
+    const affinity_operator* op = pass->op;
+    double tile[TILE_ROWS][TILE_COLS];
+    double scale, *out_row, *h_row;
+    int row, col, rows, cols, i, j, l;
+
+    for (row = begin; row < end; row += TILE_ROWS){
+        rows = end - row < TILE_ROWS ? end - row : TILE_ROWS;
+        for (col = 0; col < op->n; col += TILE_COLS){
+            cols = op->n - col < TILE_COLS ? op->n - col : TILE_COLS;
+            affinity_tile(op, row, rows, col, cols, tile);
+            for (i = 0; i < rows; i++){
+                if (pass->H == NULL){
+                    for (j = 0; j < cols; j++) pass->degree[row + i] += tile[i][j];
+                    continue;
+                }
+                out_row = pass->out[row + i];
+                for (j = 0; j < cols; j++){
+                    scale = tile[i][j] * op->d_inv_sqrt[col + j];
+                    h_row = pass->H[col + j];
+                    for (l = 0; l < pass->k; l++) out_row[l] += scale * h_row[l];
+                }
+            }
+        }
+        if (pass->H != NULL){
+            for (i = row; i < row + rows; i++){
+                for (l = 0; l < pass->k; l++) pass->out[i][l] *= op->d_inv_sqrt[i];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Prepares the matrix-free W of a set of points: one O(n^2 d) pass computes the degrees
+ * and keeps D^{-1/2}, the points themselves are borrowed, not copied
+ *
+ * @param op The operator to initialize
+ * @param points Set of n datapoints
+ * @param n Number of datapoints
+ * @param d Dimension of the datapoints
+ * @return int 0 on success, 1 on allocation failure
+ */
+int init_affinity_operator(affinity_operator* op, double** points, int n, int d){
+    affinity_pass pass;
+    int i;
+
+    op->points = points, op->n = n, op->d = d;
+    op->d_inv_sqrt = calloc(n, sizeof(double));
+    if (check_pointer(op->d_inv_sqrt)) return 1;
+
+    pass.op = op, pass.H = NULL, pass.k = 0, pass.out = NULL, pass.degree = op->d_inv_sqrt;
+    parallel_for(n, affinity_rows, &pass);
+    for (i = 0; i < n; i++){
+        op->d_inv_sqrt[i] = op->d_inv_sqrt[i] != 0 ? 1.0 / sqrt(op->d_inv_sqrt[i]) : 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Frees the memory owned by an affinity operator (not the points)
+ *
+ * @param op The operator
+ */
+void free_affinity_operator(affinity_operator* op){
+    free(op->d_inv_sqrt);
+    op->d_inv_sqrt = NULL;
+}
+
+/**
+ * @brief Calculates out = W*H tile by tile, recomputing the affinities on the fly.
+ * Every thread owns a contiguous slice of rows of out, so no synchronization is needed.
+ *
+ * @param W The matrix-free W, its data is an affinity_operator
+ * @param H A n x k matrix
+ * @param k Number of columns in H
+ * @param out A n x k matrix, overwritten with W*H
+ */
+void affinity_multiply(const w_operator* W, double** H, int k, double** out){
+    const affinity_operator* op = (const affinity_operator*)W->data;
+    affinity_pass pass;
+    int i;
+    for (i = 0; i < op->n; i++) memset(out[i], 0, k * sizeof(double));
+    pass.op = op, pass.H = H, pass.k = k, pass.out = out, pass.degree = NULL;
+    parallel_for(op->n, affinity_rows, &pass);
+}
+
+/**
+ * @brief Calculates the mean entry of W as 1^T W 1 / n^2 without materializing W
+ *
+ * @param op The matrix-free W
+ * @return double The mean of W
+ */
+double affinity_mean(const affinity_operator* op){
+    double** ones = create_matrix(op->n, 1);
+    double** out = create_matrix(op->n, 1);
+    double sum = 0;
+    w_operator W = affinity_w_operator(op);
+    int i;
+    for (i = 0; i < op->n; i++) ones[i][0] = 1;
+    affinity_multiply(&W, ones, 1, out);
+    for (i = 0; i < op->n; i++) sum += out[i][0];
+    free_matrix(ones, op->n), free_matrix(out, op->n);
+    return op->n > 0 ? sum / ((double)op->n * op->n) : 0;
+}
+
+/**
+ * @brief Wraps the matrix-free W as a generic operator for optimize_H_operator
+ *
+ * @param op The matrix-free W
+ * @return w_operator The operator
+ */
+w_operator affinity_w_operator(const affinity_operator* op){
+    w_operator W;
+    W.data = op, W.multiply = affinity_multiply, W.n = op->n;
+    return W;
+}
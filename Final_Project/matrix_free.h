@@ -0,0 +1,26 @@
+#ifndef MATRIX_FREE_H
+#define MATRIX_FREE_H
+
+#include "symnmf.h"
+
+/* Constants */
+#define TILE_ROWS 32
+#define TILE_COLS 128
+
+/* The normalized similarity matrix W of a set of points, represented only by the
+ * points and the D^{-1/2} scaling so that W is never materialized */
+typedef struct affinity_operator {
+    double** points;
+    int n;
+    int d;
+    double* d_inv_sqrt;
+} affinity_operator;
+
+/* Function declarations from matrix_free.c */
+int init_affinity_operator(affinity_operator* op, double** points, int n, int d);
+void free_affinity_operator(affinity_operator* op);
+void affinity_multiply(const w_operator* W, double** H, int k, double** out);
+double affinity_mean(const affinity_operator* op);
+w_operator affinity_w_operator(const affinity_operator* op);
+
+#endif
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "symnmf.h"
+#include "multilevel.h"
+
+/**
+ * @brief Heavy-edge matching: visits the nodes in random order and merges every unmatched
+ * node with its unmatched neighbor of largest affinity (or keeps it alone)
+ *
+ * @param A The n x n similarity matrix of the graph
+ * @param n Number of nodes
+ * @param state Random generator state
+ * @param parent Output array of size n, the coarse node of every node
+ * @return int The number of coarse nodes
+ */
+int heavy_edge_matching(double** A, int n, unsigned long *state, int* parent){
+    int *order, i, j, u, v, best, tmp, coarse_n = 0;
+    double best_weight;
+
+    order = malloc(n * sizeof(int));
+    if (check_pointer(order)) exit(1);
+    for (i = 0; i < n; i++){
+        order[i] = i;
+        parent[i] = -1;
+    }
+    for (i = n - 1; i > 0; i--){
+        j = (int)(rand_uniform(state) * (i + 1));
+        tmp = order[i], order[i] = order[j], order[j] = tmp;
+    }
+    for (i = 0; i < n; i++){
+        u = order[i];
+        if (parent[u] != -1) continue;
+        best = -1, best_weight = 0;
+        for (v = 0; v < n; v++){
+            if (v != u && parent[v] == -1 && A[u][v] > best_weight){
+                best = v, best_weight = A[u][v];
+            }
+        }
+        parent[u] = coarse_n;
+        if (best != -1) parent[best] = coarse_n;
+        coarse_n++;
+    }
+    free(order);
+    return coarse_n;
+}
+
+/**
+ * @brief Builds the coarse graph P^T A P: the affinity between two coarse nodes is the total
+ * affinity between their members, the affinity inside a merged pair stays on the diagonal
+ *
+ * @param A The n x n similarity matrix of the fine graph
+ * @param n Number of fine nodes
+ * @param parent The coarse node of every fine node
+ * @param coarse_n Number of coarse nodes
+ * @return double** The coarse_n x coarse_n similarity matrix
+ */
+double** coarsen_graph(double** A, int n, const int* parent, int coarse_n){
+    double** coarse = create_matrix(coarse_n, coarse_n);
+    int i, j;
+    for (i = 0; i < n; i++){
+        for (j = 0; j < n; j++){
+            coarse[parent[i]][parent[j]] += A[i][j];
+        }
+    }
+    return coarse;
+}
+
+/**
+ * @brief Gets a similarity matrix and returns its normalized matrix W (ddg followed by norm)
+ *
+ * @param A Similarity matrix
+ * @param n Number of rows and columns in A
+ * @param degree Output array of size n, the degree of every node
+ * @return double** W The normalized similarity matrix
+ */
+static double** normalize_graph(double** A, int n, double* degree){
+    double** D = ddg(A, n);
+    double** W = norm(D, A, n);
+    int i;
+    for (i = 0; i < n; i++) degree[i] = D[i][i];
+    free_matrix(D, n);
+    return W;
+}
+
+/**
+ * @brief Multilevel symNMF: coarsens the graph by heavy-edge matching until it is small,
+ * solves symNMF on the coarsest W, then projects H back level by level
+ * (h_i = h_parent * sqrt(deg_i / deg_parent)) and refines each level with a few update_H
+ * steps, running optimize_H to convergence on the original graph only.
+ *
+ * @param A The n x n similarity matrix (from sym), not modified
+ * @param n Number of datapoints
+ * @param k Number of columns in H
+ * @param seed Seed of the matchings and of the coarse initialization
+ * @param levels Output, the number of coarsening levels used (may be NULL)
+ * @return double** H The n x k decomposition matrix
+ */
+double** multilevel_symnmf(double** A, int n, int k, unsigned long seed, int* levels){
+    double** graphs[MULTILEVEL_MAX_LEVELS];
+    double* degrees[MULTILEVEL_MAX_LEVELS];
+    int* parents[MULTILEVEL_MAX_LEVELS];
+    int sizes[MULTILEVEL_MAX_LEVELS];
+    double **W, **H, **fine_H, **new_H, mean, bound;
+    int level = 0, coarse_n, min_size, i, j, it, *parent;
+    unsigned long state = seed;
+
+    min_size = MULTILEVEL_MIN_SIZE > 2 * k ? MULTILEVEL_MIN_SIZE : 2 * k;
+    graphs[0] = A, sizes[0] = n;
+    while (sizes[level] > min_size && level < MULTILEVEL_MAX_LEVELS - 1){
+        parent = malloc(sizes[level] * sizeof(int));
+        if (check_pointer(parent)) exit(1);
+        coarse_n = heavy_edge_matching(graphs[level], sizes[level], &state, parent);
+        if (coarse_n > MULTILEVEL_MIN_SHRINK * sizes[level]){
+            free(parent);
+            break;
+        }
+        parents[level] = parent;
+        graphs[level + 1] = coarsen_graph(graphs[level], sizes[level], parent, coarse_n);
+        sizes[level + 1] = coarse_n;
+        level++;
+    }
+    for (i = 0; i <= level; i++){
+        degrees[i] = malloc(sizes[i] * sizeof(double));
+        if (check_pointer(degrees[i])) exit(1);
+    }
+
+    /* solve on the coarsest graph, H drawn from [0, 2*sqrt(mean(W)/k)] like initialize_H */
+    W = normalize_graph(graphs[level], sizes[level], degrees[level]);
+    mean = 0;
+    for (i = 0; i < sizes[level]; i++){
+        for (j = 0; j < sizes[level]; j++) mean += W[i][j];
+    }
+    mean /= (double)sizes[level] * sizes[level];
+    bound = 2 * sqrt(mean / k);
+    H = create_matrix(sizes[level], k);
+    for (i = 0; i < sizes[level]; i++){
+        for (j = 0; j < k; j++) H[i][j] = bound * rand_uniform(&state);
+    }
+    H = optimize_H(H, W, sizes[level], k);
+    free_matrix(W, sizes[level]);
+
+    /* project and refine */
+    if (levels != NULL) *levels = level;
+    while (level > 0){
+        level--;
+        W = normalize_graph(graphs[level], sizes[level], degrees[level]);
+        fine_H = create_matrix(sizes[level], k);
+        for (i = 0; i < sizes[level]; i++){
+            parent = &parents[level][i];
+            for (j = 0; j < k; j++){
+                fine_H[i][j] = degrees[level + 1][*parent] > 0
+                    ? H[*parent][j] * sqrt(degrees[level][i] / degrees[level + 1][*parent]) : H[*parent][j];
+            }
+        }
+        free_matrix(H, sizes[level + 1]);
+        H = fine_H;
+        if (level > 0){
+            for (it = 0; it < MULTILEVEL_REFINE_ITER; it++){
+                new_H = update_H(H, W, sizes[level], k);
+                free_matrix(H, sizes[level]);
+                H = new_H;
+            }
+            free_matrix(graphs[level + 1], sizes[level + 1]);
+        } else {
+            H = optimize_H(H, W, n, k);
+            free_matrix(graphs[1], sizes[1]);
+        }
+        free_matrix(W, sizes[level]);
+        free(parents[level]);
+        free(degrees[level + 1]);
+    }
+    free(degrees[0]);
+    return H;
+}
@@ -0,0 +1,16 @@
+#ifndef MULTILEVEL_H
+#define MULTILEVEL_H
+
+/* Constants */
+#define MULTILEVEL_MAX_LEVELS 32
+#define MULTILEVEL_MIN_SIZE 64
+#define MULTILEVEL_MIN_SHRINK 0.9
+#define MULTILEVEL_REFINE_ITER 10
+#define MULTILEVEL_DEFAULT_SEED 1234
+
+/* Function declarations from multilevel.c */
+int heavy_edge_matching(double** A, int n, unsigned long *state, int* parent);
+double** coarsen_graph(double** A, int n, const int* parent, int coarse_n);
+double** multilevel_symnmf(double** A, int n, int k, unsigned long seed, int* levels);
+
+#endif
@@ -0,0 +1,75 @@
+import sys
+import time
+import numpy as np
+import symnmfmodule
+from sklearn.metrics import silhouette_score, adjusted_rand_score
+from symnmf import initialize_H
+
+# points, dimension and number of clusters of every generated gaussian mixture
+CASES = [(500, 2, 4), (1000, 3, 6), (2000, 4, 8)]
+
+def gaussian_mixture(n, d, k, seed):
+    """
+    Draws n points from k well separated unit-variance gaussians in d dimensions.
+
+    Returns:
+    points, labels: The points as a 2D list and the true cluster of every point.
+    """
+    rng = np.random.default_rng(seed)
+    centers = rng.uniform(-4 * k ** (1 / d), 4 * k ** (1 / d), (k, d))
+    labels = rng.integers(0, k, n)
+    points = centers[labels] + rng.normal(0, 1, (n, d))
+    return points.tolist(), labels
+
+def flat_labels(data_matrix, k):
+    """
+    Clusters with the flat symNMF on the full normalized similarity matrix W.
+
+    Returns:
+    labels, seconds: The symNMF labels and the run time.
+    """
+    start = time.perf_counter()
+    np.random.seed(1234)
+    W = symnmfmodule.norm(data_matrix)
+    H = symnmfmodule.symnmf(W, initialize_H(len(data_matrix), k, W), len(data_matrix), k)
+    return np.argmax(np.array(H), axis=1), time.perf_counter() - start
+
+def multilevel_labels(data_matrix, k):
+    """
+    Clusters with the multilevel symNMF.
+
+    Returns:
+    labels, levels, seconds: The symNMF labels, the number of coarsening levels and the run time.
+    """
+    start = time.perf_counter()
+    H, info = symnmfmodule.symnmf_multilevel(data_matrix, k, 1234, True)
+    return np.argmax(np.array(H), axis=1), info['levels'], time.perf_counter() - start
+
+def score(data_matrix, labels):
+    """
+    Silhouette score, or nan when all the points fall in a single cluster.
+    """
+    if len(set(labels)) < 2:
+        return float('nan')
+    return silhouette_score(data_matrix, labels)
+
+def main():
+    """
+    Compares the multilevel path against the flat path on generated gaussian mixtures (or on
+    the "n d k" triples given as arguments): agreement with the true labels, silhouette and time.
+    """
+    cases = CASES
+    if len(sys.argv) > 1:
+        cases = [tuple(int(x) for x in sys.argv[i:i + 3]) for i in range(1, len(sys.argv) - 2, 3)]
+
+    print("n,d,k,levels,ari,ari_flat,silhouette,silhouette_flat,seconds,seconds_flat")
+    for n, d, k in cases:
+        data_matrix, truth = gaussian_mixture(n, d, k, 1234)
+        flat, flat_time = flat_labels(data_matrix, k)
+        labels, levels, seconds = multilevel_labels(data_matrix, k)
+        print("%d,%d,%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f" % (n, d, k, levels,
+              adjusted_rand_score(truth, labels), adjusted_rand_score(truth, flat),
+              score(data_matrix, labels), score(data_matrix, flat), seconds, flat_time))
+
+if __name__ == "__main__":
+    main()
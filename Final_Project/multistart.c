@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "symnmf.h"
+#include "parallel.h"
+#include "packed.h"
+#include "multistart.h"
+
+/* Shared context of the restarts, W is only read */
+typedef struct multistart_pass {
+    const packed_matrix* W;
+    int k;
+    double bound;   /* 2*sqrt(mean(W)/k), as in initialize_H */
+    double w_norm2; /* ||W||^2 for the objective */
+    restart_result* results;
+} multistart_pass;
+
+/**
+ * @brief Range task running restarts [begin, end): each one draws its own H from its seed,
+ * optimizes it on the shared W and scores it. Every restart allocates its own workspace,
+ * so the runs share nothing writable.
+ *
+ * @param ctx A multistart_pass
+ * @param begin First restart
+ * @param end One past the last restart
+ */
+static void restart_runs(void* ctx, int begin, int end){
+    multistart_pass* pass = (multistart_pass*)ctx;
+    w_operator op = packed_w_operator(pass->W);
+    restart_result* run;
+    double** H;
+    unsigned long state;
+    int r, i, j;
+
+    for (r = begin; r < end; r++){
+        run = &pass->results[r];
+        state = run->seed;
+        H = create_matrix(pass->W->n, pass->k);
+        for (i = 0; i < pass->W->n; i++){
+            for (j = 0; j < pass->k; j++) H[i][j] = pass->bound * rand_uniform(&state);
+        }
+        run->H = optimize_H_operator(H, &op, pass->k, &run->iterations);
+        run->objective = operator_objective(run->H, &op, pass->k, pass->w_norm2);
+    }
+}
+
+/**
+ * @brief Runs independent symNMF restarts on one W concurrently (restart r uses seed + r,
+ * restarts are spread over the worker threads of parallel_steal, whose nested row passes run
+ * inline) and picks the lowest objective
+ *
+ * @param W The packed normalized similarity matrix, shared read-only by all the runs
+ * @param k Number of columns in H
+ * @param restarts Number of runs
+ * @param seed Seed of the first run
+ * @param results Output array of restarts results, freed by free_restart_results
+ * @return int Index of the run with the lowest objective, -1 for invalid arguments
+ */
+int symnmf_multistart(const packed_matrix* W, int k, int restarts, unsigned long seed, restart_result* results){
+    multistart_pass pass;
+    double mean;
+    int r, best = 0;
+
+    if (restarts <= 0 || k <= 0 || k >= W->n) return -1;
+    mean = packed_sum(W, &pass.w_norm2) / ((double)W->n * W->n);
+    pass.W = W, pass.k = k, pass.bound = 2 * sqrt(mean / k), pass.results = results;
+    for (r = 0; r < restarts; r++){
+        results[r].seed = seed + (unsigned long)r;
+        results[r].H = NULL;
+    }
+    parallel_steal(restarts, restart_runs, &pass);
+    for (r = 1; r < restarts; r++){
+        if (results[r].objective < results[best].objective) best = r;
+    }
+    return best;
+}
+
+/**
+ * @brief Frees the matrices owned by the results of a multi-start
+ *
+ * @param results The results
+ * @param restarts Number of results
+ * @param n Number of rows in every H
+ */
+void free_restart_results(restart_result* results, int restarts, int n){
+    int r;
+    for (r = 0; r < restarts; r++){
+        if (results[r].H != NULL) free_matrix(results[r].H, n);
+        results[r].H = NULL;
+    }
+}
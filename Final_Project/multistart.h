@@ -0,0 +1,22 @@
+#ifndef MULTISTART_H
+#define MULTISTART_H
+
+#include "symnmf.h"
+#include "packed.h"
+
+/* Constants */
+#define MULTISTART_DEFAULT_SEED 1234
+
+/* One independent run of a multi-start */
+typedef struct restart_result {
+    unsigned long seed;
+    double** H;     /* n x k, NULL once freed */
+    int iterations;
+    double objective;
+} restart_result;
+
+/* Function declarations from multistart.c */
+int symnmf_multistart(const packed_matrix* W, int k, int restarts, unsigned long seed, restart_result* results);
+void free_restart_results(restart_result* results, int restarts, int n);
+
+#endif
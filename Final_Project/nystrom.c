@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "symnmf.h"
+#include "parallel.h"
+#include "nystrom.h"
+
+/* Shared context of the pass that fills the n x m block of affinities to the landmarks */
+typedef struct landmark_pass {
+    double** points;
+    int d;
+    int* landmarks;
+    int m;
+    double** C;
+} landmark_pass;
+
+/**
+ * @brief Range task filling rows [begin, end) of C with the gaussian kernel
+ * exp(-||x_i - x_l||^2 / 2) between every point and every landmark (same kernel as sym)
+ *
+ * @param ctx A landmark_pass
+ * @param begin First row
+ * @param end One past the last row
+ */
+static void landmark_rows(void* ctx, int begin, int end){
+    landmark_pass* pass = (landmark_pass*)ctx;
+    double dist, diff, *x, *y;
+    int i, j, l;
+    for (i = begin; i < end; i++){
+        x = pass->points[i];
+        for (j = 0; j < pass->m; j++){
+            y = pass->points[pass->landmarks[j]];
+            dist = 0;
+            for (l = 0; l < pass->d; l++){
+                diff = x[l] - y[l];
+                dist += diff * diff;
+            }
+            pass->C[i][j] = exp(-dist / 2);
+        }
+    }
+}
+
+/**
+ * @brief Builds the Nystrom approximation of W from m landmark points.
+ * With C the n x m kernel block and M = V L V^T the m x m landmark block, the kernel is
+ * approximated by G G^T where G = C V L^{-1/2}. The degrees are approximated by G(G^T 1) - 1
+ * (the similarity matrix has a zero diagonal), which gives W ~ F F^T - diag(D^{-1}) with
+ * F = D^{-1/2} G. Costs O(nmd + m^3) time and O(nm) memory.
+ *
+ * @param op The operator to initialize
+ * @param points Set of n datapoints
+ * @param n Number of datapoints
+ * @param d Dimension of the datapoints
+ * @param m Number of landmarks (clamped to n)
+ * @param seed Seed of the landmark sampler
+ * @return int 0 on success, 1 on failure
+ */
+int init_nystrom_operator(lowrank_operator* op, double** points, int n, int d, int m, unsigned long seed){
+    landmark_pass pass;
+    double **C, **M, **V, *values, *col_sums, scale, deg, dinv;
+    int *indices, i, j, l, r, tmp;
+    unsigned long state = seed;
+
+    if (m > n) m = n;
+    if (n <= 0 || m <= 0) return 1;
+    indices = malloc(n * sizeof(int));
+    values = malloc(m * sizeof(double));
+    if (check_pointer(indices) || check_pointer(values)) exit(1);
+
+    /* partial Fisher-Yates shuffle, the first m indices are the landmarks */
+    for (i = 0; i < n; i++) indices[i] = i;
+    for (i = 0; i < m; i++){
+        j = i + (int)(rand_uniform(&state) * (n - i));
+        tmp = indices[i], indices[i] = indices[j], indices[j] = tmp;
+    }
+
+    C = create_matrix(n, m);
+    pass.points = points, pass.d = d, pass.landmarks = indices, pass.m = m, pass.C = C;
+    parallel_for(n, landmark_rows, &pass);
+
+    M = create_matrix(m, m);
+    V = create_matrix(m, m);
+    for (i = 0; i < m; i++) memcpy(M[i], C[indices[i]], m * sizeof(double));
+    symmetric_eigen(M, m, values, V);
+    for (r = 0; r < m && values[r] > NYSTROM_RCOND * values[0]; r++);
+
+    /* G = C V_r L_r^{-1/2}, stored directly in F */
+    op->n = n, op->r = r;
+    op->F = create_matrix(n, r > 0 ? r : 1);
+    op->diag = malloc(n * sizeof(double));
+    col_sums = calloc(r > 0 ? r : 1, sizeof(double));
+    if (check_pointer(op->diag) || check_pointer(col_sums)) exit(1);
+    for (j = 0; j < r; j++) values[j] = 1.0 / sqrt(values[j]);
+    for (i = 0; i < n; i++){
+        for (l = 0; l < m; l++){
+            scale = C[i][l];
+            for (j = 0; j < r; j++) op->F[i][j] += scale * V[l][j];
+        }
+        for (j = 0; j < r; j++){
+            op->F[i][j] *= values[j];
+            col_sums[j] += op->F[i][j];
+        }
+    }
+
+    /* degrees G(G^T 1) - 1, then F = D^{-1/2} G and the diagonal correction D^{-1} */
+    for (i = 0; i < n; i++){
+        deg = -1;
+        for (j = 0; j < r; j++) deg += op->F[i][j] * col_sums[j];
+        dinv = deg > 0 ? 1.0 / sqrt(deg) : 0;
+        for (j = 0; j < r; j++) op->F[i][j] *= dinv;
+        op->diag[i] = dinv * dinv;
+    }
+
+    free_matrix(C, n), free_matrix(M, m), free_matrix(V, m);
+    free(indices), free(values), free(col_sums);
+    return 0;
+}
+
+/**
+ * @brief Frees the memory owned by a low-rank operator
+ *
+ * @param op The operator
+ */
+void free_lowrank_operator(lowrank_operator* op){
+    free_matrix(op->F, op->n);
+    free(op->diag);
+    op->F = NULL, op->diag = NULL;
+}
+
+/**
+ * @brief Calculates out = (F F^T - diag) H as F(F^T H) - diag*H in O(nrk)
+ *
+ * @param W The low-rank W, its data is a lowrank_operator
+ * @param H A n x k matrix
+ * @param k Number of columns in H
+ * @param out A n x k matrix, overwritten with W*H
+ */
+void lowrank_multiply(const w_operator* W, double** H, int k, double** out){
+    const lowrank_operator* op = (const lowrank_operator*)W->data;
+    double** FtH = create_matrix(op->r > 0 ? op->r : 1, k);
+    int i, j, l;
+    for (i = 0; i < op->n; i++){
+        for (j = 0; j < op->r; j++){
+            for (l = 0; l < k; l++) FtH[j][l] += op->F[i][j] * H[i][l];
+        }
+    }
+    for (i = 0; i < op->n; i++){
+        for (l = 0; l < k; l++){
+            out[i][l] = -op->diag[i] * H[i][l];
+            for (j = 0; j < op->r; j++) out[i][l] += op->F[i][j] * FtH[j][l];
+        }
+    }
+    free_matrix(FtH, op->r > 0 ? op->r : 1);
+}
+
+/**
+ * @brief Calculates the mean entry of the approximated W, (||F^T 1||^2 - sum(diag)) / n^2
+ *
+ * @param op The low-rank W
+ * @return double The mean of W
+ */
+double lowrank_mean(const lowrank_operator* op){
+    double sum = 0, col;
+    int i, j;
+    for (j = 0; j < op->r; j++){
+        col = 0;
+        for (i = 0; i < op->n; i++) col += op->F[i][j];
+        sum += col * col;
+    }
+    for (i = 0; i < op->n; i++) sum -= op->diag[i];
+    return op->n > 0 ? sum / ((double)op->n * op->n) : 0;
+}
+
+/**
+ * @brief Wraps the low-rank W as a generic operator for optimize_H_operator
+ *
+ * @param op The low-rank W
+ * @return w_operator The operator
+ */
+w_operator lowrank_w_operator(const lowrank_operator* op){
+    w_operator W;
+    W.data = op, W.multiply = lowrank_multiply, W.n = op->n;
+    return W;
+}
@@ -0,0 +1,25 @@
+#ifndef NYSTROM_H
+#define NYSTROM_H
+
+#include "symnmf.h"
+
+/* Constants */
+#define NYSTROM_DEFAULT_SEED 1234
+#define NYSTROM_RCOND 1e-10
+
+/* A low-rank plus diagonal approximation W ~ F F^T - diag(diag) */
+typedef struct lowrank_operator {
+    double** F;
+    double* diag;
+    int n;
+    int r;
+} lowrank_operator;
+
+/* Function declarations from nystrom.c */
+int init_nystrom_operator(lowrank_operator* op, double** points, int n, int d, int m, unsigned long seed);
+void free_lowrank_operator(lowrank_operator* op);
+void lowrank_multiply(const w_operator* W, double** H, int k, double** out);
+double lowrank_mean(const lowrank_operator* op);
+w_operator lowrank_w_operator(const lowrank_operator* op);
+
+#endif
@@ -0,0 +1,69 @@
+import sys
+import time
+import numpy as np
+import symnmfmodule
+from sklearn.metrics import silhouette_score, adjusted_rand_score
+from symnmf import initialize_H, initialize_H_from_mean, compute_data_matrix
+
+# input file and number of clusters of every Final_Project/tests case
+CASES = [("tests/input_1.txt", 5), ("tests/input_2.txt", 4), ("tests/input_3.txt", 7)]
+LANDMARK_FRACTIONS = [0.25, 0.5, 0.75, 1.0]
+
+def exact_labels(data_matrix, k):
+    """
+    Clusters with the exact normalized similarity matrix W.
+
+    Returns:
+    labels, seconds: The symNMF labels and the run time.
+    """
+    start = time.perf_counter()
+    np.random.seed(1234)
+    W = symnmfmodule.norm(data_matrix)
+    H = initialize_H(len(data_matrix), k, W)
+    H = symnmfmodule.symnmf(W, H, len(data_matrix), k)
+    return np.argmax(np.array(H), axis=1), time.perf_counter() - start
+
+def nystrom_labels(data_matrix, k, m):
+    """
+    Clusters with the Nystrom approximation of W built from m landmarks.
+
+    Returns:
+    labels, seconds: The symNMF labels and the run time.
+    """
+    start = time.perf_counter()
+    np.random.seed(1234)
+    H = initialize_H_from_mean(len(data_matrix), k, symnmfmodule.norm_mean(data_matrix, m))
+    H = symnmfmodule.symnmf_nystrom(data_matrix, H, k, m)
+    return np.argmax(np.array(H), axis=1), time.perf_counter() - start
+
+def score(data_matrix, labels):
+    """
+    Silhouette score, or nan when all the points fall in a single cluster.
+    """
+    if len(set(labels)) < 2:
+        return float('nan')
+    return silhouette_score(data_matrix, labels)
+
+def main():
+    """
+    Compares the Nystrom path against the exact path on the test inputs (or on the
+    "file k" pairs given as arguments): agreement (adjusted rand index), silhouette and time.
+    """
+    cases = CASES
+    if len(sys.argv) > 1:
+        cases = [(sys.argv[i], int(sys.argv[i + 1])) for i in range(1, len(sys.argv) - 1, 2)]
+
+    print("input,k,landmarks,ari_vs_exact,silhouette,silhouette_exact,seconds,seconds_exact")
+    for file_name, k in cases:
+        data_matrix = compute_data_matrix(file_name)
+        n = len(data_matrix)
+        exact, exact_time = exact_labels(data_matrix, k)
+        exact_score = score(data_matrix, exact)
+        for fraction in LANDMARK_FRACTIONS:
+            m = max(k, int(round(fraction * n)))
+            labels, seconds = nystrom_labels(data_matrix, k, m)
+            print("%s,%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f" % (file_name, k, m, adjusted_rand_score(exact, labels),
+                                                       score(data_matrix, labels), exact_score, seconds, exact_time))
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "symnmf.h"
+#include "parallel.h"
+#include "placement.h"
+#include "stats.h"
+#include "packed.h"
+
+/* Shared context of a row pass over a packed matrix (sym, ddg or norm) */
+typedef struct packed_pass {
+    packed_matrix* A;
+    double** points;
+    double* weights;
+    int d;
+    const double* scale; /* D^{-1/2}, for the norm pass */
+    double* degree;      /* output of the ddg pass */
+} packed_pass;
+
+/* Shared context of packed_multiply: a slice starting at row b scatters the entries of its
+   rows into the rows [0, b) of earlier slices through spill[b], a b x k buffer of its own */
+typedef struct product_pass {
+    const packed_matrix* A;
+    double** H;
+    int k;
+    double** out;
+    double** spill;           /* n pointers, set at the first row of every slice but the first */
+    int starts[MAX_THREADS];  /* the first rows with a spill */
+    int slices;
+} product_pass;
+
+/**
+ * @brief Row offsets of a packed lower triangle, the row-major offsets of placed_alloc
+ *
+ * @param row A row (or n, for the size of the triangle)
+ * @param width Unused
+ * @return size_t PACKED_INDEX(row, 0)
+ */
+static size_t packed_row_offset(int row, int width){
+    (void)width;
+    return PACKED_INDEX(row, 0);
+}
+
+/**
+ * @brief Allocates a zeroed packed symmetric matrix, placed by placed_alloc so that
+ * the rows of every parallel_for slice are local to the thread that processes them
+ *
+ * @param A The matrix to initialize
+ * @param n Number of rows and columns
+ * @return int 0 on success, 1 on allocation failure
+ */
+int init_packed_matrix(packed_matrix* A, int n){
+    A->n = n;
+    A->data = placed_alloc(n, 0, packed_row_offset);
+    return check_pointer(A->data);
+}
+
+/**
+ * @brief Frees the memory owned by a packed symmetric matrix
+ *
+ * @param A The matrix
+ */
+void free_packed_matrix(packed_matrix* A){
+    placed_free(A->data, A->n, 0, packed_row_offset);
+    A->data = NULL;
+}
+
+/**
+ * @brief Reads entry (i, j) of a packed symmetric matrix
+ *
+ * @param A The matrix
+ * @param i Row
+ * @param j Column
+ * @return double A[i][j]
+ */
+double packed_get(const packed_matrix* A, int i, int j){
+    return i >= j ? A->data[PACKED_INDEX(i, j)] : A->data[PACKED_INDEX(j, i)];
+}
+
+/**
+ * @brief Range task of sym_packed, fills the packed rows [begin, end)
+ *
+ * @param ctx A packed_pass
+ * @param begin First row
+ * @param end One past the last row
+ */
+static void sym_rows(void* ctx, int begin, int end){
+    packed_pass* pass = (packed_pass*)ctx;
+    double* row;
+    int i, j;
+    for (i = begin; i < end; i++){
+        row = pass->A->data + PACKED_INDEX(i, 0);
+        for (j = 0; j < i; j++){
+            row[j] = exp(-(pow(vector_distance(pass->points[i], pass->points[j], pass->d), 2)) / 2);
+            if (pass->weights != NULL) row[j] *= pass->weights[i] * pass->weights[j];
+        }
+        row[i] = 0;
+    }
+}
+
+/**
+ * @brief Packed version of sym_weighted: the same gaussian affinities, each pair computed once.
+ * Rows are filled in parallel slices, the same slices that first touched them.
+ *
+ * @param A The matrix to initialize
+ * @param points Set of n datapoints
+ * @param weights Weight of every datapoint, NULL for unit weights
+ * @param n Number of datapoints
+ * @param d Dimension of the datapoints
+ * @return int 0 on success, 1 on allocation failure
+ */
+int sym_packed(packed_matrix* A, double** points, double* weights, int n, int d){
+    packed_pass pass;
+    stats_timer timer = stats_begin(STAGE_SYM);
+    if (init_packed_matrix(A, n)){
+        stats_end(timer);
+        return 1;
+    }
+    pass.A = A, pass.points = points, pass.weights = weights, pass.d = d;
+    pass.scale = NULL, pass.degree = NULL;
+    parallel_for(n, sym_rows, &pass);
+    stats_end(timer);
+    return 0;
+}
+
+/**
+ * @brief Range task of ddg_packed, sums the rows [begin, end) of A
+ *
+ * @param ctx A packed_pass
+ * @param begin First row
+ * @param end One past the last row
+ */
+static void ddg_rows(void* ctx, int begin, int end){
+    packed_pass* pass = (packed_pass*)ctx;
+    int i, j;
+    for (i = begin; i < end; i++){
+        pass->degree[i] = 0.0;
+        for (j = 0; j < pass->A->n; j++) pass->degree[i] += packed_get(pass->A, i, j);
+    }
+}
+
+/**
+ * @brief Packed version of ddg: the degrees are returned as a vector, the diagonal of D
+ *
+ * @param A The packed similarity matrix
+ * @return double* The n degrees
+ */
+double* ddg_packed(const packed_matrix* A){
+    stats_timer timer = stats_begin(STAGE_DDG);
+    double* degree = malloc((A->n > 0 ? A->n : 1) * sizeof(double));
+    packed_pass pass;
+    if (check_pointer(degree)) exit(1);
+    pass.A = (packed_matrix*)A, pass.points = NULL, pass.weights = NULL, pass.d = 0;
+    pass.scale = NULL, pass.degree = degree;
+    parallel_for(A->n, ddg_rows, &pass);
+    stats_end(timer);
+    return degree;
+}
+
+/**
+ * @brief Range task of norm_packed, scales the rows [begin, end) of A
+ *
+ * @param ctx A packed_pass
+ * @param begin First row
+ * @param end One past the last row
+ */
+static void norm_rows(void* ctx, int begin, int end){
+    packed_pass* pass = (packed_pass*)ctx;
+    double* row;
+    int i, j;
+    for (i = begin; i < end; i++){
+        row = pass->A->data + PACKED_INDEX(i, 0);
+        for (j = 0; j <= i; j++) row[j] = pass->scale[i] * row[j] * pass->scale[j];
+    }
+}
+
+/**
+ * @brief Packed version of norm: turns A into W = D^{-1/2} A D^{-1/2} in place
+ *
+ * @param A The packed similarity matrix, overwritten with W
+ * @param degree The degrees from ddg_packed
+ */
+void norm_packed(packed_matrix* A, const double* degree){
+    stats_timer timer = stats_begin(STAGE_NORM);
+    double* D_inv_sqrt = malloc((A->n > 0 ? A->n : 1) * sizeof(double));
+    packed_pass pass;
+    int i;
+    if (check_pointer(D_inv_sqrt)) exit(1);
+    for (i = 0; i < A->n; i++){
+        D_inv_sqrt[i] = degree[i] != 0 ? 1.0 / sqrt(degree[i]) : 0;
+    }
+    pass.A = A, pass.points = NULL, pass.weights = NULL, pass.d = 0;
+    pass.scale = D_inv_sqrt, pass.degree = NULL;
+    parallel_for(A->n, norm_rows, &pass);
+    free(D_inv_sqrt);
+    stats_end(timer);
+}
+
+/**
+ * @brief Prints a packed symmetric matrix in full, in the format of print_matrix
+ *
+ * @param A The matrix
+ */
+void print_packed_matrix(const packed_matrix* A){
+    int i, j;
+    for (i = 0; i < A->n; i++){
+        for (j = 0; j < A->n; j++){
+            printf("%.4f", packed_get(A, i, j));
+            if (j < A->n - 1) printf(",");
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * @brief Range task of packed_multiply, streams the packed rows [begin, end) of W: row i adds
+ * w_ij * h_j to out_i and w_ij * h_i to out_j, or to the spill of the slice when j < begin
+ *
+ * @param ctx A product_pass
+ * @param begin First row
+ * @param end One past the last row
+ */
+static void product_rows(void* ctx, int begin, int end){
+    product_pass* pass = (product_pass*)ctx;
+    const double* row;
+    double w, *out_i, *out_j, *h_i, *h_j, *spill = NULL;
+    int i, j, l, k = pass->k;
+    if (begin > 0){
+        spill = calloc((size_t)begin * k, sizeof(double));
+        if (check_pointer(spill)) exit(1);
+        pass->spill[begin] = spill;
+    }
+    for (i = begin; i < end; i++) memset(pass->out[i], 0, k * sizeof(double));
+    for (i = begin; i < end; i++){
+        row = pass->A->data + PACKED_INDEX(i, 0);
+        out_i = pass->out[i], h_i = pass->H[i];
+        for (j = 0; j < i; j++){
+            w = row[j], out_j = j < begin ? spill + (size_t)j * k : pass->out[j], h_j = pass->H[j];
+            for (l = 0; l < k; l++){
+                out_i[l] += w * h_j[l];
+                out_j[l] += w * h_i[l];
+            }
+        }
+        w = row[i];
+        for (l = 0; l < k; l++) out_i[l] += w * h_i[l];
+    }
+}
+
+/**
+ * @brief Range task of packed_multiply, adds the spills of the later slices to the rows
+ * [begin, end) of out
+ *
+ * @param ctx A product_pass
+ * @param begin First row
+ * @param end One past the last row
+ */
+static void spill_rows(void* ctx, int begin, int end){
+    product_pass* pass = (product_pass*)ctx;
+    const double* spill;
+    int i, s, l;
+    for (i = begin; i < end; i++){
+        for (s = 0; s < pass->slices; s++){
+            if (pass->starts[s] <= i) continue;
+            spill = pass->spill[pass->starts[s]] + (size_t)i * pass->k;
+            for (l = 0; l < pass->k; l++) pass->out[i][l] += spill[l];
+        }
+    }
+}
+
+/**
+ * @brief SYMM kernel, out = W*H for a packed W. Every stored entry w_ij (i > j) is read once
+ * and contributes w_ij * h_j to row i and w_ij * h_i to row j, so W is streamed once per
+ * product instead of twice. Every parallel_for slice streams its own rows, the ones
+ * placed_alloc put on its node; what they add to the rows of earlier slices goes to a spill
+ * buffer per slice, summed into out by a second row pass.
+ *
+ * @param W The packed W, its data is a packed_matrix
+ * @param H A n x k matrix
+ * @param k Number of columns in H
+ * @param out A n x k matrix, overwritten with W*H
+ */
+void packed_multiply(const w_operator* W, double** H, int k, double** out){
+    product_pass pass;
+    int n = W->n, i;
+    pass.A = (const packed_matrix*)W->data, pass.H = H, pass.k = k, pass.out = out;
+    pass.spill = calloc(n > 0 ? n : 1, sizeof(double*));
+    if (check_pointer(pass.spill)) exit(1);
+    parallel_for(n, product_rows, &pass);
+    pass.slices = 0;
+    for (i = 0; i < n; i++){
+        if (pass.spill[i] != NULL) pass.starts[pass.slices++] = i;
+    }
+    if (pass.slices > 0) parallel_for(n, spill_rows, &pass);
+    for (i = 0; i < pass.slices; i++) free(pass.spill[pass.starts[i]]);
+    free(pass.spill);
+}
+
+/**
+ * @brief Wraps a packed W as a generic operator for optimize_H_operator
+ *
+ * @param A The packed W
+ * @return w_operator The operator
+ */
+w_operator packed_w_operator(const packed_matrix* A){
+    w_operator W;
+    W.data = A, W.multiply = packed_multiply, W.n = A->n;
+    return W;
+}
+
+/**
+ * @brief Calculates the sum of all the entries of a packed symmetric matrix, and optionally
+ * the sum of their squares (||A||^2 for the frobenius norm)
+ *
+ * @param A The matrix
+ * @param squares Output, the sum of the squared entries (may be NULL)
+ * @return double The sum of the entries
+ */
+double packed_sum(const packed_matrix* A, double* squares){
+    double sum = 0, sum2 = 0, a;
+    size_t idx = 0;
+    int i, j;
+    for (i = 0; i < A->n; i++){
+        for (j = 0; j <= i; j++, idx++){
+            a = A->data[idx];
+            sum += i == j ? a : 2 * a;
+            sum2 += i == j ? a * a : 2 * a * a;
+        }
+    }
+    if (squares != NULL) *squares = sum2;
+    return sum;
+}
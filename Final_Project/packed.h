@@ -0,0 +1,27 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#include "symnmf.h"
+
+/* Position of entry (i, j), i >= j, in the row-packed lower triangle */
+#define PACKED_INDEX(i, j) ((size_t)(i) * ((size_t)(i) + 1) / 2 + (size_t)(j))
+
+/* A symmetric n x n matrix storing only its lower triangle, n(n+1)/2 entries row by row */
+typedef struct packed_matrix {
+    double* data;
+    int n;
+} packed_matrix;
+
+/* Function declarations from packed.c */
+int init_packed_matrix(packed_matrix* A, int n);
+void free_packed_matrix(packed_matrix* A);
+double packed_get(const packed_matrix* A, int i, int j);
+int sym_packed(packed_matrix* A, double** points, double* weights, int n, int d);
+double* ddg_packed(const packed_matrix* A);
+void norm_packed(packed_matrix* A, const double* degree);
+void print_packed_matrix(const packed_matrix* A);
+void packed_multiply(const w_operator* W, double** H, int k, double** out);
+w_operator packed_w_operator(const packed_matrix* A);
+double packed_sum(const packed_matrix* A, double* squares);
+
+#endif
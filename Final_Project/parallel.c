@@ -0,0 +1,234 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+/* The arguments of a single worker thread */
+typedef struct range_job {
+    range_task task;
+    void* ctx;
+    int begin;
+    int end;
+} range_job;
+
+/* The items [next, end) still queued on one worker of parallel_steal, the owner takes
+   from the front and thieves cut the back half off */
+typedef struct steal_queue {
+    pthread_mutex_t lock;
+    int next;
+    int end;
+} steal_queue;
+
+/* Shared state of a parallel_steal call */
+typedef struct steal_pool {
+    range_task task;
+    void* ctx;
+    steal_queue queues[MAX_THREADS];
+    int count;
+} steal_pool;
+
+/* The arguments of a single parallel_steal worker */
+typedef struct steal_worker {
+    steal_pool* pool;
+    int id;
+} steal_worker;
+
+/* Set on the threads of parallel_steal, whose nested parallel loops run inline */
+static pthread_key_t worker_key;
+static pthread_once_t worker_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Creates worker_key, once per process
+ */
+static void create_worker_key(void){
+    pthread_key_create(&worker_key, NULL);
+}
+
+/**
+ * @brief Whether the calling thread is a parallel_steal worker
+ *
+ * @return int 1 inside a worker, 0 otherwise
+ */
+static int inside_worker(void){
+    pthread_once(&worker_key_once, create_worker_key);
+    return pthread_getspecific(worker_key) != NULL;
+}
+
+/**
+ * @brief Thread entry point, runs a range task on its slice
+ *
+ * @param arg A range_job
+ * @return void* Always NULL
+ */
+static void* run_range_job(void* arg){
+    range_job* job = (range_job*)arg;
+    job->task(job->ctx, job->begin, job->end);
+    return NULL;
+}
+
+/**
+ * @brief Number of worker threads, taken from SYMNMF_THREADS or the number of online cores
+ *
+ * @return int The number of threads (at least 1)
+ */
+int thread_count(void){
+    const char* env = getenv(THREADS_ENV);
+    long count = env != NULL ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1) count = 1;
+    if (count > MAX_THREADS) count = MAX_THREADS;
+    return (int)count;
+}
+
+/**
+ * @brief Splits [0, items) into one contiguous slice per thread and runs the task on every slice.
+ * Slice t always covers the same rows for the same items and thread count, so data first
+ * touched by a slice is later processed by the same slice. Inside a parallel_steal worker
+ * the whole range runs on the calling thread, the pool already keeps every core busy.
+ *
+ * @param items Number of items (usually matrix rows)
+ * @param task The task to run on every slice
+ * @param ctx Context shared by all the slices
+ */
+void parallel_for(int items, range_task task, void* ctx){
+    pthread_t threads[MAX_THREADS];
+    range_job jobs[MAX_THREADS];
+    int count = thread_count(), t;
+
+    if (count > items) count = items;
+    if (count <= 1 || inside_worker()){
+        if (items > 0) task(ctx, 0, items);
+        return;
+    }
+    for (t = 0; t < count; t++){
+        jobs[t].task = task, jobs[t].ctx = ctx;
+        jobs[t].begin = (int)((long)items * t / count);
+        jobs[t].end = (int)((long)items * (t + 1) / count);
+    }
+    /* the calling thread runs slice 0, a slice whose thread cannot start runs inline */
+    for (t = 1; t < count; t++){
+        if (pthread_create(&threads[t], NULL, run_range_job, &jobs[t]) != 0){
+            run_range_job(&jobs[t]);
+            jobs[t].task = NULL;
+        }
+    }
+    run_range_job(&jobs[0]);
+    for (t = 1; t < count; t++){
+        if (jobs[t].task != NULL) pthread_join(threads[t], NULL);
+    }
+}
+
+/**
+ * @brief Takes the next item of a worker's own queue
+ *
+ * @param queue The queue
+ * @return int The item, -1 when the queue is empty
+ */
+static int pop_item(steal_queue* queue){
+    int item = -1;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->next < queue->end) item = queue->next++;
+    pthread_mutex_unlock(&queue->lock);
+    return item;
+}
+
+/**
+ * @brief Moves the back half of the fullest other queue to a worker's empty queue
+ *
+ * @param pool The pool
+ * @param id The thief
+ * @return int 1 if something was stolen, 0 when every queue is empty
+ */
+static int steal_items(steal_pool* pool, int id){
+    steal_queue *victim, *own = &pool->queues[id];
+    int t, best = -1, most = 0, left, middle;
+
+    for (t = 0; t < pool->count; t++){
+        if (t == id) continue;
+        left = pool->queues[t].end - pool->queues[t].next; /* a hint, checked again under the lock */
+        if (left > most) best = t, most = left;
+    }
+    if (best < 0) return 0;
+    victim = &pool->queues[best];
+    pthread_mutex_lock(&victim->lock);
+    left = victim->end - victim->next;
+    middle = victim->end - (left + 1) / 2;
+    if (left > 0) victim->end = middle;
+    pthread_mutex_unlock(&victim->lock);
+    if (left <= 0) return 1; /* lost the race, look again */
+    pthread_mutex_lock(&own->lock);
+    own->next = middle, own->end = middle + (left + 1) / 2;
+    pthread_mutex_unlock(&own->lock);
+    return 1;
+}
+
+/**
+ * @brief Thread entry point of parallel_steal: runs its own items, then steals until every
+ * queue is empty
+ *
+ * @param arg A steal_worker
+ * @return void* Always NULL
+ */
+static void* run_steal_worker(void* arg){
+    steal_worker* worker = (steal_worker*)arg;
+    steal_pool* pool = worker->pool;
+    int item;
+
+    pthread_setspecific(worker_key, worker);
+    do {
+        while ((item = pop_item(&pool->queues[worker->id])) >= 0){
+            pool->task(pool->ctx, item, item + 1);
+        }
+    } while (steal_items(pool, worker->id));
+    pthread_setspecific(worker_key, NULL);
+    return NULL;
+}
+
+/**
+ * @brief Runs the task on every item of [0, items) one item at a time, for items of very
+ * different costs (whole datasets of a batch). Every thread starts with a contiguous share
+ * and, once it runs dry, steals the back half of the fullest remaining share. parallel_for
+ * calls made by the task run inline on the worker.
+ *
+ * @param items Number of items
+ * @param task The task, called with end = begin + 1
+ * @param ctx Context shared by all the items
+ */
+void parallel_steal(int items, range_task task, void* ctx){
+    pthread_t threads[MAX_THREADS];
+    steal_worker workers[MAX_THREADS];
+    int started[MAX_THREADS];
+    steal_pool* pool;
+    int count = thread_count(), t;
+
+    if (count > items) count = items;
+    if (count <= 1 || inside_worker()){
+        for (t = 0; t < items; t++) task(ctx, t, t + 1);
+        return;
+    }
+    pool = malloc(sizeof(steal_pool));
+    if (pool == NULL){
+        for (t = 0; t < items; t++) task(ctx, t, t + 1);
+        return;
+    }
+    pool->task = task, pool->ctx = ctx, pool->count = count;
+    for (t = 0; t < count; t++){
+        pthread_mutex_init(&pool->queues[t].lock, NULL);
+        pool->queues[t].next = (int)((long)items * t / count);
+        pool->queues[t].end = (int)((long)items * (t + 1) / count);
+        workers[t].pool = pool, workers[t].id = t;
+    }
+    /* a worker whose thread cannot start leaves its share to be stolen */
+    for (t = 1; t < count; t++){
+        started[t] = pthread_create(&threads[t], NULL, run_steal_worker, &workers[t]) == 0;
+    }
+    run_steal_worker(&workers[0]);
+    for (t = 1; t < count; t++){
+        if (started[t]) pthread_join(threads[t], NULL);
+    }
+    for (t = 0; t < count; t++) pthread_mutex_destroy(&pool->queues[t].lock);
+    free(pool);
+}
@@ -0,0 +1,18 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/* Constants */
+#ifndef THREADS_ENV
+#define THREADS_ENV "SYMNMF_THREADS" /* kmeans++ builds parallel.c with KMEANS_THREADS */
+#endif
+#define MAX_THREADS 256
+
+/* A range task: processes the items [begin, end) using the shared context */
+typedef void (*range_task)(void* ctx, int begin, int end);
+
+/* Function declarations from parallel.c */
+int thread_count(void);
+void parallel_for(int items, range_task task, void* ctx);
+void parallel_steal(int items, range_task task, void* ctx);
+
+#endif
@@ -0,0 +1,215 @@
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "symnmf.h"
+#include "parallel.h"
+#include "placement.h"
+#include "stats.h"
+
+/* Constants */
+#define MPOL_INTERLEAVE_MODE 3
+#define NODE_ONLINE_PATH "/sys/devices/system/node/online"
+
+/* Shared context of the pass that faults in the pages of a block row slice by row slice */
+typedef struct touch_pass {
+    double* data;
+    int width;
+    row_offset offset;
+} touch_pass;
+
+/**
+ * @brief Reads the placement policy from SYMNMF_HUGEPAGES and SYMNMF_NUMA. Huge pages are off
+ * and pages are first touched in parallel by default.
+ *
+ * @return placement_policy The policy
+ */
+placement_policy placement_from_env(void){
+    placement_policy policy;
+    const char* huge = getenv(HUGEPAGES_ENV);
+    const char* numa = getenv(NUMA_ENV);
+    policy.huge = HUGE_OFF, policy.numa = NUMA_FIRST_TOUCH;
+    if (huge != NULL && strcmp(huge, "transparent") == 0) policy.huge = HUGE_TRANSPARENT;
+    if (huge != NULL && strcmp(huge, "explicit") == 0) policy.huge = HUGE_EXPLICIT;
+    if (numa != NULL && strcmp(numa, "local") == 0) policy.numa = NUMA_LOCAL;
+    if (numa != NULL && strcmp(numa, "interleave") == 0) policy.numa = NUMA_INTERLEAVE;
+    return policy;
+}
+
+/**
+ * @brief Row offsets of a dense rows x width block
+ *
+ * @param row A row (or the number of rows, for the size of the block)
+ * @param width Number of columns
+ * @return size_t row * width
+ */
+size_t dense_row_offset(int row, int width){
+    return (size_t)row * (size_t)width;
+}
+
+/**
+ * @brief Bytes reserved for a block of count doubles: blocks of at least PLACEMENT_MIN_BYTES
+ * are mapped and rounded up to whole huge pages, the size depends on count only so that
+ * placed_free finds the same mapping
+ *
+ * @param count Number of doubles
+ * @return size_t The size of the block in bytes
+ */
+static size_t placed_bytes(size_t count){
+    size_t bytes = (count > 0 ? count : 1) * sizeof(double);
+    if (bytes < PLACEMENT_MIN_BYTES) return bytes;
+    return (bytes + PLACEMENT_HUGE_PAGE - 1) / PLACEMENT_HUGE_PAGE * PLACEMENT_HUGE_PAGE;
+}
+
+/**
+ * @brief Range task zeroing the rows [begin, end) of a block, which faults their pages in on
+ * the calling thread's node
+ *
+ * @param ctx A touch_pass
+ * @param begin First row
+ * @param end One past the last row
+ */
+static void touch_rows(void* ctx, int begin, int end){
+    touch_pass* pass = (touch_pass*)ctx;
+    size_t first = pass->offset(begin, pass->width), last = pass->offset(end, pass->width);
+    memset(pass->data + first, 0, (last - first) * sizeof(double));
+}
+
+/**
+ * @brief Reads the online NUMA nodes from sysfs ("0", "0-1", "0,2-3", ...)
+ *
+ * @return unsigned long A mask with one bit per online node, 0 when unknown
+ */
+static unsigned long online_nodes(void){
+    FILE* file = fopen(NODE_ONLINE_PATH, "r");
+    unsigned long mask = 0;
+    int first, last, node, sep;
+    if (file == NULL) return 0;
+    while (fscanf(file, "%d", &first) == 1){
+        last = first;
+        sep = fgetc(file);
+        if (sep == '-'){
+            if (fscanf(file, "%d", &last) != 1) break;
+            sep = fgetc(file);
+        }
+        for (node = first; node <= last && node < (int)(8 * sizeof(mask)); node++) mask |= 1UL << node;
+        if (sep != ',') break;
+    }
+    fclose(file);
+    return mask;
+}
+
+/**
+ * @brief Asks the kernel to spread the pages of a mapping round-robin over the online nodes.
+ * Best effort: without NUMA support the pages simply stay local.
+ *
+ * @param block The mapping
+ * @param bytes Size of the mapping
+ */
+static void interleave_pages(void* block, size_t bytes){
+#ifdef SYS_mbind
+    unsigned long mask = online_nodes();
+    if (mask != 0){
+        syscall(SYS_mbind, block, bytes, MPOL_INTERLEAVE_MODE, &mask, 8 * sizeof(mask) + 1, 0UL);
+    }
+#else
+    (void)block, (void)bytes;
+#endif
+}
+
+/**
+ * @brief Allocates a zeroed row-major block of doubles under the placement policy.
+ * Small blocks come from calloc. Large ones are anonymous mappings backed by explicit huge
+ * pages (falling back to transparent ones), marked for transparent huge pages or left with
+ * regular pages. Their pages are then interleaved over the NUMA nodes, faulted in on the
+ * allocating thread, or first touched row slice by row slice through parallel_for so that
+ * every slice lands on the node of the thread whose kernels later process the same rows.
+ *
+ * @param rows Number of rows
+ * @param width Width passed to offset
+ * @param offset Row offsets of the block, offset(rows, width) is its number of doubles
+ * @return double* The block, NULL on failure
+ */
+double* placed_alloc(int rows, int width, row_offset offset){
+    placement_policy policy;
+    touch_pass pass;
+    size_t count = offset(rows, width), bytes = placed_bytes(count);
+    void* block = MAP_FAILED;
+
+    stats_count_alloc(bytes);
+    if (bytes < PLACEMENT_MIN_BYTES) return calloc(count > 0 ? count : 1, sizeof(double));
+    policy = placement_from_env();
+#ifdef MAP_HUGETLB
+    if (policy.huge == HUGE_EXPLICIT){
+        block = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (block == MAP_FAILED){
+        block = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (block == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+        if (policy.huge != HUGE_OFF) madvise(block, bytes, MADV_HUGEPAGE);
+#endif
+    }
+
+    pass.data = (double*)block, pass.width = width, pass.offset = offset;
+    if (policy.numa == NUMA_INTERLEAVE){
+        interleave_pages(block, bytes);
+    } else if (policy.numa == NUMA_FIRST_TOUCH){
+        parallel_for(rows, touch_rows, &pass);
+    } else {
+        touch_rows(&pass, 0, rows);
+    }
+    return (double*)block;
+}
+
+/**
+ * @brief Frees a block from placed_alloc
+ *
+ * @param data The block (may be NULL)
+ * @param rows Number of rows it was allocated with
+ * @param width Width it was allocated with
+ * @param offset Row offsets it was allocated with
+ */
+void placed_free(double* data, int rows, int width, row_offset offset){
+    size_t bytes = placed_bytes(offset(rows, width));
+    if (data == NULL) return;
+    if (bytes < PLACEMENT_MIN_BYTES) free(data);
+    else munmap(data, bytes);
+}
+
+/**
+ * @brief create_matrix over a single placed block: same indexing, rows are contiguous
+ *
+ * @param rows Number of rows in matrix
+ * @param columns The number of columns in matrix
+ * @return double** matrix A pointer to the allocated matrix, freed with free_placed_matrix
+ */
+double** create_placed_matrix(int rows, int columns){
+    double **matrix = malloc(sizeof(double*) * (rows > 0 ? rows : 1));
+    double *data;
+    int i;
+    if (check_pointer(matrix)) exit(1);
+    data = placed_alloc(rows, columns, dense_row_offset);
+    if (check_pointer(data)) exit(1);
+    matrix[0] = data;
+    for (i = 1; i < rows; i++) matrix[i] = data + dense_row_offset(i, columns);
+    return matrix;
+}
+
+/**
+ * @brief Frees a matrix from create_placed_matrix
+ *
+ * @param matrix A matrix
+ * @param rows Number of rows in matrix
+ * @param columns The number of columns in matrix
+ */
+void free_placed_matrix(double** matrix, int rows, int columns){
+    placed_free(matrix[0], rows, columns, dense_row_offset);
+    free(matrix);
+}
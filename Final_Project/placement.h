@@ -0,0 +1,43 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stddef.h>
+
+/* Constants */
+#define HUGEPAGES_ENV "SYMNMF_HUGEPAGES"
+#define NUMA_ENV "SYMNMF_NUMA"
+#define PLACEMENT_MIN_BYTES (4UL << 20)
+#define PLACEMENT_HUGE_PAGE (2UL << 20)
+
+/* How the pages of a large matrix are backed (SYMNMF_HUGEPAGES: off, transparent, explicit) */
+typedef enum huge_policy {
+    HUGE_OFF,
+    HUGE_TRANSPARENT,
+    HUGE_EXPLICIT
+} huge_policy;
+
+/* Where the pages of a large matrix live (SYMNMF_NUMA: local, firsttouch, interleave) */
+typedef enum numa_policy {
+    NUMA_LOCAL,       /* wherever the allocating thread runs */
+    NUMA_FIRST_TOUCH, /* every row slice is touched by the parallel_for thread that processes it */
+    NUMA_INTERLEAVE   /* pages spread round-robin over the online nodes */
+} numa_policy;
+
+/* The placement of the large matrices, read from the environment */
+typedef struct placement_policy {
+    huge_policy huge;
+    numa_policy numa;
+} placement_policy;
+
+/* Offset (in doubles) of the first entry of a row in a row-major block, row == rows gives the size */
+typedef size_t (*row_offset)(int row, int width);
+
+/* Function declarations from placement.c */
+placement_policy placement_from_env(void);
+size_t dense_row_offset(int row, int width);
+double* placed_alloc(int rows, int width, row_offset offset);
+void placed_free(double* data, int rows, int width, row_offset offset);
+double** create_placed_matrix(int rows, int columns);
+void free_placed_matrix(double** matrix, int rows, int columns);
+
+#endif
@@ -0,0 +1,615 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "symnmf.h"
+#include "batch.h"
+#include "kmeans.h"
+#include "packed.h"
+#include "server.h"
+
+/* Set by SIGINT and SIGTERM, the accept loop stops at the next wake-up */
+static volatile sig_atomic_t stop_requested = 0;
+
+/**
+ * @brief Signal handler asking the server to stop
+ *
+ * @param signal_number The signal
+ */
+static void request_stop(int signal_number){
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+/**
+ * @brief Content hash of a dataset text: 32-bit FNV-1a and djb2 hashes and the length, in hex.
+ * Two texts with the same key are told apart by load_text, which compares the texts.
+ *
+ * @param text The text
+ * @param length Its length in bytes
+ * @param key Output, at least SERVER_KEY_SIZE characters
+ */
+void content_key(const char* text, size_t length, char* key){
+    unsigned long fnv = 2166136261UL, djb = 5381UL;
+    size_t i;
+    for (i = 0; i < length; i++){
+        fnv = ((fnv ^ (unsigned char)text[i]) * 16777619UL) & 0xFFFFFFFFUL;
+        djb = (djb * 33 + (unsigned char)text[i]) & 0xFFFFFFFFUL;
+    }
+    sprintf(key, "%08lx%08lx%lx", fnv, djb, (unsigned long)length);
+}
+
+/**
+ * @brief Bytes held by a matrix from create_matrix
+ *
+ * @param rows Number of rows
+ * @param columns Number of columns
+ * @return size_t Its size, row pointers included
+ */
+static size_t matrix_bytes(int rows, int columns){
+    return (size_t)rows * (sizeof(double*) + (size_t)columns * sizeof(double));
+}
+
+/**
+ * @brief Bytes held by a packed symmetric matrix
+ *
+ * @param n Number of rows and columns
+ * @return size_t Its size, n(n+1)/2 entries
+ */
+static size_t packed_bytes(int n){
+    return PACKED_INDEX(n, 0) * sizeof(double);
+}
+
+/**
+ * @brief Prepares an empty cache
+ *
+ * @param cache The cache
+ * @param budget Bytes it may hold before evicting
+ */
+void cache_init(matrix_cache* cache, size_t budget){
+    cache->head = cache->tail = NULL;
+    cache->bytes = 0, cache->budget = budget;
+    cache->entries = cache->hits = cache->misses = cache->evictions = 0;
+}
+
+/**
+ * @brief Takes an entry out of the LRU list
+ *
+ * @param cache The cache
+ * @param entry An entry of the cache
+ */
+static void unlink_entry(matrix_cache* cache, cache_entry* entry){
+    if (entry->prev != NULL) entry->prev->next = entry->next;
+    else cache->head = entry->next;
+    if (entry->next != NULL) entry->next->prev = entry->prev;
+    else cache->tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+/**
+ * @brief Puts an entry at the most recently used end of the LRU list
+ *
+ * @param cache The cache
+ * @param entry An entry not in the list
+ */
+static void push_front(matrix_cache* cache, cache_entry* entry){
+    entry->prev = NULL, entry->next = cache->head;
+    if (cache->head != NULL) cache->head->prev = entry;
+    cache->head = entry;
+    if (cache->tail == NULL) cache->tail = entry;
+}
+
+/**
+ * @brief Frees an entry that is no longer in the list
+ *
+ * @param entry The entry
+ */
+static void free_entry(cache_entry* entry){
+    free_matrix(entry->data, entry->n);
+    if (entry->A.data != NULL) free_packed_matrix(&entry->A);
+    if (entry->W.data != NULL) free_packed_matrix(&entry->W);
+    free(entry->degree), free(entry->text);
+    free(entry);
+}
+
+/**
+ * @brief Looks a dataset up by key and marks it most recently used
+ *
+ * @param cache The cache
+ * @param key The content key
+ * @return cache_entry* The entry, NULL when it is not (or no longer) cached
+ */
+cache_entry* cache_find(matrix_cache* cache, const char* key){
+    cache_entry* entry;
+    for (entry = cache->head; entry != NULL; entry = entry->next){
+        if (strcmp(entry->key, key) == 0){
+            unlink_entry(cache, entry);
+            push_front(cache, entry);
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Evicts least recently used entries until the cache fits its budget. The entry being
+ * served is kept even when it alone is over budget.
+ *
+ * @param cache The cache
+ * @param keep An entry never evicted (may be NULL)
+ */
+void cache_evict(matrix_cache* cache, const cache_entry* keep){
+    cache_entry *entry = cache->tail, *prev;
+    while (cache->bytes > cache->budget && entry != NULL){
+        prev = entry->prev;
+        if (entry != keep){
+            unlink_entry(cache, entry);
+            cache->bytes -= entry->bytes;
+            cache->entries--, cache->evictions++;
+            free_entry(entry);
+        }
+        entry = prev;
+    }
+}
+
+/**
+ * @brief Adds a parsed dataset as the most recently used entry, evicting others as needed
+ *
+ * @param cache The cache
+ * @param key Its content key
+ * @param text The text it was parsed from, owned by the cache from now on like data
+ * @param length Length of the text
+ * @param data Its n x d points, owned by the cache from now on (freed when it cannot be added)
+ * @param n Number of points
+ * @param d Dimension of the points
+ * @return cache_entry* The new entry, NULL when out of memory
+ */
+cache_entry* cache_insert(matrix_cache* cache, const char* key, char* text, size_t length, double** data, int n, int d){
+    cache_entry* entry = calloc(1, sizeof(cache_entry));
+    if (entry == NULL){
+        free_matrix(data, n), free(text);
+        return NULL;
+    }
+    strcpy(entry->key, key);
+    entry->text = text, entry->length = length;
+    entry->data = data, entry->n = n, entry->d = d;
+    entry->A.data = entry->W.data = NULL, entry->degree = NULL;
+    entry->bytes = sizeof(cache_entry) + length + 1 + matrix_bytes(n, d);
+    push_front(cache, entry);
+    cache->bytes += entry->bytes, cache->entries++;
+    cache_evict(cache, entry);
+    return entry;
+}
+
+/**
+ * @brief Charges memory newly held by an entry to it and to the cache
+ *
+ * @param cache The cache
+ * @param entry The entry
+ * @param bytes The memory
+ */
+static void charge(matrix_cache* cache, cache_entry* entry, size_t bytes){
+    entry->bytes += bytes, cache->bytes += bytes;
+}
+
+/**
+ * @brief Computes the sym, ddg or norm matrix of a cached dataset on first use, from what the
+ * entry already holds, and keeps it until the entry is evicted. A and W are packed and ddg is
+ * kept as its diagonal, so a dataset with all three holds about n^2 doubles. The request is
+ * refused when the entry with its new matrices would be larger than the whole budget.
+ *
+ * @param cache The cache
+ * @param entry The dataset
+ * @param goal "sym", "ddg" or "norm"
+ * @return int 1, 2 or 3 for sym, ddg or norm (read them with packed_get on entry->A, the
+ * entry->degree vector or packed_get on entry->W), SERVER_GOAL_UNKNOWN,
+ * SERVER_GOAL_OVER_BUDGET or SERVER_GOAL_NO_MEMORY
+ */
+int cache_goal(matrix_cache* cache, cache_entry* entry, const char* goal){
+    int want = strcmp(goal, "sym") == 0 ? 1 : strcmp(goal, "ddg") == 0 ? 2 : strcmp(goal, "norm") == 0 ? 3 : 0;
+    int held = want == 1 ? entry->A.data != NULL : want == 2 ? entry->degree != NULL : entry->W.data != NULL;
+    size_t projected = entry->bytes;
+
+    if (want == 0) return SERVER_GOAL_UNKNOWN;
+    if (held){
+        cache->hits++;
+        return want;
+    }
+    if (entry->A.data == NULL) projected += packed_bytes(entry->n);
+    if (want >= 2 && entry->degree == NULL) projected += entry->n * sizeof(double);
+    if (want == 3) projected += packed_bytes(entry->n);
+    if (projected > cache->budget) return SERVER_GOAL_OVER_BUDGET;
+    cache->misses++;
+    if (entry->A.data == NULL){
+        if (sym_packed(&entry->A, entry->data, NULL, entry->n, entry->d)) return SERVER_GOAL_NO_MEMORY;
+        charge(cache, entry, packed_bytes(entry->n));
+    }
+    if (want >= 2 && entry->degree == NULL){
+        entry->degree = ddg_packed(&entry->A);
+        charge(cache, entry, entry->n * sizeof(double));
+    }
+    if (want == 3){
+        if (init_packed_matrix(&entry->W, entry->n)) return SERVER_GOAL_NO_MEMORY;
+        memcpy(entry->W.data, entry->A.data, packed_bytes(entry->n));
+        norm_packed(&entry->W, entry->degree);
+        charge(cache, entry, packed_bytes(entry->n));
+    }
+    cache_evict(cache, entry);
+    return want;
+}
+
+/**
+ * @brief Frees every entry
+ *
+ * @param cache The cache
+ */
+void cache_destroy(matrix_cache* cache){
+    cache_entry *entry = cache->head, *next;
+    while (entry != NULL){
+        next = entry->next;
+        free_entry(entry);
+        entry = next;
+    }
+    cache_init(cache, cache->budget);
+}
+
+/**
+ * @brief Reads one request line of at most SERVER_MAX_REQUEST characters, without its line
+ * terminator
+ *
+ * @param in The connection
+ * @param line The buffer, of SERVER_MAX_REQUEST + 1 characters
+ * @return int 1 if a line was read, 0 at the end of the connection, -1 for a line too long
+ */
+static int read_request(FILE* in, char* line){
+    size_t length = 0;
+    int ch;
+    while ((ch = fgetc(in)) != EOF && ch != '\n'){
+        if (length == SERVER_MAX_REQUEST) return -1;
+        line[length++] = (char)ch;
+    }
+    if (ch == EOF && length == 0) return 0;
+    if (length > 0 && line[length - 1] == '\r') length--;
+    line[length] = '\0';
+    return 1;
+}
+
+/**
+ * @brief Writes a matrix in the format of print_matrix
+ *
+ * @param out The connection
+ * @param matrix The matrix
+ * @param rows Number of rows
+ * @param columns Number of columns
+ */
+static void write_matrix(FILE* out, double** matrix, int rows, int columns){
+    int i, j;
+    for (i = 0; i < rows; i++){
+        for (j = 0; j < columns; j++) fprintf(out, j < columns - 1 ? "%.4f," : "%.4f\n", matrix[i][j]);
+    }
+}
+
+/**
+ * @brief Writes a goal of a cached dataset in full, in the format of print_matrix
+ *
+ * @param out The connection
+ * @param entry The dataset
+ * @param goal 1, 2 or 3 from cache_goal
+ */
+static void write_goal(FILE* out, const cache_entry* entry, int goal){
+    double value;
+    int i, j, n = entry->n;
+    for (i = 0; i < n; i++){
+        for (j = 0; j < n; j++){
+            value = goal == 1 ? packed_get(&entry->A, i, j) : goal == 3 ? packed_get(&entry->W, i, j)
+                  : i == j ? entry->degree[i] : 0.0;
+            fprintf(out, j < n - 1 ? "%.4f," : "%.4f\n", value);
+        }
+    }
+}
+
+/**
+ * @brief Answers a failed cache_goal with ERR
+ *
+ * @param out The connection
+ * @param status What cache_goal returned
+ * @return int 1 when it failed, 0 otherwise
+ */
+static int goal_failed(FILE* out, int status){
+    if (status > 0) return 0;
+    fprintf(out, status == SERVER_GOAL_UNKNOWN ? "ERR unknown goal\n"
+                 : status == SERVER_GOAL_OVER_BUDGET ? "ERR matrices larger than the cache budget\n"
+                 : "ERR out of memory\n");
+    return 1;
+}
+
+/**
+ * @brief Reads a whole file or the given number of bytes of a connection into a buffer
+ *
+ * @param file The source
+ * @param length Bytes to read, 0 to read to the end of a regular file; set to the bytes read
+ * @return char* The '\0'-terminated text, NULL when it is larger than SERVER_MAX_DATA_MB,
+ * cannot be read in full or does not fit in memory
+ */
+static char* read_text(FILE* file, size_t* length){
+    char* text;
+    long size;
+    if (*length == 0){
+        if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0) return NULL;
+        *length = (size_t)size;
+    }
+    if (*length > (size_t)SERVER_MAX_DATA_MB << 20) return NULL;
+    text = malloc(*length + 1);
+    if (text == NULL) return NULL;
+    if (fread(text, 1, *length, file) != *length){
+        free(text);
+        return NULL;
+    }
+    text[*length] = '\0';
+    return text;
+}
+
+/**
+ * @brief Finds or parses the dataset of a text and answers "OK key n d". A cached dataset is
+ * reused only when its text is the same; another text with the same content key gets the key
+ * with a "-1", "-2", ... suffix.
+ *
+ * @param cache The cache
+ * @param text The dataset text, kept by the new entry or freed here
+ * @param length Its length
+ * @param out The connection
+ */
+static void load_text(matrix_cache* cache, char* text, size_t length, FILE* out){
+    char key[SERVER_KEY_SIZE];
+    cache_entry* entry;
+    double** data;
+    size_t base;
+    int n, d, suffix = 0;
+
+    content_key(text, length, key);
+    base = strlen(key);
+    while ((entry = cache_find(cache, key)) != NULL && (entry->length != length || memcmp(entry->text, text, length) != 0)){
+        sprintf(key + base, "-%d", ++suffix);
+    }
+    if (entry != NULL){
+        cache->hits++;
+        free(text);
+    } else {
+        data = parse_points(text, &n, &d);
+        if (data == NULL){
+            free(text);
+            fprintf(out, "ERR unparsable dataset\n");
+            return;
+        }
+        cache->misses++;
+        entry = cache_insert(cache, key, text, length, data, n, d);
+    }
+    if (entry == NULL){
+        fprintf(out, "ERR out of memory\n");
+        return;
+    }
+    fprintf(out, "OK %s %d %d\n", entry->key, entry->n, entry->d);
+}
+
+/**
+ * @brief Answers one request. Requests are single lines:
+ *   LOAD path                     parse a file of the server's filesystem
+ *   DATA length                   followed by length bytes of dataset text
+ *   GOAL key sym|ddg|norm         the matrix, from the cache when already computed
+ *   SYMNMF key k [seed]           H from the cached W, initial H from seeded_H
+ *   KMEANS key k [max_iter [eps]] centroids, then the labels on one line
+ *   STATS                         the cache counters
+ *   DROP key                      evict a dataset
+ *   SHUTDOWN                      stop the server
+ * Answers are "OK ..." (followed by the rows of a matrix result) or "ERR message". Datasets
+ * are at most SERVER_MAX_DATA_MB of text; a DATA payload that is too large or cannot be held
+ * is answered with ERR and ends the connection, since the rest of the stream is unread payload.
+ * A request that runs out of memory is answered with ERR and the server keeps running.
+ *
+ * @param cache The cache
+ * @param line The request line, modified
+ * @param in The connection, for DATA payloads
+ * @param out The connection
+ * @return int 1 for SHUTDOWN, -1 when the connection must be closed, 0 otherwise
+ */
+static int handle_request(matrix_cache* cache, char* line, FILE* in, FILE* out){
+    char *command = strtok(line, " "), *key, *arg;
+    cache_entry* entry = NULL;
+    double **matrix, **centroids, eps = KMEANS_EPSILON;
+    unsigned long seed = BATCH_DEFAULT_SEED, length;
+    int k = 0, iterations, max_iter = KMEANS_MAX_ITER, i, *labels, goal;
+    w_operator W;
+    FILE* file;
+    char* text;
+    size_t size = 0;
+
+    if (command == NULL){
+        fprintf(out, "ERR empty request\n");
+        return 0;
+    }
+    if (strcmp(command, "LOAD") == 0){
+        arg = strtok(NULL, "");
+        file = arg != NULL ? fopen(arg, "rb") : NULL;
+        text = file != NULL ? read_text(file, &size) : NULL;
+        if (file != NULL) fclose(file);
+        if (text == NULL) fprintf(out, "ERR cannot read the file\n");
+        else load_text(cache, text, size, out);
+        return 0;
+    }
+    if (strcmp(command, "DATA") == 0){
+        arg = strtok(NULL, " ");
+        if (arg == NULL || sscanf(arg, "%lu", &length) != 1 || length == 0){
+            fprintf(out, "ERR invalid length\n");
+            return 0;
+        }
+        if (length > (unsigned long)SERVER_MAX_DATA_MB << 20){
+            fprintf(out, "ERR dataset larger than %d MB\n", SERVER_MAX_DATA_MB);
+            return -1;
+        }
+        size = length;
+        text = read_text(in, &size);
+        if (text == NULL){
+            fprintf(out, "ERR truncated dataset or out of memory\n");
+            return -1;
+        }
+        load_text(cache, text, size, out);
+        return 0;
+    }
+    if (strcmp(command, "STATS") == 0){
+        fprintf(out, "OK entries=%ld bytes=%lu budget=%lu hits=%ld misses=%ld evictions=%ld\n",
+                cache->entries, (unsigned long)cache->bytes, (unsigned long)cache->budget,
+                cache->hits, cache->misses, cache->evictions);
+        return 0;
+    }
+    if (strcmp(command, "SHUTDOWN") == 0){
+        fprintf(out, "OK\n");
+        return 1;
+    }
+
+    key = strtok(NULL, " ");
+    arg = strtok(NULL, " ");
+    if (key != NULL) entry = cache_find(cache, key);
+    if (entry == NULL){
+        fprintf(out, "ERR unknown dataset\n");
+        return 0;
+    }
+    if (strcmp(command, "DROP") == 0){
+        unlink_entry(cache, entry);
+        cache->bytes -= entry->bytes, cache->entries--;
+        free_entry(entry);
+        fprintf(out, "OK\n");
+    } else if (strcmp(command, "GOAL") == 0){
+        goal = arg != NULL ? cache_goal(cache, entry, arg) : SERVER_GOAL_UNKNOWN;
+        if (goal_failed(out, goal)) return 0;
+        fprintf(out, "OK %d %d\n", entry->n, entry->n);
+        write_goal(out, entry, goal);
+    } else if (strcmp(command, "SYMNMF") == 0){
+        if (arg != NULL) k = atoi(arg);
+        if ((arg = strtok(NULL, " ")) != NULL) seed = strtoul(arg, NULL, 10);
+        if (k <= 0 || k >= entry->n){
+            fprintf(out, "ERR invalid k\n");
+            return 0;
+        }
+        if (goal_failed(out, cache_goal(cache, entry, "norm"))) return 0;
+        W = packed_w_operator(&entry->W);
+        matrix = optimize_H_operator(seeded_H_sum(packed_sum(&entry->W, NULL), entry->n, k, seed), &W, k, &iterations);
+        fprintf(out, "OK %d %d %d\n", entry->n, k, iterations);
+        write_matrix(out, matrix, entry->n, k);
+        free_matrix(matrix, entry->n);
+    } else if (strcmp(command, "KMEANS") == 0){
+        if (arg != NULL) k = atoi(arg);
+        if ((arg = strtok(NULL, " ")) != NULL) max_iter = atoi(arg);
+        if ((arg = strtok(NULL, " ")) != NULL) eps = atof(arg);
+        if (k <= 0 || k > entry->n || max_iter < 0){
+            fprintf(out, "ERR invalid k or iterations\n");
+            return 0;
+        }
+        labels = malloc(entry->n * sizeof(int));
+        if (labels == NULL){
+            fprintf(out, "ERR out of memory\n");
+            return 0;
+        }
+        centroids = create_matrix(k, entry->d);
+        iterations = kmeans_fit(entry->data, entry->n, entry->d, k, max_iter, eps, centroids, labels);
+        fprintf(out, "OK %d %d %d\n", k, entry->d, iterations);
+        write_matrix(out, centroids, k, entry->d);
+        for (i = 0; i < entry->n; i++) fprintf(out, i < entry->n - 1 ? "%d," : "%d\n", labels[i]);
+        free_matrix(centroids, k), free(labels);
+    } else {
+        fprintf(out, "ERR unknown request\n");
+    }
+    return 0;
+}
+
+/**
+ * @brief Answers the requests of one connection until it closes
+ *
+ * @param cache The cache
+ * @param client The connected socket, closed here
+ * @return int 1 when a SHUTDOWN was received
+ */
+static int serve_connection(matrix_cache* cache, int client){
+    FILE *in = fdopen(client, "r"), *out = fdopen(dup(client), "w");
+    char line[SERVER_MAX_REQUEST + 1];
+    int shutdown_requested = 0, status;
+
+    if (in == NULL || out == NULL){
+        if (in != NULL) fclose(in);
+        else close(client);
+        if (out != NULL) fclose(out);
+        return 0;
+    }
+    while (!shutdown_requested && !stop_requested && (status = read_request(in, line)) != 0){
+        if (status < 0){
+            fprintf(out, "ERR request longer than %d characters\n", SERVER_MAX_REQUEST);
+            break;
+        }
+        status = handle_request(cache, line, in, out);
+        shutdown_requested = status == 1;
+        if (fflush(out) != 0 || status < 0) break; /* the client went away or the stream is out of sync */
+    }
+    fclose(in), fclose(out);
+    return shutdown_requested;
+}
+
+/**
+ * @brief Runs the resident server: listens on a Unix socket and answers the requests of one
+ * connection at a time from a matrix_cache of at most budget bytes, until SHUTDOWN, SIGINT
+ * or SIGTERM. A stale socket file at socket_path is replaced and removed on exit.
+ *
+ * @param socket_path Path of the socket
+ * @param budget Bytes the cache may hold
+ * @return int 0 on a clean stop, 1 when the socket cannot be set up
+ */
+int serve(const char* socket_path, size_t budget){
+    struct sockaddr_un address;
+    struct sigaction action;
+    struct stat existing;
+    matrix_cache cache;
+    int listener, client, shutdown_requested = 0;
+
+    if (strlen(socket_path) >= sizeof(address.sun_path)) return 1;
+    if (stat(socket_path, &existing) == 0){
+        if (!S_ISSOCK(existing.st_mode)) return 1;
+        unlink(socket_path);
+    }
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) return 1;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, SERVER_BACKLOG) != 0){
+        close(listener);
+        return 1;
+    }
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop; /* no SA_RESTART: accept returns on a signal */
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    cache_init(&cache, budget);
+    while (!shutdown_requested && !stop_requested){
+        client = accept(listener, NULL, NULL);
+        if (client < 0){
+            if (errno != EINTR) break;
+            continue;
+        }
+        shutdown_requested = serve_connection(&cache, client);
+    }
+    cache_destroy(&cache);
+    close(listener);
+    unlink(socket_path);
+    return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stddef.h>
+
+#include "packed.h"
+
+/* Constants */
+#define SERVER_DEFAULT_CACHE_MB 1024
+#define SERVER_KEY_SIZE 48
+#define SERVER_BACKLOG 16
+#define SERVER_MAX_DATA_MB 256   /* largest dataset text accepted by LOAD and DATA */
+#define SERVER_MAX_REQUEST 4096  /* longest request line */
+
+/* Results of cache_goal besides the goal itself */
+#define SERVER_GOAL_UNKNOWN 0
+#define SERVER_GOAL_OVER_BUDGET -1
+#define SERVER_GOAL_NO_MEMORY -2
+
+/* A dataset held by the server, with the matrices computed from it so far */
+typedef struct cache_entry {
+    char key[SERVER_KEY_SIZE];     /* content hash of the text it was parsed from */
+    char* text;                    /* that text, compared on a key hit */
+    size_t length;
+    double** data;                 /* n x d points */
+    int n, d;
+    packed_matrix A, W;            /* sym and norm, data NULL until first requested */
+    double* degree;                /* the diagonal of ddg, NULL until first requested */
+    size_t bytes;                  /* memory held by the text, the points and the matrices */
+    struct cache_entry* prev;      /* LRU order, most recently used first */
+    struct cache_entry* next;
+} cache_entry;
+
+/* The datasets of the server, evicted least recently used first beyond budget bytes */
+typedef struct matrix_cache {
+    cache_entry* head;
+    cache_entry* tail;
+    size_t bytes;
+    size_t budget;
+    long entries, hits, misses, evictions;
+} matrix_cache;
+
+/* Function declarations from server.c */
+void content_key(const char* text, size_t length, char* key);
+void cache_init(matrix_cache* cache, size_t budget);
+cache_entry* cache_find(matrix_cache* cache, const char* key);
+cache_entry* cache_insert(matrix_cache* cache, const char* key, char* text, size_t length, double** data, int n, int d);
+int cache_goal(matrix_cache* cache, cache_entry* entry, const char* goal);
+void cache_evict(matrix_cache* cache, const cache_entry* keep);
+void cache_destroy(matrix_cache* cache);
+int serve(const char* socket_path, size_t budget);
+
+#endif
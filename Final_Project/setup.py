@@ -1,6 +1,12 @@
 from setuptools import Extension, setup
 
-module = Extension("symnmfmodule", sources=["symnmfmodule.c", "symnmf.c"])
+module = Extension("symnmfmodule",
+                   sources=["symnmfmodule.c", "symnmf.c", "coreset.c", "parallel.c", "matrix_free.c",
+                            "nystrom.c", "spectral.c", "multilevel.c",
+                            "packed.c", "sweep.c", "multistart.c",
+                            "silhouette.c", "kmeans.c", "arena.c", "placement.c", "stats.c", "batch.c", "control.c", "server.c",
+                            "diskcache.c", "incremental.c", "checkpoint.c", "checksum.c"],
+                   extra_link_args=["-pthread"])
 
 setup(name='symnmfmodule',
      version='1.0',
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "symnmf.h"
+#include "parallel.h"
+#include "silhouette.h"
+
+/* Shared context of a silhouette pass */
+typedef struct silhouette_pass {
+    double** points;
+    int n;
+    int d;
+    int** labelings;    /* count labelings of the n points, labels in [0, clusters[l]) */
+    int count;
+    const int* clusters;
+    int** sizes;        /* sizes[l][c], number of points with label c in labeling l */
+    const int* offsets; /* first accumulator of labeling l in a row of sums */
+    int total;          /* number of accumulators per row, the sum of clusters[] */
+    const int* rows;    /* the scored points */
+    double** values;    /* values[l][r], silhouette of point rows[r] under labeling l */
+} silhouette_pass;
+
+/**
+ * @brief Silhouette of one point from its summed distances to every cluster:
+ * a = mean distance to its own cluster (without itself), b = smallest mean distance to
+ * another non-empty cluster, s = (b - a) / max(a, b), and 0 for a point alone in its cluster
+ *
+ * @param sums Summed distances to every cluster
+ * @param sizes Size of every cluster
+ * @param clusters Number of clusters
+ * @param own The cluster of the point
+ * @return double The silhouette of the point
+ */
+static double point_silhouette(const double* sums, const int* sizes, int clusters, int own){
+    double a, b = -1, mean;
+    int c;
+    if (sizes[own] <= 1) return 0;
+    a = sums[own] / (sizes[own] - 1);
+    for (c = 0; c < clusters; c++){
+        if (c == own || sizes[c] == 0) continue;
+        mean = sums[c] / sizes[c];
+        if (b < 0 || mean < b) b = mean;
+    }
+    if (b < 0 || (a == 0 && b == 0)) return 0;
+    return (b - a) / (a > b ? a : b);
+}
+
+/**
+ * @brief Range task scoring the points rows[begin, end). Distances are computed one
+ * SILHOUETTE_TILE_ROWS x SILHOUETTE_TILE_COLS tile at a time and every tile is accumulated
+ * into the per-cluster sums of all the labelings, so each distance is computed once.
+ *
+ * @param ctx A silhouette_pass
+ * @param begin First scored point
+ * @param end One past the last scored point
+ */
+static void silhouette_rows(void* ctx, int begin, int end){
+    silhouette_pass* pass = (silhouette_pass*)ctx;
+    double tile[SILHOUETTE_TILE_ROWS][SILHOUETTE_TILE_COLS];
+    double **sums = create_matrix(SILHOUETTE_TILE_ROWS, pass->total);
+    double dist, diff, *x, *y, *acc;
+    int row, col, rows, cols, i, j, l, t, p;
+
+    for (row = begin; row < end; row += SILHOUETTE_TILE_ROWS){
+        rows = end - row < SILHOUETTE_TILE_ROWS ? end - row : SILHOUETTE_TILE_ROWS;
+        for (i = 0; i < rows; i++) memset(sums[i], 0, pass->total * sizeof(double));
+        for (col = 0; col < pass->n; col += SILHOUETTE_TILE_COLS){
+            cols = pass->n - col < SILHOUETTE_TILE_COLS ? pass->n - col : SILHOUETTE_TILE_COLS;
+            for (i = 0; i < rows; i++){
+                x = pass->points[pass->rows[row + i]];
+                for (j = 0; j < cols; j++){
+                    y = pass->points[col + j];
+                    dist = 0;
+                    for (t = 0; t < pass->d; t++){
+                        diff = x[t] - y[t];
+                        dist += diff * diff;
+                    }
+                    tile[i][j] = sqrt(dist);
+                }
+            }
+            for (i = 0; i < rows; i++){
+                for (l = 0; l < pass->count; l++){
+                    acc = sums[i] + pass->offsets[l];
+                    for (j = 0; j < cols; j++) acc[pass->labelings[l][col + j]] += tile[i][j];
+                }
+            }
+        }
+        for (i = 0; i < rows; i++){
+            p = pass->rows[row + i];
+            for (l = 0; l < pass->count; l++){
+                pass->values[l][row + i] = point_silhouette(sums[i] + pass->offsets[l], pass->sizes[l],
+                                                            pass->clusters[l], pass->labelings[l][p]);
+            }
+        }
+    }
+    free_matrix(sums, SILHOUETTE_TILE_ROWS);
+}
+
+/**
+ * @brief Calculates the mean silhouette coefficient (euclidean distance) of several labelings
+ * of the same points in one multithreaded pass over the pairwise distances. With sample > 0
+ * only that many random points are scored (each against all n points), which gives an
+ * unbiased estimate in O(sample * n * d) instead of O(n^2 d).
+ *
+ * @param points Set of n datapoints
+ * @param n Number of datapoints
+ * @param d Dimension of the datapoints
+ * @param labelings count arrays of n labels, each label in [0, n)
+ * @param count Number of labelings
+ * @param sample Number of scored points, 0 (or >= n) for the exact score
+ * @param seed Seed of the sampled points
+ * @param scores Output array of count scores
+ * @return int 0 on success, 1 if a labeling has a label out of range or fewer than 2 or
+ * more than n - 1 distinct labels (the silhouette is undefined)
+ */
+int silhouette_scores(double** points, int n, int d, int** labelings, int count, int sample,
+                      unsigned long seed, double* scores){
+    silhouette_pass pass;
+    int *clusters, *offsets, *rows, **sizes, i, j, l, distinct, tmp, m, status = 0;
+    unsigned long state = seed;
+    double sum;
+
+    m = sample > 0 && sample < n ? sample : n;
+    clusters = calloc(count > 0 ? count : 1, sizeof(int));
+    offsets = calloc(count > 0 ? count : 1, sizeof(int));
+    sizes = calloc(count > 0 ? count : 1, sizeof(int*));
+    rows = malloc((n > 0 ? n : 1) * sizeof(int));
+    if (check_pointer(clusters) || check_pointer(offsets) || check_pointer(sizes) || check_pointer(rows)) exit(1);
+
+    pass.total = 0;
+    for (l = 0; l < count && status == 0; l++){
+        for (i = 0; i < n; i++){
+            if (labelings[l][i] < 0 || labelings[l][i] >= n) status = 1;
+            else if (labelings[l][i] >= clusters[l]) clusters[l] = labelings[l][i] + 1;
+        }
+        if (status != 0) break;
+        sizes[l] = calloc(clusters[l], sizeof(int));
+        if (check_pointer(sizes[l])) exit(1);
+        for (i = 0; i < n; i++) sizes[l][labelings[l][i]]++;
+        for (i = 0, distinct = 0; i < clusters[l]; i++) distinct += sizes[l][i] > 0;
+        if (distinct < 2 || distinct > n - 1) status = 1;
+        offsets[l] = pass.total, pass.total += clusters[l];
+    }
+
+    if (status == 0 && count > 0){
+        /* the scored points: all of them, or the first m of a partial Fisher-Yates shuffle */
+        for (i = 0; i < n; i++) rows[i] = i;
+        for (i = 0; i < m && m < n; i++){
+            j = i + (int)(rand_uniform(&state) * (n - i));
+            tmp = rows[i], rows[i] = rows[j], rows[j] = tmp;
+        }
+        pass.points = points, pass.n = n, pass.d = d, pass.labelings = labelings, pass.count = count;
+        pass.clusters = clusters, pass.sizes = sizes, pass.offsets = offsets, pass.rows = rows;
+        pass.values = create_matrix(count, m);
+        parallel_for(m, silhouette_rows, &pass);
+        for (l = 0; l < count; l++){
+            sum = 0;
+            for (i = 0; i < m; i++) sum += pass.values[l][i];
+            scores[l] = sum / m;
+        }
+        free_matrix(pass.values, count);
+    }
+
+    for (l = 0; l < count; l++) free(sizes[l]);
+    free(clusters), free(offsets), free(sizes), free(rows);
+    return status;
+}
@@ -0,0 +1,13 @@
+#ifndef SILHOUETTE_H
+#define SILHOUETTE_H
+
+/* Constants */
+#define SILHOUETTE_TILE_ROWS 32
+#define SILHOUETTE_TILE_COLS 128
+#define SILHOUETTE_DEFAULT_SEED 1234
+
+/* Function declarations from silhouette.c */
+int silhouette_scores(double** points, int n, int d, int** labelings, int count, int sample,
+                      unsigned long seed, double* scores);
+
+#endif
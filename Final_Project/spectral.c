@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "symnmf.h"
+#include "spectral.h"
+
+/**
+ * @brief Orthonormalizes the columns of a matrix in place (modified Gram-Schmidt),
+ * a column that is linearly dependent on the previous ones is set to zero
+ *
+ * @param Q A n x p matrix
+ * @param n Number of rows in Q
+ * @param p Number of columns in Q
+ */
+void orthonormalize_columns(double** Q, int n, int p){
+    double dot, norm;
+    int i, j, l;
+    for (j = 0; j < p; j++){
+        for (l = 0; l < j; l++){
+            dot = 0;
+            for (i = 0; i < n; i++) dot += Q[i][l] * Q[i][j];
+            for (i = 0; i < n; i++) Q[i][j] -= dot * Q[i][l];
+        }
+        norm = 0;
+        for (i = 0; i < n; i++) norm += Q[i][j] * Q[i][j];
+        norm = sqrt(norm);
+        for (i = 0; i < n; i++) Q[i][j] = norm > 1e-12 ? Q[i][j] / norm : 0;
+    }
+}
+
+/**
+ * @brief Spectral initialization of H: the top-k eigenpairs of W are found by randomized
+ * subspace iteration (only W*Q products through the operator, then a small Rayleigh-Ritz
+ * problem), and H0 = V sqrt(L) is made nonnegative by keeping, for every eigenvector, the
+ * sign with the larger positive part. Entries are floored to a small positive value since
+ * the multiplicative update cannot move an entry away from zero.
+ *
+ * @param W The n x n normalized similarity matrix as an operator
+ * @param k Number of columns in H
+ * @param seed Seed of the random starting subspace
+ * @return double** H0 The n x k initial decomposition matrix
+ */
+double** spectral_init_H(const w_operator* W, int k, unsigned long seed){
+    int n = W->n, p, i, j, l, it;
+    double **Q, **Y, **tmp, **B, **U, **H, *values;
+    double pos, neg, sign, scale, floor_value = 0, value;
+    unsigned long state = seed;
+
+    p = k + SPECTRAL_OVERSAMPLE < n ? k + SPECTRAL_OVERSAMPLE : n;
+    Q = create_matrix(n, p);
+    Y = create_matrix(n, p);
+    for (i = 0; i < n; i++){
+        for (j = 0; j < p; j++) Q[i][j] = rand_uniform(&state) - 0.5;
+    }
+    orthonormalize_columns(Q, n, p);
+    for (it = 0; it < SPECTRAL_POWER_ITERATIONS; it++){
+        W->multiply(W, Q, p, Y);
+        orthonormalize_columns(Y, n, p);
+        tmp = Q, Q = Y, Y = tmp;
+    }
+
+    /* Rayleigh-Ritz: B = Q^T W Q, B = U L U^T, eigenvectors of W ~ Q U */
+    W->multiply(W, Q, p, Y);
+    B = create_matrix(p, p);
+    U = create_matrix(p, p);
+    values = malloc(p * sizeof(double));
+    if (check_pointer(values)) exit(1);
+    for (i = 0; i < n; i++){
+        for (j = 0; j < p; j++){
+            for (l = 0; l < p; l++) B[j][l] += Q[i][j] * Y[i][l];
+        }
+    }
+    for (j = 0; j < p; j++){
+        for (l = j + 1; l < p; l++) B[j][l] = B[l][j] = (B[j][l] + B[l][j]) / 2;
+    }
+    symmetric_eigen(B, p, values, U);
+
+    H = create_matrix(n, k);
+    for (j = 0; j < k && j < p; j++){
+        pos = 0, neg = 0;
+        for (i = 0; i < n; i++){
+            value = 0;
+            for (l = 0; l < p; l++) value += Q[i][l] * U[l][j];
+            H[i][j] = value;
+            if (value > 0) pos += value * value;
+            else neg += value * value;
+        }
+        sign = pos >= neg ? 1 : -1;
+        scale = values[j] > 0 ? sqrt(values[j]) : 0;
+        for (i = 0; i < n; i++){
+            H[i][j] = sign * H[i][j] > 0 ? scale * sign * H[i][j] : 0;
+            if (H[i][j] > floor_value) floor_value = H[i][j];
+        }
+    }
+    floor_value *= SPECTRAL_FLOOR;
+    for (i = 0; i < n; i++){
+        for (j = 0; j < k; j++){
+            if (H[i][j] < floor_value) H[i][j] = floor_value;
+        }
+    }
+
+    free_matrix(Q, n), free_matrix(Y, n), free_matrix(B, p), free_matrix(U, p);
+    free(values);
+    return H;
+}
@@ -0,0 +1,16 @@
+#ifndef SPECTRAL_H
+#define SPECTRAL_H
+
+#include "symnmf.h"
+
+/* Constants */
+#define SPECTRAL_OVERSAMPLE 5
+#define SPECTRAL_POWER_ITERATIONS 10
+#define SPECTRAL_FLOOR 1e-2
+#define SPECTRAL_DEFAULT_SEED 1234
+
+/* Function declarations from spectral.c */
+void orthonormalize_columns(double** Q, int n, int p);
+double** spectral_init_H(const w_operator* W, int k, unsigned long seed);
+
+#endif
@@ -0,0 +1,157 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include "stats.h"
+
+run_stats symnmf_stats;
+
+/* Serializes the updates of symnmf_stats, optimization loops may run on several threads */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* STAGE_NAMES[STAGE_COUNT] = {
+    "parse", "sym", "ddg", "norm", "update", "convergence", "output"
+};
+
+/**
+ * @brief Seconds on the monotonic clock
+ *
+ * @return double The time
+ */
+static double wall_seconds(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Clears the recorded statistics and turns recording on or off
+ *
+ * @param enabled 1 to record, 0 to stop recording
+ */
+void stats_enable(int enabled){
+    pthread_mutex_lock(&stats_lock);
+    memset(&symnmf_stats, 0, sizeof(symnmf_stats));
+    symnmf_stats.enabled = enabled;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/**
+ * @brief Starts timing a stage, a single flag test when stats are disabled
+ *
+ * @param stage The stage
+ * @return stats_timer The timer to hand to stats_end
+ */
+stats_timer stats_begin(int stage){
+    stats_timer timer;
+    timer.stage = -1, timer.wall = 0, timer.cpu = 0;
+    if (!symnmf_stats.enabled) return timer;
+    timer.stage = stage;
+    timer.wall = wall_seconds();
+    timer.cpu = (double)clock() / CLOCKS_PER_SEC;
+    return timer;
+}
+
+/**
+ * @brief Stops timing a stage and adds the elapsed times to it
+ *
+ * @param timer The timer from stats_begin
+ */
+void stats_end(stats_timer timer){
+    double wall, cpu;
+    if (timer.stage < 0) return;
+    wall = wall_seconds() - timer.wall;
+    cpu = (double)clock() / CLOCKS_PER_SEC - timer.cpu;
+    pthread_mutex_lock(&stats_lock);
+    symnmf_stats.stages[timer.stage].wall += wall;
+    symnmf_stats.stages[timer.stage].cpu += cpu;
+    symnmf_stats.stages[timer.stage].calls++;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/**
+ * @brief Records the outcome of an optimization loop
+ *
+ * @param iterations Number of updates performed
+ * @param final_delta Last squared change of the iterate
+ */
+void stats_loop(int iterations, double final_delta){
+    if (!symnmf_stats.enabled) return;
+    pthread_mutex_lock(&stats_lock);
+    symnmf_stats.iterations = iterations;
+    symnmf_stats.final_delta = final_delta;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/**
+ * @brief Counts a matrix allocation
+ *
+ * @param bytes Size of the allocation
+ */
+void stats_count_alloc(size_t bytes){
+    if (!symnmf_stats.enabled) return;
+    pthread_mutex_lock(&stats_lock);
+    symnmf_stats.allocations++;
+    symnmf_stats.allocated_bytes += bytes;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/**
+ * @brief Fills the fields read at the end of a run (peak resident set)
+ */
+void stats_finish(void){
+    struct rusage usage;
+    if (!symnmf_stats.enabled) return;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) symnmf_stats.peak_rss_kb = usage.ru_maxrss;
+}
+
+/**
+ * @brief Name of a stage, as printed and as used for the keys of the extension's dict
+ *
+ * @param stage The stage
+ * @return const char* The name
+ */
+const char* stats_stage_name(int stage){
+    return stage >= 0 && stage < STAGE_COUNT ? STAGE_NAMES[stage] : "unknown";
+}
+
+/**
+ * @brief Prints the recorded statistics, as an aligned table or as a single JSON object.
+ * Stages that never ran are left out.
+ *
+ * @param out Where to print (stderr for the CLI)
+ * @param json 1 for JSON, 0 for the table
+ */
+void stats_print(FILE* out, int json){
+    const stage_stats* stage;
+    int i, first = 1;
+    stats_finish();
+    if (json) fprintf(out, "{\"stages\": {");
+    for (i = 0; i < STAGE_COUNT; i++){
+        stage = &symnmf_stats.stages[i];
+        if (stage->calls == 0) continue;
+        if (json){
+            fprintf(out, "%s\"%s\": {\"wall\": %.6f, \"cpu\": %.6f, \"calls\": %ld}",
+                    first ? "" : ", ", STAGE_NAMES[i], stage->wall, stage->cpu, stage->calls);
+        } else {
+            fprintf(out, "%-12s wall %10.6fs  cpu %10.6fs  calls %ld\n",
+                    STAGE_NAMES[i], stage->wall, stage->cpu, stage->calls);
+        }
+        first = 0;
+    }
+    if (json){
+        fprintf(out, "}, \"iterations\": %d, \"final_delta\": %.6e, \"allocations\": %ld, "
+                "\"allocated_bytes\": %lu, \"peak_rss_kb\": %ld}\n", symnmf_stats.iterations,
+                symnmf_stats.final_delta, symnmf_stats.allocations,
+                (unsigned long)symnmf_stats.allocated_bytes, symnmf_stats.peak_rss_kb);
+    } else {
+        fprintf(out, "iterations   %d\nfinal_delta  %.6e\nallocations  %ld (%lu bytes)\npeak_rss     %ld kB\n",
+                symnmf_stats.iterations, symnmf_stats.final_delta, symnmf_stats.allocations,
+                (unsigned long)symnmf_stats.allocated_bytes, symnmf_stats.peak_rss_kb);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* The timed stages of a run */
+typedef enum stats_stage {
+    STAGE_PARSE,
+    STAGE_SYM,
+    STAGE_DDG,
+    STAGE_NORM,
+    STAGE_UPDATE,
+    STAGE_CONVERGENCE,
+    STAGE_OUTPUT,
+    STAGE_COUNT
+} stats_stage;
+
+/* Time spent in one stage, summed over its calls */
+typedef struct stage_stats {
+    double wall; /* seconds */
+    double cpu;  /* process CPU seconds, all threads */
+    long calls;
+} stage_stats;
+
+/* Everything recorded since stats_enable; nothing is recorded while disabled */
+typedef struct run_stats {
+    int enabled;
+    stage_stats stages[STAGE_COUNT];
+    int iterations;       /* updates of the last optimization loop */
+    double final_delta;   /* last squared change of H (or centroid shift) of that loop */
+    long allocations;     /* matrices and placed blocks allocated */
+    size_t allocated_bytes;
+    long peak_rss_kb;     /* peak resident set of the process, filled by stats_finish */
+} run_stats;
+
+/* A stage being timed, from stats_begin to stats_end */
+typedef struct stats_timer {
+    int stage; /* -1 when stats are disabled */
+    double wall;
+    double cpu;
+} stats_timer;
+
+extern run_stats symnmf_stats;
+
+/* Function declarations from stats.c */
+void stats_enable(int enabled);
+stats_timer stats_begin(int stage);
+void stats_end(stats_timer timer);
+void stats_loop(int iterations, double final_delta);
+void stats_count_alloc(size_t bytes);
+void stats_finish(void);
+const char* stats_stage_name(int stage);
+void stats_print(FILE* out, int json);
+
+#endif
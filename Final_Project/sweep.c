@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "symnmf.h"
+#include "packed.h"
+#include "sweep.h"
+
+/**
+ * @brief Builds an n x (k+1) warm start from an n x k solution by splitting the column of
+ * largest norm in two: row i keeps sqrt(u_i) of it in place and moves sqrt(1 - u_i) to the new
+ * last column (u_i uniform), so the row norms of H, and the diagonal of HH^T, are unchanged
+ * while the two halves start different enough to separate
+ *
+ * @param H The n x k solution, not modified
+ * @param n Number of rows in H
+ * @param k Number of columns in H
+ * @param state Random generator state
+ * @return double** The n x (k+1) matrix
+ */
+double** split_largest_column(double** H, int n, int k, unsigned long *state){
+    double** split = create_matrix(n, k + 1);
+    double norm, best_norm = -1, u;
+    int i, j, best = 0;
+
+    for (j = 0; j < k; j++){
+        norm = 0;
+        for (i = 0; i < n; i++) norm += H[i][j] * H[i][j];
+        if (norm > best_norm) best_norm = norm, best = j;
+    }
+    for (i = 0; i < n; i++){
+        memcpy(split[i], H[i], k * sizeof(double));
+        u = rand_uniform(state);
+        split[i][best] = H[i][best] * sqrt(u);
+        split[i][k] = H[i][best] * sqrt(1 - u);
+    }
+    return split;
+}
+
+/**
+ * @brief Sorts the requested k values in increasing order (insertion sort, the list is short)
+ *
+ * @param ks The k values, sorted in place
+ * @param count Number of k values
+ */
+static void sort_ks(int* ks, int count){
+    int i, j, key;
+    for (i = 1; i < count; i++){
+        key = ks[i];
+        for (j = i - 1; j >= 0 && ks[j] > key; j--) ks[j + 1] = ks[j];
+        ks[j + 1] = key;
+    }
+}
+
+/**
+ * @brief Solves symNMF for several k on the same W. The smallest k starts from a random H
+ * bounded by 2*sqrt(mean(W)/k) as in initialize_H, every larger k starts from the previous
+ * solution with its largest column split (repeatedly when the requested k values have gaps).
+ *
+ * @param W The packed normalized similarity matrix, built once by the caller
+ * @param ks The k values, in any order, each in [1, n)
+ * @param count Number of k values
+ * @param seed Seed of the initialization and of the splits
+ * @param results Output array of count results, sorted by k, freed by free_sweep_results
+ * @return int 0 on success, 1 for an invalid k
+ */
+int symnmf_sweep(const packed_matrix* W, const int* ks, int count, unsigned long seed, sweep_result* results){
+    w_operator op = packed_w_operator(W);
+    double **H = NULL, **split, mean, w_norm2, bound;
+    int *sorted, n = W->n, i, j, k = 0, r;
+    unsigned long state = seed;
+
+    sorted = malloc((count > 0 ? count : 1) * sizeof(int));
+    if (check_pointer(sorted)) exit(1);
+    memcpy(sorted, ks, count * sizeof(int));
+    sort_ks(sorted, count);
+    if (count <= 0 || sorted[0] < 1 || sorted[count - 1] >= n){
+        free(sorted);
+        return 1;
+    }
+    mean = packed_sum(W, &w_norm2) / ((double)n * n);
+
+    for (r = 0; r < count; r++){
+        if (H == NULL){
+            k = sorted[0];
+            bound = 2 * sqrt(mean / k);
+            H = create_matrix(n, k);
+            for (i = 0; i < n; i++){
+                for (j = 0; j < k; j++) H[i][j] = bound * rand_uniform(&state);
+            }
+        }
+        for (; k < sorted[r]; k++){
+            split = split_largest_column(H, n, k, &state);
+            free_matrix(H, n);
+            H = split;
+        }
+        H = optimize_H_operator(H, &op, k, &results[r].iterations);
+        results[r].k = k;
+        results[r].objective = operator_objective(H, &op, k, w_norm2);
+        /* the result keeps its own copy, H goes on to seed the next k */
+        results[r].H = create_matrix(n, k);
+        for (i = 0; i < n; i++) memcpy(results[r].H[i], H[i], k * sizeof(double));
+    }
+    free_matrix(H, n), free(sorted);
+    return 0;
+}
+
+/**
+ * @brief Frees the matrices owned by the results of a sweep
+ *
+ * @param results The results
+ * @param count Number of results
+ * @param n Number of rows in every H
+ */
+void free_sweep_results(sweep_result* results, int count, int n){
+    int r;
+    for (r = 0; r < count; r++){
+        free_matrix(results[r].H, n);
+        results[r].H = NULL;
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "symnmf.h"
+#include "packed.h"
+
+/* Constants */
+#define SWEEP_DEFAULT_SEED 1234
+
+/* The solution of one k of a sweep */
+typedef struct sweep_result {
+    int k;
+    double** H;     /* n x k, owned by the result */
+    int iterations;
+    double objective;
+} sweep_result;
+
+/* Function declarations from sweep.c */
+double** split_largest_column(double** H, int n, int k, unsigned long *state);
+int symnmf_sweep(const packed_matrix* W, const int* ks, int count, unsigned long seed, sweep_result* results);
+void free_sweep_results(sweep_result* results, int count, int n);
+
+#endif
@@ -2,8 +2,35 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 
 #include "symnmf.h"
+#include "parallel.h"
+#include "placement.h"
+#include "packed.h"
+#include "stats.h"
+#include "control.h"
+#include "checkpoint.h"
+#include "diskcache.h"
+#include "server.h"
+
+/* Shared context of a row pass over a dense goal matrix (sym or norm) */
+typedef struct goal_pass {
+    double** points;
+    double* weights;
+    int n, d;
+    const double* scale; /* D^{-1/2}, for the norm pass */
+    double** A;
+    double** W;
+} goal_pass;
+
+/* Shared context of a row pass of a product out = A*B */
+typedef struct product_pass {
+    double** A;
+    double** B;
+    int cols_A, cols_B;
+    double** out;
+} product_pass;
 
 /**
  * @brief Calculating d the vector size
@@ -102,6 +129,7 @@ double** create_matrix(int rows, int columns){
     int i;
     double **matrix = malloc(sizeof(double*) * rows);
     if (check_pointer(matrix)) exit(1);
+    stats_count_alloc((size_t)rows * columns * sizeof(double));
     for (i=0; i<rows; i++){
         matrix[i] = calloc(columns, sizeof(double));
         if (check_pointer(matrix[i])){
@@ -168,6 +196,45 @@ double vector_distance(double *x, double *y, int d){
     return res;
 }
 
+/**
+ * @brief Range task of sym_into, fills the rows [begin, end) of A
+ * 
+ * @param ctx A goal_pass
+ * @param begin First row
+ * @param end One past the last row
+ */
+static void sym_rows(void* ctx, int begin, int end){
+    goal_pass* pass = (goal_pass*)ctx;
+    double** A = pass->A;
+    int i,j;
+    for(i=begin; i<end; i++){
+        for(j=0; j<pass->n; j++){
+            if (i!=j) { A[i][j] = exp(-(pow(vector_distance(pass->points[i],pass->points[j],pass->d),2))/2); }
+            else { A[i][j] = 0; }
+            if (pass->weights != NULL) A[i][j] *= pass->weights[i] * pass->weights[j];
+        }
+    }
+}
+
+/**
+ * @brief Fills the (weighted) Similarity Matrix of a set of datapoints, one parallel_for
+ * slice of rows per thread
+ * 
+ * @param mat Set of n datapoints
+ * @param weights Weight of every datapoint, NULL for unit weights
+ * @param n Number of rows in the matrix
+ * @param d Number of columns in the matrix
+ * @param A Output n x n matrix
+ */
+static void sym_into(double** mat, double* weights, int n, int d, double** A){
+    stats_timer timer = stats_begin(STAGE_SYM);
+    goal_pass pass;
+    pass.points = mat, pass.weights = weights, pass.n = n, pass.d = d;
+    pass.scale = NULL, pass.A = A, pass.W = NULL;
+    parallel_for(n, sym_rows, &pass);
+    stats_end(timer);
+}
+
 /**
  * @brief Gets a matrix and calculates the Similarity Matrix
  * 
@@ -178,14 +245,45 @@ double vector_distance(double *x, double *y, int d){
  */
 double** sym(double** mat, int n, int d){
     double** A = create_matrix(n,n);
+    sym_into(mat, NULL, n, d, A);
+    return A;
+}
+
+/**
+ * @brief Gets a matrix of weighted datapoints and calculates their Similarity Matrix.
+ * A point of weight w stands for w original points, so the affinity between two
+ * weighted points is the total affinity between the groups, w_i * w_j * a_ij.
+ * ddg and norm applied to this matrix give the weighted degree and normalization.
+ *
+ * @param mat Set of n datapoints
+ * @param weights Weight of every datapoint, NULL for unit weights
+ * @param n Number of rows in the matrix
+ * @param d Number of columns in the matrix
+ * @return double** A The weighted similarity matrix
+ */
+double** sym_weighted(double** mat, double* weights, int n, int d){
+    double** A = create_matrix(n,n);
+    sym_into(mat, weights, n, d, A);
+    return A;
+}
+
+/**
+ * @brief Calculates the degrees, the diagonal of the diagonal degree matrix
+ * 
+ * @param A The Similarity Matrix
+ * @param n Number of rows in matrix
+ * @param degree Output array of n entries
+ */
+static void ddg_into(double** A, int n, double* degree){
+    stats_timer timer = stats_begin(STAGE_DDG);
     int i,j;
-    for(i=0; i<n; i++){
-        for(j=0; j<n; j++){
-            if (i!=j) { A[i][j] = exp(-(pow(vector_distance(mat[i],mat[j],d),2))/2); }
-            else { A[i][j] = 0; }
+    for (i=0; i<n; i++){
+        degree[i] = 0.0;
+        for (j=0; j<n; j++){
+            degree[i] += A[i][j];
         }
     }
-    return A;
+    stats_end(timer);
 }
 
 /**
@@ -197,14 +295,54 @@ double** sym(double** mat, int n, int d){
  */
 double** ddg(double** A, int n){
     double** D = create_matrix(n,n);
-    int i,j;
-    for (i=0; i<n; i++){
-        D[i][i] = 0.0;
-        for (j=0; j<n; j++){
-            D[i][i] += A[i][j];
+    double* degree = malloc((n > 0 ? n : 1) * sizeof(double));
+    int i;
+    if (check_pointer(degree)) exit(1);
+    ddg_into(A, n, degree);
+    for (i=0; i<n; i++) D[i][i] = degree[i];
+    free(degree);
+    return D;
+}
+
+/**
+ * @brief Range task of norm_into, scales the rows [begin, end) of A into W
+ * 
+ * @param ctx A goal_pass
+ * @param begin First row
+ * @param end One past the last row
+ */
+static void norm_rows(void* ctx, int begin, int end){
+    goal_pass* pass = (goal_pass*)ctx;
+    const double* D_inv_sqrt = pass->scale;
+    int i, j;
+    for (i=begin; i<end; i++){
+        for (j=0; j<pass->n; j++){
+                pass->W[i][j] = D_inv_sqrt[i] * pass->A[i][j] * D_inv_sqrt[j];
         }
     }
-    return D;
+}
+
+/**
+ * @brief Fills the Normalized Similarity Matrix D^-1/2 A D^-1/2, one parallel_for slice
+ * of rows per thread
+ * 
+ * @param A similarity matrix
+ * @param degree The degrees, overwritten with the diagonal of D^-1/2
+ * @param n Number of rows in matrix
+ * @param W Output n x n matrix (may be A)
+ */
+static void norm_into(double** A, double* degree, int n, double** W){
+    stats_timer timer = stats_begin(STAGE_NORM);
+    goal_pass pass;
+    int i;
+    for (i=0; i<n; i++){
+        if (degree[i]!=0) { degree[i] = (1.0 / sqrt(degree[i])); }
+        else { degree[i] = 0; }
+    }
+    pass.points = NULL, pass.weights = NULL, pass.n = n, pass.d = 0;
+    pass.scale = degree, pass.A = A, pass.W = W;
+    parallel_for(n, norm_rows, &pass);
+    stats_end(timer);
 }
 
 /**
@@ -218,43 +356,93 @@ double** ddg(double** A, int n){
 double** norm(double** D, double** A, int n){
     double** W = create_matrix(n,n);
     double* D_inv_sqrt = malloc(n * sizeof(double));
-    int i, j;
+    int i;
 
     if (check_pointer(D_inv_sqrt)) {
         free_matrix(W, n);
         return NULL;
     }
-    for (i=0; i<n; i++){
-        if (D[i][i]!=0) { D_inv_sqrt[i] = (1.0 / sqrt(D[i][i])); }
-        else { D_inv_sqrt[i] = 0; }
-    }
-
-    for (i=0; i<n; i++){
-        for (j=0; j<n; j++){
-                W[i][j] = D_inv_sqrt[i] * A[i][j] * D_inv_sqrt[j];
-        }
-    }
-    
+    for (i=0; i<n; i++) D_inv_sqrt[i] = D[i][i];
+    norm_into(A, D_inv_sqrt, n, W);
     free(D_inv_sqrt);
     return W;
 }
 
 /**
- * @brief Gets a matrix and transposes it
+ * @brief Calculates the real cube root of a number of any sign
+ * 
+ * @param x A number
+ * @return double The cube root of x
+ */
+static double cbrt_signed(double x){
+    return x < 0 ? -pow(-x, 1.0 / 3) : pow(x, 1.0 / 3);
+}
+
+/**
+ * @brief Writes the transpose of a matrix into a preallocated cols x rows matrix
  * 
  * @param mat A matrix
  * @param rows Number of rows in matrix
  * @param cols Number of columns in matrix
- * @return double** trans_mat The tranposed matrix
+ * @param trans_mat Output, overwritten with the transpose
  */
-double** transpose_matrix(double** mat, int rows, int cols){
-    double** trans_mat = create_matrix(cols, rows);
+static void transpose_into(double** mat, int rows, int cols, double** trans_mat){
     int i,j;
     for (i=0; i<rows; i++){
         for (j=0; j<cols; j++){
             trans_mat[j][i] = mat[i][j];
         }
     }
+}
+
+/**
+ * @brief Range task of a product, writes the rows [begin, end) of out = A*B
+ * 
+ * @param ctx A product_pass
+ * @param begin First row
+ * @param end One past the last row
+ */
+static void multiply_rows(void* ctx, int begin, int end){
+    product_pass* pass = (product_pass*)ctx;
+    double** product_mat = pass->out;
+    int i,j,k;
+    for(i=begin;i<end;i++){
+        for (j=0;j<pass->cols_B;j++){
+            product_mat[i][j] = 0; 
+            for (k=0; k<pass->cols_A; k++){
+                product_mat[i][j] += pass->A[i][k] * pass->B[k][j];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Writes the product of two matrices into a preallocated rows_A x cols_B matrix
+ * 
+ * @param A First matrix
+ * @param B Second matrix
+ * @param rows_A Number of rows in matrix A
+ * @param cols_A Number of columns in matrix A (and rows in B)
+ * @param cols_B Number of columns in matrix B
+ * @param product_mat Output, overwritten with A*B
+ */
+static void multiply_into(double** A, double** B, int rows_A, int cols_A, int cols_B, double** product_mat){
+    product_pass pass;
+    pass.A = A, pass.B = B, pass.cols_A = cols_A, pass.cols_B = cols_B, pass.out = product_mat;
+    multiply_rows(&pass, 0, rows_A);
+}
+
+/**
+ * @brief Gets a matrix and transposes it
+ * 
+ * @param mat A matrix
+ * @param rows Number of rows in matrix
+ * @param cols Number of columns in matrix
+ * @return double** trans_mat The tranposed matrix
+ */
+double** transpose_matrix(double** mat, int rows, int cols){
+    double** trans_mat = create_matrix(cols, rows);
+    transpose_into(mat, rows, cols, trans_mat);
     return trans_mat;
 }
 
@@ -271,21 +459,96 @@ double** transpose_matrix(double** mat, int rows, int cols){
  */
 double** multiply_matrices(double** A, double** B, int rows_A, int cols_A, int rows_B, int cols_B){
     double** product_mat;
-    int i,j,k;
     if (cols_A != rows_B){
         fprintf(stderr, "%s\n", ERROR_MESSAGE);
         exit(1);
     }
     product_mat = create_matrix(rows_A, cols_B);
-    for(i=0;i<rows_A;i++){
-        for (j=0;j<cols_B;j++){
-            product_mat[i][j] = 0; 
-            for (k=0; k<cols_A; k++){
-                product_mat[i][j] += A[i][k] * B[k][j];
-            }
+    multiply_into(A, B, rows_A, cols_A, cols_B, product_mat);
+    return product_mat;
+}
+
+/**
+ * @brief multiply_matrices with the product taken from a scratch arena
+ * 
+ * @param scratch The arena the product is allocated from
+ * @param A First matrix
+ * @param B Second matrix
+ * @param rows_A Number of rows in matrix A
+ * @param cols_A Number of columns in matrix A (and rows in B)
+ * @param cols_B Number of columns in matrix B
+ * @return double** product_mat The product, released with the arena
+ */
+static double** multiply_scratch(arena* scratch, double** A, double** B, int rows_A, int cols_A, int cols_B){
+    double** product_mat = arena_matrix(scratch, rows_A, cols_B);
+    multiply_into(A, B, rows_A, cols_A, cols_B, product_mat);
+    return product_mat;
+}
+
+/**
+ * @brief Takes the products of a loop from a scratch arena and sets ||W||^2, the only part
+ * of the objective that does not depend on H
+ * 
+ * @param products The products, invalid until compute_products
+ * @param W Normalized similarity matrix
+ * @param n Number of rows and columns in W
+ * @param k Number of columns in H
+ * @param scratch The arena, W*H and H^TH are released with it
+ */
+static void init_products(symnmf_products* products, double** W, int n, int k, arena* scratch){
+    int i, j;
+    products->WxH = arena_matrix(scratch, n, k);
+    products->HtH = arena_matrix(scratch, k, k);
+    products->w_norm2 = 0, products->valid = 0;
+    for (i=0; i<n; i++){
+        for (j=0; j<n; j++) products->w_norm2 += W[i][j] * W[i][j];
+    }
+}
+
+/**
+ * @brief Calculates W*H and H^TH of an iterate, the O(n^2 k) part of every update. W*H runs
+ * one parallel_for slice of rows per thread, the slices placed W was first touched by.
+ * 
+ * @param H The iterate
+ * @param W Normalized similarity matrix
+ * @param n Number of rows in H, and the number of rows and columns in W
+ * @param k Number of columns in H
+ * @param products Output, valid for H
+ */
+static void compute_products(double** H, double** W, int n, int k, symnmf_products* products){
+    product_pass pass;
+    int i, j, l;
+    pass.A = W, pass.B = H, pass.cols_A = n, pass.cols_B = k, pass.out = products->WxH;
+    parallel_for(n, multiply_rows, &pass);
+    for (j=0; j<k; j++) memset(products->HtH[j], 0, k * sizeof(double));
+    for (i=0; i<n; i++){
+        for (j=0; j<k; j++){
+            for (l=0; l<k; l++) products->HtH[j][l] += H[i][j] * H[i][l];
         }
     }
-    return product_mat;
+    products->valid = 1;
+}
+
+/**
+ * @brief The objective ||W - HH^T||^2 from the products of H, as
+ * ||W||^2 - 2tr(H^TWH) + tr((H^TH)^2) in O(nk + k^2)
+ * 
+ * @param H The iterate
+ * @param products Valid products of H
+ * @param n Number of rows in H
+ * @param k Number of columns in H
+ * @return double The objective value
+ */
+static double products_objective(double** H, const symnmf_products* products, int n, int k){
+    double cross = 0, gram = 0;
+    int i, j;
+    for (i=0; i<n; i++){
+        for (j=0; j<k; j++) cross += H[i][j] * products->WxH[i][j];
+    }
+    for (i=0; i<k; i++){
+        for (j=0; j<k; j++) gram += products->HtH[i][j] * products->HtH[i][j];
+    }
+    return products->w_norm2 - 2 * cross + gram;
 }
 
 /**
@@ -298,22 +561,42 @@ double** multiply_matrices(double** A, double** B, int rows_A, int cols_A, int r
  * @return double** new_H The updated matrix
  */
 double** update_H(double** H, double** W, int n, int k){
-    double** WxH = multiply_matrices(W,H,n,n,n,k); 
-    double** Ht = transpose_matrix(H,n,k); 
-    double** HxHt = multiply_matrices(H,Ht,n,k,k,n); 
-    double** HHH = multiply_matrices(HxHt,H,n,n,n,k); 
-    double** new_H = create_matrix(n,k); 
-    int i,j;
+    arena scratch;
+    arena_backend backend = env_backend();
+    symnmf_products products;
+    double** new_H = create_matrix(n,k);
+    arena_init(&scratch, &backend, 0);
+    init_products(&products, W, n, k, &scratch);
+    compute_products(H, W, n, k, &products);
+    update_H_scratch(H, W, n, k, &products, new_H, &scratch);
+    arena_destroy(&scratch);
+    return new_H;
+}
+
+/**
+ * @brief One multiplicative update from the products of H: HH^TH is evaluated as H(H^TH),
+ * so the update needs no n x n temporary and nothing beyond the products costs O(n^2)
+ * 
+ * @param H Initialized decomoposition matrix
+ * @param W Normalized similarity matrix
+ * @param n Number of rows in H & number of rows and columns in W
+ * @param k Number of columns in H
+ * @param products Valid products of H, invalid on return
+ * @param new_H Output n x k matrix, overwritten with the updated H
+ * @param scratch Unused, the update has no temporaries
+ */
+void update_H_scratch(double** H, double** W, int n, int k, symnmf_products* products, double** new_H, arena* scratch){
+    double hhh;
+    int i,j,l;
+    (void)W, (void)scratch;
     for (i=0; i<n; i++){
         for (j=0; j<k; j++){
-            new_H[i][j] = H[i][j] * (0.5 + 0.5*(WxH[i][j] / HHH[i][j]));
+            hhh = 0;
+            for (l=0; l<k; l++) hhh += H[i][l] * products->HtH[l][j];
+            new_H[i][j] = H[i][j] * (0.5 + 0.5*(products->WxH[i][j] / hhh));
         }
     }
-    free_matrix(WxH,n);
-    free_matrix(Ht,k);
-    free_matrix(HxHt,n);
-    free_matrix(HHH,n);
-    return new_H;
+    products->valid = 0;
 }
 
 /**
@@ -354,17 +637,447 @@ double** subtract_matrices(double** A, double** B, int rows_A, int cols_A, int r
  */
 double frobenius_norm(double** new_H, double** H, int n, int k){
     int i,j;
-    double** diff_mat = subtract_matrices(new_H,H,n,k,n,k);
-    double norm = 0;
+    double norm = 0, diff;
     for (i=0; i<n; i++){
         for (j=0; j<k; j++){
-            norm += pow(diff_mat[i][j],2);
+            diff = new_H[i][j] - H[i][j];
+            norm += diff * diff;
         }
     }
-    free_matrix(diff_mat, n);
     return sqrt(norm);
 }
 
+/**
+ * @brief Calculates the symNMF objective ||W - HH^T||^2 (squared frobenius norm)
+ * 
+ * @param W Normalized similarity matrix
+ * @param H Decomposition matrix
+ * @param n Number of rows in H, and the number of rows and columns in W
+ * @param k Number of columns in H
+ * @return double The objective value
+ */
+double symnmf_objective(double** W, double** H, int n, int k){
+    int i, j, l;
+    double res = 0, hh;
+    for (i=0; i<n; i++){
+        for (j=0; j<n; j++){
+            hh = 0;
+            for (l=0; l<k; l++){
+                hh += H[i][l] * H[j][l];
+            }
+            res += (W[i][j] - hh) * (W[i][j] - hh);
+        }
+    }
+    return res;
+}
+
+/**
+ * @brief Finds the minimizer over x >= 0 of x^4/4 + a*x^2/2 + b*x,
+ * i.e. the best nonnegative root of the depressed cubic x^3 + a*x + b = 0 (or 0)
+ * 
+ * @param a Linear coefficient of the cubic
+ * @param b Constant coefficient of the cubic
+ * @return double x The minimizer
+ */
+static double nonnegative_cubic_root(double a, double b){
+    double roots[3], best = 0, best_val = 0, val, disc, r, phi;
+    int count, i;
+    disc = (b * b) / 4 + (a * a * a) / 27;
+    if (disc >= 0){
+        r = sqrt(disc);
+        roots[0] = cbrt_signed(-b / 2 + r) + cbrt_signed(-b / 2 - r);
+        count = 1;
+    } else {
+        r = 2 * sqrt(-a / 3);
+        phi = 3 * b / (a * r);
+        phi = acos(phi > 1 ? 1 : (phi < -1 ? -1 : phi));
+        for (i=0; i<3; i++){
+            roots[i] = r * cos((phi - 2 * M_PI_VALUE * i) / 3);
+        }
+        count = 3;
+    }
+    for (i=0; i<count; i++){
+        if (roots[i] > 0){
+            val = roots[i] * roots[i] * (roots[i] * roots[i] / 4 + a / 2) + b * roots[i];
+            if (val < best_val){
+                best = roots[i], best_val = val;
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief One sweep of exact coordinate descent (symmetric HALS) on ||W - HH^T||^2, in place.
+ * Every entry H[i][j] is replaced by the nonnegative minimizer of the objective in that entry.
+ * The residual R = W - HH^T is never formed: its row i against column j of H is
+ * (WH)[i][j] - W[i][i]h - (H_i H^TH)[j] + h||H_i||^2, and after every change W*H (one column,
+ * O(n)) and H^TH (one row and column, O(k)) are patched, so each entry costs O(n + k) and the
+ * products still describe H when the sweep ends.
+ * 
+ * @param H Current decomposition matrix, updated in place
+ * @param W Normalized similarity matrix
+ * @param n Number of rows in H, and the number of rows and columns in W
+ * @param k Number of columns in H
+ * @param products Valid products of H, kept up to date
+ */
+static void hals_sweep(double** H, double** W, int n, int k, symnmf_products* products){
+    double **WxH = products->WxH, **HtH = products->HtH;
+    double h, x, delta, p, q, row_sq, cross;
+    int i, j, l;
+    for (i=0; i<n; i++){
+        row_sq = 0;
+        for (l=0; l<k; l++) row_sq += H[i][l] * H[i][l];
+        for (j=0; j<k; j++){
+            h = H[i][j];
+            cross = 0;
+            for (l=0; l<k; l++) cross += H[i][l] * HtH[l][j];
+            p = WxH[i][j] - W[i][i] * h - (cross - h * row_sq);
+            q = HtH[j][j] - h * h;
+            x = nonnegative_cubic_root(q - (W[i][i] - row_sq) - h * h, -(p + h * q));
+            delta = x - h;
+            if (delta == 0) continue;
+            for (l=0; l<n; l++) WxH[l][j] += delta * W[i][l]; /* W is symmetric */
+            for (l=0; l<k; l++){
+                if (l != j){
+                    HtH[j][l] += delta * H[i][l];
+                    HtH[l][j] = HtH[j][l];
+                }
+            }
+            HtH[j][j] += x * x - h * h;
+            row_sq += x * x - h * h;
+            H[i][j] = x;
+        }
+    }
+}
+
+/**
+ * @brief One symmetric HALS sweep as a symnmf_update, for loops that drive the solver
+ * step by step: the sweep runs on a copy of H and leaves the products describing it
+ * 
+ * @param H Current decomposition matrix
+ * @param W Normalized similarity matrix
+ * @param n Number of rows in H, and the number of rows and columns in W
+ * @param k Number of columns in H
+ * @param products Valid products of H, valid for new_H on return
+ * @param new_H Output n x k matrix, overwritten with the updated H
+ * @param scratch Unused, the sweep has no temporaries
+ */
+void hals_update_H(double** H, double** W, int n, int k, symnmf_products* products, double** new_H, arena* scratch){
+    int i;
+    (void)scratch;
+    for (i=0; i<n; i++){
+        memcpy(new_H[i], H[i], k * sizeof(double));
+    }
+    hals_sweep(new_H, W, n, k, products);
+}
+
+/**
+ * @brief Symmetric HALS until the objective stops decreasing: W*H and H^TH are computed once
+ * and kept up to date across sweeps, so the objective costs O(nk + k^2) per sweep and nothing
+ * beyond W itself is n x n. Stops when (f_prev - f) <= OBJECTIVE_RTOL * f_prev or after
+ * MAX_ITER sweeps.
+ * 
+ * @param H Initialized decomposition matrix, updated in place
+ * @param W Normalized similarity matrix
+ * @param n Number of rows in H, and the number of rows and columns in W
+ * @param k Number of columns in H
+ * @param trace Output array of MAX_ITER + 1 entries, the objective of every iterate (may be NULL)
+ * @param iterations Output, number of sweeps performed (may be NULL)
+ * @return double** H Updated matrix
+ */
+double** optimize_H_hals(double** H, double** W, int n, int k, double* trace, int* iterations){
+    arena scratch;
+    arena_backend backend = env_backend();
+    symnmf_products products;
+    double objective, previous;
+    int iter = 0;
+
+    arena_init(&scratch, &backend, 0);
+    init_products(&products, W, n, k, &scratch);
+    compute_products(H, W, n, k, &products);
+    objective = products_objective(H, &products, n, k);
+    if (trace != NULL) trace[0] = objective;
+    while (iter < MAX_ITER){
+        hals_sweep(H, W, n, k, &products);
+        iter++;
+        previous = objective;
+        objective = products_objective(H, &products, n, k);
+        if (trace != NULL) trace[iter] = objective;
+        if (previous - objective <= OBJECTIVE_RTOL * previous) break;
+    }
+    arena_destroy(&scratch);
+    if (iterations != NULL) *iterations = iter;
+    return H;
+}
+
+/**
+ * @brief An upper bound on the Lipschitz constant of the gradient 4(HH^TH - WH) around H:
+ * its Hessian is bounded by 12||H||_2^2 + 4||W||_2, and ||H||_2^2 = ||H^TH||_2 <= ||H^TH||_F,
+ * ||W||_2 <= ||W||_F
+ * 
+ * @param products The products of H
+ * @param k Number of rows and columns in H^TH
+ * @return double L The bound
+ */
+static double pgd_lipschitz(const symnmf_products* products, int k){
+    double hth_norm = 0;
+    int i, j;
+    for (i=0; i<k; i++){
+        for (j=0; j<k; j++) hth_norm += products->HtH[i][j] * products->HtH[i][j];
+    }
+    return 4 * (3 * sqrt(hth_norm) + sqrt(products->w_norm2));
+}
+
+/**
+ * @brief One projected gradient step with an Armijo backtracking line search on ||W - HH^T||^2.
+ * The gradient is 4(HH^TH - WH); the step starts from the given length, or from 1/L for the
+ * bound L of pgd_lipschitz when it is 0, and is halved until the sufficient decrease holds.
+ * 
+ * @param H Current decomposition matrix
+ * @param W Normalized similarity matrix
+ * @param n Number of rows in H, and the number of rows and columns in W
+ * @param k Number of columns in H
+ * @param products Valid products of H
+ * @param f The objective of H
+ * @param step In: the first step length tried (0 for 1/L); out: the accepted one
+ * @param new_H Output n x k matrix, overwritten with the new iterate
+ * @param scratch Arena for the gradient
+ * @return double The objective of new_H
+ */
+static double pgd_step(double** H, double** W, int n, int k, const symnmf_products* products, double f, double* step,
+                       double** new_H, arena* scratch){
+    arena_mark mark = arena_save(scratch);
+    double** grad = multiply_scratch(scratch,H,products->HtH,n,k,k);
+    double new_f = f, decrease;
+    int i, j, tries;
+
+    for (i=0; i<n; i++){
+        for (j=0; j<k; j++){
+            grad[i][j] = 4 * (grad[i][j] - products->WxH[i][j]);
+        }
+    }
+    if (*step <= 0) *step = 1.0 / pgd_lipschitz(products, k);
+
+    for (tries = 0; tries < PGD_MAX_BACKTRACK; tries++){
+        decrease = 0;
+        for (i=0; i<n; i++){
+            for (j=0; j<k; j++){
+                new_H[i][j] = H[i][j] - *step * grad[i][j];
+                if (new_H[i][j] < 0) new_H[i][j] = 0;
+                decrease += grad[i][j] * (H[i][j] - new_H[i][j]);
+            }
+        }
+        new_f = symnmf_objective(W, new_H, n, k);
+        if (new_f <= f - PGD_ARMIJO * decrease) break;
+        *step /= 2;
+    }
+
+    arena_reset(scratch, mark);
+    return new_f;
+}
+
+/**
+ * @brief One projected gradient step as a symnmf_update, starting its line search from 1/L
+ * 
+ * @param H Current decomposition matrix
+ * @param W Normalized similarity matrix
+ * @param n Number of rows in H, and the number of rows and columns in W
+ * @param k Number of columns in H
+ * @param products Valid products of H, invalid on return
+ * @param new_H Output n x k matrix, overwritten with the updated H
+ * @param scratch Arena for the gradient
+ */
+void pgd_update_H(double** H, double** W, int n, int k, symnmf_products* products, double** new_H, arena* scratch){
+    double step = 0;
+    pgd_step(H, W, n, k, products, products_objective(H, products, n, k), &step, new_H, scratch);
+    products->valid = 0;
+}
+
+/**
+ * @brief Projected gradient descent until the objective stops decreasing. The objective of
+ * every iterate comes from the line search that accepted it, and each search starts from twice
+ * the previous accepted step (the first from 1/L), so the step grows back after a backtrack.
+ * Stops when (f_prev - f) <= OBJECTIVE_RTOL * f_prev or after MAX_ITER steps.
+ * The iterates alternate between H and one more buffer, the last one is copied back into H.
+ * 
+ * @param H Initialized decomposition matrix, updated in place
+ * @param W Normalized similarity matrix
+ * @param n Number of rows in H, and the number of rows and columns in W
+ * @param k Number of columns in H
+ * @param trace Output array of MAX_ITER + 1 entries, the objective of every iterate (may be NULL)
+ * @param iterations Output, number of steps performed (may be NULL)
+ * @return double** H Updated matrix
+ */
+double** optimize_H_pgd(double** H, double** W, int n, int k, double* trace, int* iterations){
+    arena scratch;
+    arena_backend backend = env_backend();
+    symnmf_products products;
+    double **origin = H, **new_H, **swap;
+    double objective, previous, step = 0;
+    int iter = 0, i;
+
+    arena_init(&scratch, &backend, 0);
+    init_products(&products, W, n, k, &scratch);
+    new_H = arena_matrix(&scratch, n, k);
+    compute_products(H, W, n, k, &products);
+    objective = products_objective(H, &products, n, k);
+    if (trace != NULL) trace[0] = objective;
+    while (iter < MAX_ITER){
+        previous = objective;
+        if (!products.valid) compute_products(H, W, n, k, &products);
+        objective = pgd_step(H, W, n, k, &products, previous, &step, new_H, &scratch);
+        if (objective > previous) break; /* no step length decreased it, keep H */
+        swap = H, H = new_H, new_H = swap;
+        products.valid = 0;
+        iter++;
+        if (trace != NULL) trace[iter] = objective;
+        if (previous - objective <= OBJECTIVE_RTOL * previous) break;
+        step *= 2;
+    }
+    if (H != origin){
+        for (i=0; i<n; i++) memcpy(origin[i], H[i], k * sizeof(double));
+        H = origin;
+    }
+    arena_destroy(&scratch);
+    if (iterations != NULL) *iterations = iter;
+    return H;
+}
+
+/* The available update rules, the first one is the default */
+static const symnmf_solver SOLVERS[] = {
+    {"mu", update_H_scratch, NULL, STOP_STEP},
+    {"mu-active", NULL, optimize_H_active, STOP_STEP},
+    {"hals", hals_update_H, optimize_H_hals, STOP_OBJECTIVE},
+    {"pgd", pgd_update_H, optimize_H_pgd, STOP_OBJECTIVE}
+};
+
+/**
+ * @brief Looks up a symNMF update rule by name
+ * 
+ * @param name Name of the solver ("mu", "mu-active", "hals" or "pgd"), NULL for the default
+ * @return const symnmf_solver* The solver, or NULL if there is no solver with that name
+ */
+const symnmf_solver* find_solver(const char* name){
+    size_t i;
+    if (name == NULL) return &SOLVERS[0];
+    for (i=0; i<sizeof(SOLVERS)/sizeof(SOLVERS[0]); i++){
+        if (strcmp(SOLVERS[i].name, name) == 0) return &SOLVERS[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Gets matrix H and matrix W and applies an update rule until convergence (or until max iteration number is reached)
+ * 
+ * @param H Initialized decomoposition matrix, updated in place
+ * @param W Normalized similarity matrix
+ * @param n Number of rows in H, and the number of rows and columns in W
+ * @param k Number of columns in H
+ * @param update The update rule of the solver
+ * @param iterations Output, number of updates performed (may be NULL)
+ * @param scratch Arena for the temporaries of every update, reused across iterations
+ * (NULL uses an arena of its own on the SYMNMF_ARENA backend)
+ * @return double** H Updated matrix
+ */
+double** optimize_H_with(double** H, double** W, int n, int k, symnmf_update update, int* iterations, arena* scratch){
+    return optimize_H_controlled(H, W, n, k, update, STOP_STEP, iterations, scratch, NULL, NULL);
+}
+
+/**
+ * @brief The symNMF loop of every solver with an update rule. W*H and H^TH of each iterate are
+ * computed once and shared by the update and the objective, which the trace identity
+ * ||W||^2 - 2tr(H^TWH) + tr((H^TH)^2) then gives in O(nk + k^2), so every rule, trace and
+ * progress report costs no more than the plain update. The rule decides between the step norm
+ * (||H_new - H||^2 < EPSILON) and the relative objective decrease
+ * ((f_prev - f) <= OBJECTIVE_RTOL * f_prev). Under a run_control progress is published after
+ * every update, and the loop stops between updates when cancelled or out of budget, returning
+ * the latest iterate, which is the best one since every solver is monotone in the objective.
+ * With a checkpoint on the control H is saved every interval updates and when the loop stops,
+ * and a checkpoint loaded by checkpoint_load continues counting from the updates it already did.
+ * The update writes every iterate into the other of two buffers, H and one from the scratch
+ * arena, so the loop allocates nothing per update; the final iterate is copied back into H.
+ * 
+ * @param H Initialized decomoposition matrix, updated in place
+ * @param W Normalized similarity matrix
+ * @param n Number of rows in H, and the number of rows and columns in W
+ * @param k Number of columns in H
+ * @param update The update rule of the solver
+ * @param rule A stop_rule
+ * @param iterations Output, number of updates performed (may be NULL)
+ * @param scratch Arena for the products and the temporaries of every update (may be NULL)
+ * @param control The control (NULL runs uncontrolled, as optimize_H_with)
+ * @param trace Output array of MAX_ITER + 1 entries, the objective of every iterate from the
+ * initial H to the returned one (may be NULL)
+ * @return double** H Updated matrix
+ */
+double** optimize_H_controlled(double** H, double** W, int n, int k, symnmf_update update, int rule, int* iterations, arena* scratch, struct run_control* control, double* trace){
+    arena local;
+    arena_backend backend;
+    arena_mark mark;
+    stats_timer timer;
+    symnmf_products products;
+    checkpoint* cp = control != NULL ? control->checkpoint : NULL;
+    int iter = cp != NULL ? cp->iteration : 0, start = iter, finished = cp != NULL && cp->finished, step_ok, objective_ok;
+    double **origin = H, **spare, **swap;
+    double delta = 0, objective, previous = 0;
+    int i;
+    if (scratch == NULL){
+        backend = env_backend();
+        arena_init(&local, &backend, 0);
+        scratch = &local;
+    }
+    mark = arena_save(scratch);
+    init_products(&products, W, n, k, scratch);
+    spare = arena_matrix(scratch, n, k);
+    while (1){
+        if (!products.valid){
+            timer = stats_begin(STAGE_UPDATE);
+            compute_products(H, W, n, k, &products);
+            stats_end(timer);
+        }
+        timer = stats_begin(STAGE_CONVERGENCE);
+        objective = products_objective(H, &products, n, k);
+        stats_end(timer);
+        if (trace != NULL) trace[iter] = objective;
+        if (iter > start){ /* H came from an update */
+            if (control != NULL){
+                control_report(control, iter, delta, objective);
+                checkpoint_step(cp, iter, objective, H, n, k, W, 0);
+            }
+            step_ok = delta < EPSILON;
+            objective_ok = previous - objective <= OBJECTIVE_RTOL * previous;
+            if ((rule == STOP_STEP && step_ok) || (rule == STOP_OBJECTIVE && objective_ok) || (rule == STOP_BOTH && step_ok && objective_ok)){
+                finished = 1;
+            }
+        }
+        previous = objective;
+        if (iter >= MAX_ITER || finished || control_should_stop(control)) break;
+        timer = stats_begin(STAGE_UPDATE);
+        update(H, W, n, k, &products, spare, scratch);
+        stats_end(timer);
+        iter++;
+        timer = stats_begin(STAGE_CONVERGENCE);
+        delta = pow(frobenius_norm(spare, H, n, k),2);
+        stats_end(timer);
+        swap = H, H = spare, spare = swap;
+    }
+    if (H != origin){
+        for (i=0; i<n; i++) memcpy(origin[i], H[i], k * sizeof(double));
+        H = origin;
+    }
+    stats_loop(iter, delta);
+    if (cp != NULL) cp->finished = finished || iter >= MAX_ITER;
+    if (control != NULL){
+        control_finish(control, CONTROL_DONE, objective);
+        checkpoint_step(cp, iter, objective, H, n, k, W, 1);
+    }
+    arena_reset(scratch, mark);
+    if (scratch == &local) arena_destroy(&local);
+    if (iterations != NULL) *iterations = iter;
+    return H;
+}
+
 /**
  * @brief Gets matrix H and matrix W and update H until convergence (or until max iteration number is reached)
  * 
@@ -375,70 +1088,571 @@ double frobenius_norm(double** new_H, double** H, int n, int k){
  * @return double** H Updated matrix
  */
 double** optimize_H(double** H, double** W, int n, int k){
-    int iter = 0;
-    double** new_H;
+    return optimize_H_with(H, W, n, k, update_H_scratch, NULL, NULL);
+}
+
+/**
+ * @brief Runs a solver to convergence, through its own loop when it has one
+ * 
+ * @param H Initialized decomposition matrix, updated in place
+ * @param W Normalized similarity matrix
+ * @param n Number of rows in H, and the number of rows and columns in W
+ * @param k Number of columns in H
+ * @param solver The solver
+ * @param iterations Output, number of updates performed (may be NULL)
+ * @param scratch Arena for the temporaries of the updates (may be NULL), unused by solvers with their own loop
+ * @return double** H Updated matrix
+ */
+double** optimize_H_solver(double** H, double** W, int n, int k, const symnmf_solver* solver, int* iterations, arena* scratch){
+    if (solver->optimize != NULL) return solver->optimize(H, W, n, k, NULL, iterations);
+    return optimize_H_with(H, W, n, k, solver->update, iterations, scratch);
+}
+
+/**
+ * @brief Incremental multiplicative update: only the active rows of H are recomputed.
+ * A row whose squared change drops below ACTIVE_FREEZE_RATIO * EPSILON / n is frozen and skipped,
+ * W*H and H(H^TH) are evaluated for the active rows only and H^TH is patched with the rows
+ * that moved. Every ACTIVE_RECHECK_INTERVAL iterations (and before declaring convergence)
+ * a full sweep updates every row and re-activates the ones that moved again, so the result
+ * satisfies the same stopping rule as optimize_H.
+ * 
+ * @param H Initialized decomposition matrix, updated in place
+ * @param W Normalized similarity matrix
+ * @param n Number of rows in H, and the number of rows and columns in W
+ * @param k Number of columns in H
+ * @param trace Output array of MAX_ITER + 1 entries, the objective of every iterate (may be NULL,
+ * each entry costs a full objective evaluation)
+ * @param iterations Output, number of updates performed (may be NULL)
+ * @return double** H Updated matrix
+ */
+double** optimize_H_active(double** H, double** W, int n, int k, double* trace, int* iterations){
+    double** HtH = create_matrix(k, k);
+    double** new_H = create_matrix(n, k);
+    int *active = malloc(n * sizeof(int));
+    int iter = 0, since_check = 0, full, i, j, l;
+    double delta, row_delta, hhh, w, freeze_tol = ACTIVE_FREEZE_RATIO * EPSILON / n;
+
+    if (check_pointer(active)) exit(1);
+    for (i=0; i<n; i++) active[i] = 1;
+    if (trace != NULL) trace[0] = symnmf_objective(W, H, n, k);
     while (iter < MAX_ITER){
-        new_H = update_H(H, W, n, k);
-        if (new_H == NULL){
-            return NULL;
-        }
-        if (pow(frobenius_norm(new_H, H, n, k),2) < EPSILON){
-            free_matrix(H,n); 
-            return new_H; 
-        } 
-        free_matrix(H,n);
-        H = new_H;
+        full = since_check == 0;
+        if (full){ /* fresh H^TH, drops the rounding of the incremental patches */
+            for (j=0; j<k; j++) memset(HtH[j], 0, k * sizeof(double));
+            for (i=0; i<n; i++){
+                for (j=0; j<k; j++){
+                    for (l=0; l<k; l++) HtH[j][l] += H[i][j] * H[i][l];
+                }
+            }
+        }
+        /* new rows from the current H, written aside so every row sees the same H */
+        for (i=0; i<n; i++){
+            if (!full && !active[i]) continue;
+            memset(new_H[i], 0, k * sizeof(double));
+            for (l=0; l<n; l++){
+                w = W[i][l];
+                for (j=0; j<k; j++) new_H[i][j] += w * H[l][j];
+            }
+            for (j=0; j<k; j++){
+                hhh = 0;
+                for (l=0; l<k; l++) hhh += H[i][l] * HtH[l][j];
+                new_H[i][j] = H[i][j] * (0.5 + 0.5*(new_H[i][j] / hhh));
+            }
+        }
+        delta = 0;
+        for (i=0; i<n; i++){
+            if (!full && !active[i]) continue;
+            row_delta = 0;
+            for (j=0; j<k; j++) row_delta += (new_H[i][j] - H[i][j]) * (new_H[i][j] - H[i][j]);
+            delta += row_delta;
+            active[i] = row_delta >= freeze_tol;
+            for (j=0; j<k; j++){
+                for (l=0; l<k; l++) HtH[j][l] += new_H[i][j] * new_H[i][l] - H[i][j] * H[i][l];
+            }
+            memcpy(H[i], new_H[i], k * sizeof(double));
+        }
+        iter++;
+        if (trace != NULL) trace[iter] = symnmf_objective(W, H, n, k);
+        since_check = (since_check + 1) % ACTIVE_RECHECK_INTERVAL;
+        if (delta < EPSILON){
+            if (full) break;
+            since_check = 0; /* the frozen rows must agree before stopping */
+        }
+    }
+    free_matrix(HtH, k), free_matrix(new_H, n), free(active);
+    if (iterations != NULL) *iterations = iter;
+    return H;
+}
+
+/**
+ * @brief Looks up a stopping rule by name
+ * 
+ * @param name "step", "objective" or "both", NULL for the default ("step")
+ * @return int The stop_rule, or -1 if there is no rule with that name
+ */
+int find_stop_rule(const char* name){
+    if (name == NULL || strcmp(name, "step") == 0) return STOP_STEP;
+    if (strcmp(name, "objective") == 0) return STOP_OBJECTIVE;
+    if (strcmp(name, "both") == 0) return STOP_BOTH;
+    return -1;
+}
+
+/**
+ * @brief Range task of dense_multiply, writes the rows [begin, end) of out = W*H
+ * 
+ * @param ctx A product_pass, A is W and B is H
+ * @param begin First row
+ * @param end One past the last row
+ */
+static void dense_rows(void* ctx, int begin, int end){
+    product_pass* pass = (product_pass*)ctx;
+    double w;
+    int i, j, l;
+    for (i=begin; i<end; i++){
+        memset(pass->out[i], 0, pass->cols_B * sizeof(double));
+        for (j=0; j<pass->cols_A; j++){
+            w = pass->A[i][j];
+            for (l=0; l<pass->cols_B; l++) pass->out[i][l] += w * pass->B[j][l];
+        }
+    }
+}
+
+/**
+ * @brief Operator multiply of a dense W, out = W*H, one parallel_for slice of rows per thread
+ * 
+ * @param W The operator, its data is the double** matrix
+ * @param H A n x k matrix
+ * @param k Number of columns in H
+ * @param out A n x k matrix, overwritten with W*H
+ */
+static void dense_multiply(const w_operator* W, double** H, int k, double** out){
+    product_pass pass;
+    pass.A = (double**)W->data, pass.B = H, pass.cols_A = W->n, pass.cols_B = k, pass.out = out;
+    parallel_for(W->n, dense_rows, &pass);
+}
+
+/**
+ * @brief Wraps a dense n x n W as a generic operator
+ * 
+ * @param W The normalized similarity matrix
+ * @param n Number of rows and columns in W
+ * @return w_operator The operator
+ */
+w_operator dense_w_operator(double** W, int n){
+    w_operator op;
+    op.data = W, op.multiply = dense_multiply, op.n = n;
+    return op;
+}
+
+/**
+ * @brief Same multiplicative rule as update_H for a W given as an operator; HH^TH is
+ * computed as H(H^TH) so that no n x n temporary is ever allocated
+ * 
+ * @param H Current decomposition matrix
+ * @param W The n x n normalized similarity matrix as an operator
+ * @param k Number of columns in H
+ * @return double** new_H The updated matrix
+ */
+double** update_H_operator(double** H, const w_operator* W, int k){
+    int n = W->n, i, j, l;
+    double** WxH = create_matrix(n, k);
+    double** HtH = create_matrix(k, k);
+    double** new_H = create_matrix(n, k);
+    double hhh;
+
+    W->multiply(W, H, k, WxH);
+    for (i=0; i<n; i++){
+        for (j=0; j<k; j++){
+            for (l=0; l<k; l++) HtH[j][l] += H[i][j] * H[i][l];
+        }
+    }
+    for (i=0; i<n; i++){
+        for (j=0; j<k; j++){
+            hhh = 0;
+            for (l=0; l<k; l++) hhh += H[i][l] * HtH[l][j];
+            if (WxH[i][j] < 0) WxH[i][j] = 0; /* an approximate W may have small negative entries */
+            new_H[i][j] = H[i][j] * (0.5 + 0.5 * (WxH[i][j] / hhh));
+        }
+    }
+    free_matrix(WxH, n), free_matrix(HtH, k);
+    return new_H;
+}
+
+/**
+ * @brief optimize_H for a W given as an operator (matrix-free, low-rank, ...)
+ * 
+ * @param H Initialized decomposition matrix, freed by this function
+ * @param W The n x n normalized similarity matrix as an operator
+ * @param k Number of columns in H
+ * @param iterations Output, number of updates performed (may be NULL)
+ * @return double** H Updated matrix
+ */
+double** optimize_H_operator(double** H, const w_operator* W, int k, int* iterations){
+    int n = W->n, iter = 0, i, j;
+    double** new_H = H;
+    double delta = 0, diff;
+    stats_timer timer;
+    while (iter < MAX_ITER){
+        timer = stats_begin(STAGE_UPDATE);
+        new_H = update_H_operator(H, W, k);
+        stats_end(timer);
         iter++;
+        timer = stats_begin(STAGE_CONVERGENCE);
+        delta = 0;
+        for (i=0; i<n; i++){
+            for (j=0; j<k; j++){
+                diff = new_H[i][j] - H[i][j];
+                delta += diff * diff;
+            }
+        }
+        stats_end(timer);
+        free_matrix(H, n);
+        if (delta < EPSILON) break;
+        H = new_H;
     }
+    stats_loop(iter, delta);
+    if (iterations != NULL) *iterations = iter;
     return new_H;
 }
 
 /**
- * @brief Gets a data matrix, goal, n and d and returns the desired matrix based on the goal
+ * @brief Calculates the objective ||W - HH^T||^2 for a W given as an operator, as
+ * ||W||^2 - 2tr(H^TWH) + tr((H^TH)^2) with a single W*H
+ * 
+ * @param H Decomposition matrix
+ * @param W The n x n normalized similarity matrix as an operator
+ * @param k Number of columns in H
+ * @param w_norm2 ||W||^2
+ * @return double The objective value
+ */
+double operator_objective(double** H, const w_operator* W, int k, double w_norm2){
+    int n = W->n, i, j, l;
+    double** WxH = create_matrix(n, k);
+    double** HtH = create_matrix(k, k);
+    double cross = 0, gram = 0;
+
+    W->multiply(W, H, k, WxH);
+    for (i=0; i<n; i++){
+        for (j=0; j<k; j++){
+            cross += H[i][j] * WxH[i][j];
+            for (l=0; l<k; l++) HtH[j][l] += H[i][j] * H[i][l];
+        }
+    }
+    for (j=0; j<k; j++){
+        for (l=0; l<k; l++) gram += HtH[j][l] * HtH[j][l];
+    }
+    free_matrix(WxH, n), free_matrix(HtH, k);
+    return w_norm2 - 2 * cross + gram;
+}
+
+/**
+ * @brief Calculates sqrt(a^2 + b^2) without overflow or destructive underflow
+ * 
+ * @param a First number
+ * @param b Second number
+ * @return double The hypotenuse
+ */
+static double hypotenuse(double a, double b){
+    double r;
+    if (fabs(a) > fabs(b)){
+        r = b / a;
+        return fabs(a) * sqrt(1 + r * r);
+    }
+    if (b == 0) return 0;
+    r = a / b;
+    return fabs(b) * sqrt(1 + r * r);
+}
+
+/**
+ * @brief Householder reduction of the symmetric matrix stored in V to tridiagonal form
+ * (the tred2 routine of EISPACK), V is replaced by the accumulated transformation
+ * 
+ * @param V The n x n symmetric matrix, overwritten with the orthogonal transformation
+ * @param n Number of rows and columns in V
+ * @param d Output, the diagonal of the tridiagonal matrix
+ * @param e Output, the subdiagonal of the tridiagonal matrix (e[0] is unused)
+ */
+static void tridiagonalize(double** V, int n, double* d, double* e){
+    int i, j, k;
+    double scale, f, g, h, hh;
+
+    for (j=0; j<n; j++) d[j] = V[n-1][j];
+    for (i=n-1; i>0; i--){
+        scale = 0, h = 0;
+        for (k=0; k<i; k++) scale += fabs(d[k]);
+        if (scale == 0){
+            e[i] = d[i-1];
+            for (j=0; j<i; j++){
+                d[j] = V[i-1][j], V[i][j] = 0, V[j][i] = 0;
+            }
+        } else {
+            for (k=0; k<i; k++){
+                d[k] /= scale;
+                h += d[k] * d[k];
+            }
+            f = d[i-1];
+            g = f > 0 ? -sqrt(h) : sqrt(h);
+            e[i] = scale * g;
+            h -= f * g;
+            d[i-1] = f - g;
+            for (j=0; j<i; j++) e[j] = 0;
+            for (j=0; j<i; j++){
+                f = d[j];
+                V[j][i] = f;
+                g = e[j] + V[j][j] * f;
+                for (k=j+1; k<=i-1; k++){
+                    g += V[k][j] * d[k];
+                    e[k] += V[k][j] * f;
+                }
+                e[j] = g;
+            }
+            f = 0;
+            for (j=0; j<i; j++){
+                e[j] /= h;
+                f += e[j] * d[j];
+            }
+            hh = f / (h + h);
+            for (j=0; j<i; j++) e[j] -= hh * d[j];
+            for (j=0; j<i; j++){
+                f = d[j], g = e[j];
+                for (k=j; k<=i-1; k++) V[k][j] -= (f * e[k] + g * d[k]);
+                d[j] = V[i-1][j];
+                V[i][j] = 0;
+            }
+        }
+        d[i] = h;
+    }
+    for (i=0; i<n-1; i++){
+        V[n-1][i] = V[i][i];
+        V[i][i] = 1;
+        h = d[i+1];
+        if (h != 0){
+            for (k=0; k<=i; k++) d[k] = V[k][i+1] / h;
+            for (j=0; j<=i; j++){
+                g = 0;
+                for (k=0; k<=i; k++) g += V[k][i+1] * V[k][j];
+                for (k=0; k<=i; k++) V[k][j] -= g * d[k];
+            }
+        }
+        for (k=0; k<=i; k++) V[k][i+1] = 0;
+    }
+    for (j=0; j<n; j++){
+        d[j] = V[n-1][j];
+        V[n-1][j] = 0;
+    }
+    V[n-1][n-1] = 1;
+    e[0] = 0;
+}
+
+/**
+ * @brief Diagonalizes a symmetric tridiagonal matrix by the implicit QL method
+ * (the tql2 routine of EISPACK), accumulating the rotations into V
+ * 
+ * @param V The transformation from tridiagonalize, overwritten with the eigenvectors (as columns)
+ * @param n Number of rows and columns in V
+ * @param d The diagonal, overwritten with the eigenvalues
+ * @param e The subdiagonal, destroyed
+ */
+static void tridiagonal_ql(double** V, int n, double* d, double* e){
+    int i, k, l, m, iter;
+    double f = 0, tst1 = 0, g, p, r, dl1, h, c, c2, c3, el1, s, s2;
+
+    for (i=1; i<n; i++) e[i-1] = e[i];
+    e[n-1] = 0;
+    for (l=0; l<n; l++){
+        if (fabs(d[l]) + fabs(e[l]) > tst1) tst1 = fabs(d[l]) + fabs(e[l]);
+        m = l;
+        while (m < n - 1 && fabs(e[m]) > DBL_EPSILON * tst1) m++;
+        if (m > l){
+            iter = 0;
+            do {
+                iter++;
+                g = d[l];
+                p = (d[l+1] - g) / (2 * e[l]);
+                r = hypotenuse(p, 1);
+                if (p < 0) r = -r;
+                d[l] = e[l] / (p + r);
+                d[l+1] = e[l] * (p + r);
+                dl1 = d[l+1];
+                h = g - d[l];
+                for (i=l+2; i<n; i++) d[i] -= h;
+                f += h;
+                p = d[m];
+                c = 1, c2 = 1, c3 = 1, el1 = e[l+1], s = 0, s2 = 0;
+                for (i=m-1; i>=l; i--){
+                    c3 = c2, c2 = c, s2 = s;
+                    g = c * e[i];
+                    h = c * p;
+                    r = hypotenuse(p, e[i]);
+                    e[i+1] = s * r;
+                    s = e[i] / r;
+                    c = p / r;
+                    p = c * d[i] - s * g;
+                    d[i+1] = h + s * (c * g + s * d[i]);
+                    for (k=0; k<n; k++){
+                        h = V[k][i+1];
+                        V[k][i+1] = s * V[k][i] + c * h;
+                        V[k][i] = c * V[k][i] - s * h;
+                    }
+                }
+                p = -s * s2 * c3 * el1 * e[l] / dl1;
+                e[l] = s * p;
+                d[l] = c * p;
+            } while (fabs(e[l]) > DBL_EPSILON * tst1 && iter < EIGEN_MAX_ITER);
+        }
+        d[l] += f;
+        e[l] = 0;
+    }
+}
+
+/**
+ * @brief Eigen-decomposition of a symmetric matrix: Householder tridiagonalization
+ * followed by the implicit QL method, O(n^3)
+ * 
+ * @param S A symmetric n x n matrix (not modified)
+ * @param n Number of rows and columns in S
+ * @param values Output, the n eigenvalues in decreasing order
+ * @param vectors Output n x n matrix, column i is the eigenvector of values[i]
+ */
+void symmetric_eigen(double** S, int n, double* values, double** vectors){
+    double *e, tmp;
+    int i, j, best;
+
+    if (n <= 0) return;
+    e = malloc(n * sizeof(double));
+    if (check_pointer(e)) exit(1);
+    for (i=0; i<n; i++) memcpy(vectors[i], S[i], n * sizeof(double));
+    tridiagonalize(vectors, n, values, e);
+    tridiagonal_ql(vectors, n, values, e);
+    free(e);
+
+    for (i=0; i<n; i++){ /* selection sort, decreasing eigenvalues */
+        best = i;
+        for (j=i+1; j<n; j++){
+            if (values[j] > values[best]) best = j;
+        }
+        if (best == i) continue;
+        tmp = values[i], values[i] = values[best], values[best] = tmp;
+        for (j=0; j<n; j++){
+            tmp = vectors[j][i], vectors[j][i] = vectors[j][best], vectors[j][best] = tmp;
+        }
+    }
+}
+
+/**
+ * @brief Gets a data matrix, goal, n and d and returns the desired matrix based on the goal.
+ * With SYMNMF_CACHE_DIR set, the matrices come from the disk cache (see cached_goal_packed).
+ * The result comes from create_placed_matrix, and W is normalized in place over A.
  * 
  * @param data_matrix a matrix with n datapoints of size d
+ * @param weights Weight of every datapoint (NULL for unit weights)
  * @param goal The type of matrix to be calculated
  * @param n Number of rows
  * @param d Number of columns
- * @return double** The desired matrix based on the given goal
+ * @return double** The desired matrix based on the given goal, freed with free_placed_matrix
+ * (NULL for an unknown goal)
  */
-double** compute_goals(double **data_matrix, const char *goal, int n, int d) {
-    double **A, **W, **D; 
+double** compute_goals(double **data_matrix, double *weights, const char *goal, int n, int d) {
+    double **A, **D, *degree; 
+    int i;
     
-    A = sym(data_matrix, n, d);
+    if (disk_cache_enabled()) return cached_goal(data_matrix, weights, goal, n, d);
+    if (strcmp(goal, "sym") != 0 && strcmp(goal, "ddg") != 0 && strcmp(goal, "norm") != 0) return NULL;
+    A = create_placed_matrix(n, n);
+    sym_into(data_matrix, weights, n, d, A);
     if (strcmp(goal, "sym") == 0) {
         return A;
     }
     
-    D = ddg(A, n);
+    degree = malloc((n > 0 ? n : 1) * sizeof(double));
+    if (check_pointer(degree)) exit(1);
+    ddg_into(A, n, degree);
     if (strcmp(goal, "ddg") == 0) {
-        free_matrix(A, n);
+        D = create_placed_matrix(n, n);
+        for (i=0; i<n; i++) D[i][i] = degree[i];
+        free_placed_matrix(A, n, n), free(degree);
         return D;
     }
 
-    W = norm(D, A, n);
-    free_matrix(A, n), free_matrix(D, n);
-    if (strcmp(goal, "norm") != 0){
-        free_matrix(W, n);
-        return NULL;
-    }
-    return W; 
+    norm_into(A, degree, n, A);
+    free(degree);
+    return A; 
 }
 
+/**
+ * @brief Same as compute_goals followed by print_matrix, but A and W are kept in packed
+ * symmetric form (n(n+1)/2 entries, W overwrites A) and D as a vector of degrees
+ * 
+ * @param data_matrix a matrix with n datapoints of size d
+ * @param weights Weight of every datapoint (NULL for unit weights)
+ * @param goal The type of matrix to be printed
+ * @param n Number of rows
+ * @param d Number of columns
+ * @return int 0 on success, 1 for an unknown goal or an allocation failure
+ */
+int print_goal(double **data_matrix, double *weights, const char *goal, int n, int d) {
+    packed_matrix A;
+    stats_timer timer;
+    double *degree;
+    int i, j;
+
+    if (cached_goal_packed(&A, &degree, data_matrix, weights, n, d, goal)) return 1;
+    timer = stats_begin(STAGE_OUTPUT);
+    if (strcmp(goal, "ddg") == 0) {
+        for (i=0; i<n; i++){
+            for (j=0; j<n; j++) printf(j < n - 1 ? "%.4f," : "%.4f\n", i == j ? degree[i] : 0.0);
+        }
+    } else {
+        print_packed_matrix(&A);
+    }
+    stats_end(timer);
+    free_packed_matrix(&A), free(degree);
+    return 0;
+}
 
 
+#ifndef SYMNMF_NO_MAIN
 int main(int argc, char** argv){
-    char *goal, *file_name;
-    int d, n;
-    double **result_matrix, **data_matrix;
+    char *goal = NULL, *file_name = NULL, *socket_path = NULL;
+    int d, n, i, status, stats_json = -1, cache_mb = SERVER_DEFAULT_CACHE_MB;
+    double **data_matrix;
+    stats_timer timer;
     FILE *file;
-    if (argc != 3){
+
+    for (i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc){
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc){
+            cache_mb = atoi(argv[++i]);
+            if (cache_mb <= 0){
+                fprintf(stderr, "An Error Has Occurred\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats-json") == 0){
+            stats_json = strcmp(argv[i], "--stats-json") == 0;
+        } else if (goal == NULL) {
+            goal = argv[i];
+        } else if (file_name == NULL) {
+            file_name = argv[i];
+        } else {
+            goal = NULL;
+            break;
+        }
+    }
+    if (socket_path != NULL){
+        if (serve(socket_path, (size_t)cache_mb * 1024 * 1024) != 0){
+            fprintf(stderr, "An Error Has Occurred\n");
+            return 1;
+        }
+        return 0;
+    }
+    if (goal == NULL || file_name == NULL){
         fprintf(stderr, "An Error Has Occured\n");
         return 1;
     }
-    goal = argv[1];
-    file_name = argv[2];
 
+    if (stats_json >= 0) stats_enable(1);
+    timer = stats_begin(STAGE_PARSE);
     file = fopen(file_name, "r");
     if (!file) {
         fprintf(stderr, "An Error Has Occurred\n");
@@ -448,14 +1662,15 @@ int main(int argc, char** argv){
     d = compute_d(file), n = compute_n(file);
     data_matrix = compute_data_matrix(file,n,d);
     fclose(file);
+    stats_end(timer);
 
-    result_matrix = compute_goals(data_matrix, goal, n, d);
-    if(check_pointer(result_matrix)){
+    status = print_goal(data_matrix, NULL, goal, n, d);
+    free_matrix(data_matrix, n);
+    if (stats_json >= 0) stats_print(stderr, stats_json);
+    if (status != 0){
         fprintf(stderr, "An Error Has Occurred\n");
-        free_matrix(data_matrix,n);
         return 1;
     }
-    print_matrix(result_matrix, n, n);
-    free_matrix(result_matrix, n), free_matrix(data_matrix, n);
     return 0;
 }
+#endif
@@ -6,10 +6,67 @@
 #include <math.h>
 #include <string.h>
 
+#include "arena.h"
+#include "coreset.h"
+
 /* Constants */
 #define ERROR_MESSAGE "An Error Has Occurred"
 #define MAX_ITER 300
 #define EPSILON 1e-4
+#define PGD_MAX_BACKTRACK 30
+#define PGD_ARMIJO 1e-4
+#define M_PI_VALUE 3.14159265358979323846
+#define EIGEN_MAX_ITER 100
+#define ACTIVE_FREEZE_RATIO 1e-2
+#define ACTIVE_RECHECK_INTERVAL 10
+#define OBJECTIVE_RTOL 1e-4
+
+/* W*H and the k x k Gram matrix H^TH of an iterate, from which the objective is
+   ||W||^2 - 2tr(H^TWH) + tr((H^TH)^2); the loop and the update rules share them */
+typedef struct symnmf_products {
+    double** WxH;
+    double** HtH;
+    double w_norm2; /* ||W||^2 */
+    int valid;      /* 0 once H changed since they were computed */
+} symnmf_products;
+
+/* A symNMF update rule: gets H, W and the valid products of H and writes the updated H into
+   new_H (n x k, not H itself), its temporaries come from scratch and are released before it
+   returns; it sets products->valid when it leaves them describing the new H */
+typedef void (*symnmf_update)(double** H, double** W, int n, int k, symnmf_products* products, double** new_H, arena* scratch);
+
+/* A full symNMF loop: gets H and W, runs until convergence, leaving the result in H and
+   returning H, and reports the number of updates and, when trace is not NULL, the objective of
+   every iterate (MAX_ITER + 1 entries) */
+typedef double** (*symnmf_optimize)(double** H, double** W, int n, int k, double* trace, int* iterations);
+
+/* When optimize_H_controlled stops */
+typedef enum stop_rule {
+    STOP_STEP,      /* ||H_new - H||^2 < EPSILON */
+    STOP_OBJECTIVE, /* relative objective decrease below OBJECTIVE_RTOL */
+    STOP_BOTH       /* both of the above */
+} stop_rule;
+
+/* A named update rule that optimize_H_with can run, optionally with its own loop */
+typedef struct symnmf_solver {
+    const char* name;
+    symnmf_update update;     /* one step of the solver, NULL when only its own loop implements it */
+    symnmf_optimize optimize; /* NULL runs update through optimize_H_with */
+    stop_rule stop;           /* when a loop driving update stops */
+} symnmf_solver;
+
+struct w_operator;
+struct run_control;
+
+/* Computes out = W*H for an implicitly stored n x n W */
+typedef void (*w_multiply)(const struct w_operator* W, double** H, int k, double** out);
+
+/* An n x n W known only through its product with n x k matrices */
+typedef struct w_operator {
+    const void* data;
+    w_multiply multiply;
+    int n;
+} w_operator;
 
 /* Function declarations from symnmf.c */
 int compute_d(FILE* fp);
@@ -21,13 +78,32 @@ void free_matrix(double** matrix, int n);
 void print_matrix(double** matrix, int rows, int columns);
 double vector_distance(double *x, double *y, int d);
 double** sym(double** mat, int n, int d);
+double** sym_weighted(double** mat, double* weights, int n, int d);
 double** ddg(double** A, int n);
 double** norm(double** D, double** A, int n);
 double** transpose_matrix(double** mat, int rows, int cols);
 double** multiply_matrices(double** A, double** B, int rows_A, int cols_A, int rows_B, int cols_B);
 double** update_H(double** H, double** W, int n, int k);
+void update_H_scratch(double** H, double** W, int n, int k, symnmf_products* products, double** new_H, arena* scratch);
 double frobenius_norm(double** new_H, double** H, int n, int k);
 double** optimize_H(double** H, double** W, int n, int k);
-double** compute_goals(double **data_matrix, const char *goal, int n, int d);
+double symnmf_objective(double** W, double** H, int n, int k);
+void hals_update_H(double** H, double** W, int n, int k, symnmf_products* products, double** new_H, arena* scratch);
+void pgd_update_H(double** H, double** W, int n, int k, symnmf_products* products, double** new_H, arena* scratch);
+double** optimize_H_hals(double** H, double** W, int n, int k, double* trace, int* iterations);
+double** optimize_H_pgd(double** H, double** W, int n, int k, double* trace, int* iterations);
+const symnmf_solver* find_solver(const char* name);
+double** optimize_H_with(double** H, double** W, int n, int k, symnmf_update update, int* iterations, arena* scratch);
+double** optimize_H_controlled(double** H, double** W, int n, int k, symnmf_update update, int rule, int* iterations, arena* scratch, struct run_control* control, double* trace);
+double** optimize_H_solver(double** H, double** W, int n, int k, const symnmf_solver* solver, int* iterations, arena* scratch);
+double** optimize_H_active(double** H, double** W, int n, int k, double* trace, int* iterations);
+int find_stop_rule(const char* name);
+w_operator dense_w_operator(double** W, int n);
+double** update_H_operator(double** H, const w_operator* W, int k);
+double** optimize_H_operator(double** H, const w_operator* W, int k, int* iterations);
+double operator_objective(double** H, const w_operator* W, int k, double w_norm2);
+void symmetric_eigen(double** S, int n, double* values, double** vectors);
+double** compute_goals(double **data_matrix, double *weights, const char *goal, int n, int d);
+int print_goal(double **data_matrix, double *weights, const char *goal, int n, int d);
 
 #endif 
@@ -1,8 +1,63 @@
 import sys
+import json
+import time
+import signal
 import numpy as np
 import symnmfmodule
 
-np.random.seed(1234)
+SEED = 1234 #seed of the random initial H, recorded in checkpoints
+np.random.seed(SEED)
+
+SOLVERS = ['mu', 'mu-active', 'hals', 'pgd'] #update rules implemented by the extension
+STAGE_TIMES = None #Python-side stage times (parse and output) while --stats is on
+STAGES = ['parse', 'sym', 'ddg', 'norm', 'update', 'convergence', 'output'] #in pipeline order
+CHECKPOINT_EVERY = 25 #default iterations between two checkpoints of H
+
+#Command line options: name -> (cast, check, default, modes). A flag has no cast and defaults to False,
+#a value option is followed by its value, which must pass check. An option is accepted only in the
+#listed modes. A mode option selects the mode it lists, MODE_OPTIONS gives their precedence and any
+#second mode option is rejected since its mode is not the selected one.
+ALL_MODES = ('symnmf', 'goal', 'batch', 'sweep', 'restarts', 'multilevel', 'nystrom', 'packed', 'matrix_free')
+OPTIONS = {
+    '--stats': (None, None, False, ALL_MODES), #print the run statistics to stderr
+    '--stats-json': (None, None, False, ALL_MODES), #the same, as JSON
+    '--batch': (None, None, False, ('batch',)), #the file is a manifest of datasets, all solved in one call
+    '--k-sweep': (lambda x: [int(k) for k in x.split(',')], lambda ks: min(ks) > 0, None, ('sweep',)), #k values sharing one W
+    '--restarts': (int, lambda x: x > 0, None, ('restarts',)), #independent runs on one W, the best one is printed
+    '--multilevel': (None, None, False, ('multilevel',)), #coarsen, solve and refine
+    '--nystrom': (int, lambda x: x > 0, None, ('nystrom',)), #low-rank W from this many landmarks
+    '--packed': (None, None, False, ('packed',)), #keep only the lower triangle of W
+    '--matrix-free': (None, None, False, ('matrix_free',)), #never materialize W
+    '--coreset': (int, lambda x: x > 0, None, ('symnmf',)), #size of a weighted summary of the points
+    '--solver': (str, lambda x: x in SOLVERS, 'mu', ('symnmf',)), #update rule
+    '--init': (str, lambda x: x in ('random', 'spectral'), 'random', ('symnmf',)), #initialization of H
+    '--stop': (str, lambda x: x in ('step', 'objective', 'both'), None, ('symnmf',)), #stopping rule (not for mu-active)
+    '--objective-trace': (None, None, False, ('symnmf',)), #print the objective of every iteration
+    '--compare-solvers': (None, None, False, ('symnmf',)), #report every solver side by side
+    '--compare-init': (None, None, False, ('symnmf',)), #report both initializations side by side
+    '--budget': (float, lambda x: x > 0, None, ('symnmf',)), #seconds after which symnmf stops and prints the H reached
+    '--checkpoint': (str, None, None, ('symnmf',)), #file of periodic snapshots of H, resumed from when present
+    '--checkpoint-every': (int, lambda x: x >= 0, CHECKPOINT_EVERY, ('symnmf',)), #iterations between snapshots
+    '--checkpoint-w': (None, None, False, ('symnmf',)), #also store W, so a resumed run skips computing it
+}
+MODE_OPTIONS = ['--batch', '--k-sweep', '--restarts', '--multilevel', '--nystrom', '--packed', '--matrix-free']
+GOALS = ('sym', 'ddg', 'norm') #the goals of the goal mode, every other mode computes symnmf (batch: any of the four)
+
+def record_stage(name, wall, cpu):
+    """
+    Adds the time of one call of a Python-side stage to STAGE_TIMES, when statistics are on.
+
+    Parameters:
+    name (str): The stage, named as in the extension's statistics.
+    wall (float): The perf_counter value at the start of the call.
+    cpu (float): The process_time value at the start of the call.
+    """
+    if STAGE_TIMES is None:
+        return
+    stage = STAGE_TIMES.setdefault(name, {'wall': 0.0, 'cpu': 0.0, 'calls': 0})
+    stage['wall'] += time.perf_counter() - wall
+    stage['cpu'] += time.process_time() - cpu
+    stage['calls'] += 1
 
 def compute_data_matrix(filename):
     """
@@ -14,12 +69,14 @@ def compute_data_matrix(filename):
     Returns:
     matrix: A 2D list of numbers.
     """
+    wall, cpu = time.perf_counter(), time.process_time()
     file = open(filename, 'r')
     matrix = []
     for row in file:
         matrix.append([float(x) for x in row.split(",")])
 
     file.close()
+    record_stage('parse', wall, cpu)
     return matrix
 
 def print_matrix(matrix):
@@ -29,8 +86,111 @@ def print_matrix(matrix):
     Parameters:
     matrix (list): A 2D list of numbers.
     """
+    wall, cpu = time.perf_counter(), time.process_time()
     for row in matrix:
         print(",".join(f"{x:.4f}" for x in row))
+    record_stage('output', wall, cpu)
+
+def parse_arguments(argv):
+    """
+    Splits the command line into its positional arguments and options, picks the mode and
+    checks every option against OPTIONS.
+
+    Parameters:
+    argv (list): The arguments after the script name.
+
+    Returns:
+    mode, k, goal, file_name, options: The mode, the positional arguments (k is None in the
+    sweep mode) and the value of every option, its default when absent.
+    """
+    given, positional = {}, []
+    i = 0
+    while i < len(argv):
+        name = argv[i]
+        if not name.startswith('--'):
+            positional.append(name)
+        elif name not in OPTIONS:
+            raise ValueError(f"unknown option {name}")
+        elif OPTIONS[name][0] is None:
+            given[name] = True
+        else:
+            cast, check = OPTIONS[name][:2]
+            if i + 1 >= len(argv):
+                raise ValueError(f"{name} needs a value")
+            i += 1
+            try:
+                given[name] = cast(argv[i])
+            except ValueError:
+                raise ValueError(f"invalid value {argv[i]} for {name}")
+            if check is not None and not check(given[name]):
+                raise ValueError(f"invalid value {argv[i]} for {name}")
+        i += 1
+
+    mode = next((OPTIONS[name][3][0] for name in MODE_OPTIONS if name in given), None)
+    if mode == 'sweep': #the listed k values take the place of the positional k
+        if len(positional) != 2:
+            raise ValueError("--k-sweep replaces k, give only the goal and the file")
+        positional.insert(0, None)
+    elif len(positional) != 3:
+        raise ValueError("expected k, the goal and the file")
+    k, goal, file_name = positional
+    if k is not None:
+        try:
+            k = int(k)
+        except ValueError:
+            raise ValueError(f"invalid number of clusters {k}")
+    if mode is None:
+        mode = 'goal' if goal in GOALS else 'symnmf'
+    if goal != 'symnmf' and not (mode == 'goal' or (mode == 'batch' and goal in GOALS)):
+        raise ValueError(f"invalid goal {goal}")
+    for name in given:
+        if mode not in OPTIONS[name][3]:
+            raise ValueError(f"{name} cannot be used with the {goal} goal" if mode == 'goal'
+                             else f"{name} cannot be used in the {mode} mode")
+    options = {name: given.get(name, OPTIONS[name][2]) for name in OPTIONS}
+    return mode, k, goal, file_name, options
+
+def find_checkpoint(path, n, k, dataMatrix):
+    """
+    Looks for a symnmf checkpoint that a run on n points with k clusters can resume from.
+
+    Parameters:
+    path (str): The checkpoint file.
+    n (int): Number of datapoints.
+    k (int): Number of clusters.
+    dataMatrix (list): The datapoints, a checkpoint saved from other points is not resumed.
+
+    Returns:
+    The checkpoint_info dict of the file, or None when it is missing, invalid or of another run.
+    """
+    info = symnmfmodule.checkpoint_info(path, dataMatrix)
+    if info is None or info['kind'] != 'symnmf' or info['rows'] != n or info['columns'] != k:
+        return None
+    return info
+
+def wait_for_job(job, checkpoint):
+    """
+    Waits for a symnmf job. Ctrl-C or SIGTERM cancels it; with a checkpoint the job's last H is
+    saved before exiting, so that running the same command again resumes from it.
+
+    Parameters:
+    job (symnmfmodule.Job): The running job.
+    checkpoint (str): The checkpoint file, or None.
+
+    Returns:
+    The H of the job.
+    """
+    previous = signal.signal(signal.SIGTERM, signal.default_int_handler)
+    try:
+        return job.result()
+    except KeyboardInterrupt:
+        if checkpoint is None:
+            raise
+        job.result() #the cancelled job saves its H when it stops
+        print(f"interrupted, checkpoint saved at iteration {job.poll()['iteration']}", file=sys.stderr)
+        exit(1)
+    finally:
+        signal.signal(signal.SIGTERM, previous)
 
 def initialize_H(n, k, W):
     """
@@ -44,7 +204,20 @@ def initialize_H(n, k, W):
     Returns:
     H: A 2D list representing the initialized matrix H.
     """
-    m = np.mean(W)
+    return initialize_H_from_mean(n, k, np.mean(W))
+
+def initialize_H_from_mean(n, k, m):
+    """
+    Initializes matrix H of size n X k with random values bounded by 2*sqrt(m/k).
+
+    Parameters:
+    n (int): Number of rows in matrix H.
+    k (int): Number of columns in matrix H.
+    m (float): The mean of the normalized similarity matrix W.
+
+    Returns:
+    H: A 2D list representing the initialized matrix H.
+    """
     upper_bound = 2 * np.sqrt(m / k)
 
     H = np.random.uniform(0, upper_bound, (n, k))
@@ -53,37 +226,330 @@ def initialize_H(n, k, W):
 
     return H.tolist()
 
+def compare_solvers(W, H, n, k):
+    """
+    Runs every symNMF solver from the same initial H and prints their iteration counts
+    and final objective values side by side to stderr. Since the solvers stop at different
+    local minima, each is also measured at one common objective, the highest final objective
+    (reached by every solver): the iterations it needed to get there.
+
+    Parameters:
+    W (list): The normalized similarity matrix.
+    H (list): The initial decomposition matrix.
+    n (int): Number of rows in H.
+    k (int): Number of columns in H.
+    """
+    infos = [symnmfmodule.symnmf(W, H, n, k, solver, True, None, True)[1] for solver in SOLVERS]
+    target = max(info['objective_trace'][-1] for info in infos)
+    print("solver,iterations,objective,target_objective,iterations_to_target", file=sys.stderr)
+    for solver, info in zip(SOLVERS, infos):
+        trace = info['objective_trace']
+        to_target = next(i for i, objective in enumerate(trace) if objective <= target)
+        print(f"{solver},{info['iterations']},{trace[-1]:.6f},{target:.6f},{to_target}", file=sys.stderr)
+
+def compare_inits(W, n, k, solver):
+    """
+    Runs symNMF from the random and from the spectral initialization and prints the
+    iteration counts and final objective values side by side to stderr.
+
+    Parameters:
+    W (list): The normalized similarity matrix.
+    n (int): Number of rows in H.
+    k (int): Number of columns in H.
+    solver (str): The update rule to use.
+    """
+    state = np.random.get_state() #keep the random H of the actual run unchanged
+    inits = [('random', initialize_H(n, k, W)), ('spectral', symnmfmodule.spectral_init(W, k))]
+    np.random.set_state(state)
+    print("init,iterations,objective", file=sys.stderr)
+    for name, H in inits:
+        _, info = symnmfmodule.symnmf(W, H, n, k, solver, True)
+        print(f"{name},{info['iterations']},{info['objective']:.6f}", file=sys.stderr)
+
+def print_objective_trace(trace):
+    """
+    Prints the objective ||W - HH^T||^2 of every iteration to stderr.
+
+    Parameters:
+    trace (list): The objective of the initial H followed by the one of every update.
+    """
+    print("iteration,objective", file=sys.stderr)
+    for i, objective in enumerate(trace):
+        print(f"{i},{objective:.6f}", file=sys.stderr)
+
+def read_manifest(manifest, k):
+    """
+    Reads a batch manifest: one dataset per line, "path" or "path,k", blank lines skipped.
+
+    Parameters:
+    manifest (str): The path to the manifest.
+    k (int): The number of clusters of the lines without their own.
+
+    Returns:
+    paths, ks: The dataset paths and their numbers of clusters, in manifest order.
+    """
+    paths, ks = [], []
+    with open(manifest, 'r') as file:
+        for line in file:
+            if not line.strip():
+                continue
+            path, _, own_k = line.strip().partition(',')
+            paths.append(path)
+            ks.append(int(own_k) if own_k else k)
+    return paths, ks
+
+def run_batch(k, goal, manifest):
+    """
+    Runs one goal on every dataset of a manifest in a single extension call and prints the
+    results in manifest order, separated by blank lines. The files are handed over unparsed.
+    For symnmf the initial H of every dataset is drawn by the extension, not by numpy.
+
+    Parameters:
+    k (int): The default number of clusters.
+    goal (str): sym, ddg, norm or symnmf.
+    manifest (str): The path to the manifest.
+
+    Returns:
+    failed: True when some dataset could not be processed (its result is the error message).
+    """
+    paths, ks = read_manifest(manifest, k)
+    wall, cpu = time.perf_counter(), time.process_time()
+    texts = []
+    for path in paths:
+        try:
+            with open(path, 'rb') as file:
+                texts.append(file.read())
+        except OSError: #reported like any other dataset that cannot be parsed
+            texts.append(b'')
+    record_stage('parse', wall, cpu)
+    results = symnmfmodule.batch(goal, texts, ks)
+    for i, result in enumerate(results):
+        if i > 0:
+            print()
+        if result is None:
+            print("An Error Has Occurred")
+        else:
+            print_matrix(result)
+    return None in results
+
+def print_stats(as_json):
+    """
+    Prints the statistics of the run to stderr: the extension's stages merged with the
+    Python-side parse and output, the last loop's iterations and final delta, and memory.
+
+    Parameters:
+    as_json (bool): Print a single JSON object instead of a table.
+    """
+    stats = symnmfmodule.get_stats()
+    for name, times in STAGE_TIMES.items():
+        stage = stats['stages'].setdefault(name, {'wall': 0.0, 'cpu': 0.0, 'calls': 0})
+        for key in times:
+            stage[key] += times[key]
+    stats['stages'] = {name: stats['stages'][name] for name in STAGES if name in stats['stages']}
+    if as_json:
+        print(json.dumps(stats), file=sys.stderr)
+        return
+    for name, stage in stats['stages'].items():
+        print(f"{name:<12} wall {stage['wall']:10.6f}s  cpu {stage['cpu']:10.6f}s  calls {stage['calls']}", file=sys.stderr)
+    print(f"iterations   {stats['iterations']}", file=sys.stderr)
+    print(f"final_delta  {stats['final_delta']:.6e}", file=sys.stderr)
+    print(f"allocations  {stats['allocations']} ({stats['allocated_bytes']} bytes)", file=sys.stderr)
+    print(f"peak_rss     {stats['peak_rss_kb']} kB", file=sys.stderr)
+
+def run_goal(goal, dataMatrix):
+    """
+    Prints the sym, ddg or norm matrix of the datapoints.
+
+    Parameters:
+    goal (str): sym, ddg or norm.
+    dataMatrix (list): The datapoints.
+    """
+    goals = {'sym': symnmfmodule.sym, 'ddg': symnmfmodule.ddg, 'norm': symnmfmodule.norm}
+    print_matrix(goals[goal](dataMatrix))
+
+def run_sweep(dataMatrix, ks):
+    """
+    Runs symNMF for several k on one W, each k warm-started from the previous one, and prints
+    the iterations and final objective of every k.
+
+    Parameters:
+    dataMatrix (list): The datapoints.
+    ks (list): The numbers of clusters, each below the number of datapoints.
+    """
+    if max(ks) >= len(dataMatrix):
+        raise ValueError("--k-sweep values must be below the number of points")
+    print("k,iterations,objective")
+    for result in symnmfmodule.symnmf_sweep(dataMatrix, ks):
+        print(f"{result['k']},{result['iterations']},{result['objective']:.6f}")
+
+def run_restarts(dataMatrix, k, restarts):
+    """
+    Solves symNMF from several seeds concurrently, reports every run to stderr and prints the
+    H of the best one.
+
+    Parameters:
+    dataMatrix (list): The datapoints.
+    k (int): Number of clusters.
+    restarts (int): Number of runs.
+    """
+    optimal_H, info = symnmfmodule.symnmf_multistart(dataMatrix, k, restarts)
+    print("seed,iterations,objective,best", file=sys.stderr)
+    for i, run in enumerate(info['runs']):
+        print(f"{run['seed']},{run['iterations']},{run['objective']:.6f},{int(i == info['best'])}", file=sys.stderr)
+    print_matrix(optimal_H)
+
+def run_multilevel(dataMatrix, k):
+    """
+    Solves symNMF on a coarsened graph, then refines the solution level by level, and prints H.
+
+    Parameters:
+    dataMatrix (list): The datapoints.
+    k (int): Number of clusters.
+    """
+    print_matrix(symnmfmodule.symnmf_multilevel(dataMatrix, k))
+
+def run_nystrom(dataMatrix, k, landmarks):
+    """
+    Solves symNMF with W approximated from landmark points and prints H.
+
+    Parameters:
+    dataMatrix (list): The datapoints.
+    k (int): Number of clusters.
+    landmarks (int): Number of landmark points.
+    """
+    H = initialize_H_from_mean(len(dataMatrix), k, symnmfmodule.norm_mean(dataMatrix, landmarks))
+    print_matrix(symnmfmodule.symnmf_nystrom(dataMatrix, H, k, landmarks))
+
+def run_packed(dataMatrix, k):
+    """
+    Solves symNMF with W stored once per symmetric pair and prints H.
+
+    Parameters:
+    dataMatrix (list): The datapoints.
+    k (int): Number of clusters.
+    """
+    H = initialize_H_from_mean(len(dataMatrix), k, symnmfmodule.norm_mean(dataMatrix))
+    print_matrix(symnmfmodule.symnmf_packed(dataMatrix, H, k))
+
+def run_matrix_free(dataMatrix, k):
+    """
+    Solves symNMF recomputing W*H from the points, so that W is never stored, and prints H.
+
+    Parameters:
+    dataMatrix (list): The datapoints.
+    k (int): Number of clusters.
+    """
+    H = initialize_H_from_mean(len(dataMatrix), k, symnmfmodule.norm_mean(dataMatrix))
+    print_matrix(symnmfmodule.symnmf_matrix_free(dataMatrix, H, k))
+
+def check_symnmf_options(options):
+    """
+    Checks the combinations of options of the symnmf mode that OPTIONS cannot express.
+
+    Parameters:
+    options (dict): The options, as returned by parse_arguments.
+    """
+    background = options['--budget'] is not None or options['--checkpoint'] is not None
+    if options['--stop'] is not None and options['--solver'] == 'mu-active':
+        raise ValueError("--stop cannot be used with mu-active")
+    if background and (options['--stop'] is not None or options['--objective-trace'] or options['--solver'] == 'mu-active'):
+        raise ValueError("--budget and --checkpoint cannot be used with --stop, --objective-trace or mu-active")
+    if options['--checkpoint'] is not None and (options['--compare-solvers'] or options['--compare-init']):
+        raise ValueError("--checkpoint cannot be used with --compare-solvers or --compare-init")
+    if options['--checkpoint'] is None and (options['--checkpoint-w'] or options['--checkpoint-every'] != CHECKPOINT_EVERY):
+        raise ValueError("--checkpoint-every and --checkpoint-w need --checkpoint")
+
+def run_symnmf(dataMatrix, k, options):
+    """
+    Solves symNMF and prints H, with the solver, initialization, stopping rule, comparisons,
+    coreset, time budget and checkpoint asked for by the options.
+
+    Parameters:
+    dataMatrix (list): The datapoints.
+    k (int): Number of clusters.
+    options (dict): The options, as returned by parse_arguments.
+    """
+    solver, stop, checkpoint = options['--solver'], options['--stop'], options['--checkpoint']
+    check_symnmf_options(options)
+    weights = nearest = None
+    coreset_size = options['--coreset']
+    if coreset_size is not None: #cluster a weighted coreset, every point then takes the row of its nearest coreset point
+        if not k < coreset_size < len(dataMatrix):
+            raise ValueError("--coreset must be between k and the number of points")
+        dataMatrix, weights, nearest = symnmfmodule.coreset(dataMatrix, k, coreset_size)
+    n = len(dataMatrix)
+
+    resume = find_checkpoint(checkpoint, n, k, dataMatrix) if checkpoint is not None else None
+    if resume is not None:
+        print(f"resuming from the checkpoint at iteration {resume['iteration']}", file=sys.stderr)
+    W = None if resume is not None and resume['has_W'] else symnmfmodule.norm(dataMatrix, weights)
+    if options['--compare-init']:
+        compare_inits(W, n, k, solver)
+    if resume is not None: #H comes from the checkpoint
+        H = None
+    else:
+        H = initialize_H(n, k, W) if options['--init'] == 'random' else symnmfmodule.spectral_init(W, k)
+    if options['--compare-solvers']:
+        compare_solvers(W, H, n, k)
+    if options['--budget'] is not None or checkpoint is not None: #run in the background, Ctrl-C or the budget stops it between iterations
+        job = symnmfmodule.symnmf_async(W, H, n, k, solver, options['--budget'] or 0, checkpoint,
+                                        options['--checkpoint-every'], options['--checkpoint-w'], SEED, dataMatrix)
+        optimal_H = wait_for_job(job, checkpoint)
+        progress = job.poll()
+        if progress['state'] == 'timed_out':
+            print(f"time budget reached after {progress['iteration']} iterations", file=sys.stderr)
+    elif stop is None and not options['--objective-trace']:
+        optimal_H = symnmfmodule.symnmf(W, H, n, k, solver)
+    else:
+        optimal_H, info = symnmfmodule.symnmf(W, H, n, k, solver, True, stop, options['--objective-trace'])
+        if options['--objective-trace']:
+            print_objective_trace(info['objective_trace'])
+    if nearest is not None:
+        optimal_H = [optimal_H[i] for i in nearest]
+    print_matrix(optimal_H)
+
 def main():
     """
-    Main function to perform the requested operation (symnmf, sym, ddg, or norm) on the matrix.
+    Main function: parses the command line and runs its mode (symnmf, sym, ddg or norm on one
+    file, a batch, a k sweep, restarts, or one of the symnmf variants).
+    An invalid command line prints "An Error Has Occurred", with the reason on stderr.
     """
+    global STAGE_TIMES
     try:
-        k = int(sys.argv[1]) #number of required clusters
-        goal = sys.argv[2] #goal for matrix calculations
-        file_name = sys.argv[3] #the path to the input file
-
-        dataMatrix = compute_data_matrix(file_name)
-        n = len(dataMatrix)
-        
-        if goal == 'symnmf': #compute the whole symNMF process
-            W = symnmfmodule.norm(dataMatrix)
-            H = initialize_H(n, k, W)
-            optimal_H = symnmfmodule.symnmf(W, H, n, k)
-            print_matrix(optimal_H)
-        elif goal == 'sym': #compute only SYM matrix
-            A = symnmfmodule.sym(dataMatrix)
-            print_matrix(A)
-        elif goal == 'ddg': #compute only DDG matrix
-            D = symnmfmodule.ddg(dataMatrix)
-            print_matrix(D)
-        elif goal == 'norm': #compute only NORM matrix
-            W = symnmfmodule.norm(dataMatrix)
-            print_matrix(W)
-        else: #if the goal is not one of the allowed goals
-            print("An Error Has Occurred")
+        mode, k, goal, file_name, options = parse_arguments(sys.argv[1:])
+        stats_json = options['--stats-json']
+        if stats_json or options['--stats']:
+            STAGE_TIMES = {}
+            symnmfmodule.set_stats(True)
+
+        failed = False
+        if mode == 'batch': #every dataset of the manifest, with no per-dataset option
+            failed = run_batch(k, goal, file_name)
+        else:
+            dataMatrix = compute_data_matrix(file_name)
+            if mode == 'goal':
+                run_goal(goal, dataMatrix)
+            elif mode == 'sweep':
+                run_sweep(dataMatrix, options['--k-sweep'])
+            elif mode == 'restarts':
+                run_restarts(dataMatrix, k, options['--restarts'])
+            elif mode == 'multilevel':
+                run_multilevel(dataMatrix, k)
+            elif mode == 'nystrom':
+                run_nystrom(dataMatrix, k, options['--nystrom'])
+            elif mode == 'packed':
+                run_packed(dataMatrix, k)
+            elif mode == 'matrix_free':
+                run_matrix_free(dataMatrix, k)
+            else:
+                run_symnmf(dataMatrix, k, options)
+        if STAGE_TIMES is not None:
+            print_stats(stats_json)
+        if failed:
             exit(1)
-    except ValueError:
+    except (ValueError, IndexError) as error:
         print("An Error Has Occurred")
+        print(error, file=sys.stderr)
         exit(1)
 
 
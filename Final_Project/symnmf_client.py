@@ -0,0 +1,261 @@
+import os
+import sys
+import time
+import socket
+import subprocess
+
+SERVER_BINARY = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'symnmf')
+GOALS = ['sym', 'ddg', 'norm']
+
+class ServerError(Exception):
+    """
+    An ERR answer of the server.
+    """
+
+class SymnmfClient:
+    """
+    A connection to a resident symnmf server (./symnmf --serve PATH). Datasets are loaded once
+    and referred to by the content key the server returns; the server keeps their points and
+    their sym, ddg and norm matrices cached until they are evicted.
+    """
+
+    def __init__(self, socket_path):
+        """
+        Connects to a running server.
+
+        Parameters:
+        socket_path (str): Path of the server's Unix socket.
+        """
+        self.socket_path = socket_path
+        self.sources = {} #key -> ('path', path) or ('text', bytes), to reload an evicted dataset
+        self.connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.connection.connect(socket_path)
+        self.reader = self.connection.makefile('rb')
+
+    def close(self):
+        """
+        Closes the connection, the server keeps running.
+        """
+        self.reader.close()
+        self.connection.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def request(self, line, payload=b''):
+        """
+        Sends one request and reads its status line.
+
+        Parameters:
+        line (str): The request, without its newline.
+        payload (bytes): Bytes sent right after the request line.
+
+        Returns:
+        list: The words after OK.
+        """
+        self.connection.sendall(line.encode() + b'\n' + payload)
+        status = self.reader.readline().decode().rstrip('\n')
+        if not status:
+            raise ConnectionError("the server closed the connection")
+        if status.startswith('ERR'):
+            raise ServerError(status[4:])
+        return status.split()[1:]
+
+    def read_rows(self, rows, cast=float):
+        """
+        Reads the comma-separated rows that follow a status line.
+
+        Parameters:
+        rows (int): Number of rows.
+        cast (type): Type of the values.
+
+        Returns:
+        list: A 2D list of numbers.
+        """
+        return [[cast(x) for x in self.reader.readline().decode().split(',')] for _ in range(rows)]
+
+    def load(self, path):
+        """
+        Has the server read and parse a file of its own filesystem.
+
+        Parameters:
+        path (str): The file, resolved by the server.
+
+        Returns:
+        str: The content key of the dataset.
+        """
+        key = self.request('LOAD ' + os.path.abspath(path))[0]
+        self.sources[key] = ('path', os.path.abspath(path))
+        return key
+
+    def upload(self, text):
+        """
+        Sends a dataset's text to the server.
+
+        Parameters:
+        text (str or bytes): Comma-separated points, one per line.
+
+        Returns:
+        str: The content key of the dataset.
+        """
+        if isinstance(text, str):
+            text = text.encode()
+        key = self.request('DATA %d' % len(text), text)[0]
+        self.sources[key] = ('text', text)
+        return key
+
+    def reloaded(self, key, line):
+        """
+        Sends a request about a dataset, loading it again first if the server evicted it.
+
+        Parameters:
+        key (str): The content key.
+        line (str): The request, with {} in place of the key.
+
+        Returns:
+        list: The words after OK.
+        """
+        try:
+            return self.request(line.format(key))
+        except ServerError as error:
+            if str(error) != 'unknown dataset' or key not in self.sources:
+                raise
+        kind, source = self.sources[key]
+        if kind == 'path':
+            self.load(source)
+        else:
+            self.upload(source)
+        return self.request(line.format(key))
+
+    def goal(self, key, goal):
+        """
+        The sym, ddg or norm matrix of a dataset.
+
+        Parameters:
+        key (str): The content key.
+        goal (str): 'sym', 'ddg' or 'norm'.
+
+        Returns:
+        list: The n x n matrix, rounded to 4 decimals by the server.
+        """
+        rows = int(self.reloaded(key, 'GOAL {} ' + goal)[0])
+        return self.read_rows(rows)
+
+    def symnmf(self, key, k, seed=None):
+        """
+        Runs symNMF on the cached normalized similarity matrix of a dataset.
+
+        Parameters:
+        key (str): The content key.
+        k (int): Number of clusters.
+        seed (int): Seed of the initial H, the server's default when None.
+
+        Returns:
+        tuple: H as an n x k list and the number of iterations.
+        """
+        line = 'SYMNMF {} %d' % k + ('' if seed is None else ' %d' % seed)
+        rows, _, iterations = (int(x) for x in self.reloaded(key, line))
+        return self.read_rows(rows), iterations
+
+    def kmeans(self, key, k, max_iter=None, eps=None):
+        """
+        Runs k-means on the cached points of a dataset.
+
+        Parameters:
+        key (str): The content key.
+        k (int): Number of clusters.
+        max_iter (int): Iteration cap, the server's default when None.
+        eps (float): Convergence threshold, requires max_iter.
+
+        Returns:
+        tuple: The centroids as a k x d list, the label of every point and the number of iterations.
+        """
+        line = 'KMEANS {} %d' % k
+        if max_iter is not None:
+            line += ' %d' % max_iter + ('' if eps is None else ' %r' % eps)
+        rows, _, iterations = (int(x) for x in self.reloaded(key, line))
+        centroids = self.read_rows(rows)
+        return centroids, self.read_rows(1, int)[0], iterations
+
+    def stats(self):
+        """
+        The cache counters of the server.
+
+        Returns:
+        dict: entries, bytes, budget, hits, misses and evictions.
+        """
+        return {name: int(value) for name, value in (word.split('=') for word in self.request('STATS'))}
+
+    def drop(self, key):
+        """
+        Evicts a dataset from the server's cache.
+
+        Parameters:
+        key (str): The content key.
+        """
+        self.sources.pop(key, None)
+        self.request('DROP ' + key)
+
+    def shutdown(self):
+        """
+        Stops the server, which removes its socket.
+        """
+        self.request('SHUTDOWN')
+        self.close()
+
+def start_server(socket_path, cache_mb=None, timeout=10.0):
+    """
+    Starts a resident server in the background and waits until it accepts connections.
+
+    Parameters:
+    socket_path (str): Path of the socket to create.
+    cache_mb (int): Cache budget in megabytes, the server's default when None.
+    timeout (float): Seconds to wait for the socket.
+
+    Returns:
+    Popen: The server process.
+    """
+    command = [SERVER_BINARY, '--serve', socket_path]
+    if cache_mb is not None:
+        command += ['--cache-mb', str(cache_mb)]
+    process = subprocess.Popen(command)
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        if process.poll() is not None:
+            raise RuntimeError("the server exited with status %d" % process.returncode)
+        try:
+            SymnmfClient(socket_path).close()
+            return process
+        except (FileNotFoundError, ConnectionRefusedError):
+            time.sleep(0.02)
+    process.kill()
+    raise TimeoutError("the server did not start")
+
+def main():
+    """
+    Prints a goal of a file computed by a running server, in the format of symnmf.py:
+    python3 symnmf_client.py SOCKET k goal file_name, goal one of sym, ddg, norm, symnmf, kmeans.
+    """
+    try:
+        socket_path, k, goal, filename = sys.argv[1], int(sys.argv[2]), sys.argv[3], sys.argv[4]
+        if goal not in GOALS + ['symnmf', 'kmeans']:
+            raise ValueError(goal)
+        with SymnmfClient(socket_path) as client:
+            key = client.load(filename)
+            if goal == 'symnmf':
+                matrix = client.symnmf(key, k)[0]
+            elif goal == 'kmeans':
+                matrix = client.kmeans(key, k)[0]
+            else:
+                matrix = client.goal(key, goal)
+    except Exception:
+        print("An Error Has Occurred")
+        sys.exit(1)
+    for row in matrix:
+        print(",".join(f"{x:.4f}" for x in row))
+
+if __name__ == "__main__":
+    main()
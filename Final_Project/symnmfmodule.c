@@ -5,7 +5,67 @@
 #include <stdlib.h>
 #include <string.h>
 #include <Python.h> 
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 #include "symnmf.h"
+#include "coreset.h"
+#include "matrix_free.h"
+#include "nystrom.h"
+#include "spectral.h"
+#include "multilevel.h"
+#include "packed.h"
+#include "sweep.h"
+#include "multistart.h"
+#include "silhouette.h"
+#include "kmeans.h"
+#include "placement.h"
+#include "stats.h"
+#include "batch.h"
+#include "control.h"
+#include "diskcache.h"
+#include "incremental.h"
+#include "checkpoint.h"
+
+/* Constants */
+#define JOB_WAIT_SLICE 0.1 /* seconds between two signal checks while waiting for a job */
+
+/* What an asynchronous job runs */
+typedef enum job_kind {
+    JOB_SYMNMF,
+    JOB_KMEANS
+} job_kind;
+
+/* A symNMF or k-means run on a thread of its own, owned by a Python Job object.
+   The inputs are converted before the thread starts and only the thread touches them until
+   it finishes; progress goes through control, completion through lock and cond. */
+typedef struct JobObject {
+    PyObject_HEAD
+    int kind;
+    run_control control;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int started;             /* 0 until the thread is running, nothing to join before */
+    int finished;
+    int ready_fds[2];        /* the read end becomes readable once the job finished */
+    double **W, **data;      /* W for symnmf, the points for k-means */
+    double **result;         /* H (n x k) or the centroids (k x d) */
+    int *labels;
+    int n, k, d, max_iter, iterations;
+    double eps;
+    const symnmf_solver *solver;
+    checkpoint snapshot;     /* attached to control when has_snapshot is set */
+    int has_snapshot;
+} JobObject;
+
+/* A growing dataset and its symNMF, owned by a Python Incremental object. busy is only read
+   and written with the GIL held and keeps a second thread out while an update runs. */
+typedef struct IncrementalObject {
+    PyObject_HEAD
+    incremental_state state;
+    int busy;
+} IncrementalObject;
 
 /* Macro for an error message if the object is not a Python list */
 #define VALIDATE_LIST(obj)  \
@@ -40,6 +100,30 @@ static void PyObj_To_cMatrix(PyObject* pyMat, double **cMat, int rows, int colum
     }
 }
 
+/*
+ * Converts an optional Python list of weights into a C array.
+ * Parameters:
+ *   pyWeights: The Python list object to convert, or NULL/None for unit weights.
+ *   n: Expected number of weights.
+ * Returns: Newly allocated array of n weights, or NULL when no weights were given.
+ */
+static double* PyObj_To_cWeights(PyObject* pyWeights, int n)
+{
+    int i;
+    double *weights;
+
+    if (pyWeights == NULL || pyWeights == Py_None){
+        return NULL;
+    }
+    VALIDATE_LIST(pyWeights);
+    weights = malloc(n * sizeof(double));
+    if (check_pointer(weights)) exit(1);
+    for (i = 0; i < n; i++){
+        weights[i] = PyFloat_AsDouble(PyList_GetItem(pyWeights, i));
+    }
+    return weights;
+}
+
 /*
  * Converts a C matrix (2D array) to a Python list of lists (PyObject).
  * Parameters:
@@ -60,18 +144,41 @@ static PyObject* cMatrix_to_PyObject(double** cMat, int rows, int columns){
     return PyMat;
 }
 
+/*
+ * Converts a packed symmetric matrix to a full Python list of lists (PyObject).
+ * Parameters:
+ *   A: The packed matrix to convert.
+ *   degree: When not NULL, the diagonal matrix of these values is converted instead.
+ * Returns: Python list of lists representation of the n x n matrix.
+ */
+static PyObject* packedMatrix_to_PyObject(const packed_matrix* A, const double* degree){
+    int i, j;
+    PyObject* PyMat = PyList_New(A->n);
+    for (i=0; i<A->n; i++){
+        PyObject* single_row = PyList_New(A->n);
+        for (j=0; j<A->n; j++){
+            PyList_SET_ITEM(single_row, j, PyFloat_FromDouble(degree != NULL ? (i == j ? degree[i] : 0.0)
+                                                                               : packed_get(A, i, j)));
+        }
+        PyList_SET_ITEM(PyMat, i, single_row);
+    }
+    return PyMat;
+}
+
 /*
  * Python wrapper function for calculating the similarity matrix.
- * Parameters: Python list of lists (data points), number of rows (n), and columns (d).
+ * Parameters: Python list of lists (data points), optional list of point weights.
  * Returns: Python list of lists representing the similarity matrix.
  */
 static PyObject* py_sym(PyObject *self, PyObject *args){
-    double **data_matrix ,**A;
+    double **data_matrix, *degree, *weights;
     int n, d;
-    PyObject *PyDataPoints;
+    packed_matrix A;
+    stats_timer timer;
+    PyObject *PyDataPoints, *PyWeights = NULL;
     PyObject *result_mat;
 
-    if (!PyArg_ParseTuple(args, "O", &PyDataPoints)) {
+    if (!PyArg_ParseTuple(args, "O|O", &PyDataPoints, &PyWeights)) {
         return NULL;
     }
     VALIDATE_LIST(PyDataPoints);
@@ -79,27 +186,37 @@ static PyObject* py_sym(PyObject *self, PyObject *args){
     n = PyList_Size(PyDataPoints); 
     d = n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
 
+    timer = stats_begin(STAGE_PARSE);
     data_matrix = create_matrix(n, d);
     PyObj_To_cMatrix(PyDataPoints, data_matrix, n, d);
-    A = sym(data_matrix, n, d);
-    result_mat = cMatrix_to_PyObject(A, n, n);
+    weights = PyObj_To_cWeights(PyWeights, n);
+    stats_end(timer);
+    if (cached_goal_packed(&A, &degree, data_matrix, weights, n, d, "sym")) {
+        free_matrix(data_matrix, n), free(weights);
+        return PyErr_NoMemory();
+    }
+    timer = stats_begin(STAGE_OUTPUT);
+    result_mat = packedMatrix_to_PyObject(&A, NULL);
+    stats_end(timer);
 
-    free_matrix(A, n), free_matrix(data_matrix, n);
+    free_packed_matrix(&A), free_matrix(data_matrix, n), free(degree), free(weights);
     return result_mat;
 }
 
 /*
  * Python wrapper function for calculating the diagonal degree matrix.
- * Parameters: Python list of lists (data points), number of rows (n), and columns (d).
+ * Parameters: Python list of lists (data points), optional list of point weights.
  * Returns: Python list of lists representing the diagonal degree matrix.
  */
 static PyObject* py_ddg(PyObject *self, PyObject *args){
-    double **data_matrix ,**D, **A;
+    double **data_matrix, *degree, *weights;
     int n, d;
-    PyObject *PyDataPoints;
+    packed_matrix A;
+    stats_timer timer;
+    PyObject *PyDataPoints, *PyWeights = NULL;
     PyObject *result_mat;
 
-    if (!PyArg_ParseTuple(args, "O", &PyDataPoints)) {
+    if (!PyArg_ParseTuple(args, "O|O", &PyDataPoints, &PyWeights)) {
         return NULL;
     }
     VALIDATE_LIST(PyDataPoints);
@@ -108,29 +225,37 @@ static PyObject* py_ddg(PyObject *self, PyObject *args){
     n = PyList_Size(PyDataPoints);
     d = n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
 
+    timer = stats_begin(STAGE_PARSE);
     data_matrix = create_matrix(n, d);
     PyObj_To_cMatrix(PyDataPoints, data_matrix, n, d);
+    weights = PyObj_To_cWeights(PyWeights, n);
+    stats_end(timer);
 
-
-    A = sym(data_matrix, n, d);
-    D = ddg(A ,n);
-    result_mat = cMatrix_to_PyObject(D, n, n);
-    free_matrix(A, n), free_matrix(data_matrix, n), free_matrix(D, n);
+    if (cached_goal_packed(&A, &degree, data_matrix, weights, n, d, "ddg")) {
+        free_matrix(data_matrix, n), free(weights);
+        return PyErr_NoMemory();
+    }
+    timer = stats_begin(STAGE_OUTPUT);
+    result_mat = packedMatrix_to_PyObject(&A, degree);
+    stats_end(timer);
+    free_packed_matrix(&A), free_matrix(data_matrix, n), free(degree), free(weights);
     return result_mat;
 }
 
 /*
  * Python wrapper function for calculating the normalized similarity matrix.
- * Parameters: Python list of lists (data points), number of rows (n), and columns (d).
+ * Parameters: Python list of lists (data points), optional list of point weights.
  * Returns: Python list of lists representing the normalized similarity matrix.
  */
 static PyObject* py_norm(PyObject *self, PyObject *args){
-    double **data_matrix ,**D, **A, **W;
+    double **data_matrix, *degree, *weights;
     int n, d;
-    PyObject *PyDataPoints;
+    packed_matrix A;
+    stats_timer timer;
+    PyObject *PyDataPoints, *PyWeights = NULL;
     PyObject *result_mat;
 
-    if (!PyArg_ParseTuple(args, "O", &PyDataPoints)) {
+    if (!PyArg_ParseTuple(args, "O|O", &PyDataPoints, &PyWeights)) {
         return NULL;
     }
     VALIDATE_LIST(PyDataPoints);
@@ -138,56 +263,1451 @@ static PyObject* py_norm(PyObject *self, PyObject *args){
     n = PyList_Size(PyDataPoints); 
     d = n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
 
+    timer = stats_begin(STAGE_PARSE);
     data_matrix = create_matrix(n, d);
     PyObj_To_cMatrix(PyDataPoints, data_matrix, n, d);
+    weights = PyObj_To_cWeights(PyWeights, n);
+    stats_end(timer);
 
-    A = sym(data_matrix, n, d);
-    D = ddg(A ,n);
-    W = norm(D, A, n);
-    result_mat = cMatrix_to_PyObject(W, n, n);
+    if (cached_goal_packed(&A, &degree, data_matrix, weights, n, d, "norm")) {
+        free_matrix(data_matrix, n), free(weights);
+        return PyErr_NoMemory();
+    }
+    timer = stats_begin(STAGE_OUTPUT);
+    result_mat = packedMatrix_to_PyObject(&A, NULL);
+    stats_end(timer);
 
-    free_matrix(A, n), free_matrix(data_matrix, n), free_matrix(D, n), free_matrix(W, n);
+    free_packed_matrix(&A), free_matrix(data_matrix, n), free(degree), free(weights);
     return result_mat;
 }
 
 /*
  * Python wrapper function for performing symNMF on matrix W.
- * Parameters: Python list of lists for W and H, number of rows (n), and clusters (k).
- * Returns: Python list of lists representing the resulting H matrix.
+ * Parameters: Python list of lists for W and H, number of rows (n), clusters (k),
+ *   optional solver name ("mu", "mu-active", "hals" or "pgd"), an optional flag asking for run
+ *   information, an optional stopping rule ("step", "objective" or "both", not for "mu-active")
+ *   and an optional flag asking for the objective of every iterate. A stopping rule runs the
+ *   solver's update through optimize_H_controlled, otherwise a solver with a loop of its own
+ *   runs that loop.
+ * Returns: Python list of lists representing the resulting H matrix, or a tuple (H, info)
+ *   where info is a dict with the solver, the number of iterations and the final objective,
+ *   plus the objective of every iterate when a stopping rule or the trace was asked for,
+ *   otherwise the scratch arena backend, its peak size in bytes and its number of allocations.
  */
 static PyObject* py_symnmf(PyObject *self, PyObject *args){
-    double **W, **H;
-    int n, k;
-    PyObject *Py_W, *Py_H;
+    double **W, **H, *trace = NULL;
+    stats_timer timer;
+    arena scratch;
+    arena_backend backend;
+    int n, k, iterations, with_info = 0, with_trace = 0, rule = STOP_STEP, i;
+    const char *solver_name = NULL, *stop_name = NULL;
+    const symnmf_solver *solver;
+    PyObject *Py_W, *Py_H, *Py_trace;
     PyObject *result_mat;
 
-    if (!PyArg_ParseTuple(args, "OOii", &Py_W, &Py_H, &n, &k)) { /*Delete d as an argument */
+    if (!PyArg_ParseTuple(args, "OOii|zpzp", &Py_W, &Py_H, &n, &k, &solver_name, &with_info, &stop_name, &with_trace)) { /*Delete d as an argument */
         return NULL;
     }
 
     VALIDATE_LIST(Py_W);
     VALIDATE_LIST(Py_H);
+    solver = find_solver(solver_name);
+    if (solver == NULL) {
+        PyErr_SetString(PyExc_ValueError, "Unknown solver.");
+        return NULL;
+    }
+    if (stop_name != NULL) {
+        rule = find_stop_rule(stop_name);
+        if (rule < 0 || solver->update == NULL) {
+            PyErr_SetString(PyExc_ValueError, "Unknown stopping rule for this solver.");
+            return NULL;
+        }
+    }
+    if (stop_name != NULL || with_trace) {
+        trace = malloc((MAX_ITER + 1) * sizeof(double));
+        if (trace == NULL) return PyErr_NoMemory();
+    }
 
-    W = create_matrix(n, n);
+    timer = stats_begin(STAGE_PARSE);
+    W = create_placed_matrix(n, n);
     H = create_matrix(n, k);
 
     PyObj_To_cMatrix(Py_W, W, n, n);
     PyObj_To_cMatrix(Py_H, H, n, k);
+    stats_end(timer);
 
-    H = optimize_H(H, W, n, k);
+    backend = env_backend();
+    arena_init(&scratch, &backend, 0);
+    if (solver->optimize != NULL && stop_name == NULL) {
+        H = solver->optimize(H, W, n, k, trace, &iterations);
+    } else {
+        H = optimize_H_controlled(H, W, n, k, solver->update, rule, &iterations, &scratch, NULL, trace);
+    }
+    timer = stats_begin(STAGE_OUTPUT);
     result_mat = cMatrix_to_PyObject(H, n, k);
+    stats_end(timer);
+    if (with_info && trace != NULL) {
+        Py_trace = PyList_New(iterations + 1);
+        for (i = 0; i <= iterations; i++) {
+            PyList_SET_ITEM(Py_trace, i, PyFloat_FromDouble(trace[i]));
+        }
+        result_mat = Py_BuildValue("(N{s:s,s:i,s:d,s:s,s:N})", result_mat, "solver", solver->name,
+                                   "iterations", iterations, "objective", trace[iterations],
+                                   "stop", stop_name, "objective_trace", Py_trace);
+    } else if (with_info) {
+        result_mat = Py_BuildValue("(N{s:s,s:i,s:d,s:s,s:n,s:n})", result_mat, "solver", solver->name,
+                                   "iterations", iterations, "objective", symnmf_objective(W, H, n, k),
+                                   "scratch_backend", scratch.backend.name,
+                                   "scratch_high_water", (Py_ssize_t)scratch.high_water,
+                                   "scratch_allocations", (Py_ssize_t)scratch.allocations);
+    }
     
+    arena_destroy(&scratch);
+    free_placed_matrix(W, n, n), free_matrix(H, n), free(trace);
+    return result_mat;
+}
+
+/*
+ * Python wrapper function for building a weighted coreset of the data points.
+ * Parameters: Python list of lists (data points), k for the k-means++ seeding pass,
+ *   coreset size (m) and an optional seed.
+ * Returns: Tuple (points, weights, nearest) of the sampled m points, their weights and the
+ *   index of the nearest coreset point of every data point.
+ */
+static PyObject* py_coreset(PyObject *self, PyObject *args){
+    double **data_matrix, **coreset, *weights;
+    int n, d, k, m, i, *nearest;
+    unsigned long seed = CORESET_DEFAULT_SEED;
+    PyObject *PyDataPoints, *PyWeights, *PyNearest;
+    PyObject *result;
+
+    if (!PyArg_ParseTuple(args, "Oii|k", &PyDataPoints, &k, &m, &seed)) {
+        return NULL;
+    }
+    VALIDATE_LIST(PyDataPoints);
+
+    n = PyList_Size(PyDataPoints);
+    d = n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
+    if (m > n) m = n;
+    if (k <= 0 || m <= 0) {
+        PyErr_SetString(PyExc_ValueError, "k and the coreset size must be positive.");
+        return NULL;
+    }
+
+    data_matrix = create_matrix(n, d);
+    PyObj_To_cMatrix(PyDataPoints, data_matrix, n, d);
+    weights = malloc(m * sizeof(double));
+    nearest = malloc(n * sizeof(int));
+    if (weights == NULL || nearest == NULL) {
+        free_matrix(data_matrix, n), free(weights), free(nearest);
+        return PyErr_NoMemory();
+    }
+
+    coreset = build_coreset(data_matrix, n, d, k, m, seed, weights);
+    coreset_nearest(data_matrix, n, coreset, m, d, nearest);
+    PyWeights = PyList_New(m);
+    for (i = 0; i < m; i++){
+        PyList_SET_ITEM(PyWeights, i, PyFloat_FromDouble(weights[i]));
+    }
+    PyNearest = PyList_New(n);
+    for (i = 0; i < n; i++){
+        PyList_SET_ITEM(PyNearest, i, PyLong_FromLong(nearest[i]));
+    }
+    result = Py_BuildValue("(NNN)", cMatrix_to_PyObject(coreset, m, d), PyWeights, PyNearest);
+
+    free_matrix(coreset, m), free_matrix(data_matrix, n), free(weights), free(nearest);
+    return result;
+}
+
+/*
+ * Converts Python data points into a C matrix and prepares the matrix-free W over them.
+ * Parameters: Python list of lists (data points), the operator to initialize, output n.
+ * Returns: The C data matrix borrowed by the operator, or NULL on failure.
+ */
+static double** prepare_affinity_operator(PyObject *PyDataPoints, affinity_operator *op, int *n){
+    double **data_matrix;
+    int d, failed;
+
+    VALIDATE_LIST(PyDataPoints);
+    *n = PyList_Size(PyDataPoints);
+    d = *n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
+    data_matrix = create_matrix(*n, d);
+    PyObj_To_cMatrix(PyDataPoints, data_matrix, *n, d);
+
+    Py_BEGIN_ALLOW_THREADS
+    failed = init_affinity_operator(op, data_matrix, *n, d);
+    Py_END_ALLOW_THREADS
+    if (failed) {
+        free_matrix(data_matrix, *n);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    return data_matrix;
+}
+
+/*
+ * Converts Python data points into a C matrix and builds the Nystrom approximation of W over them.
+ * Parameters: Python list of lists (data points), the operator to initialize, number of
+ *   landmarks, sampler seed, output n.
+ * Returns: 0 on success, 1 on failure (with a Python exception set).
+ */
+static int prepare_lowrank_operator(PyObject *PyDataPoints, lowrank_operator *op, int m, unsigned long seed, int *n){
+    double **data_matrix;
+    int d, failed;
+
+    VALIDATE_LIST(PyDataPoints);
+    *n = PyList_Size(PyDataPoints);
+    d = *n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
+    if (m <= 0 || *n <= 0) {
+        PyErr_SetString(PyExc_ValueError, "The number of landmarks must be positive.");
+        return 1;
+    }
+    data_matrix = create_matrix(*n, d);
+    PyObj_To_cMatrix(PyDataPoints, data_matrix, *n, d);
+
+    Py_BEGIN_ALLOW_THREADS
+    failed = init_nystrom_operator(op, data_matrix, *n, d, m, seed);
+    Py_END_ALLOW_THREADS
+    free_matrix(data_matrix, *n);
+    if (failed) {
+        PyErr_NoMemory();
+    }
+    return failed;
+}
+
+/*
+ * Python wrapper function for the mean entry of the normalized similarity matrix,
+ * computed without materializing W (used to initialize H in matrix-free and Nystrom modes).
+ * Parameters: Python list of lists (data points), optional number of landmarks (0 for the
+ *   exact matrix-free W) and an optional landmark seed.
+ * Returns: The mean of W as a float.
+ */
+static PyObject* py_norm_mean(PyObject *self, PyObject *args){
+    double **data_matrix, mean;
+    int n, landmarks = 0;
+    unsigned long seed = NYSTROM_DEFAULT_SEED;
+    affinity_operator op;
+    lowrank_operator lowrank;
+    PyObject *PyDataPoints;
+
+    if (!PyArg_ParseTuple(args, "O|ik", &PyDataPoints, &landmarks, &seed)) {
+        return NULL;
+    }
+    if (landmarks > 0) {
+        if (prepare_lowrank_operator(PyDataPoints, &lowrank, landmarks, seed, &n)) {
+            return NULL;
+        }
+        mean = lowrank_mean(&lowrank);
+        free_lowrank_operator(&lowrank);
+        return PyFloat_FromDouble(mean);
+    }
+    data_matrix = prepare_affinity_operator(PyDataPoints, &op, &n);
+    if (data_matrix == NULL) {
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    mean = affinity_mean(&op);
+    Py_END_ALLOW_THREADS
+
+    free_affinity_operator(&op), free_matrix(data_matrix, n);
+    return PyFloat_FromDouble(mean);
+}
+
+/*
+ * Python wrapper function for performing symNMF without materializing W: W*H is
+ * recomputed tile by tile from the data points, so memory stays O(n(d+k)).
+ * Parameters: Python list of lists (data points), initial H, clusters (k) and an
+ *   optional flag asking for run information.
+ * Returns: The resulting H matrix, or a tuple (H, info) with the number of iterations.
+ */
+static PyObject* py_symnmf_matrix_free(PyObject *self, PyObject *args){
+    double **data_matrix, **H;
+    int n, k, iterations, with_info = 0;
+    affinity_operator op;
+    w_operator W;
+    PyObject *PyDataPoints, *Py_H;
+    PyObject *result_mat;
+
+    if (!PyArg_ParseTuple(args, "OOi|p", &PyDataPoints, &Py_H, &k, &with_info)) {
+        return NULL;
+    }
+    VALIDATE_LIST(Py_H);
+    data_matrix = prepare_affinity_operator(PyDataPoints, &op, &n);
+    if (data_matrix == NULL) {
+        return NULL;
+    }
+    H = create_matrix(n, k);
+    PyObj_To_cMatrix(Py_H, H, n, k);
+
+    W = affinity_w_operator(&op);
+    Py_BEGIN_ALLOW_THREADS
+    H = optimize_H_operator(H, &W, k, &iterations);
+    Py_END_ALLOW_THREADS
+    result_mat = cMatrix_to_PyObject(H, n, k);
+    if (with_info) {
+        result_mat = Py_BuildValue("(N{s:s,s:i})", result_mat, "solver", "mu", "iterations", iterations);
+    }
+
+    free_affinity_operator(&op), free_matrix(data_matrix, n), free_matrix(H, n);
+    return result_mat;
+}
+
+/*
+ * Python wrapper function for performing symNMF on the Nystrom approximation of W:
+ * m landmarks give W ~ F F^T - diag, so every W*H costs O(nmk) instead of O(n^2 k).
+ * Parameters: Python list of lists (data points), initial H, clusters (k), number of
+ *   landmarks (m), optional landmark seed and an optional flag asking for run information.
+ * Returns: The resulting H matrix, or a tuple (H, info) with the rank and the number of iterations.
+ */
+static PyObject* py_symnmf_nystrom(PyObject *self, PyObject *args){
+    double **H;
+    int n, k, m, iterations, with_info = 0;
+    unsigned long seed = NYSTROM_DEFAULT_SEED;
+    lowrank_operator op;
+    w_operator W;
+    PyObject *PyDataPoints, *Py_H;
+    PyObject *result_mat;
+
+    if (!PyArg_ParseTuple(args, "OOii|kp", &PyDataPoints, &Py_H, &k, &m, &seed, &with_info)) {
+        return NULL;
+    }
+    VALIDATE_LIST(Py_H);
+    if (prepare_lowrank_operator(PyDataPoints, &op, m, seed, &n)) {
+        return NULL;
+    }
+    H = create_matrix(n, k);
+    PyObj_To_cMatrix(Py_H, H, n, k);
+
+    W = lowrank_w_operator(&op);
+    Py_BEGIN_ALLOW_THREADS
+    H = optimize_H_operator(H, &W, k, &iterations);
+    Py_END_ALLOW_THREADS
+    result_mat = cMatrix_to_PyObject(H, n, k);
+    if (with_info) {
+        result_mat = Py_BuildValue("(N{s:s,s:i,s:i})", result_mat, "solver", "mu",
+                                   "iterations", iterations, "rank", op.r);
+    }
+
+    free_lowrank_operator(&op), free_matrix(H, n);
+    return result_mat;
+}
+
+/*
+ * Python wrapper function for the spectral initialization of H from the top-k eigenvectors of W.
+ * Parameters: Python list of lists for W, clusters (k) and an optional seed.
+ * Returns: Python list of lists representing the nonnegative initial H.
+ */
+static PyObject* py_spectral_init(PyObject *self, PyObject *args){
+    double **W, **H;
+    int n, k;
+    unsigned long seed = SPECTRAL_DEFAULT_SEED;
+    w_operator op;
+    PyObject *Py_W;
+    PyObject *result_mat;
+
+    if (!PyArg_ParseTuple(args, "Oi|k", &Py_W, &k, &seed)) {
+        return NULL;
+    }
+    VALIDATE_LIST(Py_W);
+    n = PyList_Size(Py_W);
+    if (k <= 0 || k > n) {
+        PyErr_SetString(PyExc_ValueError, "Invalid number of clusters.");
+        return NULL;
+    }
+    W = create_matrix(n, n);
+    PyObj_To_cMatrix(Py_W, W, n, n);
+
+    op = dense_w_operator(W, n);
+    Py_BEGIN_ALLOW_THREADS
+    H = spectral_init_H(&op, k, seed);
+    Py_END_ALLOW_THREADS
+    result_mat = cMatrix_to_PyObject(H, n, k);
+
     free_matrix(W, n), free_matrix(H, n);
     return result_mat;
 }
 
+/*
+ * Python wrapper function for the multilevel symNMF: the similarity graph is coarsened by
+ * heavy-edge matching, solved on the coarsest level and refined back to the original points.
+ * Parameters: Python list of lists (data points), clusters (k), an optional seed and an
+ *   optional flag asking for run information.
+ * Returns: The resulting H matrix, or a tuple (H, info) with the number of coarsening levels.
+ */
+static PyObject* py_symnmf_multilevel(PyObject *self, PyObject *args){
+    double **data_matrix, **A, **H;
+    int n, d, k, levels = 0, with_info = 0;
+    unsigned long seed = MULTILEVEL_DEFAULT_SEED;
+    PyObject *PyDataPoints;
+    PyObject *result_mat;
+
+    if (!PyArg_ParseTuple(args, "Oi|kp", &PyDataPoints, &k, &seed, &with_info)) {
+        return NULL;
+    }
+    VALIDATE_LIST(PyDataPoints);
+    n = PyList_Size(PyDataPoints);
+    d = n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
+    if (k <= 0 || k >= n) {
+        PyErr_SetString(PyExc_ValueError, "Invalid number of clusters.");
+        return NULL;
+    }
+    data_matrix = create_matrix(n, d);
+    PyObj_To_cMatrix(PyDataPoints, data_matrix, n, d);
+
+    Py_BEGIN_ALLOW_THREADS
+    A = sym(data_matrix, n, d);
+    H = multilevel_symnmf(A, n, k, seed, &levels);
+    Py_END_ALLOW_THREADS
+    result_mat = cMatrix_to_PyObject(H, n, k);
+    if (with_info) {
+        result_mat = Py_BuildValue("(N{s:s,s:i})", result_mat, "solver", "mu", "levels", levels);
+    }
+
+    free_matrix(data_matrix, n), free_matrix(A, n), free_matrix(H, n);
+    return result_mat;
+}
+
+/*
+ * Python wrapper function for performing symNMF with W kept in packed symmetric form:
+ * about n^2/2 doubles in memory and every W*H streams them once (SYMM kernel).
+ * Parameters: Python list of lists (data points), initial H, clusters (k) and an
+ *   optional flag asking for run information.
+ * Returns: The resulting H matrix, or a tuple (H, info) with the number of iterations.
+ */
+static PyObject* py_symnmf_packed(PyObject *self, PyObject *args){
+    double **data_matrix, **H, *degree;
+    int n, d, k, iterations = 0, status, with_info = 0;
+    packed_matrix A;
+    w_operator W;
+    PyObject *PyDataPoints, *Py_H;
+    PyObject *result_mat;
+
+    if (!PyArg_ParseTuple(args, "OOi|p", &PyDataPoints, &Py_H, &k, &with_info)) {
+        return NULL;
+    }
+    VALIDATE_LIST(PyDataPoints);
+    VALIDATE_LIST(Py_H);
+    n = PyList_Size(PyDataPoints);
+    d = n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
+    data_matrix = create_matrix(n, d);
+    PyObj_To_cMatrix(PyDataPoints, data_matrix, n, d);
+    H = create_matrix(n, k);
+    PyObj_To_cMatrix(Py_H, H, n, k);
+
+    Py_BEGIN_ALLOW_THREADS
+    status = cached_goal_packed(&A, &degree, data_matrix, NULL, n, d, "norm");
+    if (status == 0) {
+        W = packed_w_operator(&A);
+        H = optimize_H_operator(H, &W, k, &iterations);
+    }
+    Py_END_ALLOW_THREADS
+    if (status != 0) {
+        free_matrix(data_matrix, n), free_matrix(H, n);
+        return PyErr_NoMemory();
+    }
+    result_mat = cMatrix_to_PyObject(H, n, k);
+    if (with_info) {
+        result_mat = Py_BuildValue("(N{s:s,s:i})", result_mat, "solver", "mu", "iterations", iterations);
+    }
+
+    free_packed_matrix(&A), free(degree), free_matrix(data_matrix, n), free_matrix(H, n);
+    return result_mat;
+}
+
+/*
+ * Python wrapper function for solving symNMF for several k on the same data: W is built
+ * once (packed) and the solution of every k warm-starts the next one.
+ * Parameters: Python list of lists (data points), list of k values, an optional seed and an
+ *   optional flag asking for labels (argmax of every row) instead of the H matrices.
+ * Returns: A list sorted by k of dicts with k, iterations, objective and H (or labels).
+ */
+static PyObject* py_symnmf_sweep(PyObject *self, PyObject *args){
+    double **data_matrix, *degree, best;
+    int n, d, count, i, j, r, status = 0, built, with_labels = 0, *ks, label;
+    unsigned long seed = SWEEP_DEFAULT_SEED;
+    packed_matrix W;
+    sweep_result *results;
+    PyObject *PyDataPoints, *Py_ks, *Py_H, *result, *entry;
+
+    if (!PyArg_ParseTuple(args, "OO|kp", &PyDataPoints, &Py_ks, &seed, &with_labels)) {
+        return NULL;
+    }
+    VALIDATE_LIST(PyDataPoints);
+    VALIDATE_LIST(Py_ks);
+    n = PyList_Size(PyDataPoints);
+    d = n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
+    count = PyList_Size(Py_ks);
+    ks = malloc((count > 0 ? count : 1) * sizeof(int));
+    results = malloc((count > 0 ? count : 1) * sizeof(sweep_result));
+    if (check_pointer(ks) || check_pointer(results)) exit(1);
+    for (r = 0; r < count; r++) {
+        ks[r] = (int)PyLong_AsLong(PyList_GetItem(Py_ks, r));
+    }
+    if (PyErr_Occurred()) {
+        free(ks), free(results);
+        return NULL;
+    }
+    data_matrix = create_matrix(n, d);
+    PyObj_To_cMatrix(PyDataPoints, data_matrix, n, d);
+
+    Py_BEGIN_ALLOW_THREADS
+    built = cached_goal_packed(&W, &degree, data_matrix, NULL, n, d, "norm") == 0;
+    if (built) status = symnmf_sweep(&W, ks, count, seed, results);
+    Py_END_ALLOW_THREADS
+    free_matrix(data_matrix, n), free(ks);
+    if (!built) {
+        free(results);
+        return PyErr_NoMemory();
+    }
+    free_packed_matrix(&W), free(degree);
+    if (status != 0) {
+        free(results);
+        PyErr_SetString(PyExc_ValueError, "Invalid number of clusters.");
+        return NULL;
+    }
+
+    result = PyList_New(count);
+    for (r = 0; r < count; r++) {
+        if (with_labels) {
+            Py_H = PyList_New(n);
+            for (i = 0; i < n; i++) {
+                label = 0, best = results[r].H[i][0];
+                for (j = 1; j < results[r].k; j++) {
+                    if (results[r].H[i][j] > best) best = results[r].H[i][j], label = j;
+                }
+                PyList_SET_ITEM(Py_H, i, PyLong_FromLong(label));
+            }
+        } else {
+            Py_H = cMatrix_to_PyObject(results[r].H, n, results[r].k);
+        }
+        entry = Py_BuildValue("{s:i,s:i,s:d,s:N}", "k", results[r].k, "iterations", results[r].iterations,
+                              "objective", results[r].objective, with_labels ? "labels" : "H", Py_H);
+        PyList_SET_ITEM(result, r, entry);
+    }
+    free_sweep_results(results, count, n), free(results);
+    return result;
+}
+
+/*
+ * Python wrapper function for multi-start symNMF: W is built once (packed) and shared
+ *   read-only by independent runs from different random H, executed on the worker threads.
+ * Parameters: Python list of lists (data points), clusters (k), number of restarts and an
+ *   optional base seed (restart r uses seed + r).
+ * Returns: A tuple (H, info) with the H of lowest objective, info holding the index of that
+ *   run and the seed, iterations and objective of every run.
+ */
+static PyObject* py_symnmf_multistart(PyObject *self, PyObject *args){
+    double **data_matrix, *degree;
+    int n, d, k, restarts, best = 0, built, r;
+    unsigned long seed = MULTISTART_DEFAULT_SEED;
+    packed_matrix W;
+    restart_result *results;
+    PyObject *PyDataPoints, *runs, *result_mat;
+
+    if (!PyArg_ParseTuple(args, "Oii|k", &PyDataPoints, &k, &restarts, &seed)) {
+        return NULL;
+    }
+    VALIDATE_LIST(PyDataPoints);
+    n = PyList_Size(PyDataPoints);
+    d = n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
+    if (k <= 0 || k >= n || restarts <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Invalid number of clusters or restarts.");
+        return NULL;
+    }
+    results = malloc(restarts * sizeof(restart_result));
+    if (check_pointer(results)) exit(1);
+    data_matrix = create_matrix(n, d);
+    PyObj_To_cMatrix(PyDataPoints, data_matrix, n, d);
+
+    Py_BEGIN_ALLOW_THREADS
+    built = cached_goal_packed(&W, &degree, data_matrix, NULL, n, d, "norm") == 0;
+    if (built) best = symnmf_multistart(&W, k, restarts, seed, results);
+    Py_END_ALLOW_THREADS
+    if (!built) {
+        free(results), free_matrix(data_matrix, n);
+        return PyErr_NoMemory();
+    }
+
+    runs = PyList_New(restarts);
+    for (r = 0; r < restarts; r++) {
+        PyList_SET_ITEM(runs, r, Py_BuildValue("{s:k,s:i,s:d}", "seed", results[r].seed,
+                                               "iterations", results[r].iterations, "objective", results[r].objective));
+    }
+    result_mat = Py_BuildValue("(N{s:i,s:N})", cMatrix_to_PyObject(results[best].H, n, k), "best", best, "runs", runs);
+
+    free_restart_results(results, restarts, n), free(results);
+    free_packed_matrix(&W), free(degree), free_matrix(data_matrix, n);
+    return result_mat;
+}
+
+/*
+ * Python wrapper function for the silhouette score of several labelings of the same points,
+ *   computed in one multithreaded pass over the pairwise euclidean distances.
+ * Parameters: Python list of lists (data points), list of labelings (lists of n labels in
+ *   [0, n)), an optional number of sampled points (0 for the exact score) and an optional seed.
+ * Returns: Python list with the mean silhouette of every labeling.
+ */
+static PyObject* py_silhouette(PyObject *self, PyObject *args){
+    double **data_matrix, *scores;
+    int n, d, count, sample = 0, status, i, l, **labelings;
+    unsigned long seed = SILHOUETTE_DEFAULT_SEED;
+    PyObject *PyDataPoints, *PyLabelings, *labels, *result;
 
+    if (!PyArg_ParseTuple(args, "OO|ik", &PyDataPoints, &PyLabelings, &sample, &seed)) {
+        return NULL;
+    }
+    VALIDATE_LIST(PyDataPoints);
+    VALIDATE_LIST(PyLabelings);
+    n = PyList_Size(PyDataPoints);
+    d = n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
+    count = PyList_Size(PyLabelings);
+    labelings = calloc(count > 0 ? count : 1, sizeof(int*));
+    scores = malloc((count > 0 ? count : 1) * sizeof(double));
+    if (check_pointer(labelings) || check_pointer(scores)) exit(1);
+    for (l = 0; l < count; l++) {
+        labels = PyList_GetItem(PyLabelings, l);
+        VALIDATE_LIST(labels);
+        labelings[l] = malloc((n > 0 ? n : 1) * sizeof(int));
+        if (check_pointer(labelings[l])) exit(1);
+        for (i = 0; i < n; i++) {
+            labelings[l][i] = i < PyList_Size(labels) ? (int)PyLong_AsLong(PyList_GetItem(labels, i)) : -1;
+        }
+    }
+    if (PyErr_Occurred()) {
+        for (l = 0; l < count; l++) free(labelings[l]);
+        free(labelings), free(scores);
+        return NULL;
+    }
+    data_matrix = create_matrix(n, d);
+    PyObj_To_cMatrix(PyDataPoints, data_matrix, n, d);
+
+    Py_BEGIN_ALLOW_THREADS
+    status = silhouette_scores(data_matrix, n, d, labelings, count, sample, seed, scores);
+    Py_END_ALLOW_THREADS
+    result = NULL;
+    if (status != 0) {
+        PyErr_SetString(PyExc_ValueError, "Every labeling needs between 2 and n - 1 labels in [0, n).");
+    } else {
+        result = PyList_New(count);
+        for (l = 0; l < count; l++) PyList_SET_ITEM(result, l, PyFloat_FromDouble(scores[l]));
+    }
+
+    for (l = 0; l < count; l++) free(labelings[l]);
+    free(labelings), free(scores), free_matrix(data_matrix, n);
+    return result;
+}
+
+/*
+ * Python wrapper function for the native k-means (Lloyd, initial centroids = first k points).
+ * Parameters: Python list of lists (data points), clusters (k), optional maximum number of
+ *   iterations and optional convergence threshold.
+ * Returns: A tuple (centroids, labels, iterations).
+ */
+static PyObject* py_kmeans(PyObject *self, PyObject *args){
+    double **data_matrix, **centroids, eps = KMEANS_EPSILON;
+    int n, d, k, max_iter = KMEANS_MAX_ITER, iterations, i, *labels;
+    PyObject *PyDataPoints, *Py_labels, *result;
+
+    if (!PyArg_ParseTuple(args, "Oi|id", &PyDataPoints, &k, &max_iter, &eps)) {
+        return NULL;
+    }
+    VALIDATE_LIST(PyDataPoints);
+    n = PyList_Size(PyDataPoints);
+    d = n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
+    if (k <= 0 || k > n || max_iter < 0) {
+        PyErr_SetString(PyExc_ValueError, "Invalid number of clusters or iterations.");
+        return NULL;
+    }
+    labels = malloc(n * sizeof(int));
+    if (check_pointer(labels)) exit(1);
+    data_matrix = create_matrix(n, d);
+    centroids = create_matrix(k, d);
+    PyObj_To_cMatrix(PyDataPoints, data_matrix, n, d);
+
+    Py_BEGIN_ALLOW_THREADS
+    iterations = kmeans_fit(data_matrix, n, d, k, max_iter, eps, centroids, labels);
+    Py_END_ALLOW_THREADS
+    Py_labels = PyList_New(n);
+    for (i = 0; i < n; i++) PyList_SET_ITEM(Py_labels, i, PyLong_FromLong(labels[i]));
+    result = Py_BuildValue("(NNi)", cMatrix_to_PyObject(centroids, k, d), Py_labels, iterations);
+
+    free_matrix(data_matrix, n), free_matrix(centroids, k), free(labels);
+    return result;
+}
+
+/*
+ * Copies a dataset given as text (str or bytes) into a new '\0'-terminated buffer.
+ * Parameters:
+ *   PyText: The str or bytes object.
+ * Returns: The buffer, or NULL (with a Python error set) when PyText is neither.
+ */
+static char* PyText_To_cBuffer(PyObject* PyText)
+{
+    const char *bytes;
+    Py_ssize_t length;
+    char *text;
+
+    if (PyUnicode_Check(PyText)) {
+        bytes = PyUnicode_AsUTF8AndSize(PyText, &length);
+        if (bytes == NULL) return NULL;
+    } else if (PyBytes_Check(PyText)) {
+        bytes = PyBytes_AS_STRING(PyText), length = PyBytes_GET_SIZE(PyText);
+    } else {
+        PyErr_SetString(PyExc_TypeError, "Every dataset must be a list of lists, str or bytes.");
+        return NULL;
+    }
+    text = malloc(length + 1);
+    if (check_pointer(text)) exit(1);
+    memcpy(text, bytes, length);
+    text[length] = '\0';
+    return text;
+}
+
+/*
+ * Python wrapper function for running one goal on many independent datasets in a single call.
+ * The datasets are converted (text is only copied, it is parsed in C) and then solved
+ *   concurrently on a work-stealing pool with the GIL released.
+ * Parameters: Goal name ("sym", "ddg", "norm" or "symnmf"), Python list of datasets (each a
+ *   list of lists of points, or the text of a points file as str or bytes), the number of
+ *   clusters as an int shared by every dataset or a list with one k per dataset (symnmf only)
+ *   and an optional seed of the initial H, drawn in C as 2*sqrt(mean(W)/k) * uniform.
+ * Returns: Python list with, in order, the goal matrix (H for symnmf) of every dataset, None
+ *   for a dataset that could not be parsed or has an invalid k.
+ */
+static PyObject* py_batch(PyObject *self, PyObject *args){
+    const char *goal_name;
+    int goal, count, j;
+    unsigned long seed = BATCH_DEFAULT_SEED;
+    batch_job *jobs;
+    PyObject *PyDatasets, *PyKs = NULL, *dataset, *result;
+
+    if (!PyArg_ParseTuple(args, "sO|Ok", &goal_name, &PyDatasets, &PyKs, &seed)) {
+        return NULL;
+    }
+    VALIDATE_LIST(PyDatasets);
+    goal = find_batch_goal(goal_name);
+    count = PyList_Size(PyDatasets);
+    if (goal < 0 || (PyKs != NULL && PyList_Check(PyKs) && PyList_Size(PyKs) != count)) {
+        PyErr_SetString(PyExc_ValueError, "Unknown goal or one k per dataset expected.");
+        return NULL;
+    }
+    jobs = calloc(count > 0 ? count : 1, sizeof(batch_job));
+    if (check_pointer(jobs)) exit(1);
+    for (j = 0; j < count; j++) {
+        dataset = PyList_GetItem(PyDatasets, j);
+        if (PyKs != NULL && PyKs != Py_None) {
+            jobs[j].k = (int)PyLong_AsLong(PyList_Check(PyKs) ? PyList_GetItem(PyKs, j) : PyKs);
+        }
+        if (PyList_Check(dataset)) {
+            jobs[j].n = PyList_Size(dataset);
+            jobs[j].d = jobs[j].n > 0 ? PyList_Size(PyList_GetItem(dataset, 0)) : 0;
+            jobs[j].data = create_matrix(jobs[j].n, jobs[j].d);
+            PyObj_To_cMatrix(dataset, jobs[j].data, jobs[j].n, jobs[j].d);
+        } else {
+            jobs[j].text = PyText_To_cBuffer(dataset);
+        }
+        if (PyErr_Occurred()) {
+            free_batch_jobs(jobs, count), free(jobs);
+            return NULL;
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    batch_run(jobs, count, goal, seed);
+    Py_END_ALLOW_THREADS
+
+    result = PyList_New(count);
+    for (j = 0; j < count; j++) {
+        if (jobs[j].status != 0) {
+            Py_INCREF(Py_None);
+            PyList_SET_ITEM(result, j, Py_None);
+        } else {
+            PyList_SET_ITEM(result, j, cMatrix_to_PyObject(jobs[j].result, jobs[j].rows, jobs[j].columns));
+        }
+    }
+    free_batch_jobs(jobs, count), free(jobs);
+    return result;
+}
+
+/*
+ * Thread entry point of a Job: runs the solver under the job's control, then signals completion.
+ */
+static void* run_job(void* arg){
+    JobObject *job = (JobObject*)arg;
+    char done = 1;
+
+    if (job->kind == JOB_SYMNMF) {
+        job->result = optimize_H_controlled(job->result, job->W, job->n, job->k, job->solver->update,
+                                            job->solver->stop, &job->iterations, NULL, &job->control, NULL);
+    } else {
+        job->iterations = kmeans_fit_controlled(job->data, job->n, job->d, job->k, job->max_iter, job->eps,
+                                                job->result, job->labels, &job->control);
+    }
+    pthread_mutex_lock(&job->lock);
+    job->finished = 1;
+    pthread_cond_broadcast(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+    if (write(job->ready_fds[1], &done, 1) != 1) {
+        /* waiters on cond are woken all the same, only event loops miss the wake-up */
+    }
+    return NULL;
+}
+
+/*
+ * Starts the thread of a job whose inputs are ready.
+ * Returns: The job, or NULL (the job released) when the thread cannot start.
+ */
+static PyObject* start_job(JobObject *job){
+    if (pthread_create(&job->thread, NULL, run_job, job) != 0) {
+        Py_DECREF(job);
+        PyErr_SetString(PyExc_RuntimeError, "Cannot start the job thread.");
+        return NULL;
+    }
+    job->started = 1;
+    return (PyObject*)job;
+}
+
+/*
+ * Waits until the job finished, with the GIL released, checking for signals every JOB_WAIT_SLICE
+ *   seconds so that Ctrl-C cancels the job and interrupts the wait.
+ * Parameters: The job and a timeout in seconds (negative waits forever).
+ * Returns: 1 once finished, 0 on timeout, -1 with a Python error set (the job cancelled).
+ */
+static int wait_job(JobObject *job, double timeout){
+    struct timespec until;
+    double end = timeout >= 0 ? control_now() + timeout : -1, slice;
+    int finished;
+
+    for (;;) {
+        slice = end < 0 ? JOB_WAIT_SLICE : end - control_now();
+        if (slice > JOB_WAIT_SLICE) slice = JOB_WAIT_SLICE;
+        Py_BEGIN_ALLOW_THREADS
+        pthread_mutex_lock(&job->lock);
+        if (!job->finished && slice > 0) {
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_sec += (time_t)slice;
+            until.tv_nsec += (long)((slice - (time_t)slice) * 1e9);
+            if (until.tv_nsec >= 1000000000L) until.tv_sec++, until.tv_nsec -= 1000000000L;
+            pthread_cond_timedwait(&job->cond, &job->lock, &until);
+        }
+        finished = job->finished;
+        pthread_mutex_unlock(&job->lock);
+        Py_END_ALLOW_THREADS
+        if (finished) return 1;
+        if (PyErr_CheckSignals() != 0) {
+            control_cancel(&job->control);
+            return -1;
+        }
+        if (end >= 0 && control_now() >= end) return 0;
+    }
+}
+
+/*
+ * Name of a control_state, as reported by Job.poll.
+ */
+static const char* job_state_name(int state){
+    static const char* names[] = {"running", "done", "cancelled", "timed_out"};
+    return state >= 0 && state <= CONTROL_TIMED_OUT ? names[state] : "unknown";
+}
+
+/*
+ * Job.poll(): progress of the job without waiting.
+ * Returns: Python dict with "state" ("running", "done", "cancelled" or "timed_out"),
+ *   "iteration", "delta" and "objective" (None until first computed).
+ */
+static PyObject* Job_poll(JobObject *self, PyObject *Py_UNUSED(args)){
+    int iteration, state;
+    double delta, objective;
+    PyObject *Py_objective;
+
+    control_read(&self->control, &iteration, &delta, &objective, &state);
+    if (state != CONTROL_RUNNING) {
+        pthread_mutex_lock(&self->lock);
+        if (!self->finished) state = CONTROL_RUNNING; /* stopping, the result is not there yet */
+        pthread_mutex_unlock(&self->lock);
+    }
+    Py_objective = objective >= 0 ? PyFloat_FromDouble(objective) : (Py_INCREF(Py_None), Py_None);
+    return Py_BuildValue("{s:s,s:i,s:d,s:N}", "state", job_state_name(state), "iteration", iteration,
+                         "delta", delta, "objective", Py_objective);
+}
+
+/*
+ * Job.done(): whether the result is available.
+ */
+static PyObject* Job_done(JobObject *self, PyObject *Py_UNUSED(args)){
+    int finished;
+    pthread_mutex_lock(&self->lock);
+    finished = self->finished;
+    pthread_mutex_unlock(&self->lock);
+    return PyBool_FromLong(finished);
+}
+
+/*
+ * Job.cancel(): asks the job to stop before its next iteration; its result is then the
+ *   iterate it had reached. Returns None.
+ */
+static PyObject* Job_cancel(JobObject *self, PyObject *Py_UNUSED(args)){
+    control_cancel(&self->control);
+    Py_RETURN_NONE;
+}
+
+/*
+ * Job.set_budget(seconds): the job stops before the first iteration that would start more
+ *   than seconds from now (0 or less removes the budget). Returns None.
+ */
+static PyObject* Job_set_budget(JobObject *self, PyObject *args){
+    double seconds;
+    if (!PyArg_ParseTuple(args, "d", &seconds)) {
+        return NULL;
+    }
+    control_set_budget(&self->control, seconds);
+    Py_RETURN_NONE;
+}
+
+/*
+ * Job.result([timeout]): waits for the job (Ctrl-C cancels it) and converts its result.
+ * Returns: H for symnmf, a tuple (centroids, labels, iterations) for k-means.
+ *   Raises TimeoutError when timeout seconds pass first.
+ */
+static PyObject* Job_result(JobObject *self, PyObject *args){
+    double timeout = -1;
+    PyObject *Py_labels;
+    int status, i;
+
+    if (!PyArg_ParseTuple(args, "|d", &timeout)) {
+        return NULL;
+    }
+    status = wait_job(self, timeout);
+    if (status < 0) return NULL;
+    if (status == 0) {
+        PyErr_SetString(PyExc_TimeoutError, "The job is still running.");
+        return NULL;
+    }
+    if (self->kind == JOB_SYMNMF) {
+        return cMatrix_to_PyObject(self->result, self->n, self->k);
+    }
+    Py_labels = PyList_New(self->n);
+    for (i = 0; i < self->n; i++) PyList_SET_ITEM(Py_labels, i, PyLong_FromLong(self->labels[i]));
+    return Py_BuildValue("(NNi)", cMatrix_to_PyObject(self->result, self->k, self->d), Py_labels, self->iterations);
+}
+
+/*
+ * Job.fileno(): a descriptor that becomes readable once the job finished, for event loops.
+ */
+static PyObject* Job_fileno(JobObject *self, PyObject *Py_UNUSED(args)){
+    return PyLong_FromLong(self->ready_fds[0]);
+}
+
+/*
+ * Completion callback registered on the asyncio loop by Job.__await__.
+ * Parameters: self is the tuple (job, future, loop).
+ */
+static PyObject* job_ready(PyObject *self, PyObject *Py_UNUSED(args)){
+    PyObject *job = PyTuple_GET_ITEM(self, 0), *future = PyTuple_GET_ITEM(self, 1);
+    PyObject *loop = PyTuple_GET_ITEM(self, 2), *done, *result, *outcome, *type, *value, *traceback;
+
+    outcome = PyObject_CallMethod(loop, "remove_reader", "i", ((JobObject*)job)->ready_fds[0]);
+    Py_XDECREF(outcome);
+    done = PyObject_CallMethod(future, "done", NULL);
+    if (done != NULL && !PyObject_IsTrue(done)) {
+        result = PyObject_CallMethod(job, "result", NULL);
+        if (result != NULL) {
+            outcome = PyObject_CallMethod(future, "set_result", "(O)", result);
+        } else {
+            PyErr_Fetch(&type, &value, &traceback);
+            PyErr_NormalizeException(&type, &value, &traceback);
+            outcome = PyObject_CallMethod(future, "set_exception", "(O)", value);
+            Py_XDECREF(type), Py_XDECREF(value), Py_XDECREF(traceback);
+        }
+        Py_XDECREF(result);
+        Py_XDECREF(outcome);
+    }
+    Py_XDECREF(done);
+    PyErr_Clear();
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef job_ready_def = {"job_ready", job_ready, METH_NOARGS, NULL};
+
+/*
+ * await job: a future of the running asyncio loop, resolved with Job.result() when the job's
+ *   descriptor becomes readable, so waiting never blocks the loop.
+ */
+static PyObject* Job_await(JobObject *self){
+    PyObject *asyncio, *loop = NULL, *future = NULL, *context = NULL, *callback = NULL, *outcome, *awaitable = NULL;
+
+    asyncio = PyImport_ImportModule("asyncio");
+    if (asyncio != NULL) loop = PyObject_CallMethod(asyncio, "get_running_loop", NULL);
+    if (loop != NULL) future = PyObject_CallMethod(loop, "create_future", NULL);
+    if (future != NULL) context = Py_BuildValue("(OOO)", self, future, loop);
+    if (context != NULL) callback = PyCFunction_New(&job_ready_def, context);
+    if (callback != NULL) {
+        outcome = PyObject_CallMethod(loop, "add_reader", "iO", self->ready_fds[0], callback);
+        if (outcome != NULL) awaitable = PyObject_CallMethod(future, "__await__", NULL);
+        Py_XDECREF(outcome);
+    }
+    Py_XDECREF(asyncio), Py_XDECREF(loop), Py_XDECREF(future), Py_XDECREF(context), Py_XDECREF(callback);
+    return awaitable;
+}
+
+/*
+ * Releases a job: a job still running is cancelled and joined first.
+ */
+static void Job_dealloc(JobObject *self){
+    if (self->started) {
+        control_cancel(&self->control);
+        Py_BEGIN_ALLOW_THREADS
+        pthread_join(self->thread, NULL);
+        Py_END_ALLOW_THREADS
+    }
+    if (self->W != NULL) free_matrix(self->W, self->n);
+    if (self->data != NULL) free_matrix(self->data, self->n);
+    if (self->result != NULL) free_matrix(self->result, self->kind == JOB_SYMNMF ? self->n : self->k);
+    free(self->labels);
+    if (self->has_snapshot) checkpoint_destroy(&self->snapshot);
+    close(self->ready_fds[0]), close(self->ready_fds[1]);
+    control_destroy(&self->control);
+    pthread_cond_destroy(&self->cond), pthread_mutex_destroy(&self->lock);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyMethodDef Job_methods[] = {
+    {"poll", (PyCFunction)Job_poll, METH_NOARGS, "Progress of the job: state, iteration, delta and objective."},
+    {"done", (PyCFunction)Job_done, METH_NOARGS, "Whether the result is available."},
+    {"cancel", (PyCFunction)Job_cancel, METH_NOARGS, "Stop before the next iteration, keeping the iterate reached."},
+    {"set_budget", (PyCFunction)Job_set_budget, METH_VARARGS, "Stop once this many seconds from now have passed."},
+    {"result", (PyCFunction)Job_result, METH_VARARGS, "Wait for the job (Ctrl-C cancels it) and return its result."},
+    {"fileno", (PyCFunction)Job_fileno, METH_NOARGS, "Descriptor readable once the job finished."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyAsyncMethods Job_async = {(unaryfunc)Job_await, NULL, NULL, NULL};
+
+static PyTypeObject JobType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "symnmfmodule.Job",
+    .tp_basicsize = sizeof(JobObject),
+    .tp_dealloc = (destructor)Job_dealloc,
+    .tp_as_async = &Job_async,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "A symNMF or k-means run in the background, from symnmf_async or kmeans_async.",
+    .tp_methods = Job_methods,
+};
+
+/*
+ * Allocates a Job with its synchronization set up and no inputs yet.
+ * Parameters: The job_kind and the time budget in seconds (0 for none), counted from now.
+ * Returns: The job, or NULL with a Python error set.
+ */
+static JobObject* new_job(int kind, double budget){
+    JobObject *job = PyObject_New(JobObject, &JobType);
+    if (job == NULL) return NULL;
+    job->kind = kind, job->started = 0, job->finished = 0;
+    job->W = job->data = job->result = NULL, job->labels = NULL;
+    job->n = job->k = job->d = job->max_iter = job->iterations = 0;
+    job->eps = 0, job->solver = NULL, job->has_snapshot = 0;
+    control_init(&job->control);
+    control_set_budget(&job->control, budget);
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->cond, NULL);
+    if (pipe(job->ready_fds) != 0) {
+        job->ready_fds[0] = job->ready_fds[1] = -1;
+        Py_DECREF(job);
+        PyErr_SetFromErrno(PyExc_OSError);
+        return NULL;
+    }
+    return job;
+}
+
+/*
+ * Attaches a checkpoint to a job whose iterate is allocated, resuming from the file when it
+ *   holds a snapshot of the same kind, shape and input data.
+ * Parameters: The job, the checkpoint's path, interval, whether to store W and seed, the
+ *   data the job runs on (data_rows x data_columns, fingerprinted), the iterate's shape and
+ *   where to put a stored W (NULL when not wanted).
+ * Returns: 1 when the job resumes from the file, 0 when it starts fresh.
+ */
+static int attach_checkpoint(JobObject *job, const char *path, int interval, int with_W, unsigned long seed,
+                             double **data, int data_rows, int data_columns, int rows, int columns, double ***W){
+    checkpoint_init(&job->snapshot, path, job->kind == JOB_SYMNMF ? CHECKPOINT_SYMNMF : CHECKPOINT_KMEANS,
+                    interval, with_W, seed);
+    checkpoint_fingerprint(&job->snapshot, data, data_rows, data_columns, NULL);
+    job->has_snapshot = 1;
+    job->control.checkpoint = &job->snapshot;
+    return checkpoint_load(&job->snapshot, job->result, rows, columns, W) == 0;
+}
+
+/*
+ * Python wrapper function starting symNMF on W in the background.
+ * Parameters: Python list of lists for W and H, number of rows (n), clusters (k), optional
+ *   solver name ("mu", "hals" or "pgd"), optional time budget in seconds (0 for none), optional
+ *   checkpoint path, optional iterations between snapshots, optional flag storing W in them,
+ *   optional seed recorded in them and optional points W was built from. A run resuming from
+ *   the checkpoint takes H from it, so H may be None, and W may be None when the checkpoint
+ *   stored it. The checkpoint is resumed only for the same points (or the same W when the
+ *   points are not given), so the points are needed when W is None.
+ * Returns: A Job; its result is H, the iterate reached when it was cancelled or timed out.
+ */
+static PyObject* py_symnmf_async(PyObject *self, PyObject *args){
+    double budget = 0, **stored_W = NULL;
+    int n, k, interval = CHECKPOINT_DEFAULT_INTERVAL, with_W = 0, resumed = 0;
+    unsigned long seed = 0;
+    const char *solver_name = NULL, *path = NULL;
+    const symnmf_solver *solver;
+    JobObject *job;
+    PyObject *Py_W, *Py_H, *Py_points = Py_None;
+    double **points = NULL;
+    int m = 0, d = 0;
+
+    if (!PyArg_ParseTuple(args, "OOii|zdzipkO", &Py_W, &Py_H, &n, &k, &solver_name, &budget,
+                          &path, &interval, &with_W, &seed, &Py_points)) {
+        return NULL;
+    }
+    if (Py_W != Py_None) VALIDATE_LIST(Py_W);
+    if (Py_H != Py_None) VALIDATE_LIST(Py_H);
+    if (Py_points != Py_None) VALIDATE_LIST(Py_points);
+    if (path != NULL && Py_W == Py_None && Py_points == Py_None) {
+        PyErr_SetString(PyExc_ValueError, "A checkpoint needs W or the points to check it belongs to them.");
+        return NULL;
+    }
+    solver = find_solver(solver_name);
+    if (solver == NULL || solver->update == NULL) {
+        PyErr_SetString(PyExc_ValueError, "Unknown solver, or a solver with only its own loop.");
+        return NULL;
+    }
+    job = new_job(JOB_SYMNMF, budget);
+    if (job == NULL) return NULL;
+    job->n = n, job->k = k, job->solver = solver;
+    job->result = create_matrix(n, k);
+    if (Py_W != Py_None) {
+        job->W = create_matrix(n, n);
+        PyObj_To_cMatrix(Py_W, job->W, n, n);
+    }
+    if (path != NULL && Py_points != Py_None) {
+        m = PyList_Size(Py_points);
+        d = m > 0 ? PyList_Size(PyList_GetItem(Py_points, 0)) : 0;
+        points = create_matrix(m, d);
+        PyObj_To_cMatrix(Py_points, points, m, d);
+        resumed = attach_checkpoint(job, path, interval, with_W, seed, points, m, d, n, k,
+                                    Py_W == Py_None ? &stored_W : NULL);
+        free_matrix(points, m);
+    } else if (path != NULL) {
+        resumed = attach_checkpoint(job, path, interval, with_W, seed, job->W, n, n, n, k, NULL);
+    }
+    if ((Py_W == Py_None && stored_W == NULL) || (Py_H == Py_None && !resumed)) {
+        Py_DECREF(job);
+        PyErr_SetString(PyExc_ValueError, "W and H are needed unless the checkpoint holds them.");
+        return NULL;
+    }
+    if (job->W == NULL) job->W = stored_W;
+    if (!resumed) PyObj_To_cMatrix(Py_H, job->result, n, k);
+    return start_job(job);
+}
+
+/*
+ * Python wrapper function starting the native k-means in the background.
+ * Parameters: Python list of lists (data points), clusters (k), optional maximum number of
+ *   iterations, optional convergence threshold, optional time budget in seconds (0 for none),
+ *   optional checkpoint path and optional iterations between snapshots. A run resuming from the
+ *   checkpoint starts from its centroids instead of the first k points.
+ * Returns: A Job; its result is (centroids, labels, iterations), the centroids reached when it
+ *   was cancelled or timed out.
+ */
+static PyObject* py_kmeans_async(PyObject *self, PyObject *args){
+    double eps = KMEANS_EPSILON, budget = 0;
+    int n, d, k, max_iter = KMEANS_MAX_ITER, interval = CHECKPOINT_DEFAULT_INTERVAL;
+    const char *path = NULL;
+    JobObject *job;
+    PyObject *PyDataPoints;
+
+    if (!PyArg_ParseTuple(args, "Oi|iddzi", &PyDataPoints, &k, &max_iter, &eps, &budget, &path, &interval)) {
+        return NULL;
+    }
+    VALIDATE_LIST(PyDataPoints);
+    n = PyList_Size(PyDataPoints);
+    d = n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
+    if (k <= 0 || k > n || max_iter < 0) {
+        PyErr_SetString(PyExc_ValueError, "Invalid number of clusters or iterations.");
+        return NULL;
+    }
+    job = new_job(JOB_KMEANS, budget);
+    if (job == NULL) return NULL;
+    job->n = n, job->d = d, job->k = k, job->max_iter = max_iter, job->eps = eps;
+    job->data = create_matrix(n, d);
+    job->result = create_matrix(k, d);
+    job->labels = malloc(n * sizeof(int));
+    if (check_pointer(job->labels)) exit(1);
+    PyObj_To_cMatrix(PyDataPoints, job->data, n, d);
+    if (path != NULL) attach_checkpoint(job, path, interval, 0, 0, job->data, n, d, k, d, NULL);
+    return start_job(job);
+}
+
+/*
+ * Python wrapper function describing a checkpoint file without loading it.
+ * Parameters: The checkpoint path and optional points the run works on.
+ * Returns: None for a missing or invalid file or one saved from other points, otherwise a
+ *   dict with the kind ("symnmf" or
+ *   "kmeans"), the iteration, whether the loop had finished, the iterate's rows and columns,
+ *   whether W is stored, the seed and the history as a list of (iteration, objective) pairs.
+ */
+static PyObject* py_checkpoint_info(PyObject *self, PyObject *args){
+    const char *path;
+    checkpoint_header header;
+    checkpoint cp;
+    double *history, **points;
+    PyObject *Py_history, *Py_points = Py_None;
+    unsigned int i;
+    int n, d;
+
+    if (!PyArg_ParseTuple(args, "s|O", &path, &Py_points)) {
+        return NULL;
+    }
+    if (Py_points != Py_None) VALIDATE_LIST(Py_points);
+    if (checkpoint_probe(path, &header, &history) != 0) {
+        Py_RETURN_NONE;
+    }
+    if (Py_points != Py_None) {
+        n = PyList_Size(Py_points);
+        d = n > 0 ? PyList_Size(PyList_GetItem(Py_points, 0)) : 0;
+        points = create_matrix(n, d);
+        PyObj_To_cMatrix(Py_points, points, n, d);
+        checkpoint_fingerprint(&cp, points, n, d, NULL);
+        free_matrix(points, n);
+        if (header.data_key[0] != cp.data_key[0] || header.data_key[1] != cp.data_key[1]) {
+            free(history);
+            Py_RETURN_NONE;
+        }
+    }
+    Py_history = PyList_New(header.history_length);
+    for (i = 0; i < header.history_length; i++) {
+        PyList_SET_ITEM(Py_history, i, Py_BuildValue("(id)", (int)history[2 * i], history[2 * i + 1]));
+    }
+    free(history);
+    return Py_BuildValue("{s:s,s:I,s:O,s:I,s:I,s:O,s:k,s:N}",
+                         "kind", header.kind == CHECKPOINT_SYMNMF ? "symnmf" : "kmeans",
+                         "iteration", header.iteration, "finished", header.finished ? Py_True : Py_False,
+                         "rows", header.rows, "columns", header.columns,
+                         "has_W", header.has_W ? Py_True : Py_False,
+                         "seed", header.seed[0] | (((unsigned long)header.seed[1] << 16) << 16),
+                         "history", Py_history);
+}
+
+/*
+ * Whether an Incremental may be used: an update running on another thread reallocates H, the
+ *   degrees and the points with the GIL released, so nothing reads them until it returns.
+ * Returns: 1 when no update runs, 0 with a RuntimeError set otherwise.
+ */
+static int incremental_idle(IncrementalObject *self){
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "An update of this Incremental is already running.");
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Appends points to an Incremental and warm-starts symNMF from its previous H.
+ * Parameters: Python list of lists (the new points, of the same dimension).
+ * Returns: The H of all the points so far, the new points' rows last.
+ */
+static PyObject* Incremental_extend(IncrementalObject *self, PyObject *args){
+    double **points;
+    int m, d;
+    PyObject *PyDataPoints;
+
+    if (!PyArg_ParseTuple(args, "O", &PyDataPoints)) {
+        return NULL;
+    }
+    VALIDATE_LIST(PyDataPoints);
+    m = PyList_Size(PyDataPoints);
+    d = m > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
+    if (m == 0 || d != self->state.d) {
+        PyErr_SetString(PyExc_ValueError, "Expected new points of the same dimension.");
+        return NULL;
+    }
+    if (!incremental_idle(self)) return NULL;
+    points = create_matrix(m, d);
+    PyObj_To_cMatrix(PyDataPoints, points, m, d);
+
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    incremental_extend(&self->state, points, m);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+    free_matrix(points, m);
+    return cMatrix_to_PyObject(self->state.H, self->state.n, self->state.k);
+}
+
+/*
+ * The current H of an Incremental.
+ * Returns: Python list of lists, n x k.
+ */
+static PyObject* Incremental_H(IncrementalObject *self, PyObject *Py_UNUSED(args)){
+    if (!incremental_idle(self)) return NULL;
+    return cMatrix_to_PyObject(self->state.H, self->state.n, self->state.k);
+}
+
+/*
+ * The degree vector of an Incremental, the diagonal of D for all the points so far.
+ * Returns: Python list of n floats.
+ */
+static PyObject* Incremental_degree(IncrementalObject *self, PyObject *Py_UNUSED(args)){
+    PyObject *degree;
+    int i;
+
+    if (!incremental_idle(self)) return NULL;
+    degree = PyList_New(self->state.n);
+    for (i = 0; i < self->state.n; i++) {
+        PyList_SET_ITEM(degree, i, PyFloat_FromDouble(self->state.degree[i]));
+    }
+    return degree;
+}
+
+/*
+ * Size of an Incremental and the cost of its last solve.
+ * Returns: Python dict with n, d, k and the iterations of the last optimization.
+ */
+static PyObject* Incremental_info(IncrementalObject *self, PyObject *Py_UNUSED(args)){
+    if (!incremental_idle(self)) return NULL;
+    return Py_BuildValue("{s:i,s:i,s:i,s:i}", "n", self->state.n, "d", self->state.d,
+                         "k", self->state.k, "iterations", self->state.iterations);
+}
+
+static void Incremental_dealloc(IncrementalObject *self){
+    free_incremental_state(&self->state);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyMethodDef Incremental_methods[] = {
+    {"extend", (PyCFunction)Incremental_extend, METH_VARARGS, "Append points and warm-start symNMF, returning the new H."},
+    {"H", (PyCFunction)Incremental_H, METH_NOARGS, "The current H."},
+    {"degree", (PyCFunction)Incremental_degree, METH_NOARGS, "The degree of every point."},
+    {"info", (PyCFunction)Incremental_info, METH_NOARGS, "n, d, k and the iterations of the last solve."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject IncrementalType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "symnmfmodule.Incremental",
+    .tp_basicsize = sizeof(IncrementalObject),
+    .tp_dealloc = (destructor)Incremental_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "A dataset growing by appended points with its symNMF, from symnmf_incremental.",
+    .tp_methods = Incremental_methods,
+};
+
+/*
+ * Python wrapper function starting an incremental symNMF: A and the degrees are built once and
+ *   only extended by Incremental.extend, W is never materialized.
+ * Parameters: Python list of lists (data points), clusters (k) and an optional seed of the
+ *   initial H.
+ * Returns: An Incremental holding the solved state; its H() is the factor of the points.
+ */
+static PyObject* py_symnmf_incremental(PyObject *self, PyObject *args){
+    double **data_matrix;
+    int n, d, k, status;
+    unsigned long seed = INCREMENTAL_DEFAULT_SEED;
+    IncrementalObject *incremental;
+    PyObject *PyDataPoints;
+
+    if (!PyArg_ParseTuple(args, "Oi|k", &PyDataPoints, &k, &seed)) {
+        return NULL;
+    }
+    VALIDATE_LIST(PyDataPoints);
+    n = PyList_Size(PyDataPoints);
+    d = n > 0 ? PyList_Size(PyList_GetItem(PyDataPoints, 0)) : 0;
+    if (k <= 0 || k >= n) {
+        PyErr_SetString(PyExc_ValueError, "Invalid number of clusters.");
+        return NULL;
+    }
+    incremental = PyObject_New(IncrementalObject, &IncrementalType);
+    if (incremental == NULL) return NULL;
+    memset(&incremental->state, 0, sizeof(incremental->state));
+    incremental->busy = 1;
+    data_matrix = create_matrix(n, d);
+    PyObj_To_cMatrix(PyDataPoints, data_matrix, n, d);
+
+    Py_BEGIN_ALLOW_THREADS
+    status = incremental_init(&incremental->state, data_matrix, n, d, k, seed);
+    Py_END_ALLOW_THREADS
+    incremental->busy = 0;
+    free_matrix(data_matrix, n);
+    if (status != 0) {
+        Py_DECREF(incremental);
+        PyErr_SetString(PyExc_ValueError, "Invalid number of clusters.");
+        return NULL;
+    }
+    return (PyObject*)incremental;
+}
+
+/*
+ * Python wrapper function for turning the run statistics on or off.
+ * Parameters: A flag, true to record. The recorded statistics are cleared either way.
+ * Returns: None.
+ */
+static PyObject* py_set_stats(PyObject *self, PyObject *args){
+    int enabled;
+    if (!PyArg_ParseTuple(args, "p", &enabled)) {
+        return NULL;
+    }
+    stats_enable(enabled);
+    Py_RETURN_NONE;
+}
+
+/*
+ * Python wrapper function for reading the run statistics recorded since set_stats(True).
+ * Parameters: None.
+ * Returns: Python dict with "stages" (stage name to a dict of wall and CPU seconds and calls,
+ *   stages that never ran are left out), "iterations", "final_delta", "allocations",
+ *   "allocated_bytes" and "peak_rss_kb", or None when the statistics are off.
+ */
+static PyObject* py_get_stats(PyObject *self, PyObject *args){
+    const stage_stats* stage;
+    PyObject *stages, *entry;
+    int i;
+
+    if (!symnmf_stats.enabled) {
+        Py_RETURN_NONE;
+    }
+    stats_finish();
+    stages = PyDict_New();
+    for (i = 0; i < STAGE_COUNT; i++) {
+        stage = &symnmf_stats.stages[i];
+        if (stage->calls == 0) continue;
+        entry = Py_BuildValue("{s:d,s:d,s:l}", "wall", stage->wall, "cpu", stage->cpu, "calls", stage->calls);
+        PyDict_SetItemString(stages, stats_stage_name(i), entry);
+        Py_DECREF(entry);
+    }
+    return Py_BuildValue("{s:N,s:i,s:d,s:l,s:n,s:l}", "stages", stages,
+                         "iterations", symnmf_stats.iterations, "final_delta", symnmf_stats.final_delta,
+                         "allocations", symnmf_stats.allocations,
+                         "allocated_bytes", (Py_ssize_t)symnmf_stats.allocated_bytes,
+                         "peak_rss_kb", symnmf_stats.peak_rss_kb);
+}
 
 static PyMethodDef symNMF_Methods[] = {
     {"sym", py_sym, METH_VARARGS, "Calculate the similarity matrix."},
     {"ddg", py_ddg, METH_VARARGS, "Calculate the diagonal degree matrix."},
     {"norm", py_norm, METH_VARARGS, "Calculate the normalized similarity matrix."},
     {"symnmf", py_symnmf, METH_VARARGS, "Perform the full symNMF."},
+    {"coreset", py_coreset, METH_VARARGS, "Build a weighted coreset of the data points."},
+    {"spectral_init", py_spectral_init, METH_VARARGS, "Initialize H from the top-k eigenvectors of W."},
+    {"norm_mean", py_norm_mean, METH_VARARGS, "Mean of the (optionally Nystrom-approximated) normalized similarity matrix, computed matrix-free."},
+    {"symnmf_matrix_free", py_symnmf_matrix_free, METH_VARARGS, "Perform symNMF without materializing W."},
+    {"symnmf_nystrom", py_symnmf_nystrom, METH_VARARGS, "Perform symNMF on a Nystrom approximation of W."},
+    {"symnmf_packed", py_symnmf_packed, METH_VARARGS, "Perform symNMF with W in packed symmetric storage."},
+    {"symnmf_sweep", py_symnmf_sweep, METH_VARARGS, "Perform symNMF for several k on a shared W with warm starts."},
+    {"symnmf_multistart", py_symnmf_multistart, METH_VARARGS, "Perform parallel multi-start symNMF and keep the best objective."},
+    {"silhouette", py_silhouette, METH_VARARGS, "Mean silhouette of several labelings in one pass over the distances."},
+    {"kmeans", py_kmeans, METH_VARARGS, "Native k-means returning centroids and labels."},
+    {"symnmf_multilevel", py_symnmf_multilevel, METH_VARARGS, "Perform multilevel (coarsen, solve, refine) symNMF."},
+    {"symnmf_async", py_symnmf_async, METH_VARARGS, "Start symNMF in the background and return a Job."},
+    {"kmeans_async", py_kmeans_async, METH_VARARGS, "Start the native k-means in the background and return a Job."},
+    {"checkpoint_info", py_checkpoint_info, METH_VARARGS, "Describe a checkpoint file, None when missing or invalid."},
+    {"symnmf_incremental", py_symnmf_incremental, METH_VARARGS, "Start an incremental symNMF that grows with appended points."},
+    {"batch", py_batch, METH_VARARGS, "Run one goal on many datasets concurrently in a single call."},
+    {"set_stats", py_set_stats, METH_VARARGS, "Clear the run statistics and turn recording on or off."},
+    {"get_stats", py_get_stats, METH_NOARGS, "Run statistics recorded since set_stats(True)."},
     {NULL, NULL, 0, NULL}
 };
 
@@ -201,9 +1721,24 @@ static struct PyModuleDef symnmfmodule = {
 
 PyMODINIT_FUNC PyInit_symnmfmodule(void) {
     PyObject *m;
+    if (PyType_Ready(&JobType) < 0 || PyType_Ready(&IncrementalType) < 0) {
+        return NULL;
+    }
     m = PyModule_Create(&symnmfmodule);
     if (!m) {
         return NULL;
     }
+    Py_INCREF(&JobType);
+    if (PyModule_AddObject(m, "Job", (PyObject*)&JobType) < 0) {
+        Py_DECREF(&JobType);
+        Py_DECREF(m);
+        return NULL;
+    }
+    Py_INCREF(&IncrementalType);
+    if (PyModule_AddObject(m, "Incremental", (PyObject*)&IncrementalType) < 0) {
+        Py_DECREF(&IncrementalType);
+        Py_DECREF(m);
+        return NULL;
+    }
     return m;
 }
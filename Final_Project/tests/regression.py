@@ -0,0 +1,293 @@
+import os
+import sys
+import json
+import time
+import random
+import shutil
+import tempfile
+import subprocess
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+PROJECT = os.path.dirname(HERE) #Final_Project
+ROOT = os.path.dirname(PROJECT)
+KMEANS_DIR = os.path.join(ROOT, 'kmeans')
+KMEANS_PP_DIR = os.path.join(ROOT, 'kmeans++')
+BASELINE = os.path.join(HERE, 'regression_baseline.json')
+
+TOLERANCE = 1.5e-4 #outputs are printed with 4 decimals
+TIME_MARGIN = 0.5 #allowed relative slowdown before failing
+MEMORY_MARGIN = 0.2 #allowed relative growth of the peak resident set
+MIN_SECONDS = 0.05 #slowdowns smaller than this are treated as noise
+REPEAT = 3 #runs per case, the fastest one is kept
+LARGE_CASES = [(2000, 5, 5), (4000, 8, 8)] #n, d, k of the generated inputs
+TEST_KS = {1: 5, 2: 4, 3: 7} #k of every input under tests, as in tests/readme.txt
+
+def parse_matrix(text):
+    """
+    Parses comma-separated rows of numbers.
+
+    Parameters:
+    text (str): The text.
+
+    Returns:
+    rows: A list of lists of floats, blank lines skipped.
+    """
+    return [[float(x) for x in line.split(',')] for line in text.splitlines() if line.strip()]
+
+def parse_scores(text):
+    """
+    Parses "name: value" lines, as printed by analysis.py.
+
+    Returns:
+    scores: A dict from name to value.
+    """
+    scores = {}
+    for line in text.splitlines():
+        if ':' in line:
+            name, value = line.split(':', 1)
+            scores[name.strip()] = float(value)
+    return scores
+
+def final_H(text):
+    """
+    Keeps the part of an H_matrices golden file after the "H_final:" line.
+    """
+    return text.split('H_final:', 1)[1]
+
+def max_difference(expected, actual):
+    """
+    Largest absolute difference between two matrices, or infinity when their shapes differ.
+    """
+    if len(expected) != len(actual) or any(len(a) != len(b) for a, b in zip(expected, actual)):
+        return float('inf')
+    return max((abs(a - b) for ra, rb in zip(expected, actual) for a, b in zip(ra, rb)), default=0.0)
+
+def check_output(case, output):
+    """
+    Compares the output of a case with its golden file.
+
+    Parameters:
+    case (dict): The case, with its "golden" path and "kind" (matrix, H or scores).
+    output (str): What the case printed.
+
+    Returns:
+    error: None when the output matches within TOLERANCE, otherwise a description.
+    """
+    if case.get('golden') is None:
+        return None
+    with open(case['golden']) as file:
+        golden = file.read()
+    if case['kind'] == 'scores':
+        expected, actual = parse_scores(golden), parse_scores(output)
+        if expected.keys() != actual.keys():
+            return f"scores {sorted(actual)} instead of {sorted(expected)}"
+        diff = max(abs(expected[name] - actual[name]) for name in expected)
+    else:
+        if case['kind'] == 'H':
+            golden = final_H(golden)
+        diff = max_difference(parse_matrix(golden), parse_matrix(output))
+    return None if diff <= TOLERANCE else f"differs from {os.path.relpath(case['golden'], ROOT)} by {diff:.3g}"
+
+def run_once(case):
+    """
+    Runs a case once and measures it. The child is started with posix_spawn and this script
+    keeps no large output in memory, so the peak resident set is the child's own, floored at
+    the small resident set of this script (Linux carries the peak from before exec over).
+
+    Parameters:
+    case (dict): The case: its command, working directory and optional stdin file.
+
+    Returns:
+    output, seconds, peak_rss_kb, status: What it printed (empty for cases without a golden
+    file), its wall time, the peak resident set of the child process and its exit status.
+    """
+    with tempfile.TemporaryFile(mode='w+') as out:
+        actions = [(os.POSIX_SPAWN_OPEN, 0, case.get('stdin') or os.devnull, os.O_RDONLY, 0),
+                   (os.POSIX_SPAWN_OPEN, 2, os.devnull, os.O_WRONLY, 0)]
+        if case.get('golden') is None:
+            actions.append((os.POSIX_SPAWN_OPEN, 1, os.devnull, os.O_WRONLY, 0))
+        else:
+            actions.append((os.POSIX_SPAWN_DUP2, out.fileno(), 1))
+        cwd = os.getcwd()
+        os.chdir(case['cwd'])
+        try:
+            start = time.perf_counter()
+            pid = os.posix_spawnp(case['cmd'][0], case['cmd'], os.environ, file_actions=actions)
+            _, status, usage = os.wait4(pid, 0)
+            seconds = time.perf_counter() - start
+        finally:
+            os.chdir(cwd)
+        out.seek(0)
+        return out.read(), seconds, usage.ru_maxrss, os.waitstatus_to_exitcode(status)
+
+def measure(case, repeat):
+    """
+    Runs a case repeat times, checks its output every time and keeps the fastest run.
+
+    Returns:
+    result: A dict with "seconds", "peak_rss_kb" and "error" (None when it passed).
+    """
+    result = {'seconds': float('inf'), 'peak_rss_kb': 0, 'error': None}
+    for _ in range(repeat):
+        output, seconds, rss, status = run_once(case)
+        error = f"exit status {status}" if status != 0 else check_output(case, output)
+        if error is not None:
+            result['error'] = error
+            return result
+        if seconds < result['seconds']:
+            result['seconds'], result['peak_rss_kb'] = seconds, rss
+    return result
+
+def write_mixture(path, n, d, k, seed):
+    """
+    Writes n points drawn from k unit-variance gaussians in d dimensions, one per line.
+    """
+    rng = random.Random(seed)
+    centers = [[rng.uniform(-4, 4) for _ in range(d)] for _ in range(k)]
+    with open(path, 'w') as file:
+        for _ in range(n):
+            center = centers[rng.randrange(k)]
+            file.write(','.join(f"{c + rng.gauss(0, 1):.4f}" for c in center) + '\n')
+
+def build(python, extensions):
+    """
+    Builds the kmeans CLI and, with extensions, the symnmf CLI and both extensions in place.
+
+    Returns:
+    kmeans: The path of the kmeans CLI.
+    """
+    quiet = {'stdout': subprocess.DEVNULL, 'stderr': subprocess.DEVNULL, 'check': True}
+    if extensions:
+        subprocess.run(['make', 'symnmf'], cwd=PROJECT, **quiet)
+        subprocess.run([python, 'setup.py', 'build_ext', '--inplace'], cwd=PROJECT, **quiet)
+        subprocess.run([python, 'setup.py', 'build_ext', '--inplace'], cwd=KMEANS_PP_DIR, **quiet)
+    subprocess.run(['make', 'kmeans'], cwd=KMEANS_DIR, **quiet)
+    return os.path.join(KMEANS_DIR, 'kmeans')
+
+def make_cases(python, kmeans, workdir, large):
+    """
+    Lists the cases: every entry point on the inputs under tests (checked against the golden
+    files) and, with large, on generated gaussian mixtures (time and memory only).
+    """
+    cases = []
+    for i, k in TEST_KS.items():
+        data = os.path.join(HERE, f"input_{i}.txt")
+        goldens = {'sym': 'similarity_matrix', 'ddg': 'diagonal_degree_matrix', 'norm': 'normalized_matrix'}
+        for goal, golden in goldens.items():
+            golden = os.path.join(HERE, f"{golden}_{i}.txt")
+            cases.append({'name': f"c_{goal}_{i}", 'cmd': ['./symnmf', goal, data], 'cwd': PROJECT,
+                          'golden': golden, 'kind': 'matrix'})
+            cases.append({'name': f"py_{goal}_{i}", 'cmd': [python] + ['symnmf.py', str(k), goal, data],
+                          'cwd': PROJECT, 'golden': golden, 'kind': 'matrix'})
+        cases.append({'name': f"py_symnmf_{i}", 'cmd': [python] + ['symnmf.py', str(k), 'symnmf', data],
+                      'cwd': PROJECT, 'golden': os.path.join(HERE, f"H_matrices_{i}.txt"), 'kind': 'H'})
+        cases.append({'name': f"analysis_{i}", 'cmd': [python] + ['analysis.py', str(k), data],
+                      'cwd': PROJECT, 'golden': os.path.join(HERE, f"analyze_scores_{i}"), 'kind': 'scores'})
+    for i, args in {1: ['3', '600'], 2: ['7'], 3: ['15', '300']}.items():
+        cases.append({'name': f"kmeans_c_{i}", 'cmd': [kmeans] + args, 'cwd': KMEANS_DIR,
+                      'stdin': os.path.join(KMEANS_DIR, f"input_{i}.txt"),
+                      'golden': os.path.join(KMEANS_DIR, f"output_{i}.txt"), 'kind': 'matrix'})
+    for i in (1, 2, 3):
+        cases.append({'name': f"kmeans_pp_{i}", 'cwd': KMEANS_PP_DIR,
+                      'cmd': [python] + ['kmeans_pp.py', '3', '333', '0', f"input_{i}_db_1.txt", f"input_{i}_db_2.txt"]})
+    if large:
+        for n, d, k in LARGE_CASES:
+            data = os.path.join(workdir, f"mixture_{n}_{d}_{k}.txt")
+            write_mixture(data, n, d, k, 1234)
+            tag = f"{n}x{d}"
+            cases.append({'name': f"large_c_norm_{tag}", 'cmd': ['./symnmf', 'norm', data], 'cwd': PROJECT})
+            cases.append({'name': f"large_py_symnmf_{tag}", 'cwd': PROJECT,
+                          'cmd': [python] + ['symnmf.py', str(k), 'symnmf', data, '--packed']})
+            cases.append({'name': f"large_analysis_{tag}", 'cmd': [python] + ['analysis.py', str(k), data],
+                          'cwd': PROJECT})
+            cases.append({'name': f"large_kmeans_c_{tag}", 'cmd': [kmeans, str(k)], 'cwd': KMEANS_DIR, 'stdin': data})
+    return cases
+
+def compare(result, baseline, time_margin, memory_margin):
+    """
+    Compares a measured case with its baseline.
+
+    Returns:
+    problems: The regressions found, empty when none.
+    """
+    problems = []
+    if result['error'] is not None:
+        return [result['error']]
+    if baseline is None:
+        return problems
+    if result['seconds'] > baseline['seconds'] * (1 + time_margin) and \
+            result['seconds'] - baseline['seconds'] > MIN_SECONDS:
+        problems.append(f"{result['seconds']:.3f}s against {baseline['seconds']:.3f}s")
+    if result['peak_rss_kb'] > baseline['peak_rss_kb'] * (1 + memory_margin):
+        problems.append(f"{result['peak_rss_kb']} kB against {baseline['peak_rss_kb']} kB")
+    return problems
+
+def pop_option(argv, name, cast, default):
+    """
+    Removes an option of the form "--name value" from the argument list.
+
+    Returns:
+    value: The cast value, or default when the option is absent.
+    """
+    if name not in argv:
+        return default
+    i = argv.index(name)
+    value = cast(argv[i + 1])
+    del argv[i:i + 2]
+    return value
+
+def main():
+    """
+    End-to-end regression run. Builds everything, runs every case, checks the outputs
+    against the golden files and the run time and peak memory against the stored baselines.
+    Usage: regression.py [--update] [--no-large] [--no-build] [--repeat r]
+                         [--time-margin m] [--memory-margin m] [--python path] [--baseline file]
+    --no-build keeps the symnmf CLI and the extensions as they are (the kmeans CLI is always built).
+    --update rewrites the baselines from this run instead of comparing. Exits with status 1
+    when a case fails or regresses.
+    """
+    argv = sys.argv[1:]
+    update = '--update' in argv
+    large = '--no-large' not in argv
+    skip_build = '--no-build' in argv
+    for flag in ('--update', '--no-large', '--no-build'):
+        if flag in argv:
+            argv.remove(flag)
+    repeat = pop_option(argv, '--repeat', int, REPEAT)
+    time_margin = pop_option(argv, '--time-margin', float, TIME_MARGIN)
+    memory_margin = pop_option(argv, '--memory-margin', float, MEMORY_MARGIN)
+    python = pop_option(argv, '--python', str, sys.executable)
+    baseline_path = pop_option(argv, '--baseline', str, BASELINE)
+    if argv:
+        print(f"unknown arguments: {' '.join(argv)}", file=sys.stderr)
+        sys.exit(2)
+
+    baselines = {}
+    if os.path.exists(baseline_path):
+        with open(baseline_path) as file:
+            baselines = json.load(file)
+    workdir = tempfile.mkdtemp(prefix='symnmf-regression-')
+    failed = False
+    try:
+        kmeans = build(python, not skip_build)
+        print(f"{'case':<28}{'seconds':>10}{'baseline':>10}{'rss kB':>10}{'baseline':>10}  status")
+        for case in make_cases(python, kmeans, workdir, large):
+            result = measure(case, repeat)
+            base = baselines.get(case['name'])
+            problems = compare(result, None if update else base, time_margin, memory_margin)
+            failed = failed or bool(problems)
+            if update and result['error'] is None:
+                baselines[case['name']] = {'seconds': round(result['seconds'], 4), 'peak_rss_kb': result['peak_rss_kb']}
+            print(f"{case['name']:<28}{result['seconds']:>10.3f}"
+                  f"{base['seconds'] if base else float('nan'):>10.3f}{result['peak_rss_kb']:>10}"
+                  f"{base['peak_rss_kb'] if base else '-':>10}  {'; '.join(problems) or 'ok'}")
+    finally:
+        shutil.rmtree(workdir)
+    if update:
+        with open(baseline_path, 'w') as file:
+            json.dump(baselines, file, indent=2, sort_keys=True)
+            file.write('\n')
+    sys.exit(1 if failed else 0)
+
+if __name__ == "__main__":
+    main()
@@ -1,29 +1,18 @@
 import math
 import sys
-import pandas as pd
 import numpy as np
 import mykmeanssp as c
 
 '''
-1. reads file1 and file2
-2. combines dataframes by inner join
-3. sorts merged dataframe in ascending order
-4. creates a matrix out of df and returns it
+1. streams file1 and file2 through the native loader
+2. combines them by inner join on the key column (external sort-merge join)
+3. the joined rows come in ascending key order (ties in file order), in one native buffer
+4. returns a read-only matrix viewing that buffer, which c.fit and c.coreset read without a copy
 '''
 
 
 def join_dataframes(file1, file2):
-    df1 = pd.read_csv(file1, sep=",", header=None)
-    df2 = pd.read_csv(file2, sep=",", header=None)
-
-    df1.rename(columns={0: 'key'}, inplace=True)
-    df2.rename(columns={0: 'key'}, inplace=True)
-
-    df = pd.merge(df1, df2, on='key', how='inner')
-    df.sort_values(by='key', inplace=True)
-    df = df.iloc[:, 1:]  # after merging by key, we need to remove it
-    matrix = df.to_numpy(dtype=float)
-    return matrix
+    return np.asarray(c.join_files(file1, file2))
 
 
 # calculating euclidean distance from two d-dimensional vectors V
@@ -36,7 +25,17 @@ def vector_distance(x, y):
     return res
 
 
-def kmeans_pp(k, iter, eps, file_name_1, file_name_2):
+# with a checkpoint the fit is saved every checkpoint_every iterations, and a rerun of the same command resumes it
+def kmeans_pp(k, iter, eps, file_name_1, file_name_2, coreset_size=None, checkpoint=None, checkpoint_every=25):
+    indices, fit_args = seed_centroids(k, iter, eps, file_name_1, file_name_2, coreset_size)
+    print(','.join(f'{value:}' for value in indices))
+    if checkpoint is not None:
+        fit_args = fit_args + (checkpoint, checkpoint_every)
+    return np.array(c.fit(*fit_args))
+
+
+# joins the two files and picks the k-means++ seeds, returns their indices and the arguments of c.fit
+def seed_centroids(k, iter, eps, file_name_1, file_name_2, coreset_size=None):
     np.random.seed(1234)
     datapoints = join_dataframes(file_name_1, file_name_2)
     indices = []
@@ -44,6 +43,14 @@ def kmeans_pp(k, iter, eps, file_name_1, file_name_2):
     n = len(datapoints)
     if n <= k or k<=1:
         print_error_and_exit("Invalid number of clusters!")
+    weights = None
+    if coreset_size is not None and not k < coreset_size < n:
+        print_error_and_exit("Invalid coreset size!")
+    if coreset_size is not None:
+        # cluster a weighted summary of the data instead of every point
+        points, weights = c.coreset(len(datapoints[0]), n, k, coreset_size, datapoints)
+        datapoints = np.array(points)
+        n = coreset_size
     index = np.random.randint(0, n)
     indices.append(index)
     centroids = np.array(
@@ -54,6 +61,9 @@ def kmeans_pp(k, iter, eps, file_name_1, file_name_2):
         # print("dist:\n",dist)
         total = sum(dist[i] for i in range(n))
         # print("total:\n",total)
+        if weights is not None:
+            dist = [dist[i] * weights[i] for i in range(n)]
+            total = sum(dist)
         prob = [dist[i] / total for i in range(n)]
         # print("prob:\n",prob)
 
@@ -63,9 +73,23 @@ def kmeans_pp(k, iter, eps, file_name_1, file_name_2):
         # print("chosen centroid:\n", chosen_cent)
         centroids = np.vstack([centroids, chosen_cent])
         # print("centroids:\n",centroids)
-    print(','.join(f'{value:}' for value in indices))
-    centroids = np.array(c.fit(len(datapoints[0]), n, k, iter, eps, centroids.tolist(), datapoints.tolist()))
-    return centroids
+    return indices, (len(datapoints[0]), n, k, iter, eps, centroids.tolist(), datapoints, weights)
+
+
+# every "file1,file2" pair of the manifest is seeded as by kmeans_pp, then all the fits run in one call
+def kmeans_pp_batch(k, iter, eps, manifest, coreset_size=None):
+    seeded = []
+    with open(manifest) as file:
+        for line in file:
+            if line.strip():
+                file_name_1, _, file_name_2 = line.strip().partition(',')
+                seeded.append(seed_centroids(k, iter, eps, file_name_1, file_name_2, coreset_size))
+    results = c.fit_batch([fit_args for _, fit_args in seeded])
+    for i, ((indices, _), centroids) in enumerate(zip(seeded, results)):
+        if i > 0:
+            print()
+        print(','.join(f'{value:}' for value in indices))
+        print_matrix(centroids)
 
 
 def print_matrix(mat):
@@ -76,7 +100,49 @@ def print_error_and_exit(msg):
     print(msg)
     exit(1)
 
+def pop_checkpoint_options(argv):
+    # removes "--checkpoint FILE" and "--checkpoint-every N" from the arguments and returns them (None and 25 if absent)
+    checkpoint, every = None, 25
+    if '--checkpoint' in argv:
+        i = argv.index('--checkpoint')
+        if i + 1 >= len(argv):
+            print_error_and_exit("Invalid checkpoint!")
+        checkpoint = argv[i + 1]
+        del argv[i:i + 2]
+    if '--checkpoint-every' in argv:
+        i = argv.index('--checkpoint-every')
+        try:
+            every = int(argv[i + 1])
+        except (IndexError, ValueError):
+            print_error_and_exit("Invalid checkpoint interval!")
+        if every < 0 or checkpoint is None:
+            print_error_and_exit("Invalid checkpoint interval!")
+        del argv[i:i + 2]
+    return checkpoint, every
+
+def pop_coreset_option(argv):
+    # removes "--coreset M" from the arguments and returns M (None if absent)
+    if '--coreset' not in argv:
+        return None
+    i = argv.index('--coreset')
+    try:
+        size = int(argv[i + 1])
+    except (IndexError, ValueError):
+        print_error_and_exit("Invalid coreset size!")
+    if size <= 0:
+        print_error_and_exit("Invalid coreset size!")
+    del argv[i:i + 2]
+    return size
+
 if __name__ == '__main__':
+    coreset_size = pop_coreset_option(sys.argv)
+    checkpoint, checkpoint_every = pop_checkpoint_options(sys.argv)
+    batch = '--batch' in sys.argv  # the file arguments are replaced by one manifest of file pairs
+    if batch and checkpoint is not None:
+        print_error_and_exit("Invalid checkpoint!")
+    if batch:
+        sys.argv.remove('--batch')
+        sys.argv.append('')  # stands for the second file, every manifest line names both
     if len(sys.argv) < 5 or len(sys.argv) > 6:
         print_error_and_exit("Invalid Input!")
     try:
@@ -102,5 +168,8 @@ if __name__ == '__main__':
 
     file_name_1 = sys.argv[4] if len(sys.argv) == 6 else sys.argv[3]
     file_name_2 = sys.argv[5] if len(sys.argv) == 6 else sys.argv[4]
-    kcentroids = kmeans_pp(k, maxIter, eps, file_name_1, file_name_2)
+    if batch:
+        kmeans_pp_batch(k, maxIter, eps, file_name_1, coreset_size)
+        sys.exit(0)
+    kcentroids = kmeans_pp(k, maxIter, eps, file_name_1, file_name_2, coreset_size, checkpoint, checkpoint_every)
     print_matrix(kcentroids)
\ No newline at end of file
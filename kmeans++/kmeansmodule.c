@@ -2,43 +2,59 @@
 
 #include <stdio.h>
 #include <Python.h>
-#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "coreset.h"
+#include "parallel.h"
+#include "checkpoint.h"
+#include "arena.h"
+#include "kmeans.h"
+
 
-void copy_matrix(double **read_matrix, double**write_matrix, int k, int d);
 void free_matrix(double** matrix, int rows);
-double vector_distance(double *x, double *y, int d);
-void find_closest_point(double* vector, double** centroids, int* vectors_per_cluster, double **clusters, int k, int d);
 double** create_matrix(int rows, int columns);
-void update_centroids(double **centroids, int *vectors_per_cluster, double **clusters, int k, int d);
-int convergence(double** centroids, double** before, int curr_iter, int max_iter, int k, int d, double eps);
-void clear_matrix(double **clusters, int *vectors_per_cluster, int k, int d);
-double** k_means(int k, int maxIter, int n, int d, double **data_matrix, double **centroids, double eps);
+int check_pointer(void* ptr);
+double** k_means(int k, int maxIter, int n, int d, double **data_matrix, double *weights, double **centroids, double eps, const char* checkpoint_file, int interval);
 void print_matrix(double** matrix, int rows, int columns);
 
+#define JOIN_RUN_ROWS 65536
+#define JOIN_INITIAL_ROWS 1024
+
+/* One input file of a join, cut into sorted runs spilled to temporary files */
+typedef struct sorted_runs {
+    FILE** runs;
+    int count;
+    int width;      /* fields per record, the key first */
+    double* heads;  /* current record of every run, count x width */
+    int* alive;     /* 0 once a run is exhausted */
+    int failed;     /* set when a run could not be read back whole */
+} sorted_runs;
+
+/* The arguments of one fit call, owned by the job */
+typedef struct fit_job {
+    int d, n, k, maxIter;
+    double eps;
+    double** dataPoints;
+    double** centroids; /* initial centroids, final ones after the run */
+    double* weights;    /* NULL for unit weights */
+    const char* checkpoint; /* NULL for none, borrowed from the argument tuple */
+    int interval;       /* iterations between two checkpoints */
+    Py_buffer view;     /* the buffer dataPoints point into, when has_view is set */
+    int has_view;
+    arena memory;       /* the matrices above (but a borrowed dataPoints) */
+} fit_job;
+
+/* The joined rows of join_files: a read-only n x d buffer of doubles that NumPy views and fit
+   reads in place, so the output of the join is never copied */
+typedef struct {
+    PyObject_HEAD
+    double* rows;         /* n x d row-major, NULL when n is 0 */
+    Py_ssize_t shape[2];  /* n, d */
+    Py_ssize_t strides[2];
+} PointsObject;
 
 
-/**
- * @brief Copies the first k rows from a matrix to a new k*d matrix.
- *
- * @param read_matrix The matrix from which you read.
- * @param write_matrix The matrix to which you write.
- * @param k The number of rows to copy.
- * @param d The number of columns per row.
- * 
- * @return A pointer to the new k*d matrix.
- */
-void copy_matrix(double** read_matrix, double**write_matrix, int k, int d){
-    int i, j;
-    for (i =0; i< k; i++){
-        for (j=0; j<d; j++){
-            write_matrix[i][j] = read_matrix[i][j];
-        }
-    }
-}
-   
 /**
  * @brief prints the matrix
  */ 
@@ -67,58 +83,6 @@ void free_matrix(double** matrix, int n){
     
 }
 
-/**
- * @brief Calculates the Euclidean distance between two vectors.
- *
- * @param x The first vector.
- * @param y The second vector.
- * @param d The dimension of the vectors.
- * 
- * @return The Euclidean distance between the two vectors.
- */
-double vector_distance(double *x, double *y, int d){
-    double res;
-    int i;
-    res = 0;
-    for(i = 0; i < d; i++){
-        res += pow((x[i]-y[i]), 2);
-    }
-    res = pow(res, 0.5);
-    return res;
-}
-
-/**
- * @brief Finds the closest centroid to a given vector and updates the cluster.
- *
- * Finds the closest centroid from the given `vector` among `k` centroids,
- * updates the count of vectors per cluster, and accumulates the vector to the relevant cluster.
- *
- * @param vector The vector for which to find the closest centroid.
- * @param centroids The matrix of centroids.
- * @param vectors_per_cluster The array holding the count of vectors in each cluster.
- * @param clusters The matrix to accumulate the vectors in each cluster.
- * @param k The number of centroids/clusters.
- * @param d The dimension of each vector.
- */
-
-void find_closest_point(double* vector, double** centroids, int* vectors_per_cluster, double **clusters, int k, int d){
-    int i, j, min_index;
-    double dist;
-    double min = HUGE_VAL;
-    min_index = -1;
-    for (i=0; i<k ; i++){
-        dist = vector_distance(vector, centroids[i], d);
-        if (dist < min){
-            min_index = i;
-            min = dist;
-        }
-    }
-    vectors_per_cluster[min_index]++;
-    for(j=0; j<d; j++){
-      clusters[min_index][j]+= vector[j];
-    }
-}
-
 /**
  * @brief Allocates memory for a matrix and returns a pointer to it.
  *
@@ -148,104 +112,397 @@ double** create_matrix(int rows, int columns){
 }
 
 /**
- * @brief Updates the centroids to be the mean of each corresponding cluster.
+ * @brief Reports a failed allocation, for the shared code linked from Final_Project.
  *
- * @param centroids The matrix of centroids to be updated.
- * @param vectors_per_cluster The array holding the amount of vectors in each cluster.
- * @param clusters The matrix containing the sum of vectors in each cluster.
- * @param k The number of centroids/clusters.
- * @param d The dimension of each vector.
+ * @param ptr The pointer returned by the allocation.
+ *
+ * @return 1 (after printing the error) if the pointer is NULL, 0 otherwise.
  */
-void update_centroids(double **centroids, int *vectors_per_cluster, double **clusters, int k, int d){
-    int i,j;
-    for(i =0; i < k; i++){
-        for(j = 0; j < d; j++){
-            centroids[i][j] = (clusters[i][j] / vectors_per_cluster[i]);
-        }
+int check_pointer(void* ptr){
+    if (ptr == NULL){
+        fprintf(stderr, "An Error Has Occurred\n");
+        return 1;
     }
+    return 0;
 }
 
 /**
- * @brief Checks if the centroids have converged or the maximum iterations have been reached.
+ * @brief Runs Lloyd's algorithm on a (possibly weighted) set of vectors.
+ *
+ * The loop is kmeans_lloyd of Final_Project/kmeans.c, shared with kmeans/ and the symnmf k-means:
+ * an empty cluster keeps its centroid, and the loop stops after maxIter updates or once no
+ * centroid moves by eps or more.
  *
- * @param centroids The current centroids.
- * @param prev_centroids The centroids from the previous iteration.
- * @param curr_iter The current iteration number.
- * @param iter The maximum number of iterations allowed.
  * @param k The number of centroids/clusters.
+ * @param maxIter The maximum number of iterations.
+ * @param n The number of vectors.
  * @param d The dimension of each vector.
- * 
- * @return 1 if the centroids have converged or the maximum iterations have been reached, otherwise 0.
+ * @param data_matrix The vectors to cluster.
+ * @param weights The weight of each vector, NULL for unit weights.
+ * @param centroids The initial centroids, updated in place.
+ * @param eps The convergence threshold.
+ * @param checkpoint_file File the state is saved to every interval iterations and at the end, and
+ * resumed from when it holds a checkpoint of the same shape; NULL for none. The snapshot is a
+ * CHECKPOINT_KMEANS checkpoint of Final_Project/checkpoint.c whose k x d iterate is the centroids.
+ * @param interval The iterations between two checkpoints, 0 saves only at the end.
+ *
+ * @return The final centroids.
  */
-int convergence(double **centroids, double **prev_centroids, int curr_iter, int iter, int k, int d, double eps){
-    int i;
-    double dist;
-    if (curr_iter >= iter){
-        return 1;
+double** k_means(int k, int maxIter, int n, int d, double **data_matrix, double *weights, double **centroids, double eps, const char* checkpoint_file, int interval){
+    run_control control;
+    checkpoint cp;
+
+    if (checkpoint_file == NULL){
+        kmeans_lloyd(data_matrix, weights, n, d, k, maxIter, eps, centroids, NULL, NULL);
+        return centroids;
     }
-    for (i =0; i<k; i++){
-        dist = vector_distance(centroids[i], prev_centroids[i], d);
-        if (dist >= eps){
-            return 0;
+    control_init(&control);
+    checkpoint_init(&cp, checkpoint_file, CHECKPOINT_KMEANS, interval, 0, 0);
+    checkpoint_fingerprint(&cp, data_matrix, n, d, weights);
+    checkpoint_load(&cp, centroids, k, d, NULL);
+    control.checkpoint = &cp;
+    kmeans_lloyd(data_matrix, weights, n, d, k, maxIter, eps, centroids, NULL, &control);
+    checkpoint_destroy(&cp);
+    control_destroy(&control);
+    return centroids;
+}
+
+/**
+ * @brief Reads one line of any length into a growing buffer.
+ *
+ * @param file The file to read from.
+ * @param line The buffer, reallocated as needed.
+ * @param capacity The size of the buffer.
+ *
+ * @return 1 if a line was read, 0 at the end of the file.
+ */
+static int read_line(FILE* file, char** line, size_t* capacity){
+    size_t length = 0;
+    if (*line == NULL){
+        *capacity = 256;
+        *line = malloc(*capacity);
+        if (*line == NULL){
+            fprintf(stderr, "An Error Has Occurred\n");
+            exit(1);
         }
     }
-    return 1;
+    while (fgets(*line + length, (int)(*capacity - length), file) != NULL){
+        length += strlen(*line + length);
+        if (length > 0 && (*line)[length - 1] == '\n') return 1;
+        *capacity *= 2;
+        *line = realloc(*line, *capacity);
+        if (*line == NULL){
+            fprintf(stderr, "An Error Has Occurred\n");
+            exit(1);
+        }
+    }
+    return length > 0;
 }
 
 /**
- * @brief Resets the vectors_per_cluster count and the clusters matrix.
+ * @brief Parses a comma separated line of numbers.
  *
- * @param clusters The matrix of clusters to be cleared.
- * @param vectors_per_cluster The array holding the count of vectors in each cluster.
- * @param k The number of clusters.
- * @param d The dimension of each vector.
+ * @param line The line.
+ * @param record The parsed numbers, at most width of them.
+ * @param width The expected number of fields, 0 to only count them.
+ *
+ * @return The number of fields in the line (0 for a blank line).
  */
-void clear_matrix(double **clusters, int *vectors_per_cluster, int k, int d){
-    int i ,j;
-    for (i =0; i < k; i++){
-        vectors_per_cluster[i] = 0;
-        for (j=0; j<d; j++){
-            clusters[i][j] = 0.0;
+static int parse_record(const char* line, double* record, int width){
+    const char* cursor = line;
+    char* end;
+    double value;
+    int fields = 0;
+    while (1){
+        value = strtod(cursor, &end);
+        if (end == cursor) break;
+        if (fields < width) record[fields] = value;
+        fields++;
+        while (*end == ' ' || *end == '\t' || *end == '\r') end++;
+        if (*end != ',') break;
+        cursor = end + 1;
+    }
+    return fields;
+}
+
+/**
+ * @brief Sorts records by their key (the first field) with a bottom-up merge sort. The sort is
+ * stable, so records with equal keys keep their file order, i.e. the order is (key, row index).
+ *
+ * @param records The rows x width records, sorted in place.
+ * @param scratch Room for rows x width doubles.
+ * @param rows The number of records.
+ * @param width The number of fields per record.
+ */
+static void sort_records(double* records, double* scratch, int rows, int width){
+    double *from = records, *to = scratch, *swap;
+    size_t bytes = sizeof(double) * width;
+    int size, lo, mid, hi, i, j, out;
+    for (size = 1; size < rows; size *= 2){
+        for (lo = 0; lo < rows; lo += 2 * size){
+            mid = lo + size < rows ? lo + size : rows;
+            hi = lo + 2 * size < rows ? lo + 2 * size : rows;
+            for (i = lo, j = mid, out = lo; out < hi; out++){
+                if (j >= hi || (i < mid && from[(size_t)i * width] <= from[(size_t)j * width])){
+                    memcpy(to + (size_t)out * width, from + (size_t)i * width, bytes);
+                    i++;
+                } else {
+                    memcpy(to + (size_t)out * width, from + (size_t)j * width, bytes);
+                    j++;
+                }
+            }
         }
+        swap = from, from = to, to = swap;
     }
+    if (from != records) memcpy(records, from, bytes * rows);
 }
 
-double** k_means(int k, int maxIter, int n, int d, double **data_matrix, double **centroids, double eps){
-    int i, curr_iter;
-    double *vector;
-    double **clusters, **prev_centroids;
-    int *vectors_per_cluster;
+/**
+ * @brief Moves a run to its next record, or marks it exhausted.
+ *
+ * @param input The runs of a file.
+ * @param run The run to advance.
+ */
+static void advance_run(sorted_runs* input, int run){
+    double* head = input->heads + (size_t)run * input->width;
+    size_t got = fread(head, sizeof(double), input->width, input->runs[run]);
+    input->alive[run] = got == (size_t)input->width;
+    /* a partial record or a read error is a truncated run, not its end */
+    if (!input->alive[run] && (got != 0 || ferror(input->runs[run]))) input->failed = 1;
+}
 
-    /*allocate memory for the cluster matrix*/
-    clusters = create_matrix(k, d);
+/**
+ * @brief Closes the temporary files of the runs and frees them.
+ *
+ * @param input The runs of a file.
+ */
+static void free_sorted_runs(sorted_runs* input){
+    int run;
+    for (run = 0; run < input->count; run++) fclose(input->runs[run]);
+    free(input->runs), free(input->heads), free(input->alive);
+    input->runs = NULL, input->heads = NULL, input->alive = NULL, input->count = 0;
+}
 
-    /*allocate memory for the prev_clusters matrix*/
-    prev_centroids = create_matrix(k, d);
+/**
+ * @brief External sort, first phase: reads a csv file in chunks of JOIN_RUN_ROWS records,
+ * sorts every chunk by key and spills it to a temporary file, so only one chunk is ever
+ * held in memory. The runs are spilled in file order.
+ *
+ * @param file_name The csv file, the key in the first column.
+ * @param input The runs to initialize.
+ *
+ * @return 0 on success, 1 if the file cannot be read, has rows of different widths or a run
+ * cannot be written whole (the runs are then already freed).
+ */
+static int spill_sorted_runs(const char* file_name, sorted_runs* input){
+    FILE* file = fopen(file_name, "r");
+    char* line = NULL;
+    size_t capacity = 0;
+    double *chunk = NULL, *scratch = NULL;
+    int rows = 0, fields, status = 0, more = 1, run;
+
+    input->runs = NULL, input->count = 0, input->width = 0, input->heads = NULL, input->alive = NULL;
+    input->failed = 0;
+    if (file == NULL) return 1;
+    while (more && status == 0){
+        more = read_line(file, &line, &capacity);
+        fields = more ? parse_record(line, NULL, 0) : 0;
+        if (fields > 0 && input->width == 0){
+            input->width = fields;
+            chunk = malloc(sizeof(double) * JOIN_RUN_ROWS * fields);
+            scratch = malloc(sizeof(double) * JOIN_RUN_ROWS * fields);
+            if (chunk == NULL || scratch == NULL){
+                fprintf(stderr, "An Error Has Occurred\n");
+                exit(1);
+            }
+        }
+        if (fields > 0 && fields != input->width){
+            status = 1;
+        } else if (fields > 0){
+            parse_record(line, chunk + (size_t)rows * input->width, input->width);
+            rows++;
+        }
+        if (rows > 0 && (rows == JOIN_RUN_ROWS || !more || status != 0)){
+            sort_records(chunk, scratch, rows, input->width);
+            input->runs = realloc(input->runs, sizeof(FILE*) * (input->count + 1));
+            if (input->runs == NULL){
+                fprintf(stderr, "An Error Has Occurred\n");
+                exit(1);
+            }
+            input->runs[input->count] = tmpfile();
+            if (input->runs[input->count] == NULL) {
+                status = 1;
+                break;
+            }
+            run = input->count++;
+            /* a short write (a full disk) would otherwise read back as a short run and drop rows */
+            if (fwrite(chunk, sizeof(double) * input->width, rows, input->runs[run]) != (size_t)rows
+                || fflush(input->runs[run]) != 0 || fseek(input->runs[run], 0L, SEEK_SET) != 0 || ferror(input->runs[run])){
+                status = 1;
+            }
+            rows = 0;
+        }
+    }
+    fclose(file), free(line), free(chunk), free(scratch);
+    if (status != 0){
+        free_sorted_runs(input);
+        return 1;
+    }
+    if (input->count > 0){
+        input->heads = malloc(sizeof(double) * input->count * input->width);
+        input->alive = malloc(sizeof(int) * input->count);
+        if (input->heads == NULL || input->alive == NULL){
+            fprintf(stderr, "An Error Has Occurred\n");
+            exit(1);
+        }
+        for (run = 0; run < input->count; run++) advance_run(input, run);
+    }
+    return status;
+}
 
-    /*allocate memory for the vectors_per_cluster matrix*/
-    vectors_per_cluster = malloc(sizeof(int) * k);
-    if (vectors_per_cluster == NULL) {
-        fprintf(stderr, "An Error Has Occurred\n");
-        exit(1);
+/**
+ * @brief External sort, second phase: pops the record of smallest key among the run heads.
+ * A tie goes to the earliest run, which keeps the merge stable.
+ *
+ * @param input The runs of a file.
+ * @param record Output, the next record in key order.
+ *
+ * @return 1 if a record was produced, 0 once every run is exhausted.
+ */
+static int next_sorted_record(sorted_runs* input, double* record){
+    int run, best = -1;
+    for (run = 0; run < input->count; run++){
+        if (input->alive[run] && (best < 0 || input->heads[(size_t)run * input->width] < input->heads[(size_t)best * input->width])){
+            best = run;
+        }
     }
+    if (best < 0) return 0;
+    memcpy(record, input->heads + (size_t)best * input->width, sizeof(double) * input->width);
+    advance_run(input, best);
+    return 1;
+}
 
-    curr_iter = 0;
-    while (!convergence(centroids, prev_centroids, curr_iter, maxIter, k, d, eps)){
-        clear_matrix(clusters, vectors_per_cluster, k, d);
-        for (i = 0; i < n; i++){
-            vector = data_matrix[i];
-            find_closest_point(vector, centroids, vectors_per_cluster, clusters, k, d);
+/**
+ * @brief Appends one joined row (the features of both records, without the keys).
+ *
+ * @param rows The growing row-major output, reallocated as needed.
+ * @param n The number of rows already in the output.
+ * @param capacity The number of rows the output can hold.
+ * @param left The record of the first file.
+ * @param right The record of the second file.
+ * @param left_width The number of fields in left.
+ * @param right_width The number of fields in right.
+ */
+static void append_joined(double** rows, int* n, int* capacity, const double* left, const double* right, int left_width, int right_width){
+    int d = left_width + right_width - 2;
+    double* row;
+    if (*n == *capacity){
+        *capacity = *capacity > 0 ? *capacity * 2 : JOIN_INITIAL_ROWS;
+        *rows = realloc(*rows, sizeof(double) * (size_t)*capacity * (d > 0 ? d : 1));
+        if (*rows == NULL){
+            fprintf(stderr, "An Error Has Occurred\n");
+            exit(1);
         }
-        copy_matrix(centroids, prev_centroids, k, d);
-        update_centroids(centroids, vectors_per_cluster, clusters, k, d);
-        curr_iter++;
     }
+    row = *rows + (size_t)*n * d;
+    memcpy(row, left + 1, sizeof(double) * (left_width - 1));
+    memcpy(row + left_width - 1, right + 1, sizeof(double) * (right_width - 1));
+    (*n)++;
+}
 
-    free_matrix(prev_centroids, k);
-    free_matrix(clusters, k);
-    free(vectors_per_cluster);
+/**
+ * @brief Sort-merge inner join of two csv files on their first column, in increasing key order,
+ * with the semantics of pandas.merge(how='inner') followed by sort_values: every pair of records
+ * with equal keys gives one row, the features of the first file then those of the second.
+ * Both files are externally sorted, so only a run of each file and the output are in memory.
+ *
+ * @param file_name_1 The first csv file.
+ * @param file_name_2 The second csv file.
+ * @param n Output, the number of joined rows.
+ * @param d Output, the number of features in a joined row.
+ *
+ * @return The n x d row-major joined matrix (NULL when n is 0), -1 in n when a file cannot be read
+ * or a sorted run cannot be written or read back whole.
+ */
+static double* merge_join_files(const char* file_name_1, const char* file_name_2, int* n, int* d){
+    sorted_runs left, right;
+    double *rows = NULL, *l, *r, *group = NULL, key;
+    int capacity = 0, group_size, group_capacity = 0, has_l, has_r, i;
+
+    *n = 0, *d = 0;
+    if (spill_sorted_runs(file_name_1, &left) != 0){
+        *n = -1;
+        return NULL;
+    }
+    if (left.width < 1 || spill_sorted_runs(file_name_2, &right) != 0){
+        free_sorted_runs(&left);
+        *n = -1;
+        return NULL;
+    }
+    if (right.width < 1){
+        free_sorted_runs(&left), free_sorted_runs(&right);
+        *n = -1;
+        return NULL;
+    }
+    *d = left.width + right.width - 2;
+    l = malloc(sizeof(double) * left.width);
+    r = malloc(sizeof(double) * right.width);
+    if (l == NULL || r == NULL){
+        fprintf(stderr, "An Error Has Occurred\n");
+        exit(1);
+    }
+    has_l = next_sorted_record(&left, l), has_r = next_sorted_record(&right, r);
+    while (has_l && has_r){
+        if (l[0] < r[0]){
+            has_l = next_sorted_record(&left, l);
+        } else if (l[0] > r[0]){
+            has_r = next_sorted_record(&right, r);
+        } else {
+            /* buffer the records of the second file with this key, then pair every record of the first */
+            key = r[0], group_size = 0;
+            while (has_r && r[0] == key){
+                if (group_size == group_capacity){
+                    group_capacity = group_capacity > 0 ? group_capacity * 2 : 4;
+                    group = realloc(group, sizeof(double) * group_capacity * right.width);
+                    if (group == NULL){
+                        fprintf(stderr, "An Error Has Occurred\n");
+                        exit(1);
+                    }
+                }
+                memcpy(group + (size_t)group_size * right.width, r, sizeof(double) * right.width);
+                group_size++;
+                has_r = next_sorted_record(&right, r);
+            }
+            while (has_l && l[0] == key){
+                for (i = 0; i < group_size; i++){
+                    append_joined(&rows, n, &capacity, l, group + (size_t)i * right.width, left.width, right.width);
+                }
+                has_l = next_sorted_record(&left, l);
+            }
+        }
+    }
+    free(l), free(r), free(group);
+    if (left.failed || right.failed){ /* a run could not be read back, the join would miss rows */
+        free(rows);
+        rows = NULL, *n = -1;
+    }
+    free_sorted_runs(&left), free_sorted_runs(&right);
+    return rows;
+}
 
-    return centroids;
+/**
+ * @brief Range task of fit_batch: runs k_means on the jobs [begin, end).
+ *
+ * @param ctx The array of fit_job.
+ * @param begin The first job.
+ * @param end One past the last job.
+ */
+static void run_fit_jobs(void* ctx, int begin, int end){
+    fit_job* job;
+    for (job = (fit_job*)ctx + begin; job < (fit_job*)ctx + end; job++){
+        k_means(job->k, job->maxIter, job->n, job->d, job->dataPoints, job->weights, job->centroids, job->eps,
+                job->checkpoint, job->interval);
+    }
 }
 
 static void convert_PyObj_To_cMatrix(PyObject* pyMat, double **cMat, int rows, int columns)
@@ -265,53 +522,329 @@ static void convert_PyObj_To_cMatrix(PyObject* pyMat, double **cMat, int rows, i
     }
 }
 
-static PyObject* fit(PyObject *self, PyObject *args)
+/**
+ * @brief Reads data points without a copy when they are a C-contiguous buffer of n x d doubles
+ * (the Points of join_files or a NumPy array): the rows point into the buffer, which stays held
+ * in view until PyBuffer_Release.
+ *
+ * @param obj The data points argument.
+ * @param n The number of data points.
+ * @param d The dimension of the data points.
+ * @param view Output, the held buffer.
+ * @param rows Output, n pointers into the buffer (to be freed, the rows themselves are not).
+ *
+ * @return 1 when the points come from the buffer, 0 for a list (nothing held), -1 (with a Python
+ * error set) for a buffer that is not n x d doubles.
+ */
+static int borrow_points(PyObject* obj, int n, int d, Py_buffer* view, double*** rows)
 {
-    int n, d, k, maxIter, i, j;
-    double eps;
-    PyObject *PyCentroids, *PyDataPoints, *finalCentroids_py, *single_centroid;
-    double** dataPoints;
-    double** centroids;
-    double** finalCentroids_c;
+    int i;
+    if (PyList_Check(obj)) return 0;
+    if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) return -1;
+    if (view->itemsize != sizeof(double) || view->format == NULL || strcmp(view->format, "d") != 0
+        || n < 0 || d < 0 || view->len != (Py_ssize_t)sizeof(double) * n * d) {
+        PyBuffer_Release(view);
+        PyErr_SetString(PyExc_ValueError, "The data points must be n x d doubles.");
+        return -1;
+    }
+    *rows = malloc(sizeof(double*) * (n > 0 ? n : 1));
+    if (*rows == NULL) {
+        PyBuffer_Release(view);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (i = 0; i < n; i++) (*rows)[i] = (double*)view->buf + (size_t)i * d;
+    return 1;
+}
+
+/**
+ * @brief Converts the arguments of a fit call into a job.
+ *
+ * @param args The argument tuple of fit.
+ * @param job The job to fill, freed with free_fit_job.
+ *
+ * @return 0 on success, -1 (with a Python error set) otherwise.
+ */
+static int parse_fit_job(PyObject *args, fit_job* job)
+{
+    int i;
+    PyObject *PyCentroids, *PyDataPoints;
+    PyObject *PyWeights = NULL;
+    arena_backend backend = env_backend();
+
+    arena_init(&job->memory, &backend, 0);
+    job->dataPoints = NULL, job->centroids = NULL, job->weights = NULL, job->has_view = 0;
+    job->checkpoint = NULL, job->interval = CHECKPOINT_DEFAULT_INTERVAL;
     /* This parses the Python arguments into a double (d)  variable named z and int (i) variable named n*/
-    if(!PyArg_ParseTuple(args, "iiiidOO", &d, &n, &k, &maxIter, &eps, &PyCentroids, &PyDataPoints)) {
-        return NULL; /* In the CPython API, a NULL value is never valid for a
+    if(!PyArg_ParseTuple(args, "iiiidOO|Ozi", &job->d, &job->n, &job->k, &job->maxIter, &job->eps, &PyCentroids, &PyDataPoints, &PyWeights,
+                         &job->checkpoint, &job->interval)) {
+        return -1; /* In the CPython API, a NULL value is never valid for a
                         PyObject* so it is used to signal that an error has occurred. */
     }
 
-    // Ensure the objects are lists of lists
-    if (!PyList_Check(PyCentroids) || !PyList_Check(PyDataPoints)) {
+    /* Ensure the objects are lists of lists, or a buffer of doubles for the data points */
+    if (!PyList_Check(PyCentroids) || (!PyList_Check(PyDataPoints) && !PyObject_CheckBuffer(PyDataPoints))) {
         PyErr_SetString(PyExc_TypeError, "Both arguments must be matrices.");
+        return -1;
+    }
+    if (PyWeights != NULL && PyWeights != Py_None && !PyList_Check(PyWeights)) {
+        PyErr_SetString(PyExc_TypeError, "Weights must be a list.");
+        return -1;
+    }
+    job->has_view = borrow_points(PyDataPoints, job->n, job->d, &job->view, &job->dataPoints);
+    if (job->has_view < 0) {
+        job->has_view = 0;
+        return -1;
+    }
+    if (!job->has_view) {
+        job->dataPoints = arena_matrix(&job->memory, job->n, job->d);
+        convert_PyObj_To_cMatrix(PyDataPoints, job->dataPoints, job->n, job->d);
+    }
+
+    job->centroids = arena_matrix(&job->memory, job->k, job->d);
+    convert_PyObj_To_cMatrix(PyCentroids, job->centroids, job->k, job->d);
+
+    if (PyWeights != NULL && PyWeights != Py_None) {
+        job->weights = arena_alloc(&job->memory, sizeof(double) * (job->n > 0 ? job->n : 1));
+        for (i = 0; i < job->n; i++) {
+            job->weights[i] = PyFloat_AsDouble(PyList_GetItem(PyWeights, i));
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Frees the matrices of a job.
+ *
+ * @param job The job.
+ */
+static void free_fit_job(fit_job* job)
+{
+    if (job->has_view) {
+        free(job->dataPoints);
+        PyBuffer_Release(&job->view);
+    }
+    arena_destroy(&job->memory);
+    job->dataPoints = NULL, job->centroids = NULL, job->weights = NULL, job->has_view = 0;
+}
+
+/**
+ * @brief Converts the centroids of a job into a tuple of tuples.
+ *
+ * @param job The job.
+ *
+ * @return The centroids.
+ */
+static PyObject* centroids_to_PyObject(const fit_job* job)
+{
+    int i, j;
+    PyObject *finalCentroids_py, *single_centroid;
+
+    finalCentroids_py = PyTuple_New(job->k);
+    for (i = 0; i < job->k; i++) {
+        single_centroid = PyTuple_New(job->d);
+        for (j = 0; j < job->d; j++){
+            PyTuple_SET_ITEM(single_centroid, j, PyFloat_FromDouble(job->centroids[i][j]));
+        }
+        PyTuple_SET_ITEM(finalCentroids_py, i, single_centroid);
+    }
+    return finalCentroids_py;
+}
+
+static PyObject* fit(PyObject *self, PyObject *args)
+{
+    fit_job job;
+    PyObject *finalCentroids_py;
+
+    if (parse_fit_job(args, &job) != 0) {
+        free_fit_job(&job);
+        return NULL;
+    }
+    k_means(job.k, job.maxIter, job.n, job.d, job.dataPoints, job.weights, job.centroids, job.eps, job.checkpoint, job.interval);
+    finalCentroids_py = centroids_to_PyObject(&job);
+    free_fit_job(&job);
+    return finalCentroids_py;
+}
+
+static PyObject* fit_batch(PyObject *self, PyObject *args)
+{
+    int count, j;
+    fit_job* jobs;
+    PyObject *PyJobs, *job_args, *results;
+
+    if(!PyArg_ParseTuple(args, "O", &PyJobs)) {
+        return NULL;
+    }
+    if (!PyList_Check(PyJobs)) {
+        PyErr_SetString(PyExc_TypeError, "The jobs must be a list of fit argument tuples.");
         return NULL;
     }
-    dataPoints = create_matrix(n, d);
-    convert_PyObj_To_cMatrix(PyDataPoints, dataPoints, n, d);
+    count = PyList_Size(PyJobs);
+    jobs = calloc(count > 0 ? count : 1, sizeof(fit_job));
+    if (jobs == NULL) {
+        fprintf(stderr, "An Error Has Occurred\n");
+        exit(1);
+    }
+    for (j = 0; j < count; j++) {
+        job_args = PyList_GetItem(PyJobs, j);
+        if (!PyTuple_Check(job_args)) {
+            PyErr_SetString(PyExc_TypeError, "The jobs must be a list of fit argument tuples.");
+        }
+        if (PyErr_Occurred() || parse_fit_job(job_args, &jobs[j]) != 0) {
+            for (; j >= 0; j--) free_fit_job(&jobs[j]);
+            free(jobs);
+            return NULL;
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    parallel_steal(count, run_fit_jobs, jobs);
+    Py_END_ALLOW_THREADS
 
-    centroids = create_matrix(k, d);
-    convert_PyObj_To_cMatrix(PyCentroids, centroids, k, d);
+    results = PyList_New(count);
+    for (j = 0; j < count; j++) {
+        PyList_SET_ITEM(results, j, centroids_to_PyObject(&jobs[j]));
+        free_fit_job(&jobs[j]);
+    }
+    free(jobs);
+    return results;
+}
 
+static PyObject* coreset(PyObject *self, PyObject *args)
+{
+    int n, d, k, m, i, j;
+    unsigned long seed = CORESET_DEFAULT_SEED;
+    PyObject *PyDataPoints, *PyPoints, *PyWeights, *single_point;
+    double** dataPoints;
+    double** coresetPoints;
+    double* weights;
+    Py_buffer view;
+    int borrowed;
 
-    finalCentroids_c = k_means(k, maxIter, n, d, dataPoints, centroids, eps);
-    finalCentroids_py = PyTuple_New(k);
-    for (i = 0; i < k; i++) {
-        single_centroid = PyTuple_New(d);
+    if(!PyArg_ParseTuple(args, "iiiiO|k", &d, &n, &k, &m, &PyDataPoints, &seed)) {
+        return NULL;
+    }
+    if (!PyList_Check(PyDataPoints) && !PyObject_CheckBuffer(PyDataPoints)) {
+        PyErr_SetString(PyExc_TypeError, "Data points must be a matrix.");
+        return NULL;
+    }
+    if (k <= 0 || k > n || m <= 0 || m > n) {
+        PyErr_SetString(PyExc_ValueError, "Invalid coreset size!");
+        return NULL;
+    }
+    borrowed = borrow_points(PyDataPoints, n, d, &view, &dataPoints);
+    if (borrowed < 0) return NULL;
+    if (!borrowed) {
+        dataPoints = create_matrix(n, d);
+        convert_PyObj_To_cMatrix(PyDataPoints, dataPoints, n, d);
+    }
+    weights = malloc(sizeof(double) * m);
+    if (weights == NULL) {
+        fprintf(stderr, "An Error Has Occurred\n");
+        exit(1);
+    }
+
+    coresetPoints = build_coreset(dataPoints, n, d, k, m, seed, weights);
+    PyPoints = PyList_New(m);
+    PyWeights = PyList_New(m);
+    for (i = 0; i < m; i++) {
+        single_point = PyList_New(d);
         for (j = 0; j < d; j++){
-            PyTuple_SET_ITEM(single_centroid, j, PyFloat_FromDouble(finalCentroids_c[i][j]));
-        } 
-    PyTuple_SET_ITEM(finalCentroids_py, i, single_centroid);
+            PyList_SET_ITEM(single_point, j, PyFloat_FromDouble(coresetPoints[i][j]));
+        }
+        PyList_SET_ITEM(PyPoints, i, single_point);
+        PyList_SET_ITEM(PyWeights, i, PyFloat_FromDouble(weights[i]));
     }
 
-    free_matrix(centroids, k);
-    free_matrix(dataPoints, n); 
+    free_matrix(coresetPoints, m);
+    if (borrowed) {
+        free(dataPoints);
+        PyBuffer_Release(&view);
+    } else {
+        free_matrix(dataPoints, n);
+    }
+    free(weights);
 
-    return finalCentroids_py;  
+    return Py_BuildValue("(NN)", PyPoints, PyWeights);
 }
+/**
+ * @brief Exposes the joined rows as a read-only 2-D buffer of doubles.
+ */
+static int Points_getbuffer(PointsObject* self, Py_buffer* view, int flags)
+{
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "The joined points are read-only.");
+        view->obj = NULL;
+        return -1;
+    }
+    view->buf = self->rows != NULL ? (void*)self->rows : (void*)self->shape; /* no bytes are read when n is 0 */
+    view->obj = (PyObject*)self;
+    Py_INCREF(self);
+    view->len = self->shape[0] * self->shape[1] * (Py_ssize_t)sizeof(double);
+    view->readonly = 1;
+    view->itemsize = sizeof(double);
+    view->format = (flags & PyBUF_FORMAT) ? (char*)"d" : NULL;
+    view->ndim = 2;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static void Points_dealloc(PointsObject* self)
+{
+    free(self->rows);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyBufferProcs Points_buffer = {(getbufferproc)Points_getbuffer, NULL};
+
+static PyTypeObject PointsType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "mykmeanssp.Points",
+    .tp_basicsize = sizeof(PointsObject),
+    .tp_dealloc = (destructor)Points_dealloc,
+    .tp_as_buffer = &Points_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "The joined rows of join_files, an n x d buffer of doubles (numpy.asarray views it).",
+};
+
+static PyObject* join_files(PyObject *self, PyObject *args)
+{
+    const char *file_name_1, *file_name_2;
+    double *rows;
+    int n, d;
+    PointsObject *points;
+
+    if(!PyArg_ParseTuple(args, "ss", &file_name_1, &file_name_2)) {
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    rows = merge_join_files(file_name_1, file_name_2, &n, &d);
+    Py_END_ALLOW_THREADS
+    if (n < 0) {
+        PyErr_SetString(PyExc_OSError, "Cannot read the input files.");
+        return NULL;
+    }
+
+    points = PyObject_New(PointsObject, &PointsType);
+    if (points == NULL) {
+        free(rows);
+        return NULL;
+    }
+    points->rows = rows;
+    points->shape[0] = n, points->shape[1] = d;
+    points->strides[0] = (Py_ssize_t)sizeof(double) * d, points->strides[1] = sizeof(double);
+    return (PyObject*)points;
+}
+
 static PyMethodDef kmeans_pp_Methods[] = {
     {  
         "fit",                   
         (PyCFunction) fit, 
         METH_VARARGS,          
-        PyDoc_STR("fit(d, n, k, maxIter, eps, PyCentroids, PyDataPoints)\n\n"
+        PyDoc_STR("fit(d, n, k, maxIter, eps, PyCentroids, PyDataPoints[, PyWeights[, checkpoint[, interval]]])\n\n"
                   "Parameters:\n"
                   "d: int - dimension of the vectors\n"
                   "n: int - amount of data points\n"
@@ -319,9 +852,49 @@ static PyMethodDef kmeans_pp_Methods[] = {
                   "maxIter: int - maximum number of iterations\n"
                   "eps: float - convergence threshold\n"
                   "PyCentroids: list of lists - initial centroids\n"
-                  "PyDataPoints: list of lists - data points\n\n"
+                  "PyDataPoints: list of lists, or n x d doubles such as join_files' result - data points\n"
+                  "PyWeights: list - optional weight of each data point\n"
+                  "checkpoint: str - optional file the fit is saved to periodically and resumed from\n"
+                  "interval: int - optional iterations between two checkpoints (default 25)\n\n"
                   "Returns:\n"
                   "finalCentroids: list of lists - final centroids")
+    }, {
+        "fit_batch",
+        (PyCFunction) fit_batch,
+        METH_VARARGS,
+        PyDoc_STR("fit_batch(jobs)\n\n"
+                  "Runs many independent fits in one call, spread over a work-stealing thread pool\n"
+                  "(KMEANS_THREADS threads, default one per online core) with the GIL released.\n\n"
+                  "Parameters:\n"
+                  "jobs: list of tuples - the arguments of every fit call\n\n"
+                  "Returns:\n"
+                  "results: list - the final centroids of every job, in order")
+    }, {
+        "coreset",
+        (PyCFunction) coreset,
+        METH_VARARGS,
+        PyDoc_STR("coreset(d, n, k, m, PyDataPoints[, seed])\n\n"
+                  "Parameters:\n"
+                  "d: int - dimension of the vectors\n"
+                  "n: int - amount of data points\n"
+                  "k: int - number of seeds for the k-means++ pass\n"
+                  "m: int - coreset size\n"
+                  "PyDataPoints: list of lists, or n x d doubles - data points\n"
+                  "seed: int - optional seed of the sampler\n\n"
+                  "Returns:\n"
+                  "(points, weights): the m sampled points and their weights")
+    }, {
+        "join_files",
+        (PyCFunction) join_files,
+        METH_VARARGS,
+        PyDoc_STR("join_files(file_name_1, file_name_2)\n\n"
+                  "Inner-joins two csv files on their first column with an external sort-merge join.\n\n"
+                  "Parameters:\n"
+                  "file_name_1: str - first input file, the key in column 0\n"
+                  "file_name_2: str - second input file, the key in column 0\n\n"
+                  "Returns:\n"
+                  "points: Points - the n x d joined rows in increasing key order, without the key;\n"
+                  "    numpy.asarray(points) views them and fit and coreset read them without a copy")
     }, {
         NULL, NULL, 0, NULL
         }
@@ -339,6 +912,9 @@ static struct PyModuleDef mykmeanssp = {
 PyMODINIT_FUNC PyInit_mykmeanssp(void)
 {
     PyObject *m;
+    if (PyType_Ready(&PointsType) < 0) {
+        return NULL;
+    }
     m = PyModule_Create(&mykmeanssp);
     if (!m) {
         return NULL;
@@ -1,6 +1,11 @@
 from setuptools import Extension, setup
 
-module = Extension("mykmeanssp", sources=['kmeansmodule.c'])
+module = Extension("mykmeanssp", sources=['kmeansmodule.c', '../Final_Project/coreset.c', '../Final_Project/parallel.c',
+                                          '../Final_Project/checkpoint.c', '../Final_Project/checksum.c',
+                                          '../Final_Project/arena.c', '../Final_Project/kmeans.c',
+                                          '../Final_Project/control.c', '../Final_Project/stats.c'],
+                   include_dirs=['../Final_Project'], define_macros=[('THREADS_ENV', '"KMEANS_THREADS"')],
+                   extra_link_args=["-pthread"])
 setup(name='mykmeanssp',
      version='1.0',
      description='Python wrapper for kmeans_pp.c extension',
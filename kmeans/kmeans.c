@@ -1,19 +1,21 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
+#include <string.h>
+
+/* The Lloyd loop, the coreset builder and the --stats counters are shared with the symNMF
+   project, see Makefile */
+#include "kmeans.h"
+#include "coreset.h"
+#include "stats.h"
 
 int compute_d(void);
 int compute_n(void);
 double** compute_data_matrix(int n, int d);
 void copy_matrix(double **read_matrix, double**write_matrix, int k, int d);
 void free_matrix(double** matrix, int n);
-double vector_distance(double *x, double *y, int d);
-void find_closest_point(double* vector, double** centroids, int* vectors_per_cluster, double **clusters, int k, int d);
 double** create_matrix(int rows, int columns);
-void update_centroids(double **centroids, int *vectors_per_cluster, double **clusters, int k, int d);
-int convergence(double** centroids, double** before, int curr_iter, int max_iter, int k, int d);
-void clear_matrix(double **clusters, int *vectors_per_cluster, int k, int d);
-int k_means(int k, int iter);
+int check_pointer(void* ptr);
+int k_means(int k, int iter, int coreset_size);
 void print_matrix(double** matrix, int rows, int columns);
 
 /* Calculating d - vector size */
@@ -124,57 +126,6 @@ void free_matrix(double** matrix, int n){
     
 }
 
-/**
- * @brief Calculates the Euclidean distance between two vectors.
- *
- * @param x The first vector.
- * @param y The second vector.
- * @param d The dimension of the vectors.
- * 
- * @return The Euclidean distance between the two vectors.
- */
-double vector_distance(double *x, double *y, int d){
-    double res;
-    int i;
-    res = 0;
-    for(i = 0; i < d; i++){
-        res += pow((x[i]-y[i]), 2);
-    }
-    res = pow(res, 0.5);
-    return res;
-}
-
-/**
- * @brief Finds the closest centroid to a given vector and updates the cluster.
- *
- * Finds the closest centroid from the given `vector` among `k` centroids,
- * updates the count of vectors per cluster, and accumulates the vector to the relevant cluster.
- *
- * @param vector The vector for which to find the closest centroid.
- * @param centroids The matrix of centroids.
- * @param vectors_per_cluster The array holding the count of vectors in each cluster.
- * @param clusters The matrix to accumulate the vectors in each cluster.
- * @param k The number of centroids/clusters.
- * @param d The dimension of each vector.
- */
-
-void find_closest_point(double* vector, double** centroids, int* vectors_per_cluster, double **clusters, int k, int d){
-    int i, j, min_index;
-    double dist;
-    double min = HUGE_VAL;
-    for (i=0; i<k ; i++){
-        dist = vector_distance(vector, centroids[i], d);
-        if (dist < min){
-            min_index = i;
-            min = dist;
-        }
-    }
-    vectors_per_cluster[min_index]++;
-    for(j=0; j<d; j++){
-      clusters[min_index][j]+= vector[j];
-    }
-}
-
 /**
  * @brief Allocates memory for a matrix and returns a pointer to it.
  *
@@ -193,6 +144,7 @@ double** create_matrix(int rows, int columns){
         fprintf(stderr, "An Error Has Occurred\n");
         exit(1);
     }
+    stats_count_alloc((size_t)rows * columns * sizeof(double));
     for (i=0; i<rows; i++){
         matrix[i] = malloc(sizeof(double) * columns);
         if (matrix[i] == NULL){
@@ -204,76 +156,39 @@ double** create_matrix(int rows, int columns){
 }
 
 /**
- * @brief Updates the centroids to be the mean of each corresponding cluster.
+ * @brief Reports a failed allocation, for the shared code linked from Final_Project.
  *
- * @param centroids The matrix of centroids to be updated.
- * @param vectors_per_cluster The array holding the amount of vectors in each cluster.
- * @param clusters The matrix containing the sum of vectors in each cluster.
- * @param k The number of centroids/clusters.
- * @param d The dimension of each vector.
- */
-void update_centroids(double **centroids, int *vectors_per_cluster, double **clusters, int k, int d){
-    int i,j;
-    for(i =0; i < k; i++){
-        for(j = 0; j < d; j++){
-            centroids[i][j] = (clusters[i][j] / vectors_per_cluster[i]);
-        }
-    }
-}
-
-/**
- * @brief Checks if the centroids have converged or the maximum iterations have been reached.
+ * @param ptr The pointer returned by the allocation.
  *
- * @param centroids The current centroids.
- * @param prev_centroids The centroids from the previous iteration.
- * @param curr_iter The current iteration number.
- * @param iter The maximum number of iterations allowed.
- * @param k The number of centroids/clusters.
- * @param d The dimension of each vector.
- * 
- * @return 1 if the centroids have converged or the maximum iterations have been reached, otherwise 0.
+ * @return 1 (after printing the error) if the pointer is NULL, 0 otherwise.
  */
-int convergence(double **centroids, double **prev_centroids, int curr_iter, int iter, int k, int d){
-    int i;
-    double dist;
-    if (curr_iter >= iter){
+int check_pointer(void* ptr){
+    if (ptr == NULL){
+        fprintf(stderr, "An Error Has Occurred\n");
         return 1;
     }
-    for (i =0; i<k; i++){
-        dist = vector_distance(centroids[i], prev_centroids[i], d);
-        if (dist >= 0.001){
-            return 0;
-        }
-    }
-    return 1;
+    return 0;
 }
 
 /**
- * @brief Resets the vectors_per_cluster count and the clusters matrix.
+ * @brief Runs Lloyd's algorithm (kmeans_lloyd of Final_Project/kmeans.c) on the data points
+ * read from stdin, from the first k points, and prints the centroids.
+ *
+ * @param k The number of centroids/clusters.
+ * @param iter The maximum number of iterations.
+ * @param coreset_size The size of a weighted coreset to cluster instead of all the points (0 for none).
  *
- * @param clusters The matrix of clusters to be cleared.
- * @param vectors_per_cluster The array holding the count of vectors in each cluster.
- * @param k The number of clusters.
- * @param d The dimension of each vector.
+ * @return 0 on success.
  */
-void clear_matrix(double **clusters, int *vectors_per_cluster, int k, int d){
-    int i ,j;
-    for (i =0; i < k; i++){
-        vectors_per_cluster[i] = 0;
-        for (j=0; j<d; j++){
-            clusters[i][j] = 0.0;
-        }
-    }
-}
-
-int k_means(int k, int iter){
-    int i, curr_iter;
-    int d = compute_d();
-    int n = compute_n();
-    double *vector;
-    double **data_matrix, **centroids, **clusters, **prev_centroids;
-    int *vectors_per_cluster;
+int k_means(int k, int iter, int coreset_size){
+    int d, n;
+    double **data_matrix, **centroids, **coreset;
+    double *weights = NULL;
+    stats_timer timer;
 
+    timer = stats_begin(STAGE_PARSE);
+    d = compute_d();
+    n = compute_n();
 
     if (k >= n){
         fprintf(stderr, "Invalid number of clusters!");
@@ -282,42 +197,33 @@ int k_means(int k, int iter){
     /*allocate memory for the centroids matrix */
     centroids = create_matrix(k, d);
 
-    /*allocate memory for the cluster matrix*/
-    clusters = create_matrix(k, d);
-
-    /*allocate memory for the prev_clusters matrix*/
-    prev_centroids = create_matrix(k, d);
-
-    /*allocate memory for the vectors_per_cluster matrix*/
-    vectors_per_cluster = malloc(sizeof(int) * k);
-    if (vectors_per_cluster == NULL) {
-        fprintf(stderr, "An Error Has Occurred\n");
+    if (coreset_size != 0 && (coreset_size <= k || coreset_size >= n)){
+        fprintf(stderr, "Invalid coreset size!");
         exit(1);
     }
-
-
-
     data_matrix = compute_data_matrix(n, d);
-    copy_matrix(data_matrix, centroids, k, d);
-
-    curr_iter = 0;
-    while (!convergence(centroids, prev_centroids, curr_iter, iter, k, d)){
-        clear_matrix(clusters, vectors_per_cluster, k, d);
-        for (i = 0; i < n; i++){
-            vector = data_matrix[i];
-            find_closest_point(vector, centroids, vectors_per_cluster, clusters, k, d);
+    stats_end(timer);
+    if (coreset_size != 0){
+        /*cluster a weighted summary of the data instead of every point*/
+        weights = malloc(sizeof(double) * coreset_size);
+        if (weights == NULL) {
+            fprintf(stderr, "An Error Has Occurred\n");
+            exit(1);
         }
-        copy_matrix(centroids, prev_centroids, k, d);
-        update_centroids(centroids, vectors_per_cluster, clusters, k, d);
-        curr_iter++;
+        coreset = build_coreset(data_matrix, n, d, k, coreset_size, CORESET_DEFAULT_SEED, weights);
+        free_matrix(data_matrix, n);
+        data_matrix = coreset;
+        n = coreset_size;
     }
+    copy_matrix(data_matrix, centroids, k, d);
+    kmeans_lloyd(data_matrix, weights, n, d, k, iter, KMEANS_EPSILON, centroids, NULL, NULL);
 
-    free_matrix(prev_centroids, k);
-    free_matrix(clusters, k);
     free_matrix(data_matrix, n);
-    free(vectors_per_cluster);
+    free(weights);
 
+    timer = stats_begin(STAGE_OUTPUT);
     print_matrix(centroids, k, d);
+    stats_end(timer);
     free_matrix(centroids, k);
 
     return 0;
@@ -327,7 +233,22 @@ int k_means(int k, int iter){
 Missing:
 * valid inputs of extreme cases */
 int main(int argc, char** argv){
-    int k, iter;
+    int k, iter, coreset_size = 0, stats_json = -1, i, j;
+    for (i = j = 1; i < argc; i++){
+        /*--stats, --stats-json and --coreset M may appear anywhere, the other arguments are positional*/
+        if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats-json") == 0){
+            stats_json = strcmp(argv[i], "--stats-json") == 0;
+        }
+        else if (strcmp(argv[i], "--coreset") == 0){
+            coreset_size = i + 1 < argc ? atoi(argv[++i]) : 0;
+            if (coreset_size <= 0 || coreset_size != atof(argv[i])){
+                fprintf(stderr, "Invalid coreset size!");
+                return 1;
+            }
+        }
+        else argv[j++] = argv[i];
+    }
+    argc = j;
     if ((argc != 2) && (argc != 3)){
         fprintf(stderr, "An Error Has Occurred\n Invalid number of arguments");
         return 1;
@@ -347,6 +268,8 @@ int main(int argc, char** argv){
         fprintf(stderr, "Invalid number of clusters!");
         return 1;
     }
-    k_means(k, iter);
+    if (stats_json >= 0) stats_enable(1);
+    k_means(k, iter, coreset_size);
+    if (stats_json >= 0) stats_print(stderr, stats_json);
     return 0;
 }